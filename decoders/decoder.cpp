@@ -1,6 +1,47 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #include "decoder.h"
 
-Decoder::Decoder()
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+Decoder::Decoder() :
+  video_output_format_(AV_PIX_FMT_RGBA),
+  audio_output_rate_(48000),
+  audio_output_layout_(AV_CH_LAYOUT_STEREO)
 {
+}
+
+Decoder::~Decoder()
+{
+}
 
+void Decoder::SetVideoOutputFormat(AVPixelFormat format)
+{
+  video_output_format_ = format;
+}
+
+void Decoder::SetAudioOutputFormat(int sample_rate, uint64_t channel_layout)
+{
+  audio_output_rate_ = sample_rate;
+  audio_output_layout_ = channel_layout;
 }
@@ -1,11 +1,203 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #ifndef DECODER_H
 #define DECODER_H
 
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/rational.h>
+#include <libavutil/pixfmt.h>
+}
 
+#include <QString>
+
+/**
+ * @brief The Decoder class
+ *
+ * An abstract pull-based interface for decoding a single stream from a media file. Unlike Cacher, a Decoder has no
+ * dependencies on Clip, Sequence, the UI or OpenGL, and does no threading of its own. The caller simply asks for
+ * the frame at a certain time (or a range of audio samples) and the Decoder seeks and decodes as necessary to provide
+ * it, which makes it usable from any thread or tool that needs decoded media (e.g. preview/proxy generation or
+ * benchmarking).
+ *
+ * All times are in seconds and are converted to timestamps in the stream's time base the same way Cacher does (see
+ * seconds_to_timestamp()), so a Decoder and a Cacher will return the same frame for the same time.
+ */
 class Decoder
 {
 public:
+  /**
+   * @brief Decoder Constructor
+   */
   Decoder();
+
+  /**
+   * @brief Decoder Destructor
+   */
+  virtual ~Decoder();
+
+  /**
+   * @brief Open a stream from a file for decoding
+   *
+   * @param filename
+   *
+   * Path to the media file
+   *
+   * @param stream_index
+   *
+   * Index of the stream in the file to decode (see FootageStream::file_index)
+   *
+   * @return
+   *
+   * **TRUE** if the stream was opened successfully.
+   */
+  virtual bool Open(const QString& filename, int stream_index) = 0;
+
+  /**
+   * @brief Close the stream and free any memory allocated by the decoder
+   */
+  virtual void Close() = 0;
+
+  /**
+   * @brief Returns whether the decoder is currently open
+   */
+  virtual bool IsOpen() = 0;
+
+  /**
+   * @brief Seek the decoder
+   *
+   * The next frame decoded will be the frame at or before this timestamp. Retrieve functions seek automatically when
+   * necessary so calling this directly is usually not required.
+   *
+   * @param timestamp
+   *
+   * Timestamp in the stream's time base (see time_base())
+   *
+   * @return
+   *
+   * **TRUE** if the seek succeeded.
+   */
+  virtual bool Seek(int64_t timestamp) = 0;
+
+  /**
+   * @brief Retrieve the video frame that should be displayed at a certain time
+   *
+   * @param time
+   *
+   * Time in seconds
+   *
+   * @return
+   *
+   * A frame converted to the video output format (see SetVideoOutputFormat()) that the caller takes ownership of (free
+   * with av_frame_free()), or `nullptr` if no frame could be retrieved.
+   */
+  virtual AVFrame* RetrieveVideo(double time) = 0;
+
+  /**
+   * @brief Retrieve the keyframe closest to (at or before) a certain time
+   *
+   * Much cheaper than RetrieveVideo() since only one frame is decoded after seeking, but the frame is only an
+   * approximation of the one displayed at this time. Intended for previews (e.g. timeline thumbnails).
+   *
+   * @param time
+   *
+   * Time in seconds
+   *
+   * @return
+   *
+   * A frame converted to the video output format (see SetVideoOutputFormat()) that the caller takes ownership of (free
+   * with av_frame_free()), or `nullptr` if no frame could be retrieved.
+   */
+  virtual AVFrame* RetrieveKeyframe(double time) = 0;
+
+  /**
+   * @brief Retrieve a range of audio samples
+   *
+   * @param time
+   *
+   * Time in seconds of the first sample to retrieve
+   *
+   * @param nb_samples
+   *
+   * Number of samples (per channel) to retrieve
+   *
+   * @param samples
+   *
+   * Buffer to write interleaved float samples in the audio output format (see SetAudioOutputFormat()) to. Must be at
+   * least `nb_samples * channels` floats long.
+   *
+   * @return
+   *
+   * The number of samples per channel written, which may be less than `nb_samples` if the end of the stream was
+   * reached, or a negative value on error.
+   */
+  virtual int RetrieveAudio(double time, int nb_samples, float* samples) = 0;
+
+  /**
+   * @brief Returns the time base of the stream's timestamps
+   */
+  virtual AVRational time_base() = 0;
+
+  /**
+   * @brief Returns the duration of the stream in seconds, or 0 if unknown
+   */
+  virtual double duration() = 0;
+
+  /**
+   * @brief Returns the time in seconds of the start of the stream
+   *
+   * Times passed to RetrieveVideo() and RetrieveAudio() are absolute, so a stream that doesn't start at 0 must be
+   * read from this time to get its first frame or sample.
+   */
+  virtual double start_time() = 0;
+
+  /**
+   * @brief Set the pixel format video frames will be converted to by RetrieveVideo()
+   *
+   * Defaults to AV_PIX_FMT_RGBA.
+   */
+  void SetVideoOutputFormat(AVPixelFormat format);
+
+  /**
+   * @brief Set the sample rate and channel layout audio will be converted to by RetrieveAudio()
+   *
+   * Defaults to 48000Hz stereo. Must be called before Open() to take effect.
+   */
+  void SetAudioOutputFormat(int sample_rate, uint64_t channel_layout);
+
+protected:
+  /**
+   * @brief Pixel format for RetrieveVideo()
+   */
+  AVPixelFormat video_output_format_;
+
+  /**
+   * @brief Sample rate for RetrieveAudio()
+   */
+  int audio_output_rate_;
+
+  /**
+   * @brief Channel layout for RetrieveAudio()
+   */
+  uint64_t audio_output_layout_;
 };
 
-#endif // DECODER_H
\ No newline at end of file
+#endif // DECODER_H
@@ -1,6 +1,540 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #include "ffmpegdecoder.h"
 
-FFmpegDecoder::FFmpegDecoder()
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+#include <QDebug>
+
+#include "rendering/framepool.h"
+
+// how far ahead of the current frame a video request can be before seeking is assumed to be faster than decoding
+// every frame in between
+const double kMaxDecodeAheadSeconds = 2.0;
+
+FFmpegDecoder::FFmpegDecoder() :
+  fmt_ctx_(nullptr),
+  codec_ctx_(nullptr),
+  stream_(nullptr),
+  pkt_(nullptr),
+  eof_sent_(false),
+  current_frame_(nullptr),
+  next_frame_(nullptr),
+  sws_ctx_(nullptr),
+  swr_ctx_(nullptr),
+  audio_fifo_(nullptr),
+  audio_fifo_start_(-1)
+{
+}
+
+FFmpegDecoder::~FFmpegDecoder()
+{
+  Close();
+}
+
+bool FFmpegDecoder::Open(const QString &filename, int stream_index)
+{
+  Close();
+
+  QByteArray filename_bytes = filename.toUtf8();
+
+  int err_code = avformat_open_input(&fmt_ctx_, filename_bytes.constData(), nullptr, nullptr);
+  if (err_code != 0) {
+    char err[1024];
+    av_strerror(err_code, err, 1024);
+    qCritical() << "Could not open" << filename << "-" << err;
+    return false;
+  }
+
+  err_code = avformat_find_stream_info(fmt_ctx_, nullptr);
+  if (err_code < 0) {
+    char err[1024];
+    av_strerror(err_code, err, 1024);
+    qCritical() << "Could not open" << filename << "-" << err;
+    Close();
+    return false;
+  }
+
+  if (stream_index < 0 || stream_index >= int(fmt_ctx_->nb_streams)) {
+    qCritical() << "Stream" << stream_index << "does not exist in" << filename;
+    Close();
+    return false;
+  }
+
+  stream_ = fmt_ctx_->streams[stream_index];
+
+  if (stream_->codecpar->codec_type != AVMEDIA_TYPE_VIDEO && stream_->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+    qCritical() << "Stream" << stream_index << "in" << filename << "is not a video or audio stream";
+    Close();
+    return false;
+  }
+
+  // we only need packets from our stream, don't let the demuxer waste time on the others
+  for (unsigned int i=0;i<fmt_ctx_->nb_streams;i++) {
+    if (int(i) != stream_index) {
+      fmt_ctx_->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  AVCodec* codec = avcodec_find_decoder(stream_->codecpar->codec_id);
+  if (codec == nullptr) {
+    qCritical() << "No decoder available for stream" << stream_index << "in" << filename;
+    Close();
+    return false;
+  }
+
+  codec_ctx_ = avcodec_alloc_context3(codec);
+  avcodec_parameters_to_context(codec_ctx_, stream_->codecpar);
+
+  AVDictionary* opts = nullptr;
+  av_dict_set(&opts, "threads", "auto", 0);
+
+  err_code = avcodec_open2(codec_ctx_, codec, &opts);
+  av_dict_free(&opts);
+
+  if (err_code < 0) {
+    qCritical() << "Could not open codec for" << filename << "-" << err_code;
+    Close();
+    return false;
+  }
+
+  if (stream_->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+    uint64_t in_layout = codec_ctx_->channel_layout;
+    if (in_layout == 0) {
+      in_layout = uint64_t(av_get_default_channel_layout(codec_ctx_->channels));
+    }
+
+    swr_ctx_ = swr_alloc_set_opts(nullptr,
+                                  int64_t(audio_output_layout_),
+                                  AV_SAMPLE_FMT_FLT,
+                                  audio_output_rate_,
+                                  int64_t(in_layout),
+                                  codec_ctx_->sample_fmt,
+                                  codec_ctx_->sample_rate,
+                                  0,
+                                  nullptr);
+
+    if (swr_ctx_ == nullptr || swr_init(swr_ctx_) < 0) {
+      qCritical() << "Could not create resampler for" << filename;
+      Close();
+      return false;
+    }
+
+    audio_fifo_ = av_audio_fifo_alloc(AV_SAMPLE_FMT_FLT,
+                                      av_get_channel_layout_nb_channels(audio_output_layout_),
+                                      audio_output_rate_);
+  }
+
+  pkt_ = av_packet_alloc();
+
+  ResetState();
+
+  return true;
+}
+
+void FFmpegDecoder::Close()
+{
+  av_frame_free(&current_frame_);
+  av_frame_free(&next_frame_);
+
+  if (audio_fifo_ != nullptr) {
+    av_audio_fifo_free(audio_fifo_);
+    audio_fifo_ = nullptr;
+  }
+
+  swr_free(&swr_ctx_);
+
+  sws_freeContext(sws_ctx_);
+  sws_ctx_ = nullptr;
+
+  av_packet_free(&pkt_);
+  avcodec_free_context(&codec_ctx_);
+  avformat_close_input(&fmt_ctx_);
+
+  stream_ = nullptr;
+}
+
+bool FFmpegDecoder::IsOpen()
+{
+  return codec_ctx_ != nullptr && avcodec_is_open(codec_ctx_);
+}
+
+bool FFmpegDecoder::Seek(int64_t timestamp)
+{
+  if (!IsOpen()) {
+    return false;
+  }
+
+  avcodec_flush_buffers(codec_ctx_);
+  ResetState();
+
+  int ret = av_seek_frame(fmt_ctx_, stream_->index, timestamp, AVSEEK_FLAG_BACKWARD);
+  if (ret < 0) {
+    qWarning() << "Failed to seek to" << timestamp << "-" << ret;
+    return false;
+  }
+
+  return true;
+}
+
+AVFrame *FFmpegDecoder::RetrieveVideo(double time)
+{
+  if (!IsOpen() || stream_->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    return nullptr;
+  }
+
+  int64_t target_pts = qRound64(time * av_q2d(av_inv_q(stream_->time_base)));
+  int64_t max_decode_ahead = qRound64(kMaxDecodeAheadSeconds * av_q2d(av_inv_q(stream_->time_base)));
+
+  // only seek if we can't get to the target by decoding forward from where we are
+  if (current_frame_ == nullptr
+      || target_pts < current_frame_->pts
+      || target_pts - current_frame_->pts > max_decode_ahead) {
+    if (!SeekToFrame(target_pts)) {
+      return nullptr;
+    }
+  }
+
+  // decode until the next frame would be after the target
+  while (true) {
+    if (next_frame_ == nullptr) {
+      next_frame_ = av_frame_alloc();
+      if (DecodeNextFrame(next_frame_) < 0) {
+        // end of the stream (or an error), the current frame is the last one we'll get
+        av_frame_free(&next_frame_);
+        break;
+      }
+    }
+
+    if (next_frame_->pts > target_pts) {
+      break;
+    }
+
+    av_frame_free(&current_frame_);
+    current_frame_ = next_frame_;
+    next_frame_ = nullptr;
+  }
+
+  return ConvertVideoFrame(current_frame_);
+}
+
+AVFrame *FFmpegDecoder::RetrieveKeyframe(double time)
+{
+  if (!IsOpen() || stream_->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    return nullptr;
+  }
+
+  int64_t target_pts = qRound64(time * av_q2d(av_inv_q(stream_->time_base)));
+
+  // the first frame decoded after seeking is the keyframe, don't decode forward to the exact frame
+  if (!SeekToFrame(target_pts)) {
+    return nullptr;
+  }
+
+  return ConvertVideoFrame(current_frame_);
+}
+
+int FFmpegDecoder::RetrieveAudio(double time, int nb_samples, float *samples)
 {
+  if (!IsOpen() || stream_->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+    return -1;
+  }
+
+  int64_t start_sample = qRound64(time * audio_output_rate_);
+
+  // only seek if we can't get to the start by decoding forward from where we are
+  if (audio_fifo_start_ < 0
+      || start_sample < audio_fifo_start_
+      || start_sample - audio_fifo_start_ > audio_output_rate_ * kMaxDecodeAheadSeconds) {
+    if (!SeekToSample(start_sample)) {
+      return -1;
+    }
+  }
+
+  // skip any samples before the start
+  while (audio_fifo_start_ < start_sample) {
+    int ret = FillAudioFifo(1);
+    if (ret < 0 && av_audio_fifo_size(audio_fifo_) == 0) {
+      return (ret == AVERROR_EOF) ? 0 : ret;
+    }
+
+    int skip = int(qMin(start_sample - audio_fifo_start_, int64_t(av_audio_fifo_size(audio_fifo_))));
+    av_audio_fifo_drain(audio_fifo_, skip);
+    audio_fifo_start_ += skip;
+  }
+
+  int ret = FillAudioFifo(nb_samples);
+  if (ret < 0 && ret != AVERROR_EOF) {
+    return ret;
+  }
+
+  void* data[] = {samples};
+  int read = av_audio_fifo_read(audio_fifo_, data, nb_samples);
+  if (read > 0) {
+    audio_fifo_start_ += read;
+  }
+
+  return read;
+}
+
+AVRational FFmpegDecoder::time_base()
+{
+  if (stream_ == nullptr) {
+    return av_make_q(0, 1);
+  }
+
+  return stream_->time_base;
+}
+
+double FFmpegDecoder::duration()
+{
+  if (stream_ == nullptr) {
+    return 0;
+  }
+
+  if (stream_->duration != AV_NOPTS_VALUE) {
+    return stream_->duration * av_q2d(stream_->time_base);
+  }
+
+  if (fmt_ctx_->duration != AV_NOPTS_VALUE) {
+    return double(fmt_ctx_->duration) / AV_TIME_BASE;
+  }
+
+  return 0;
+}
+
+double FFmpegDecoder::start_time()
+{
+  if (stream_ == nullptr || stream_->start_time == AV_NOPTS_VALUE) {
+    return 0;
+  }
+
+  return stream_->start_time * av_q2d(stream_->time_base);
+}
+
+int FFmpegDecoder::DecodeNextFrame(AVFrame *f)
+{
+  int receive_ret;
+
+  av_frame_unref(f);
+  while ((receive_ret = avcodec_receive_frame(codec_ctx_, f)) == AVERROR(EAGAIN)) {
+    int read_ret;
+    do {
+      av_packet_unref(pkt_);
+      read_ret = av_read_frame(fmt_ctx_, pkt_);
+    } while (read_ret >= 0 && pkt_->stream_index != stream_->index);
+
+    if (read_ret >= 0) {
+      int send_ret = avcodec_send_packet(codec_ctx_, pkt_);
+      av_packet_unref(pkt_);
+      if (send_ret < 0) {
+        qCritical() << "Failed to send packet to decoder." << send_ret;
+        return send_ret;
+      }
+    } else if (read_ret == AVERROR_EOF) {
+      if (eof_sent_) {
+        return AVERROR_EOF;
+      }
+
+      // flush the decoder so it returns any frames it's still holding
+      int send_ret = avcodec_send_packet(codec_ctx_, nullptr);
+      if (send_ret < 0) {
+        qCritical() << "Failed to send packet to decoder." << send_ret;
+        return send_ret;
+      }
+      eof_sent_ = true;
+    } else {
+      qCritical() << "Could not read frame." << read_ret;
+      return read_ret;
+    }
+  }
+
+  if (receive_ret < 0) {
+    if (receive_ret != AVERROR_EOF) {
+      qCritical() << "Failed to receive frame from decoder." << receive_ret;
+    }
+    return receive_ret;
+  }
+
+  if (f->pts == AV_NOPTS_VALUE) {
+    f->pts = f->best_effort_timestamp;
+  }
+
+  return 0;
+}
+
+AVFrame *FFmpegDecoder::ConvertVideoFrame(AVFrame *f)
+{
+  if (f == nullptr) {
+    return nullptr;
+  }
+
+  sws_ctx_ = sws_getCachedContext(sws_ctx_,
+                                  f->width,
+                                  f->height,
+                                  static_cast<AVPixelFormat>(f->format),
+                                  f->width,
+                                  f->height,
+                                  video_output_format_,
+                                  SWS_BILINEAR,
+                                  nullptr,
+                                  nullptr,
+                                  nullptr);
+  if (sws_ctx_ == nullptr) {
+    qCritical() << "Could not create video converter";
+    return nullptr;
+  }
+
+  AVFrame* out = olive::frame_pool.Get(f->width, f->height, video_output_format_);
+  if (out == nullptr) {
+    return nullptr;
+  }
+
+  sws_scale(sws_ctx_, f->data, f->linesize, 0, f->height, out->data, out->linesize);
+  av_frame_copy_props(out, f);
+
+  return out;
+}
+
+bool FFmpegDecoder::SeekToFrame(int64_t target_pts)
+{
+  int64_t stream_start = (stream_->start_time == AV_NOPTS_VALUE) ? 0 : stream_->start_time;
+  int64_t seek_ts = target_pts;
+  int64_t backoff = qMax(int64_t(1), qRound64(av_q2d(av_inv_q(stream_->time_base))));
+
+  // some formats seek past the target, keep seeking further back until the first frame is at or before it
+  while (true) {
+    if (!Seek(seek_ts)) {
+      return false;
+    }
+
+    current_frame_ = av_frame_alloc();
+    if (DecodeNextFrame(current_frame_) < 0) {
+      av_frame_free(&current_frame_);
+      return false;
+    }
+
+    if (current_frame_->pts <= target_pts || seek_ts <= stream_start) {
+      return true;
+    }
+
+    seek_ts -= backoff;
+    backoff *= 2;
+  }
+}
+
+bool FFmpegDecoder::SeekToSample(int64_t sample)
+{
+  int64_t target_ts = av_rescale_q(sample, av_make_q(1, audio_output_rate_), stream_->time_base);
+  int64_t stream_start = (stream_->start_time == AV_NOPTS_VALUE) ? 0 : stream_->start_time;
+  int64_t seek_ts = target_ts;
+  int64_t backoff = qMax(int64_t(1), qRound64(av_q2d(av_inv_q(stream_->time_base))));
+
+  while (true) {
+    if (!Seek(seek_ts)) {
+      return false;
+    }
+
+    int ret = FillAudioFifo(1);
+    if (ret == AVERROR_EOF) {
+      // nothing left to decode, RetrieveAudio() will return no samples
+      return true;
+    } else if (ret < 0) {
+      return false;
+    }
+
+    if (audio_fifo_start_ <= sample || seek_ts <= stream_start) {
+      return true;
+    }
+
+    seek_ts -= backoff;
+    backoff *= 2;
+  }
+}
+
+int FFmpegDecoder::FillAudioFifo(int nb_samples)
+{
+  int channels = av_get_channel_layout_nb_channels(audio_output_layout_);
+  int ret = 0;
+
+  AVFrame* frame = av_frame_alloc();
+
+  while (av_audio_fifo_size(audio_fifo_) < nb_samples) {
+    ret = DecodeNextFrame(frame);
+    if (ret < 0) {
+      break;
+    }
+
+    // the first frame after a seek determines where the FIFO starts
+    if (audio_fifo_start_ < 0) {
+      int64_t pts = (frame->pts == AV_NOPTS_VALUE) ? 0 : frame->pts;
+      audio_fifo_start_ = av_rescale_q(pts, stream_->time_base, av_make_q(1, audio_output_rate_));
+    }
+
+    int out_count = swr_get_out_samples(swr_ctx_, frame->nb_samples);
+
+    uint8_t* buffer = nullptr;
+    av_samples_alloc(&buffer, nullptr, channels, out_count, AV_SAMPLE_FMT_FLT, 0);
+
+    int converted = swr_convert(swr_ctx_,
+                                &buffer,
+                                out_count,
+                                const_cast<const uint8_t**>(frame->extended_data),
+                                frame->nb_samples);
+
+    if (converted > 0) {
+      av_audio_fifo_write(audio_fifo_, reinterpret_cast<void**>(&buffer), converted);
+    }
+
+    av_freep(&buffer);
+
+    if (converted < 0) {
+      qCritical() << "Failed to resample audio." << converted;
+      ret = converted;
+      break;
+    }
+  }
+
+  av_frame_free(&frame);
+
+  return ret;
+}
+
+void FFmpegDecoder::ResetState()
+{
+  av_frame_free(&current_frame_);
+  av_frame_free(&next_frame_);
+
+  eof_sent_ = false;
+
+  if (audio_fifo_ != nullptr) {
+    av_audio_fifo_reset(audio_fifo_);
+  }
+  audio_fifo_start_ = -1;
 
+  // drop any samples the resampler is still holding from before the seek
+  if (swr_ctx_ != nullptr) {
+    swr_init(swr_ctx_);
+  }
 }
@@ -1,11 +1,144 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #ifndef FFMPEGDECODER_H
 #define FFMPEGDECODER_H
 
+#include "decoder.h"
 
-class FFmpegDecoder
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
+#include <libavutil/audio_fifo.h>
+}
+
+/**
+ * @brief The FFmpegDecoder class
+ *
+ * A Decoder implementation using FFmpeg's libavformat/libavcodec. Video frames are converted with libswscale into
+ * buffers from the global FramePool and audio is converted with libswresample.
+ *
+ * Sequential retrieval is cheap: as long as each request is at or slightly after the previous one, the decoder simply
+ * continues decoding from where it left off. Requests further away (or backwards) cause a seek.
+ *
+ * An FFmpegDecoder is not thread-safe, but separate instances can be used on separate threads freely.
+ */
+class FFmpegDecoder : public Decoder
 {
 public:
+  /**
+   * @brief FFmpegDecoder Constructor
+   */
   FFmpegDecoder();
+
+  /**
+   * @brief FFmpegDecoder Destructor
+   *
+   * Closes the decoder if it's still open.
+   */
+  virtual ~FFmpegDecoder() override;
+
+  virtual bool Open(const QString& filename, int stream_index) override;
+  virtual void Close() override;
+  virtual bool IsOpen() override;
+  virtual bool Seek(int64_t timestamp) override;
+  virtual AVFrame* RetrieveVideo(double time) override;
+  virtual AVFrame* RetrieveKeyframe(double time) override;
+  virtual int RetrieveAudio(double time, int nb_samples, float* samples) override;
+  virtual AVRational time_base() override;
+  virtual double duration() override;
+  virtual double start_time() override;
+
+private:
+  /**
+   * @brief Decode the next frame from the stream
+   *
+   * @return
+   *
+   * 0 on success, AVERROR_EOF at the end of the stream, or another negative error code on failure.
+   */
+  int DecodeNextFrame(AVFrame* f);
+
+  /**
+   * @brief Convert a decoded video frame to the video output format
+   *
+   * @return
+   *
+   * A new frame that the caller takes ownership of, or `nullptr` on failure.
+   */
+  AVFrame* ConvertVideoFrame(AVFrame* f);
+
+  /**
+   * @brief Seek to a timestamp and decode until the frame at or before it is current_frame_
+   */
+  bool SeekToFrame(int64_t target_pts);
+
+  /**
+   * @brief Seek the audio to a sample (in the output sample rate) and reset the audio FIFO
+   */
+  bool SeekToSample(int64_t sample);
+
+  /**
+   * @brief Decode and convert audio into the FIFO until it contains at least `nb_samples`
+   */
+  int FillAudioFifo(int nb_samples);
+
+  /**
+   * @brief Free any decoded frames and reset decoding state, called after seeking and closing
+   */
+  void ResetState();
+
+  AVFormatContext* fmt_ctx_;
+  AVCodecContext* codec_ctx_;
+  AVStream* stream_;
+  AVPacket* pkt_;
+
+  /**
+   * @brief Set once the decoder has been sent a flush packet at the end of the file
+   */
+  bool eof_sent_;
+
+  /**
+   * @brief The latest decoded video frame at or before the last requested time
+   */
+  AVFrame* current_frame_;
+
+  /**
+   * @brief A decoded video frame after current_frame_ that hasn't been reached yet (or `nullptr`)
+   */
+  AVFrame* next_frame_;
+
+  SwsContext* sws_ctx_;
+  SwrContext* swr_ctx_;
+
+  /**
+   * @brief Converted audio samples waiting to be retrieved
+   */
+  AVAudioFifo* audio_fifo_;
+
+  /**
+   * @brief Index (in the output sample rate) of the first sample in audio_fifo_
+   */
+  int64_t audio_fifo_start_;
 };
 
-#endif // FFMPEGDECODER_H
\ No newline at end of file
+#endif // FFMPEGDECODER_H
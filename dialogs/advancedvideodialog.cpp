@@ -24,6 +24,7 @@
 #include <QGridLayout>
 #include <QLabel>
 #include <QComboBox>
+#include <QThread>
 
 #include <QDebug>
 
@@ -89,6 +90,38 @@ AdvancedVideoDialog::AdvancedVideoDialog(QWidget *parent,
 
   row++;
 
+  // create row for segmented exporting
+  layout->addWidget(new QLabel(tr("Segments:")), row, 0);
+
+  segment_spinbox_ = new QSpinBox();
+
+  // one segment exports the video as a single stream
+  segment_spinbox_->setRange(1, qMax(1, QThread::idealThreadCount()));
+  segment_spinbox_->setSpecialValueText(tr("Off"));
+  segment_spinbox_->setToolTip(tr("Render and encode this many parts of the video at the same time and join them "
+                                  "into one file afterwards. Uses more memory, but is faster on computers with many "
+                                  "CPU cores."));
+
+  // load current segment value
+  segment_spinbox_->setValue(params_.segments);
+
+  layout->addWidget(segment_spinbox_, row, 1);
+
+  row++;
+
+  // create row for smart rendering
+  smart_render_checkbox_ = new QCheckBox(tr("Copy Unaltered Footage"));
+  smart_render_checkbox_->setToolTip(tr("Copy frames that are shown unaltered straight from the footage files where "
+                                        "they're already encoded with this codec, pixel format and size, and only "
+                                        "encode the frames around them."));
+
+  // load current smart render value
+  smart_render_checkbox_->setChecked(params_.smart_render);
+
+  layout->addWidget(smart_render_checkbox_, row, 0, 1, 2);
+
+  row++;
+
   // buttons
   QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
   buttons->setCenterButtons(true);
@@ -102,6 +135,8 @@ void AdvancedVideoDialog::accept() {
 
   params_.pix_fmt = pix_fmt_combo_->currentData().toInt();
   params_.threads = thread_spinbox_->value();
+  params_.segments = segment_spinbox_->value();
+  params_.smart_render = smart_render_checkbox_->isChecked();
 
   QDialog::accept();
 }
@@ -24,6 +24,7 @@
 #include <QDialog>
 #include <QComboBox>
 #include <QSpinBox>
+#include <QCheckBox>
 
 #include "rendering/exportthread.h"
 
@@ -75,6 +76,16 @@ private:
    * @brief SpinBox for multithreading settings
    */
   QSpinBox* thread_spinbox_;
+
+  /**
+   * @brief SpinBox for the amount of segments to export in parallel
+   */
+  QSpinBox* segment_spinbox_;
+
+  /**
+   * @brief CheckBox for copying unaltered footage instead of re-encoding it
+   */
+  QCheckBox* smart_render_checkbox_;
 };
 
 #endif // ADVANCEDVIDEODIALOG_H
@@ -129,7 +129,8 @@ void AutoCutSilenceDialog::cut_silence() {
     // Check if this clip is an audio footage clip
     if (clip->type() == olive::kTypeAudio
         && clip->media() != nullptr
-        && clip->media_stream()->preview_done) { // TODO provide warning for preview not being done
+        && clip->media_stream()->preview_done
+        && clip->media_stream()->audio_preview != nullptr) { // TODO provide warning for preview not being done
 
       QVector<long> split_positions;
 
@@ -137,8 +138,8 @@ void AutoCutSilenceDialog::cut_silence() {
       const FootageStream* ms = clip->media_stream();
 
       long media_length = clip->media_length();
-      int preview_size = ms->audio_preview.length();
-      float chunk_size = (float)preview_size/media_length;  // how many audio samples to read for each fotogram
+      const WaveformPyramid* waveform = ms->audio_preview.get();
+      double chunk_size = double(waveform->level_size(0))/media_length;  // how many waveform points to read for each fotogram
 
       int sample_size = qMax(current_attack_time, current_release_time)+1;
 
@@ -151,13 +152,15 @@ void AutoCutSilenceDialog::cut_silence() {
 
       // loop through the entire sequence
       for (long i=clip_start;i<media_length+clip_start;i++) {
-        long start = ((i-clip_start)*chunk_size);     //audio samples are read relative to the clip, not absolute to the timeline
+        qint64 start = qint64((i-clip_start)*chunk_size);     //audio samples are read relative to the clip, not absolute to the timeline
+        qint64 end = qint64((i-clip_start+1)*chunk_size);
         int circular_index = i%sample_size;
 
-        // read the current sample into the circular array
+        // read the current peak of all channels into the circular array
         qint8 tmp = 0;
-        for (long k=start; k<start+chunk_size; k++){
-          tmp = qMax(tmp, qint8(qRound(double(ms->audio_preview.at(k)))));
+        for (int k=0; k<waveform->channels(); k++){
+          WaveformPoint point = waveform->Summarize(0, k, start, end);
+          tmp = qMax(tmp, qMax(point.max, qint8(-point.min)));
         }
         vols[circular_index] = tmp;
 
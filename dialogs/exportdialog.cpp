@@ -68,8 +68,9 @@ enum ExportFormats {
   FORMAT_SIZE
 };
 
-ExportDialog::ExportDialog(QWidget *parent, Sequence* sequence) :
+ExportDialog::ExportDialog(QWidget *parent, SequencePtr sequence) :
   QDialog(parent),
+  export_thread_(nullptr),
   sequence_(sequence)
 {
   setWindowTitle(tr("Export \"%1\"").arg(sequence->name()));
@@ -117,6 +118,9 @@ ExportDialog::ExportDialog(QWidget *parent, Sequence* sequence) :
 
   // set some advanced defaults
   vcodec_params.threads = 0;
+  vcodec_params.gop_size = 0;
+  vcodec_params.segments = 1;
+  vcodec_params.smart_render = false;
 }
 
 void ExportDialog::add_codec_to_combobox(QComboBox* box, enum AVCodecID codec) {
@@ -332,6 +336,8 @@ void ExportDialog::format_changed(int index) {
 }
 
 void ExportDialog::export_thread_finished() {
+  olive::Global->set_export_state(false);
+
   // Determine if the export succeeded
   bool succeeded = (progressBar->value() == 100);
 
@@ -345,16 +351,9 @@ void ExportDialog::export_thread_finished() {
           );
   }
 
-  // Clear audio buffer
-  clear_audio_ibuffer();
-
   // Re-enable/disable UI widgets based on the rendering state
   prep_ui_for_render(false);
 
-  // Move OpenGL context back to the sequence viewer
-  panel_sequence_viewer->viewer_widget()->makeCurrent();
-  panel_sequence_viewer->viewer_widget()->initializeGL();
-
   // Update the application UI
   update_ui(false);
 
@@ -363,6 +362,7 @@ void ExportDialog::export_thread_finished() {
 
   // Free the export thread
   export_thread_->deleteLater();
+  export_thread_ = nullptr;
 
   // If the export succeeded, close the dialog
   if (succeeded) {
@@ -370,6 +370,15 @@ void ExportDialog::export_thread_finished() {
   }
 }
 
+void ExportDialog::reject()
+{
+  if (export_thread_ != nullptr) {
+    return;
+  }
+
+  QDialog::reject();
+}
+
 void ExportDialog::prep_ui_for_render(bool r) {
   export_button->setEnabled(!r);
   cancel_button->setEnabled(!r);
@@ -538,7 +547,7 @@ void ExportDialog::StartExport() {
 
     // Set up export parameters to send to the ExportThread
     ExportParams params;
-    params.sequence = sequence_;
+    params.sequence = sequence_.get();
     params.filename = filename;
     params.video_enabled = videoGroupbox->isChecked();
     if (params.video_enabled) {
@@ -571,12 +580,6 @@ void ExportDialog::StartExport() {
     connect(export_thread_, SIGNAL(ProgressChanged(int, qint64)), this, SLOT(update_progress_bar(int, qint64)));
     connect(renderCancel, SIGNAL(clicked(bool)), export_thread_, SLOT(Interrupt()));
 
-    // Close all effects in effect controls (prevents UI threading issues)
-    panel_effect_controls->Clear();
-
-    // Close all currently open clips
-    sequence_->Close();
-
     olive::Global->set_export_state(true);
 
     olive::Global->save_autorecovery_file();
@@ -38,6 +38,9 @@
  * The dialog to initiate an export. Requires a valid Sequence to be set in olive::ActiveSequence or the result is
  * defined (most likely a crash), so you should always do a `nullptr` check on olive::ActiveSequence before constructing
  * this dialog.
+ *
+ * The dialog is intended to be shown non-modally so the user can keep editing (or start further exports) while it
+ * runs. It holds a reference to its Sequence so the Sequence outlives it even if it's closed in the meantime.
  */
 class ExportDialog : public QDialog
 {
@@ -50,7 +53,15 @@ public:
    *
    * QWidget parent. Usually MainWindow.
    */
-  explicit ExportDialog(QWidget *parent, Sequence *sequence);
+  explicit ExportDialog(QWidget *parent, SequencePtr sequence);
+
+public slots:
+  /**
+   * @brief Overridden reject() that ignores attempts to close the dialog while an export is running
+   *
+   * The export has to be cancelled with the progress bar's cancel button first.
+   */
+  virtual void reject() override;
 
 private slots:
   /**
@@ -271,7 +282,7 @@ private:
    */
   qint64 total_export_time_start;
 
-  Sequence* sequence_;
+  SequencePtr sequence_;
 };
 
 #endif // EXPORTDIALOG_H
@@ -413,16 +413,21 @@ void PreferencesDialog::accept() {
   olive::config.upcoming_queue_type = upcoming_queue_type->currentIndex();
   olive::config.previous_queue_size = previous_queue_spinbox->value();
   olive::config.previous_queue_type = previous_queue_type->currentIndex();
+  olive::config.frame_cache_size = frame_cache_spinbox->value();
+  olive::config.decode_threads = decode_threads_spinbox->value();
+  olive::config.clip_lookahead = clip_lookahead_spinbox->value();
 
   // Audio settings may require the audio device to be re-initiated.
   if (olive::config.preferred_audio_output != audio_output_devices->currentData().toString()
       || olive::config.preferred_audio_input != audio_input_devices->currentData().toString()
-      || olive::config.audio_rate != audio_sample_rate->currentData().toInt()) {
+      || olive::config.audio_rate != audio_sample_rate->currentData().toInt()
+      || olive::config.audio_period_size != audio_period_size->currentData().toInt()) {
     reinit_audio = true;
   }
   olive::config.preferred_audio_output = audio_output_devices->currentData().toString();
   olive::config.preferred_audio_input = audio_input_devices->currentData().toString();
   olive::config.audio_rate = audio_sample_rate->currentData().toInt();
+  olive::config.audio_period_size = audio_period_size->currentData().toInt();
 
   olive::config.effect_textbox_lines = effect_textbox_lines_field->value();
 
@@ -967,8 +972,32 @@ void PreferencesDialog::setup_ui() {
   previous_queue_type->addItem(tr("seconds"));
   previous_queue_type->setCurrentIndex(olive::config.previous_queue_type);
   memory_usage_layout->addWidget(previous_queue_type, 1, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Shared Frame Cache:"), playback_tab), 2, 0);
+  frame_cache_spinbox = new QSpinBox(playback_tab);
+  frame_cache_spinbox->setMaximum(65536);
+  frame_cache_spinbox->setValue(olive::config.frame_cache_size);
+  memory_usage_layout->addWidget(frame_cache_spinbox, 2, 1);
+  memory_usage_layout->addWidget(new QLabel(tr("MB"), playback_tab), 2, 2);
   playback_tab_layout->addWidget(memory_usage_group);
 
+  // Playback -> Decoding
+  QGroupBox* decoding_group = new QGroupBox(playback_tab);
+  decoding_group->setTitle(tr("Decoding"));
+  QGridLayout* decoding_layout = new QGridLayout(decoding_group);
+  decoding_layout->addWidget(new QLabel(tr("Decoding Threads:"), playback_tab), 0, 0);
+  decode_threads_spinbox = new QSpinBox(playback_tab);
+  decode_threads_spinbox->setMaximum(256);
+  decode_threads_spinbox->setSpecialValueText(tr("Automatic"));
+  decode_threads_spinbox->setValue(olive::config.decode_threads);
+  decoding_layout->addWidget(decode_threads_spinbox, 0, 1);
+  decoding_layout->addWidget(new QLabel(tr("Open Clips Ahead:"), playback_tab), 1, 0);
+  clip_lookahead_spinbox = new QDoubleSpinBox(playback_tab);
+  clip_lookahead_spinbox->setMaximum(60);
+  clip_lookahead_spinbox->setValue(olive::config.clip_lookahead);
+  decoding_layout->addWidget(clip_lookahead_spinbox, 1, 1);
+  decoding_layout->addWidget(new QLabel(tr("seconds"), playback_tab), 1, 2);
+  playback_tab_layout->addWidget(decoding_group);
+
   tabWidget->addTab(playback_tab, tr("Playback"));
 
   // Audio
@@ -1041,6 +1070,22 @@ void PreferencesDialog::setup_ui() {
 
   row++;
 
+  // Audio -> Period Size
+
+  audio_tab_layout->addWidget(new QLabel(tr("Period Size:")), row, 0);
+
+  audio_period_size = new QComboBox();
+  for (int i=256;i<=2048;i*=2) {
+    audio_period_size->addItem(tr("%1 samples").arg(i), i);
+    if (i == olive::config.audio_period_size) {
+      audio_period_size->setCurrentIndex(audio_period_size->count()-1);
+    }
+  }
+
+  audio_tab_layout->addWidget(audio_period_size, row, 1);
+
+  row++;
+
   // Audio -> Audio Recording
   audio_tab_layout->addWidget(new QLabel(tr("Audio Recording:"), this), row, 0);
 
@@ -227,6 +227,21 @@ private:
    */
   QComboBox* previous_queue_type;
 
+  /**
+   * @brief UI widget for editing the shared frame cache size
+   */
+  QSpinBox* frame_cache_spinbox;
+
+  /**
+   * @brief UI widget for editing the amount of decoding threads
+   */
+  QSpinBox* decode_threads_spinbox;
+
+  /**
+   * @brief UI widget for editing how far ahead clips are opened during playback
+   */
+  QDoubleSpinBox* clip_lookahead_spinbox;
+
   /**
    * @brief UI widget for editing the size of textboxes in the EffectControls panel
    */
@@ -247,6 +262,11 @@ private:
    */
   QComboBox* audio_sample_rate;
 
+  /**
+   * @brief UI widget for selecting the audio output period size
+   */
+  QComboBox* audio_period_size;
+
   /**
    * @brief UI widget for selecting the UI language
    */
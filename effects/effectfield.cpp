@@ -22,7 +22,8 @@
 
 #include <QDateTime>
 #include <QtMath>
-#include <cfloat>
+#include <QMutexLocker>
+#include <algorithm>
 
 #include "rendering/renderfunctions.h"
 #include "global/config.h"
@@ -38,7 +39,10 @@
 EffectField::EffectField(NodeIO* parent, EffectFieldType t) :
   QObject(parent),
   type_(t),
-  enabled_(true)
+  enabled_(true),
+  keyframes_version_(0),
+  indexed_version_(-1),
+  segment_cursor_(-1)
 {
   // EffectField MUST be created with a parent.
   Q_ASSERT(parent != nullptr);
@@ -48,6 +52,9 @@ EffectField::EffectField(NodeIO* parent, EffectFieldType t) :
 
   // Connect this field to the effect's changed function
   connect(this, SIGNAL(Changed()), parent->ParentNode(), SLOT(FieldChanged()));
+
+  // Undo commands may modify keyframes directly, so check the keyframe index whenever the undo stack changes
+  connect(&olive::undo_stack, SIGNAL(indexChanged(int)), this, SLOT(KeyframesChanged()));
 }
 
 NodeIO *EffectField::GetParentRow()
@@ -70,91 +77,27 @@ void EffectField::UpdateWidgetValue(QWidget *, double) {}
 QVariant EffectField::GetValueAt(double timecode)
 {
   if (HasKeyframes()) {
+    QMutexLocker locker(&index_lock_);
+
+    UpdateKeyframeIndex();
+
     int before_keyframe;
     int after_keyframe;
     double progress;
     GetKeyframeData(timecode, before_keyframe, after_keyframe, progress);
 
-    const QVariant& before_data = keyframes.at(before_keyframe).data;
     switch (type_) {
     case EFFECT_FIELD_DOUBLE:
-    {
-      double value;
-      if (before_keyframe == after_keyframe) {
-        value = keyframes.at(before_keyframe).data.toDouble();
-      } else {
-        const EffectKeyframe& before_key = keyframes.at(before_keyframe);
-        const EffectKeyframe& after_key = keyframes.at(after_keyframe);
-
-        double before_dbl = before_key.data.toDouble();
-        double after_dbl = after_key.data.toDouble();
-
-        if (before_key.type == EFFECT_KEYFRAME_HOLD) {
-
-          // Hold keyframes will always return the previous keyframe with no interpolation
-          value = before_dbl;
-
-        } else if (before_key.type == EFFECT_KEYFRAME_BEZIER || after_key.type == EFFECT_KEYFRAME_BEZIER) {
-
-          // bezier interpolation
-          if (before_key.type == EFFECT_KEYFRAME_BEZIER && after_key.type == EFFECT_KEYFRAME_BEZIER) {
-
-            // cubic bezier
-            double t = cubic_t_from_x(timecode,
-                                      before_key.time,
-                                      before_key.time+GetValidKeyframeHandlePosition(before_keyframe, true),
-                                      after_key.time+GetValidKeyframeHandlePosition(after_keyframe, false),
-                                      after_key.time);
-
-            value = cubic_from_t(before_dbl,
-                                 before_dbl+before_key.post_handle.y(),
-                                 after_dbl+after_key.pre_handle.y(),
-                                 after_dbl,
-                                 t);
-
-          } else if (after_key.type == EFFECT_KEYFRAME_LINEAR) { // quadratic bezier
-
-            // last keyframe is the bezier one
-            double t = quad_t_from_x(timecode,
-                                     before_key.time,
-                                     before_key.time+GetValidKeyframeHandlePosition(before_keyframe, true),
-                                     after_key.time);
-
-            value = quad_from_t(before_dbl,
-                                before_dbl+before_key.post_handle.y(),
-                                after_dbl,
-                                t);
-
-          } else {
-            // this keyframe is the bezier one
-            double t = quad_t_from_x(timecode,
-                                     before_key.time,
-                                     after_key.time+GetValidKeyframeHandlePosition(after_keyframe, false),
-                                     after_key.time);
-
-            value = quad_from_t(before_dbl,
-                                after_dbl+after_key.pre_handle.y(),
-                                after_dbl,
-                                t);
-          }
-        } else {
-
-          // Linear interpolation (default)
-          value = double_lerp(before_dbl, after_dbl, progress);
-
-        }
-      }
-      persistent_data_ = value;
+      persistent_data_ = GetDoubleBetweenKeyframes(timecode, before_keyframe, after_keyframe, progress);
       break;
-    }
     case EFFECT_FIELD_COLOR:
     {
       QColor value;
       if (before_keyframe == after_keyframe) {
-        value = keyframes.at(before_keyframe).data.value<QColor>();
+        value = color_values_.at(before_keyframe);
       } else {
-        QColor before_data = keyframes.at(before_keyframe).data.value<QColor>();
-        QColor after_data = keyframes.at(after_keyframe).data.value<QColor>();
+        const QColor& before_data = color_values_.at(before_keyframe);
+        const QColor& after_data = color_values_.at(after_keyframe);
         value = QColor(lerp(before_data.red(), after_data.red(), progress),
                        lerp(before_data.green(), after_data.green(), progress),
                        lerp(before_data.blue(), after_data.blue(), progress));
@@ -167,7 +110,7 @@ QVariant EffectField::GetValueAt(double timecode)
     case EFFECT_FIELD_COMBO:
     case EFFECT_FIELD_FONT:
     case EFFECT_FIELD_FILE:
-      persistent_data_ = before_data;
+      persistent_data_ = keyframes.at(before_keyframe).data;
       break;
     default:
       break;
@@ -177,6 +120,85 @@ QVariant EffectField::GetValueAt(double timecode)
   return persistent_data_;
 }
 
+void EffectField::GetValuesInRange(double timecode_start, double timecode_end, float *values, int count)
+{
+  if (count <= 0) {
+    return;
+  }
+
+  if (!HasKeyframes()) {
+    std::fill(values, values + count, persistent_data_.toFloat());
+    return;
+  }
+
+  QMutexLocker locker(&index_lock_);
+
+  UpdateKeyframeIndex();
+
+  double interval = (timecode_end - timecode_start) / count;
+  int last_segment = sorted_keys_.size() - 1;
+
+  int i = 0;
+  while (i < count) {
+    double timecode = timecode_start + interval * i;
+
+    int segment = FindKeyframeSegment(timecode);
+
+    // every value up to the next keyframe uses the same segment of the curve
+    int segment_end = count;
+    if (segment < last_segment && interval > 0) {
+      double next_index = qCeil((sorted_times_.at(segment + 1) - timecode_start) / interval);
+      segment_end = qBound(i + 1, int(qMin(next_index, double(count))), count);
+    }
+
+    if (segment == -1 || segment == last_segment) {
+
+      // before the first keyframe or after the last one, the value is constant
+      float value = GetKeyframeFloat(sorted_keys_.at(qMax(segment, 0)));
+      std::fill(values + i, values + segment_end, value);
+
+    } else {
+
+      int before = sorted_keys_.at(segment);
+      int after = sorted_keys_.at(segment + 1);
+
+      const EffectKeyframe& before_key = keyframes.at(before);
+      const EffectKeyframe& after_key = keyframes.at(after);
+
+      if (type_ != EFFECT_FIELD_DOUBLE || before_key.type == EFFECT_KEYFRAME_HOLD) {
+
+        // no interpolation
+        std::fill(values + i, values + segment_end, GetKeyframeFloat(before));
+
+      } else if (before_key.type == EFFECT_KEYFRAME_BEZIER || after_key.type == EFFECT_KEYFRAME_BEZIER) {
+
+        // bezier curves have no closed form in time, so evaluate each value individually
+        double segment_length = after_key.time - before_key.time;
+        for (int j=i;j<segment_end;j++) {
+          double t = timecode_start + interval * j;
+          values[j] = float(GetDoubleBetweenKeyframes(t, before, after, (t - before_key.time) / segment_length));
+        }
+
+      } else {
+
+        // linear interpolation is a straight line in time
+        double before_dbl = double_values_.at(before);
+        double slope = (double_values_.at(after) - before_dbl) / (after_key.time - before_key.time);
+        double offset = before_dbl + slope * (timecode_start - before_key.time);
+        double step = slope * interval;
+
+        for (int j=i;j<segment_end;j++) {
+          values[j] = float(offset + step * j);
+        }
+
+      }
+
+    }
+
+    i = segment_end;
+  }
+}
+
 void EffectField::SetValueAt(double time, const QVariant &value)
 {
   if (HasKeyframes()) {
@@ -204,6 +226,8 @@ void EffectField::SetValueAt(double time, const QVariant &value)
       key.data = value;
     }
 
+    KeyframesChanged();
+
   } else {
 
     persistent_data_ = value;
@@ -225,6 +249,7 @@ void EffectField::PrepareDataForKeyframing(bool enabled, ComboAction *ca)
     key.type = EFFECT_KEYFRAME_LINEAR;
 
     keyframes.append(key);
+    KeyframesChanged();
 
     ca->append(new KeyframeAdd(this, keyframes.size()-1));
 
@@ -249,18 +274,17 @@ const EffectField::EffectFieldType &EffectField::type()
 }
 
 double EffectField::GetValidKeyframeHandlePosition(int key, bool post) {
-  int comp_key = -1;
+  QMutexLocker locker(&index_lock_);
+
+  UpdateKeyframeIndex();
 
+  return GetValidHandlePosition(key, post);
+}
+
+double EffectField::GetValidHandlePosition(int key, bool post) {
   // find keyframe before or after this one
-  for (int i=0;i<keyframes.size();i++) {
-    if (i != key
-        && ((keyframes.at(i).time > keyframes.at(key).time) == post)
-        && (comp_key == -1
-          || ((keyframes.at(i).time < keyframes.at(comp_key).time) == post))) {
-      // compare with next keyframe for post or previous frame for pre
-      comp_key = i;
-    }
-  }
+  int comp_position = sorted_positions_.at(key) + (post ? 1 : -1);
+  int comp_key = (comp_position >= 0 && comp_position < sorted_keys_.size()) ? sorted_keys_.at(comp_position) : -1;
 
   double adjusted_key = post ? keyframes.at(key).post_handle.x() : keyframes.at(key).pre_handle.x();
 
@@ -295,39 +319,195 @@ double EffectField::GetValidKeyframeHandlePosition(int key, bool post) {
 }
 
 void EffectField::GetKeyframeData(double timecode, int &before, int &after, double &progress) {
-  int before_keyframe_index = -1;
-  int after_keyframe_index = -1;
-  double before_keyframe_time = DBL_MIN;
-  double after_keyframe_time = DBL_MAX;
-
-  for (int i=0;i<keyframes.size();i++) {
-    double eval_keyframe_time = keyframes.at(i).time;
-    if (qFuzzyCompare(eval_keyframe_time, timecode)) {
-      before = i;
-      after = i;
-      return;
-    } else if (eval_keyframe_time < timecode && eval_keyframe_time > before_keyframe_time) {
-      before_keyframe_index = i;
-      before_keyframe_time = eval_keyframe_time;
-    } else if (eval_keyframe_time > timecode && eval_keyframe_time < after_keyframe_time) {
-      after_keyframe_index = i;
-      after_keyframe_time = eval_keyframe_time;
-    }
+  int segment = FindKeyframeSegment(timecode);
+  int last_segment = sorted_keys_.size() - 1;
+
+  // check if there's a keyframe at exactly this time
+  if (segment > -1 && qFuzzyCompare(sorted_times_.at(segment), timecode)) {
+    before = sorted_keys_.at(segment);
+    after = before;
+    return;
+  }
+  if (segment < last_segment && qFuzzyCompare(sorted_times_.at(segment + 1), timecode)) {
+    before = sorted_keys_.at(segment + 1);
+    after = before;
+    return;
   }
 
-  if ((type_ == EFFECT_FIELD_DOUBLE || type_ == EFFECT_FIELD_COLOR)
-      && (before_keyframe_index > -1 && after_keyframe_index > -1)) {
-    // interpolate
-    before = before_keyframe_index;
-    after = after_keyframe_index;
-    progress = (timecode-before_keyframe_time)/(after_keyframe_time-before_keyframe_time);
-  } else if (before_keyframe_index > -1) {
-    before = before_keyframe_index;
-    after = before_keyframe_index;
+  if (segment == -1) {
+    before = sorted_keys_.first();
+    after = before;
+  } else if (segment == last_segment
+             || (type_ != EFFECT_FIELD_DOUBLE && type_ != EFFECT_FIELD_COLOR)) {
+    before = sorted_keys_.at(segment);
+    after = before;
   } else {
-    before = after_keyframe_index;
-    after = after_keyframe_index;
+    // interpolate
+    before = sorted_keys_.at(segment);
+    after = sorted_keys_.at(segment + 1);
+    progress = (timecode-sorted_times_.at(segment))/(sorted_times_.at(segment + 1)-sorted_times_.at(segment));
+  }
+}
+
+double EffectField::GetDoubleBetweenKeyframes(double timecode, int before, int after, double progress)
+{
+  if (before == after) {
+    return double_values_.at(before);
+  }
+
+  const EffectKeyframe& before_key = keyframes.at(before);
+  const EffectKeyframe& after_key = keyframes.at(after);
+
+  double before_dbl = double_values_.at(before);
+  double after_dbl = double_values_.at(after);
+
+  if (before_key.type == EFFECT_KEYFRAME_HOLD) {
+
+    // Hold keyframes will always return the previous keyframe with no interpolation
+    return before_dbl;
+
+  } else if (before_key.type == EFFECT_KEYFRAME_BEZIER || after_key.type == EFFECT_KEYFRAME_BEZIER) {
+
+    // bezier interpolation
+    if (before_key.type == EFFECT_KEYFRAME_BEZIER && after_key.type == EFFECT_KEYFRAME_BEZIER) {
+
+      // cubic bezier
+      double t = cubic_t_from_x(timecode,
+                                before_key.time,
+                                before_key.time+GetValidHandlePosition(before, true),
+                                after_key.time+GetValidHandlePosition(after, false),
+                                after_key.time);
+
+      return cubic_from_t(before_dbl,
+                          before_dbl+before_key.post_handle.y(),
+                          after_dbl+after_key.pre_handle.y(),
+                          after_dbl,
+                          t);
+
+    } else if (after_key.type == EFFECT_KEYFRAME_LINEAR) { // quadratic bezier
+
+      // last keyframe is the bezier one
+      double t = quad_t_from_x(timecode,
+                               before_key.time,
+                               before_key.time+GetValidHandlePosition(before, true),
+                               after_key.time);
+
+      return quad_from_t(before_dbl,
+                         before_dbl+before_key.post_handle.y(),
+                         after_dbl,
+                         t);
+
+    } else {
+      // this keyframe is the bezier one
+      double t = quad_t_from_x(timecode,
+                               before_key.time,
+                               after_key.time+GetValidHandlePosition(after, false),
+                               after_key.time);
+
+      return quad_from_t(before_dbl,
+                         after_dbl+after_key.pre_handle.y(),
+                         after_dbl,
+                         t);
+    }
+  }
+
+  // Linear interpolation (default)
+  return double_lerp(before_dbl, after_dbl, progress);
+}
+
+float EffectField::GetKeyframeFloat(int key)
+{
+  switch (type_) {
+  case EFFECT_FIELD_DOUBLE:
+    return float(double_values_.at(key));
+  case EFFECT_FIELD_BOOL:
+    return bool_values_.at(key) ? 1.0f : 0.0f;
+  default:
+    return keyframes.at(key).data.toFloat();
+  }
+}
+
+void EffectField::UpdateKeyframeIndex()
+{
+  int version = keyframes_version_.loadAcquire();
+
+  // also rebuild if the amount of keyframes changed in case they were added without calling KeyframesChanged()
+  if (version == indexed_version_ && sorted_keys_.size() == keyframes.size()) {
+    return;
+  }
+
+  int count = keyframes.size();
+
+  sorted_keys_.resize(count);
+  for (int i=0;i<count;i++) {
+    sorted_keys_[i] = i;
+  }
+
+  const QVector<EffectKeyframe>& keys = keyframes;
+  std::stable_sort(sorted_keys_.begin(), sorted_keys_.end(), [&keys](int a, int b) {
+    return keys.at(a).time < keys.at(b).time;
+  });
+
+  sorted_times_.resize(count);
+  sorted_positions_.resize(count);
+  for (int i=0;i<count;i++) {
+    sorted_times_[i] = keyframes.at(sorted_keys_.at(i)).time;
+    sorted_positions_[sorted_keys_.at(i)] = i;
+  }
+
+  double_values_.clear();
+  color_values_.clear();
+  bool_values_.clear();
+
+  switch (type_) {
+  case EFFECT_FIELD_DOUBLE:
+    double_values_.resize(count);
+    for (int i=0;i<count;i++) {
+      double_values_[i] = keyframes.at(i).data.toDouble();
+    }
+    break;
+  case EFFECT_FIELD_COLOR:
+    color_values_.resize(count);
+    for (int i=0;i<count;i++) {
+      color_values_[i] = keyframes.at(i).data.value<QColor>();
+    }
+    break;
+  case EFFECT_FIELD_BOOL:
+    bool_values_.resize(count);
+    for (int i=0;i<count;i++) {
+      bool_values_[i] = keyframes.at(i).data.toBool();
+    }
+    break;
+  default:
+    break;
+  }
+
+  indexed_version_ = version;
+  segment_cursor_ = -1;
+}
+
+int EffectField::FindKeyframeSegment(double timecode)
+{
+  int count = sorted_times_.size();
+  int cursor = segment_cursor_;
+
+  if (cursor >= -1 && cursor < count && (cursor == -1 || sorted_times_.at(cursor) <= timecode)) {
+    // still in the same segment
+    if (cursor + 1 == count || timecode < sorted_times_.at(cursor + 1)) {
+      return cursor;
+    }
+
+    // moved into the next segment
+    if (cursor + 2 == count || timecode < sorted_times_.at(cursor + 2)) {
+      segment_cursor_ = cursor + 1;
+      return segment_cursor_;
+    }
   }
+
+  segment_cursor_ = int(std::upper_bound(sorted_times_.constBegin(), sorted_times_.constEnd(), timecode)
+                        - sorted_times_.constBegin()) - 1;
+
+  return segment_cursor_;
 }
 
 bool EffectField::HasKeyframes() {
@@ -342,3 +522,17 @@ void EffectField::SetEnabled(bool e) {
   enabled_ = e;
   emit EnabledChanged(enabled_);
 }
+
+QVector<int> EffectField::GetSortedKeyframes()
+{
+  QMutexLocker locker(&index_lock_);
+
+  UpdateKeyframeIndex();
+
+  return sorted_keys_;
+}
+
+void EffectField::KeyframesChanged()
+{
+  keyframes_version_.fetchAndAddRelease(1);
+}
@@ -24,6 +24,9 @@
 #include <QObject>
 #include <QVariant>
 #include <QVector>
+#include <QColor>
+#include <QMutex>
+#include <QAtomicInt>
 
 #include "effects/keyframe.h"
 #include "undo/undostack.h"
@@ -153,6 +156,36 @@ public:
    */
   QVariant GetValueAt(double timecode);
 
+  /**
+   * @brief Get the values of this field over a block of evenly spaced timecodes
+   *
+   * Equivalent to calling GetValueAt() for each timecode and converting the result to a float, but intended for
+   * functions that need a value per sample (e.g. audio effects). Rather than searching the keyframes for every
+   * timecode, the keyframes are searched once per keyframe segment covered by the block. If the field isn't
+   * keyframing, the block is simply filled with the same value.
+   *
+   * Only meaningful for fields whose values can be converted to a number (e.g. DoubleField and BoolField). Boolean
+   * values are returned as 1.0 and 0.0.
+   *
+   * @param timecode_start
+   *
+   * The time of the first value in clip/media seconds.
+   *
+   * @param timecode_end
+   *
+   * The time directly after the last value in clip/media seconds. Value `i` is retrieved at
+   * `timecode_start + (timecode_end - timecode_start) / count * i`.
+   *
+   * @param values
+   *
+   * Array to fill with values. Must be large enough to hold `count` floats.
+   *
+   * @param count
+   *
+   * Number of values to retrieve.
+   */
+  void GetValuesInRange(double timecode_start, double timecode_end, float* values, int count);
+
   /**
    * @brief Set the value of this field at a given timecode
    *
@@ -330,6 +363,18 @@ public:
    */
   void SetEnabled(bool e);
 
+  /**
+   * @brief Get the keyframes of this field in chronological order
+   *
+   * `keyframes` is kept in the order keyframes were added (other objects like undo commands refer to keyframes by
+   * their index), so this function provides the order they occur in time instead.
+   *
+   * @return
+   *
+   * An array of indices into `keyframes` sorted by keyframe time.
+   */
+  QVector<int> GetSortedKeyframes();
+
   /**
    * @brief Persistent data object
    *
@@ -347,9 +392,22 @@ public:
    * bezier, or hold), to the bezier handles (if using bezier). If the row is not keyframing, this array is never used
    * (`persistent_data_` is used instead). If it is, this array will always be used unless the array is empty, in which
    * case `persistent_data_` will be used again.
+   *
+   * Keyframes are not necessarily stored in chronological order, use GetSortedKeyframes() for that. If you modify this
+   * array directly, call KeyframesChanged() afterwards.
    */
   QVector<EffectKeyframe> keyframes;
 
+public slots:
+  /**
+   * @brief Notify this field that `keyframes` has been modified directly
+   *
+   * GetValueAt() evaluates keyframes through an internal time-sorted copy of the keyframe times and values. Any code
+   * that changes the time or data of a keyframe in `keyframes` directly must call this function afterwards so that
+   * copy gets rebuilt. This is called automatically whenever the undo stack changes.
+   */
+  void KeyframesChanged();
+
 signals:
   /**
    * @brief Changed signal
@@ -410,11 +468,96 @@ private:
    */
   void GetKeyframeData(double timecode, int& before, int& after, double& d);
 
+  /**
+   * @brief Internal function for interpolating a double value between two keyframes
+   *
+   * Expects the keyframe index to be up to date (see UpdateKeyframeIndex()).
+   */
+  double GetDoubleBetweenKeyframes(double timecode, int before, int after, double progress);
+
+  /**
+   * @brief Internal implementation of GetValidKeyframeHandlePosition() that expects the keyframe index to be up to date
+   */
+  double GetValidHandlePosition(int key, bool post);
+
+  /**
+   * @brief Internal function for retrieving a keyframe's value as a float
+   *
+   * Expects the keyframe index to be up to date (see UpdateKeyframeIndex()).
+   */
+  float GetKeyframeFloat(int key);
+
+  /**
+   * @brief Rebuild the sorted keyframe index if `keyframes` has changed since it was last built
+   *
+   * Expects `index_lock_` to be locked.
+   */
+  void UpdateKeyframeIndex();
+
+  /**
+   * @brief Find the last keyframe at or before a given timecode
+   *
+   * Checks the segment found by the last call first (and the one after it), so evaluating a field at increasing
+   * timecodes (e.g. during playback) doesn't need to search at all. Otherwise falls back to a binary search.
+   *
+   * Expects the keyframe index to be up to date (see UpdateKeyframeIndex()).
+   *
+   * @return
+   *
+   * Position in `sorted_keys_` of the last keyframe at or before `timecode`, or -1 if `timecode` is before the first
+   * keyframe.
+   */
+  int FindKeyframeSegment(double timecode);
+
   /**
    * @brief Internal enabled value
    */
   bool enabled_;
 
+  /**
+   * @brief Indices into `keyframes` sorted by time
+   */
+  QVector<int> sorted_keys_;
+
+  /**
+   * @brief Keyframe times in the same order as `sorted_keys_`, used for binary searching
+   */
+  QVector<double> sorted_times_;
+
+  /**
+   * @brief Position of each keyframe in `sorted_keys_`, indexed the same as `keyframes`
+   */
+  QVector<int> sorted_positions_;
+
+  /**
+   * @brief Typed copies of the keyframe values, indexed the same as `keyframes`
+   *
+   * Only the array matching this field's type is filled, which saves converting from QVariant on every evaluation.
+   */
+  QVector<double> double_values_;
+  QVector<QColor> color_values_;
+  QVector<bool> bool_values_;
+
+  /**
+   * @brief Incremented by KeyframesChanged() to mark the keyframe index out of date
+   */
+  QAtomicInt keyframes_version_;
+
+  /**
+   * @brief Value of `keyframes_version_` the keyframe index was last built from
+   */
+  int indexed_version_;
+
+  /**
+   * @brief Position in `sorted_keys_` of the segment found by the last call to FindKeyframeSegment()
+   */
+  int segment_cursor_;
+
+  /**
+   * @brief Lock for the keyframe index, since fields can be evaluated from the UI and rendering threads at once
+   */
+  QMutex index_lock_;
+
 };
 
 #endif // EFFECTFIELD_H
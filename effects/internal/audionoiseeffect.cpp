@@ -23,6 +23,8 @@
 #include <QDateTime>
 #include <QtMath>
 
+#include "rendering/audiodsp.h"
+
 AudioNoiseEffect::AudioNoiseEffect(Clip* c) : OldEffectNode(c) {
   amount_val = new DoubleInput(this, "amount", tr("Amount"));
   amount_val->SetMinimum(0);
@@ -72,23 +74,35 @@ void AudioNoiseEffect::process_audio(double timecode_start,
 
   Q_UNUSED(type)
 
-  double interval = (timecode_end - timecode_start)/nb_samples;
-  for (int i=0;i<nb_samples;i+=4) {
-    double timecode = timecode_start+(interval*i);
+  QVector<float> volume(nb_samples);
+  QVector<float> mix(nb_samples);
+
+  amount_val->GetValuesInRange(timecode_start, timecode_end, volume.data(), nb_samples);
+  mix_val->GetValuesInRange(timecode_start, timecode_end, mix.data(), nb_samples);
 
-    // set noise volume
-    float vol = log_volume( amount_val->GetDoubleAt(timecode)*0.01 );
+  // set noise volume, the amount is usually constant so only recalculate it when it changes
+  float last_amount = -1.0f;
+  float last_volume = 0.0f;
+  for (int i=0;i<nb_samples;i++) {
+    if (volume[i] != last_amount) {
+      last_amount = volume[i];
+      last_volume = float(log_volume(last_amount*0.01));
+    }
+    volume[i] = last_volume;
+  }
 
-    for (int j=0;j<channel_count;j++) {
-      // Generate noise sample
-      float noise_sample = this->randomFloat<float>() * vol;
+  QVector<float> noise(nb_samples);
 
-      // mix with source audio
-      if (mix_val->GetBoolAt(timecode)) {
-        samples[j][i] += noise_sample;
-      } else {
-        samples[j][i] = noise_sample;
-      }
+  for (int j=0;j<channel_count;j++) {
+
+    // generate this channel's noise
+    for (int i=0;i<nb_samples;i++) {
+      noise[i] = this->randomFloat<float>();
     }
+    olive::dsp::Envelope(noise.data(), volume.constData(), nb_samples);
+
+    // mix is 1.0 to mix with the source audio or 0.0 to replace it
+    olive::dsp::MultiplyAdd(samples[j], mix.constData(), noise.constData(), nb_samples);
+
   }
 }
@@ -21,6 +21,9 @@
 #include "exponentialfadetransition.h"
 
 #include <QtMath>
+#include <QVector>
+
+#include "rendering/audiodsp.h"
 
 ExponentialFadeTransition::ExponentialFadeTransition(Clip* c) :
   Transition(c)
@@ -65,19 +68,26 @@ void ExponentialFadeTransition::process_audio(double timecode_start,
                                               int type) {
   double interval = (timecode_end-timecode_start)/nb_samples;
 
-  for (int i=0;i<nb_samples;i++) {
+  // calculate the fade curve once and apply it to every channel
+  QVector<float> envelope(nb_samples);
 
+  for (int i=0;i<nb_samples;i++) {
     double multi = timecode_start + (interval * i);
-
-    for (int j=0;j<channel_count;j++) {
-      switch (type) {
-      case kTransitionOpening:
-        samples[j][i] *= qPow(multi, 2);
-        break;
-      case kTransitionClosing:
-        samples[j][i] *= qPow(1.0 - multi, 2);
-        break;
-      }
+    double inverse = 1.0 - multi;
+
+    switch (type) {
+    case kTransitionOpening:
+      envelope[i] = float(multi*multi);
+      break;
+    case kTransitionClosing:
+      envelope[i] = float(inverse*inverse);
+      break;
+    default:
+      envelope[i] = 1.0f;
     }
   }
+
+  for (int j=0;j<channel_count;j++) {
+    olive::dsp::Envelope(samples[j], envelope.constData(), nb_samples);
+  }
 }
@@ -20,6 +20,8 @@
 
 #include "linearfadetransition.h"
 
+#include "rendering/audiodsp.h"
+
 LinearFadeTransition::LinearFadeTransition(Clip* c) : Transition(c) {}
 
 QString LinearFadeTransition::name()
@@ -58,22 +60,15 @@ void LinearFadeTransition::process_audio(double timecode_start,
                                          int nb_samples,
                                          int channel_count,
                                          int type) {
-  double interval = (timecode_end-timecode_start)/nb_samples;
-
-  for (int i=0;i<nb_samples;i++) {
+  float start = float(timecode_start);
+  float end = float(timecode_end);
 
-    float multi = timecode_start + (interval * i);
-
-    for (int j=0;j<channel_count;j++) {
+  if (type == kTransitionClosing) {
+    start = 1.0f - start;
+    end = 1.0f - end;
+  }
 
-      switch (type) {
-      case kTransitionOpening:
-        samples[j][i] *= multi;
-        break;
-      case kTransitionClosing:
-        samples[j][i] *= 1.0f - multi;
-        break;
-      }
-    }
+  for (int j=0;j<channel_count;j++) {
+    olive::dsp::GainRamp(samples[j], nb_samples, start, end);
   }
 }
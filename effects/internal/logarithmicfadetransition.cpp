@@ -21,6 +21,9 @@
 #include "logarithmicfadetransition.h"
 
 #include <QtMath>
+#include <QVector>
+
+#include "rendering/audiodsp.h"
 
 LogarithmicFadeTransition::LogarithmicFadeTransition(Clip* c) :
   Transition(c)
@@ -65,19 +68,26 @@ void LogarithmicFadeTransition::process_audio(double timecode_start,
                                               int type) {
   double interval = (timecode_end-timecode_start)/nb_samples;
 
-  for (int i=0;i<nb_samples;i++) {
+  // calculate the fade curve once and apply it to every channel
+  QVector<float> envelope(nb_samples);
 
-    float multi = timecode_start + (interval * i);
-
-    for (int j=0;j<channel_count;j++) {
-      switch (type) {
-      case kTransitionOpening:
-        samples[j][i] *= qSqrt(multi);
-        break;
-      case kTransitionClosing:
-        samples[j][i] *= qSqrt(1.0f - multi);
-        break;
-      }
+  for (int i=0;i<nb_samples;i++) {
+    double multi = timecode_start + (interval * i);
+    double inverse = 1.0 - multi;
+
+    switch (type) {
+    case kTransitionOpening:
+      envelope[i] = float(qSqrt(multi));
+      break;
+    case kTransitionClosing:
+      envelope[i] = float(qSqrt(inverse));
+      break;
+    default:
+      envelope[i] = 1.0f;
     }
   }
+
+  for (int j=0;j<channel_count;j++) {
+    olive::dsp::Envelope(samples[j], envelope.constData(), nb_samples);
+  }
 }
@@ -25,6 +25,7 @@
 #include <QtMath>
 #include <cmath>
 
+#include "rendering/audiodsp.h"
 #include "ui/labelslider.h"
 #include "ui/collapsiblewidget.h"
 
@@ -79,18 +80,35 @@ void PanEffect::process_audio(double timecode_start,
     return;
   }
 
-  double interval = (timecode_end - timecode_start)/nb_samples;
+  QVector<float> left(nb_samples);
+  QVector<float> right(nb_samples);
+
+  // left holds the pan values until they're converted to gains below
+  pan_val->GetValuesInRange(timecode_start, timecode_end, left.data(), nb_samples);
+
+  // pan is usually constant across a block, only recalculate the gain when it changes
+  float last_pan = 0.0f;
+  float last_gain = 1.0f;
 
   for (int i=0;i<nb_samples;i++) {
-    double pan_field_val = pan_val->GetDoubleAt(timecode_start+(interval*i));
-    double pval = log_volume(qAbs(pan_field_val)*0.01);
+    float pan = left[i];
 
-    if (pan_field_val < 0) {
+    if (pan != last_pan) {
+      last_pan = pan;
+      last_gain = float(1.0 - log_volume(qAbs(pan)*0.01));
+    }
+
+    if (pan < 0) {
       // affect right channel
-      samples[1][i] *= (1.0-pval);
+      left[i] = 1.0f;
+      right[i] = last_gain;
     } else {
       // affect left channel
-      samples[0][i] *= (1.0-pval);
+      left[i] = last_gain;
+      right[i] = 1.0f;
     }
   }
+
+  olive::dsp::Envelope(samples[0], left.constData(), nb_samples);
+  olive::dsp::Envelope(samples[1], right.constData(), nb_samples);
 }
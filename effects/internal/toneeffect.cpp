@@ -24,6 +24,7 @@
 
 #define TONE_TYPE_SINE 0
 
+#include "rendering/audiodsp.h"
 #include "timeline/clip.h"
 #include "timeline/sequence.h"
 
@@ -84,31 +85,64 @@ void ToneEffect::process_audio(double timecode_start,
 
   Q_UNUSED(type)
 
-  double interval = (timecode_end - timecode_start)/nb_samples;
+  QVector<float> tone(nb_samples);
+  QVector<float> amount(nb_samples);
+  QVector<float> mix(nb_samples);
 
-  for (int i=0;i<nb_samples;i++) {
-
-    double timecode = timecode_start+(interval*i);
-    float tone_sample = qSin((2*M_PI*sinX*freq_val->GetDoubleAt(timecode))
-                                           /parent_clip->track()->sequence()->audio_frequency())
-                                      *log_volume(amount_val->GetDoubleAt(timecode)*0.01);
-
-    for (int j=0;j<channel_count;j++) {
+  freq_val->GetValuesInRange(timecode_start, timecode_end, tone.data(), nb_samples);
+  amount_val->GetValuesInRange(timecode_start, timecode_end, amount.data(), nb_samples);
+  mix_val->GetValuesInRange(timecode_start, timecode_end, mix.data(), nb_samples);
 
-      if (mix_val->GetBoolAt(timecode)) {
+  double angular_step = 2*M_PI/parent_clip->track()->sequence()->audio_frequency();
 
-        // mix with source audio
-        samples[j][i] += tone_sample;
-
-      } else {
+  bool constant_frequency = true;
+  for (int i=1;i<nb_samples;i++) {
+    if (tone[i] != tone[0]) {
+      constant_frequency = false;
+      break;
+    }
+  }
 
-        // replace source audio
-        samples[j][i] = tone_sample;
+  // generate the tone once, the frequency buffer is replaced with the tone samples
+  if (constant_frequency && nb_samples > 0) {
+    // the frequency is usually constant across a block, in which case each sample can be derived from the last two
+    // (sin(x+w) = 2cos(w)sin(x) - sin(x-w)) instead of calling qSin() for every one
+    double w = angular_step*tone[0];
+    double c = 2*qCos(w);
+    double previous = qSin(w*(double(sinX)-1));
+    double current = qSin(w*double(sinX));
+
+    for (int i=0;i<nb_samples;i++) {
+      tone[i] = float(current);
+
+      double next = c*current - previous;
+      previous = current;
+      current = next;
+    }
 
-      }
+    sinX += nb_samples;
+  } else {
+    for (int i=0;i<nb_samples;i++) {
+      tone[i] = qSin(angular_step*sinX*tone[i]);
+      sinX++;
+    }
+  }
 
+  // the amount is usually constant too, only recalculate its volume when it changes
+  float last_amount = -1.0f;
+  float last_volume = 0.0f;
+  for (int i=0;i<nb_samples;i++) {
+    if (amount[i] != last_amount) {
+      last_amount = amount[i];
+      last_volume = float(log_volume(last_amount*0.01));
     }
+    amount[i] = last_volume;
+  }
+
+  olive::dsp::Envelope(tone.data(), amount.constData(), nb_samples);
 
-    sinX++;
+  // mix is 1.0 to mix with the source audio or 0.0 to replace it
+  for (int j=0;j<channel_count;j++) {
+    olive::dsp::MultiplyAdd(samples[j], mix.constData(), tone.constData(), nb_samples);
   }
 }
@@ -224,6 +224,25 @@ void TransformEffect::process_coords(double timecode, GLTextureCoords& coords, i
   coords.opacity *= float(opacity->GetDoubleAt(timecode)*0.01);
 }
 
+bool TransformEffect::IsIdentity() {
+  if (position->IsKeyframing()
+      || scale->IsKeyframing()
+      || rotation->IsKeyframing()
+      || anchor_point->IsKeyframing()
+      || opacity->IsKeyframing()) {
+    return false;
+  }
+
+  QVector2D center(parent_clip->track()->sequence()->width()*0.5f,
+                   parent_clip->track()->sequence()->height()*0.5f);
+
+  return qFuzzyCompare(position->GetVector2DAt(0), center)
+      && qFuzzyCompare(scale->GetVector2DAt(0), QVector2D(100, 100))
+      && qFuzzyIsNull(rotation->GetDoubleAt(0))
+      && anchor_point->GetVector2DAt(0).isNull()
+      && qFuzzyCompare(opacity->GetDoubleAt(0), 100.0);
+}
+
 QVector3D LerpVector3D(const QVector3D& a, const QVector3D& b, float t) {
   return QVector3D(
         float_lerp(a.x(), b.x(), t),
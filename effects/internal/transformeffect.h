@@ -41,6 +41,13 @@ public:
 
   virtual void gizmo_draw(double timecode, GLTextureCoords& coords) override;
 
+  /**
+   * @brief Returns **TRUE** if this transform leaves the clip exactly as it is for its whole length
+   *
+   * i.e. none of its values are animated and they're all at their defaults.
+   */
+  bool IsIdentity();
+
 public slots:
   void toggle_uniform_scale(bool enabled);
 
@@ -25,6 +25,7 @@
 #include <QtMath>
 #include <stdint.h>
 
+#include "rendering/audiodsp.h"
 #include "ui/labelslider.h"
 #include "ui/collapsiblewidget.h"
 
@@ -75,16 +76,10 @@ void VolumeEffect::process_audio(double timecode_start,
 
   Q_UNUSED(type)
 
-  double interval = (timecode_end-timecode_start)/nb_samples;
+  QVector<float> volume(nb_samples);
+  volume_val->GetValuesInRange(timecode_start, timecode_end, volume.data(), nb_samples);
 
-  for (int i=0;i<nb_samples;i++) {
-
-    double vol_val = volume_val->GetDoubleAt(timecode_start+(interval*i));
-
-    for (int j=0;j<channel_count;j++) {
-
-      samples[j][i] *= vol_val;
-
-    }
+  for (int j=0;j<channel_count;j++) {
+    olive::dsp::Envelope(samples[j], volume.constData(), nb_samples);
   }
 }
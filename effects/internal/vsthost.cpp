@@ -187,7 +187,8 @@ void VSTHost::startPlugin() {
   dispatcher(plugin, effOpen, 0, 0, nullptr, 0.0f);
 
   // Set some default properties
-  dispatcher(plugin, effSetSampleRate, 0, 0, nullptr, current_audio_freq());
+  sample_rate_ = current_audio_freq();
+  dispatcher(plugin, effSetSampleRate, 0, 0, nullptr, sample_rate_);
   dispatcher(plugin, effSetBlockSize, 0, BLOCK_SIZE, nullptr, 0.0f);
 
   resumePlugin();
@@ -230,6 +231,7 @@ void VSTHost::send_data_cache_to_plugin()
 VSTHost::VSTHost(Clip* c) :
   OldEffectNode(c),
   plugin(nullptr),
+  sample_rate_(0),
   dialog(nullptr),
   input_cache(BLOCK_SIZE),
   output_cache(BLOCK_SIZE)
@@ -287,6 +289,15 @@ void VSTHost::process_audio(double timecode_start,
                             int type) {
   if (plugin != nullptr) {
 
+    // the plugin may have been started at the playback rate but be rendering for an export (or vice versa)
+    int sample_rate = current_audio_freq();
+    if (sample_rate != sample_rate_) {
+      suspendPlugin();
+      sample_rate_ = sample_rate;
+      dispatcher(plugin, effSetSampleRate, 0, 0, nullptr, sample_rate_);
+      resumePlugin();
+    }
+
     // Make copy of audio
     input_cache.Create(channel_count);
     output_cache.Create(channel_count);
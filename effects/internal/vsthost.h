@@ -80,6 +80,7 @@ private:
   void freePlugin();
   dispatcherFuncPtr dispatcher;
   AEffect* plugin;
+  int sample_rate_;
   bool configurePluginCallbacks();
   void startPlugin();
   void stopPlugin();
@@ -53,6 +53,7 @@ Config::Config()
     drop_on_media_to_replace(true),
     autoscroll(olive::AUTOSCROLL_PAGE_SCROLL),
     audio_rate(48000),
+    audio_period_size(512),
     hover_focus(false),
     project_view_type(olive::PROJECT_VIEW_TREE),
     set_name_with_marker(true),
@@ -61,13 +62,16 @@ Config::Config()
     previous_queue_type(olive::FRAME_QUEUE_TYPE_FRAMES),
     upcoming_queue_size(0.5),
     upcoming_queue_type(olive::FRAME_QUEUE_TYPE_SECONDS),
+    frame_cache_size(512),
+    decode_threads(0),
+    clip_lookahead(2.0),
     loop(false),
     seek_also_selects(false),
     auto_seek_to_beginning(true),
     effect_textbox_lines(3),
     use_software_fallback(false),
     center_timeline_timecodes(true),
-    waveform_resolution(64),
+    waveform_resolution(256),
     thumbnail_resolution(120),
     add_default_effects_to_clips(true),
     invert_timeline_scroll_axes(true),
@@ -157,6 +161,9 @@ void Config::load(QString path) {
         } else if (stream.name() == "AudioRate") {
           stream.readNext();
           audio_rate = stream.text().toInt();
+        } else if (stream.name() == "AudioPeriodSize") {
+          stream.readNext();
+          audio_period_size = qBound(256, stream.text().toInt(), 2048);
         } else if (stream.name() == "HoverFocus") {
           stream.readNext();
           hover_focus = (stream.text() == "1");
@@ -181,6 +188,15 @@ void Config::load(QString path) {
         } else if (stream.name() == "UpcomingFrameQueueType") {
           stream.readNext();
           upcoming_queue_type = stream.text().toInt();
+        } else if (stream.name() == "SharedFrameCacheSize") {
+          stream.readNext();
+          frame_cache_size = stream.text().toInt();
+        } else if (stream.name() == "DecodeThreads") {
+          stream.readNext();
+          decode_threads = stream.text().toInt();
+        } else if (stream.name() == "ClipLookahead") {
+          stream.readNext();
+          clip_lookahead = stream.text().toDouble();
         } else if (stream.name() == "Loop") {
           stream.readNext();
           loop = (stream.text() == "1");
@@ -316,6 +332,7 @@ void Config::save(QString path) {
   stream.writeTextElement("DropFileOnMediaToReplace", QString::number(drop_on_media_to_replace));
   stream.writeTextElement("Autoscroll", QString::number(autoscroll));
   stream.writeTextElement("AudioRate", QString::number(audio_rate));
+  stream.writeTextElement("AudioPeriodSize", QString::number(audio_period_size));
   stream.writeTextElement("HoverFocus", QString::number(hover_focus));
   stream.writeTextElement("ProjectViewType", QString::number(project_view_type));
   stream.writeTextElement("SetNameWithMarker", QString::number(set_name_with_marker));
@@ -324,6 +341,9 @@ void Config::save(QString path) {
   stream.writeTextElement("PreviousFrameQueueType", QString::number(previous_queue_type));
   stream.writeTextElement("UpcomingFrameQueueSize", QString::number(upcoming_queue_size));
   stream.writeTextElement("UpcomingFrameQueueType", QString::number(upcoming_queue_type));
+  stream.writeTextElement("SharedFrameCacheSize", QString::number(frame_cache_size));
+  stream.writeTextElement("DecodeThreads", QString::number(decode_threads));
+  stream.writeTextElement("ClipLookahead", QString::number(clip_lookahead));
   stream.writeTextElement("Loop", QString::number(loop));
   stream.writeTextElement("SeekAlsoSelects", QString::number(seek_also_selects));
   stream.writeTextElement("AutoSeekToBeginning", QString::number(auto_seek_to_beginning));
@@ -314,6 +314,17 @@ struct Config {
    */
   int audio_rate;
 
+  /**
+   * @brief Audio output period size
+   *
+   * The amount of sample frames the audio output device requests from Olive at a time. Smaller periods lower the
+   * latency between starting playback (or scrubbing) and hearing audio, at the cost of more frequent wakeups and a
+   * higher risk of dropouts on slower systems.
+   *
+   * Set to a value between 256 and 2048.
+   */
+  int audio_period_size;
+
   /**
    * @brief Enable hover focus
    *
@@ -392,6 +403,38 @@ struct Config {
    */
   int upcoming_queue_type;
 
+  /**
+   * @brief Shared frame cache size
+   *
+   * Decoded frames are also kept in a cache shared between all clips (see FrameCache) so that clips using the same
+   * footage don't have to decode the same frames again. This variable sets the maximum amount of memory (in megabytes)
+   * that this cache can use.
+   *
+   * Set to 0 to disable the shared frame cache.
+   */
+  int frame_cache_size;
+
+  /**
+   * @brief Decoding threads
+   *
+   * The maximum amount of clips that can decode video at the same time (i.e. the size of the DecodeScheduler's worker
+   * pool), which is also the total amount of codec threads split between all open clips.
+   *
+   * Set to 0 to use the amount of CPU cores.
+   */
+  int decode_threads;
+
+  /**
+   * @brief Clip lookahead
+   *
+   * During playback, clips that start within this many seconds of the playhead (in the playback direction) are opened
+   * and start caching in the background before the playhead reaches them, and clips that ended within this many
+   * seconds are kept open in case the playhead goes back to them. Clips further away are closed.
+   *
+   * Set to 0 to only open clips once the playhead reaches them.
+   */
+  double clip_lookahead;
+
   /**
    * @brief Loop
    *
@@ -486,8 +529,10 @@ struct Config {
    *
    * Sets how detailed the waveforms should be in the Timeline. Higher value = more detail.
    *
-   * Specifically sets how many samples per second should be "cached" for preview. If the waveforms are too blocky,
-   * set this higher. If Timeline performance is slow, set this lower.
+   * Specifically sets how many points per second are stored in the most detailed level of each stream's
+   * WaveformPyramid (rounded so each point covers a power of two samples). Coarser levels are drawn when zoomed out,
+   * so this doesn't affect Timeline performance, only how much detail is visible when zoomed in and how much disk
+   * space waveforms use. 0 disables waveforms.
    */
   int waveform_resolution;
 
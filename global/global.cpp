@@ -59,7 +59,7 @@ QString olive::AppName;
 
 OliveGlobal::OliveGlobal() :
   changed_since_last_autorecovery(false),
-  rendering_(false)
+  rendering_(0)
 {
   // sets current app name
   QString version_id;
@@ -117,12 +117,18 @@ void OliveGlobal::check_for_autorecovery_file() {
 
 bool OliveGlobal::is_exporting()
 {
-  return rendering_;
+  return (rendering_ > 0);
 }
 
 void OliveGlobal::set_export_state(bool rendering) {
-  rendering_ = rendering;
+  // several exports can run at once, so only restore the state once the last one has finished
   if (rendering) {
+    rendering_++;
+  } else {
+    rendering_ = qMax(0, rendering_ - 1);
+  }
+
+  if (rendering_ > 0) {
     autorecovery_timer.stop();
   } else {
     autorecovery_timer.start();
@@ -593,8 +599,10 @@ void OliveGlobal::open_import_dialog()
 
 void OliveGlobal::open_export_dialog() {
   if (CheckForActiveSequence()) {
-    ExportDialog e(olive::MainWindow, Timeline::GetTopSequence().get());
-    e.exec();
+    // shown non-modally so the sequence can still be edited (or exported again) while this export runs
+    ExportDialog* e = new ExportDialog(olive::MainWindow, Timeline::GetTopSequence());
+    e->setAttribute(Qt::WA_DeleteOnClose);
+    e->show();
   }
 }
 
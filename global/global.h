@@ -75,8 +75,10 @@ public:
   void check_for_autorecovery_file();
 
   /**
-     * @brief Get whether the project is currently being rendered or not. Useful for determining whether to treat the
-     * render as online or offline.
+     * @brief Get whether the project is currently being rendered or not.
+     *
+     * Viewers keep rendering while an export runs, so this shouldn't be used to decide how a render is done. Exports
+     * mark their own renders instead (see ComposeSequenceParams::exporting).
      *
      * @return
      *
@@ -91,14 +93,15 @@ public:
      * as necessary.
      *
      * The current functions are as follows:
-     * * Auto-recovery interval. Olive saves an auto-recovery just before exporting anyway and seeing as the user
-     * cannot make changes while rendering, there's no reason to continue saving auto-recovery files.
+     * * Auto-recovery interval. Olive saves an auto-recovery just before exporting anyway, so it doesn't compete with
+     * the export for disk access by saving more while it runs.
      * * Audio device playback. Olive uses the same internal audio buffer for exporting as it does for playback, but
      * this buffer does not need to be forwarded to the output device when exporting.
      *
      * @param rendering
      *
-     * **TRUE** if Olive is about to export a video. **FALSE** if Olive has finished exporting.
+     * **TRUE** if Olive is about to export a video. **FALSE** if Olive has finished exporting. Calls are counted, so
+     * the state is only cleared once every export that set it has finished.
      */
   void set_export_state(bool rendering);
 
@@ -507,8 +510,10 @@ private:
 
   /**
      * @brief Internal variable for rendering state (set by set_rendering_state() and accessed by is_rendering() ).
+     *
+     * Number of exports currently running.
      */
-  bool rendering_;
+  int rendering_;
 
   /**
      * @brief Internal variable for the filename to the autorecovery project file
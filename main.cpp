@@ -20,6 +20,7 @@
 
 #include <QApplication>
 #include <QMessageBox>
+#include <QTimer>
 
 #include "dialogs/crashdialog.h"
 #include "global/crashhandler.h"
@@ -27,7 +28,9 @@
 #include "global/config.h"
 #include "global/global.h"
 #include "panels/timeline.h"
+#include "rendering/headlessexport.h"
 #include "rendering/pixelformats.h"
+#include "ui/filmstripservice.h"
 #include "ui/mediaiconservice.h"
 #include "ui/mainwindow.h"
 
@@ -48,6 +51,11 @@ int main(int argc, char *argv[]) {
 
   bool use_internal_logger = true;
 
+  QString export_project;
+  QString export_sequence;
+  QString export_preset;
+  QString export_output;
+
   if (argc > 1) {
     for (int i=1;i<argc;i++) {
       if (argv[i][0] == '-') {
@@ -68,6 +76,14 @@ int main(int argc, char *argv[]) {
                  "\t--no-debug\t\tDisable internal debug log and output directly to console\n"
                  "\t--translation <file>\tSet an external language file to use\n"
                  "\n"
+                 "Exporting:\n"
+                 "\t--export <file>\t\tExport a sequence from this project without opening the main window\n"
+                 "\t--sequence <name>\tName of the sequence to export\n"
+                 "\t--output <file>\t\tFile to export to (its extension determines the format)\n"
+                 "\t--preset <file>\t\tINI file with export settings (optional)\n"
+                 "\tProgress is printed to stdout. No window is shown, but rendering still requires an OpenGL\n"
+                 "\tcontext from the current Qt platform.\n"
+                 "\n"
                  "Environment Variables:\n"
                  "\tOLIVE_EFFECTS_PATH\tSpecify a path to search for GLSL shader effects\n"
                  "\tFREI0R_PATH\t\tSpecify a path to search for Frei0r effects\n"
@@ -90,6 +106,42 @@ int main(int argc, char *argv[]) {
             printf("[ERROR] No translation file specified\n");
             return 1;
           }
+        } else if (!strcmp(argv[i], "--export")) {
+          if (i + 1 < argc && argv[i + 1][0] != '-') {
+            export_project = argv[i + 1];
+
+            i++;
+          } else {
+            printf("[ERROR] No project file specified to export\n");
+            return HeadlessExport::kExitInvalidArguments;
+          }
+        } else if (!strcmp(argv[i], "--sequence")) {
+          if (i + 1 < argc) {
+            export_sequence = argv[i + 1];
+
+            i++;
+          } else {
+            printf("[ERROR] No sequence name specified\n");
+            return HeadlessExport::kExitInvalidArguments;
+          }
+        } else if (!strcmp(argv[i], "--output")) {
+          if (i + 1 < argc && argv[i + 1][0] != '-') {
+            export_output = argv[i + 1];
+
+            i++;
+          } else {
+            printf("[ERROR] No output file specified\n");
+            return HeadlessExport::kExitInvalidArguments;
+          }
+        } else if (!strcmp(argv[i], "--preset")) {
+          if (i + 1 < argc && argv[i + 1][0] != '-') {
+            export_preset = argv[i + 1];
+
+            i++;
+          } else {
+            printf("[ERROR] No preset file specified\n");
+            return HeadlessExport::kExitInvalidArguments;
+          }
         } else {
           printf("[ERROR] Unknown argument '%s'\n", argv[1]);
           return 1;
@@ -100,6 +152,11 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (!export_project.isEmpty() && (export_sequence.isEmpty() || export_output.isEmpty())) {
+    printf("[ERROR] --export requires --sequence and --output\n");
+    return HeadlessExport::kExitInvalidArguments;
+  }
+
   if (use_internal_logger) {
     qInstallMessageHandler(debug_message_handler);
   }
@@ -128,6 +185,9 @@ int main(int argc, char *argv[]) {
   // start media icon service (uses QPixmaps which require a QGuiApplication to have been created)
   olive::media_icon_service = std::unique_ptr<MediaIconService>(new MediaIconService());
 
+  // start timeline thumbnail service (uses QImages and emits signals to the Timeline)
+  olive::filmstrip_service = std::unique_ptr<FilmstripService>(new FilmstripService());
+
   // set app name data
   QCoreApplication::setOrganizationName("olivevideoeditor.org");
   QCoreApplication::setOrganizationDomain("olivevideoeditor.org");
@@ -139,6 +199,16 @@ int main(int argc, char *argv[]) {
 
   olive::crash_dialog = new CrashDialog();
 
+  if (!export_project.isEmpty()) {
+    // set up rendering bit depths
+    olive::InitializePixelFormats();
+
+    // export without the main window, the application exits with the export's status once it's finished
+    HeadlessExport exporter(export_project, export_sequence, export_preset, export_output);
+    QTimer::singleShot(0, &exporter, SLOT(Start()));
+    return a.exec();
+  }
+
   MainWindow w(nullptr);
 
   // multiply track height constants by the current DPI scale
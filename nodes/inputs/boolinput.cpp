@@ -14,3 +14,8 @@ bool BoolInput::GetBoolAt(double timecode)
 {
   return static_cast<BoolField*>(Field(0))->GetBoolAt(timecode);
 }
+
+void BoolInput::GetValuesInRange(double timecode_start, double timecode_end, float *values, int count)
+{
+  Field(0)->GetValuesInRange(timecode_start, timecode_end, values, count);
+}
@@ -24,6 +24,13 @@ public:
    */
   bool GetBoolAt(double timecode);
 
+  /**
+   * @brief Get the boolean values over a block of evenly spaced timecodes
+   *
+   * A wrapper for EffectField::GetValuesInRange(). Each value is 1.0 for TRUE and 0.0 for FALSE.
+   */
+  void GetValuesInRange(double timecode_start, double timecode_end, float* values, int count);
+
 signals:
   /**
    * @brief Emitted whenever the UI widget's boolean value has changed
@@ -89,6 +89,11 @@ double DoubleInput::GetDoubleAt(double timecode)
   return static_cast<DoubleField*>(Field(0))->GetDoubleAt(timecode);
 }
 
+void DoubleInput::GetValuesInRange(double timecode_start, double timecode_end, float *values, int count)
+{
+  Field(0)->GetValuesInRange(timecode_start, timecode_end, values, count);
+}
+
 Vec2Input::Vec2Input(Node *parent, const QString &id, const QString &name, bool savable, bool keyframable) :
   VecInput(parent, id, name, 2, savable, keyframable)
 {
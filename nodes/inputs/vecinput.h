@@ -46,6 +46,7 @@ public:
   DoubleInput(Node* parent, const QString& id, const QString& name, bool savable = true, bool keyframable = true);
 
   double GetDoubleAt(double timecode);
+  void GetValuesInRange(double timecode_start, double timecode_end, float* values, int count);
 };
 
 class Vec2Input : public VecInput {
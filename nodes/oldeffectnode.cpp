@@ -122,6 +122,7 @@ void OldEffectNode::copy_field_keyframes(OldEffectNodePtr e) {
 
       // Copy keyframes between effects
       copy_field->keyframes = field->keyframes;
+      copy_field->KeyframesChanged();
 
       // Copy persistet data between effects
       copy_field->persistent_data_ = field->persistent_data_;
@@ -353,6 +354,7 @@ void OldEffectNode::load(QXmlStreamReader& stream) {
                 }
               }
 
+              field->KeyframesChanged();
               field->Changed();
 
             }
@@ -417,6 +419,7 @@ void OldEffectNode::load_from_string(const QByteArray &s) {
     for (int j=0;j<row->FieldCount();j++) {
       EffectField* field = row->Field(j);
       field->keyframes.clear();
+      field->KeyframesChanged();
     }
   }
 
@@ -143,13 +143,12 @@ void Viewer::reset_all_audio() {
 
     }
 
-    audio_ibuffer_frame = seq->playhead;
+    long start_frame = seq->playhead;
     if (playback_speed < 0) {
-      audio_ibuffer_frame = last_frame - audio_ibuffer_frame;
+      start_frame = last_frame - start_frame;
     }
-    audio_ibuffer_timecode = double(audio_ibuffer_frame) / seq->frame_rate();
+    reset_audio_context(&audio_context_, start_frame, seq->frame_rate());
   }
-  clear_audio_ibuffer();
 }
 
 void Viewer::seek(long p) {
@@ -173,7 +172,7 @@ void Viewer::seek(long p) {
   }
 
   reset_all_audio();
-  audio_scrub = true;
+  audio_scrub_context = &audio_context_;
   last_playhead = seq->playhead;
   update_parents(update_fx);
 }
@@ -314,7 +313,6 @@ void Viewer::play(bool in_to_out) {
 void Viewer::play_wake() {
   start_msecs = QDateTime::currentMSecsSinceEpoch();
   playback_updater.start();
-  if (audio_thread != nullptr) audio_thread->notifyReceiver();
 }
 
 void Viewer::pause() {
@@ -416,6 +414,11 @@ ViewerWidget *Viewer::viewer_widget()
   return viewer_widget_;
 }
 
+AudioRenderContext *Viewer::audio_context()
+{
+  return &audio_context_;
+}
+
 void Viewer::set_marker() {
   Marker::SetOnSequence(seq.get());
 }
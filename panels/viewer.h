@@ -29,6 +29,7 @@
 #include "timeline/marker.h"
 #include "timeline/mediaimportdata.h"
 #include "project/media.h"
+#include "rendering/audiorendercontext.h"
 
 #include "ui/panel.h"
 #include "ui/viewerwidget.h"
@@ -92,6 +93,11 @@ public:
 
   ViewerWidget* viewer_widget();
 
+  /**
+   * @brief Returns the context this viewer's audio is rendered into for playback
+   */
+  AudioRenderContext* audio_context();
+
   Media* media;
   SequencePtr seq;
   QVector<Marker>* marker_ref;
@@ -177,6 +183,8 @@ private:
   int playback_speed;
 
   Mode mode_;
+
+  AudioRenderContext audio_context_;
 };
 
 #endif // VIEWER_H
@@ -0,0 +1,136 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "analysisscheduler.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+AnalysisScheduler olive::analysis_scheduler;
+
+namespace {
+
+// how long throughput is measured for before the limit is adjusted
+const qint64 kSampleInterval = 2000;
+
+// changes in throughput smaller than this fraction are treated as noise
+const double kThroughputTolerance = 0.05;
+
+}
+
+AnalysisScheduler::AnalysisScheduler() :
+  active_jobs_(0),
+  waiting_jobs_(0),
+  target_jobs_(qMin(2, max_jobs())),
+  direction_(1),
+  last_throughput_(0),
+  sample_bytes_(0)
+{
+  sample_timer_.start();
+}
+
+void AnalysisScheduler::Acquire()
+{
+  QMutexLocker locker(&lock_);
+
+  waiting_jobs_++;
+
+  while (active_jobs_ >= target_jobs_) {
+    slot_freed_.wait(&lock_);
+  }
+
+  waiting_jobs_--;
+
+  // a sample taken while nothing was running would count the idle time against the current limit
+  if (active_jobs_ == 0) {
+    RestartSample();
+  }
+
+  active_jobs_++;
+}
+
+void AnalysisScheduler::Release()
+{
+  QMutexLocker locker(&lock_);
+
+  active_jobs_--;
+
+  slot_freed_.wakeAll();
+}
+
+void AnalysisScheduler::ReportBytesRead(qint64 bytes)
+{
+  QMutexLocker locker(&lock_);
+
+  sample_bytes_ += bytes;
+
+  qint64 elapsed = sample_timer_.elapsed();
+  if (elapsed < kSampleInterval) {
+    return;
+  }
+
+  // only a sample taken with every slot in use says anything about the current limit
+  if (active_jobs_ == target_jobs_) {
+    double throughput = double(sample_bytes_) * 1000.0 / double(elapsed);
+
+    if (last_throughput_ > 0 && throughput < last_throughput_ * (1.0 - kThroughputTolerance)) {
+      // the last change made things worse, go back the other way
+      direction_ = -direction_;
+      target_jobs_ += direction_;
+    } else if (last_throughput_ <= 0 || throughput > last_throughput_ * (1.0 + kThroughputTolerance)) {
+      // the last change helped (or this is the first sample), keep going the same way if there's work for it
+      if (direction_ < 0 || waiting_jobs_ > 0) {
+        target_jobs_ += direction_;
+      }
+    }
+
+    target_jobs_ = qBound(1, target_jobs_, max_jobs());
+
+    // at either end of the range, the only way left to try is back the other way
+    if (target_jobs_ == 1) {
+      direction_ = 1;
+    } else if (target_jobs_ == max_jobs()) {
+      direction_ = -1;
+    }
+
+    last_throughput_ = throughput;
+
+    slot_freed_.wakeAll();
+  }
+
+  RestartSample();
+}
+
+int AnalysisScheduler::concurrency()
+{
+  QMutexLocker locker(&lock_);
+  return target_jobs_;
+}
+
+int AnalysisScheduler::max_jobs()
+{
+  return qMax(1, QThread::idealThreadCount());
+}
+
+void AnalysisScheduler::RestartSample()
+{
+  sample_bytes_ = 0;
+  sample_timer_.start();
+}
@@ -0,0 +1,122 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ANALYSISSCHEDULER_H
+#define ANALYSISSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * @brief The AnalysisScheduler class
+ *
+ * Limits how many PreviewGenerators analyze files at the same time.
+ *
+ * Analyzing is mostly limited by how fast files can be read, and the best amount of files to read at once depends on
+ * the storage (e.g. an SSD benefits from many parallel reads while a hard drive slows down when it has to seek between
+ * files). Rather than a fixed limit, the scheduler measures the combined throughput of all running jobs and adjusts
+ * the limit one job at a time towards whichever direction increases it, never exceeding the number of CPU cores.
+ *
+ * All functions are thread-safe.
+ */
+class AnalysisScheduler {
+public:
+  /**
+   * @brief AnalysisScheduler Constructor
+   */
+  AnalysisScheduler();
+
+  /**
+   * @brief Wait until another job is allowed to run
+   *
+   * Every call must be paired with a call to Release().
+   */
+  void Acquire();
+
+  /**
+   * @brief Release a slot acquired with Acquire()
+   */
+  void Release();
+
+  /**
+   * @brief Report data read by a running job
+   *
+   * @param bytes
+   *
+   * Amount of bytes read since the job last reported
+   */
+  void ReportBytesRead(qint64 bytes);
+
+  /**
+   * @brief Returns the current amount of jobs allowed to run at once
+   */
+  int concurrency();
+
+private:
+  /**
+   * @brief Returns the maximum amount of jobs allowed to run at once (the CPU core count)
+   */
+  static int max_jobs();
+
+  /**
+   * @brief Start a new throughput sample. Expects lock_ to be locked.
+   *
+   * Jobs starting and finishing don't restart the sample, since files shorter than the sample interval would
+   * otherwise keep the limit from ever being adjusted.
+   */
+  void RestartSample();
+
+  QMutex lock_;
+
+  QWaitCondition slot_freed_;
+
+  int active_jobs_;
+
+  int waiting_jobs_;
+
+  /**
+   * @brief Current limit of jobs running at once
+   */
+  int target_jobs_;
+
+  /**
+   * @brief Whether the limit was last raised (1) or lowered (-1)
+   */
+  int direction_;
+
+  /**
+   * @brief Throughput in bytes per second measured at the previous limit, or 0 if it hasn't been measured yet
+   */
+  double last_throughput_;
+
+  qint64 sample_bytes_;
+
+  QElapsedTimer sample_timer_;
+};
+
+namespace olive {
+  /**
+   * @brief Global scheduler shared by all PreviewGenerators
+   */
+  extern AnalysisScheduler analysis_scheduler;
+}
+
+#endif // ANALYSISSCHEDULER_H
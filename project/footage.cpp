@@ -28,7 +28,9 @@
 namespace OCIO = OCIO_NAMESPACE::v1;
 
 #include "project/previewgenerator.h"
+#include "rendering/framecache.h"
 #include "timeline/clip.h"
+#include "ui/filmstripservice.h"
 #include "global/config.h"
 #include "global/global.h"
 
@@ -130,6 +132,33 @@ void Footage::reset() {
   video_tracks.clear();
   audio_tracks.clear();
   ready = false;
+
+  // any frames decoded from this footage may no longer be valid
+  olive::frame_cache.RemoveFootage(this);
+  if (olive::filmstrip_service != nullptr) {
+    olive::filmstrip_service->RemoveFootage(this);
+  }
+}
+
+int64_t FootageStream::get_keyframe_before(int64_t pts) const {
+  // binary search for the last keyframe with a timestamp <= pts
+  int low = 0;
+  int high = keyframe_index.size();
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (keyframe_index.at(mid).pts <= pts) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  if (low == 0) {
+    return AV_NOPTS_VALUE;
+  }
+
+  return keyframe_index.at(low - 1).pts;
 }
 
 long Footage::get_length_in_frames(double frame_rate) {
@@ -34,6 +34,7 @@ extern "C" {
 #include <QPixmap>
 #include <QIcon>
 
+#include "project/waveformpyramid.h"
 #include "timeline/marker.h"
 
 enum VideoInterlacingMode {
@@ -46,6 +47,11 @@ class Sequence;
 class Clip;
 class PreviewGenerator;
 
+struct FootageKeyframe {
+  int64_t pts;
+  int64_t pos;
+};
+
 struct FootageStream {
   int file_index;
   int video_width;
@@ -59,10 +65,15 @@ struct FootageStream {
   int audio_frequency;
   bool enabled;
 
-  // preview thumbnail/waveform
+  // preview thumbnail/waveform (audio_preview is nullptr until the waveform has been generated)
   bool preview_done;
   QImage video_preview;
-  QVector<qint8> audio_preview;
+  WaveformPyramidPtr audio_preview;
+
+  // keyframe timestamps/byte positions sorted by timestamp, used for seeking
+  QVector<FootageKeyframe> keyframe_index;
+
+  int64_t get_keyframe_before(int64_t pts) const;
 };
 
 class Footage {
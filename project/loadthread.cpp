@@ -31,6 +31,8 @@
 #include "effects/internal/voideffect.h"
 #include "global/debug.h"
 #include "effects/effectloaders.h"
+#include "timeline/sequence.h"
+#include "timeline/track.h"
 
 #include <QFile>
 #include <QTreeWidgetItem>
@@ -38,9 +40,22 @@
 const int LOAD_TYPE_VERSION = 100;
 const int LOAD_TYPE_URL = 101;
 
-LoadThread::LoadThread(const QString& filename, bool autorecovery) :
+// older projects only store a track index on each clip, negative for video tracks and positive for audio tracks
+static Track* get_legacy_track(Sequence* s, int index) {
+  olive::TrackType type = (index < 0) ? olive::kTypeVideo : olive::kTypeAudio;
+  int type_index = (index < 0) ? (-index - 1) : index;
+
+  while (s->TrackCount(type) <= type_index) {
+    s->AddTrack(type);
+  }
+
+  return s->TrackAt(type, type_index);
+}
+
+LoadThread::LoadThread(const QString& filename, bool autorecovery, bool interactive) :
   filename_(filename),
   autorecovery_(autorecovery),
+  interactive_(interactive),
   cancelled_(false)
 {
   connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
@@ -431,7 +446,14 @@ bool LoadThread::load_worker(QFile& f, QXmlStreamReader& stream, int type) {
                 }
               }
 
-              // load all clips and clip information
+              // tracks are restored from the file, so start without the Sequence's default ones
+              qDeleteAll(s->findChildren<Track*>(QString(), Qt::FindDirectChildrenOnly));
+              Track* current_track = nullptr;
+
+              // links can point to clips further down the file, so they're resolved once every clip is loaded
+              QVector<QPair<Clip*, int> > loaded_links;
+
+              // load all tracks, clips and clip information
               while (!cancelled_ && !(stream.name() == child_search && stream.isEndElement()) && !stream.atEnd()) {
                 read_next_start_element(stream);
                 if (stream.name() == "marker" && stream.isStartElement()) {
@@ -445,14 +467,49 @@ bool LoadThread::load_worker(QFile& f, QXmlStreamReader& stream, int type) {
                     }
                   }
                   s->markers.append(m);
+                } else if (stream.name() == "track" && stream.isStartElement()) {
+                  olive::TrackType track_type = olive::kTypeVideo;
+                  for (int j=0;j<stream.attributes().size();j++) {
+                    const QXmlStreamAttribute& attr = stream.attributes().at(j);
+                    if (attr.name() == "type") {
+                      track_type = static_cast<olive::TrackType>(attr.value().toInt());
+                    }
+                  }
+
+                  current_track = s->AddTrack(track_type);
+
+                  for (int j=0;j<stream.attributes().size();j++) {
+                    const QXmlStreamAttribute& attr = stream.attributes().at(j);
+                    if (attr.name() == "name") {
+                      current_track->SetName(attr.value().toString());
+                    } else if (attr.name() == "muted") {
+                      current_track->SetMuted(attr.value() == "1");
+                    } else if (attr.name() == "soloed") {
+                      current_track->SetSoloed(attr.value() == "1");
+                    } else if (attr.name() == "locked") {
+                      current_track->SetLocked(attr.value() == "1");
+                    } else if (attr.name() == "height") {
+                      current_track->set_height(attr.value().toInt());
+                    }
+                  }
                 } else if (stream.name() == "clip" && stream.isStartElement()) {
                   int media_type = -1;
                   int media_id = -1;
                   int stream_id = -1;
 
-                  Track* t;
+                  // clips are stored inside their track's element, older projects store the track index instead
+                  Track* t = current_track;
+                  for (int j=0;j<stream.attributes().size();j++) {
+                    const QXmlStreamAttribute& attr = stream.attributes().at(j);
+                    if (attr.name() == "track") {
+                      t = get_legacy_track(s.get(), attr.value().toInt());
+                    }
+                  }
+                  if (t == nullptr) {
+                    t = get_legacy_track(s.get(), -1);
+                  }
+
                   ClipPtr c = std::make_shared<Clip>(t);
-                  //ClipPtr c = std::make_shared<Clip>(s.get());
 
                   QColor clip_color;
                   ClipSpeed speed_info = c->speed();
@@ -517,6 +574,9 @@ bool LoadThread::load_worker(QFile& f, QXmlStreamReader& stream, int type) {
                     break;
                   }
 
+                  // shared transitions are looked up through the clip's track, so add it before loading effects
+                  t->AddClip(c);
+
                   // load links and effects
                   while (!cancelled_ && !(stream.name() == "clip" && stream.isEndElement()) && !stream.atEnd()) {
                     read_next(stream);
@@ -528,8 +588,7 @@ bool LoadThread::load_worker(QFile& f, QXmlStreamReader& stream, int type) {
                             for (int k=0;k<stream.attributes().size();k++) {
                               const QXmlStreamAttribute& link_attr = stream.attributes().at(k);
                               if (link_attr.name() == "id") {
-                                // FIXME reimplement this
-                                //c->linked.append(link_attr.value().toInt());
+                                loaded_links.append(qMakePair(c.get(), link_attr.value().toInt()));
                                 break;
                               }
                             }
@@ -556,48 +615,49 @@ bool LoadThread::load_worker(QFile& f, QXmlStreamReader& stream, int type) {
                     }
                   }
                   if (cancelled_) return false;
-
-                  //s->clips.append(c);
                 }
               }
               if (cancelled_) return false;
 
-              /*
-              // correct links, clip IDs, transitions
-              for (int i=0;i<s->clips.size();i++) {
-                // correct links
-                Clip* correct_clip = s->clips.at(i).get();
-                for (int j=0;j<correct_clip->linked.size();j++) {
-                  bool found = false;
-                  for (int k=0;k<s->clips.size();k++) {
-                    if (s->clips.at(k)->load_id == correct_clip->linked.at(j)) {
-                      correct_clip->linked[j] = k;
-                      found = true;
-                      break;
-                    }
+              // correct links
+              QVector<Clip*> sequence_clips = s->GetAllClips();
+              for (int i=0;i<loaded_links.size();i++) {
+                Clip* link = nullptr;
+                for (int k=0;k<sequence_clips.size();k++) {
+                  if (sequence_clips.at(k)->load_id == loaded_links.at(i).second) {
+                    link = sequence_clips.at(k);
+                    break;
                   }
-                  if (!found) {
-                    correct_clip->linked.removeAt(j);
-                    j--;
-
-                    show_message(
-                          tr("Invalid Clip Link"),
-                          tr("This project contains an invalid clip link. It may be corrupt. Would you like to continue loading it?"),
-                          QMessageBox::Yes | QMessageBox::No
-                          );
-
-                    if (question_btn == QMessageBox::No) {
-                      s.reset();
-                      return false;
-                    }
+                }
+
+                if (link != nullptr) {
+                  loaded_links.at(i).first->linked.append(link);
+                } else {
+                  show_message(
+                        tr("Invalid Clip Link"),
+                        tr("This project contains an invalid clip link. It may be corrupt. Would you like to continue loading it?"),
+                        QMessageBox::Yes | QMessageBox::No
+                        );
+
+                  if (question_btn == QMessageBox::No) {
+                    s.reset();
+                    return false;
                   }
                 }
               }
 
-              MediaPtr m = panel_project->create_sequence_internal(nullptr, s, false, parent);
+              // a Sequence always needs at least one track of each type
+              if (s->TrackCount(olive::kTypeVideo) == 0) {
+                s->AddTrack(olive::kTypeVideo);
+              }
+              if (s->TrackCount(olive::kTypeAudio) == 0) {
+                s->AddTrack(olive::kTypeAudio);
+              }
+
+              // added through the model rather than the Project panel so this also works without the UI
+              MediaPtr m = olive::project_model.CreateSequence(nullptr, s, false, parent);
 
               loaded_sequences.append(m.get());
-              */
             }
               break;
             }
@@ -642,6 +702,10 @@ void LoadThread::run() {
   QFile file(filename_);
   if (!file.open(QIODevice::ReadOnly)) {
     qCritical() << "Could not open file";
+    error_str = tr("Could not open '%1' for reading").arg(filename_);
+    xml_error = false;
+    emit error();
+    mutex.unlock();
     return;
   }
 
@@ -751,16 +815,26 @@ void LoadThread::cancel() {
 
 void LoadThread::question_func(const QString &title, const QString &text, int buttons) {
   mutex.lock();
-  question_btn = QMessageBox::warning(
-        olive::MainWindow,
-        title,
-        text,
-        static_cast<enum QMessageBox::StandardButton>(buttons));
+  if (interactive_) {
+    question_btn = QMessageBox::warning(
+          olive::MainWindow,
+          title,
+          text,
+          static_cast<enum QMessageBox::StandardButton>(buttons));
+  } else {
+    qWarning() << title << "-" << text << "Aborting.";
+    question_btn = QMessageBox::No;
+  }
   mutex.unlock();
   waitCond.wakeAll();
 }
 
 void LoadThread::error_func() {
+  if (!interactive_) {
+    qCritical() << (xml_error ? "Error parsing XML." : "Error loading project:") << error_str;
+    return;
+  }
+
   if (xml_error) {
     qCritical() << "Error parsing XML." << error_str;
     QMessageBox::critical(olive::MainWindow,
@@ -776,6 +850,11 @@ void LoadThread::error_func() {
 }
 
 void LoadThread::success_func() {
+  // the project was only loaded to be used without the main window, so it doesn't become the open project
+  if (!interactive_) {
+    return;
+  }
+
   if (autorecovery_) {
     QString orig_filename = internal_proj_url;
     int insert_index = internal_proj_url.lastIndexOf(".ove", -1, Qt::CaseInsensitive);
@@ -35,7 +35,24 @@ class LoadThread : public QThread
 {
   Q_OBJECT
 public:
-  LoadThread(const QString& filename, bool autorecovery);
+  /**
+   * @brief LoadThread Constructor
+   *
+   * @param filename
+   *
+   * Project file to load
+   *
+   * @param autorecovery
+   *
+   * Whether this file is an autorecovery file (see OliveGlobal::LoadProject())
+   *
+   * @param interactive
+   *
+   * **TRUE** to ask the user questions and show errors in message boxes and open the loaded project in the main
+   * window. **FALSE** to load the project without any user interface (e.g. when exporting from the command line), in
+   * which case errors are only logged and any question about continuing to load is answered with "No".
+   */
+  LoadThread(const QString& filename, bool autorecovery, bool interactive = true);
   void run();
 public slots:
   void cancel();
@@ -50,6 +67,7 @@ private slots:
   void success_func();
 private:
   bool autorecovery_;
+  bool interactive_;
   QString filename_;
 
   bool load_worker(QFile& f, QXmlStreamReader& stream, int type);
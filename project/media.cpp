@@ -107,6 +107,10 @@ void Media::set_parent(Media *p) {
   parent = p;
 }
 
+void Media::set_progress(const QString &progress) {
+  progress_ = progress;
+}
+
 void Media::update_tooltip(const QString& error) {
   switch (type) {
   case MEDIA_TYPE_FOOTAGE:
@@ -342,6 +346,9 @@ QVariant Media::data(int column, int role) {
     }
     break;
   case Qt::ToolTipRole:
+    if (!progress_.isEmpty()) {
+      return tooltip + "\n" + progress_;
+    }
     return tooltip;
 
   case Qt::UserRole:
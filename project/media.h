@@ -58,6 +58,7 @@ public:
   void set_folder();
   void set_parent(Media* p);
   void update_tooltip(const QString& error = nullptr);
+  void set_progress(const QString& progress);
   VoidPtr to_object();
   int get_type();
   const QString& get_name();
@@ -97,6 +98,7 @@ private:
   Media* parent;
   QString folder_name;
   QString tooltip;
+  QString progress_;
   QIcon icon;
   bool disable_thumbnail_;
 };
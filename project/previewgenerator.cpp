@@ -21,6 +21,7 @@
 #include "previewgenerator.h"
 
 #include "ui/mediaiconservice.h"
+#include "project/analysisscheduler.h"
 #include "project/media.h"
 #include "project/footage.h"
 #include "panels/viewer.h"
@@ -33,11 +34,12 @@
 #include <QPixmap>
 #include <QtMath>
 #include <QTreeWidgetItem>
-#include <QSemaphore>
 #include <QFile>
 #include <QDir>
+#include <algorithm>
 
-QSemaphore sem(5); // only 5 preview generators can run at one time
+// how often (in milliseconds) analysis progress is reported
+const qint64 kProgressInterval = 500;
 
 PreviewGenerator::PreviewGenerator(Media* i) :
   QThread(nullptr)
@@ -47,6 +49,9 @@ PreviewGenerator::PreviewGenerator(Media* i) :
   retrieve_duration_ = (false);
   contains_still_image_ = (false);
   cancelled_ = (false);
+  last_progress_report_ = 0;
+  bytes_read_ = 0;
+  reported_bytes_ = 0;
   footage_ = media_->to_footage();
 
   footage_->preview_gen = this;
@@ -158,19 +163,27 @@ bool PreviewGenerator::retrieve_preview(const QString& hash) {
       found = false;
       break;
     }
+
+    // still images have no keyframe index
+    if (!ms.infinite_length) {
+      QFile index_file(get_keyframe_index_path(hash, ms));
+      if (index_file.open(QFile::ReadOnly)) {
+        QByteArray data = index_file.readAll();
+        ms.keyframe_index.resize(data.size() / int(sizeof(FootageKeyframe)));
+        memcpy(ms.keyframe_index.data(), data.constData(), size_t(ms.keyframe_index.size()) * sizeof(FootageKeyframe));
+        index_file.close();
+      } else {
+        found = false;
+        break;
+      }
+    }
   }
   for (int i=0;i<footage_->audio_tracks.size();i++) {
     FootageStream& ms = footage_->audio_tracks[i];
-    QString waveform_path = get_waveform_path(hash, ms);
-    QFile f(waveform_path);
-    if (f.exists()) {
-      //dout << "loaded wave" << ms->file_index << "from" << waveform_path;
-      f.open(QFile::ReadOnly);
-      QByteArray data = f.readAll();
-      ms.audio_preview.resize(data.size());
-      memcpy(ms.audio_preview.data(), data, data.size());
+    WaveformPyramidPtr waveform = std::make_shared<WaveformPyramid>();
+    if (waveform->Open(get_waveform_path(hash, ms))) {
+      ms.audio_preview = waveform;
       ms.preview_done = true;
-      f.close();
     } else {
       found = false;
       break;
@@ -179,11 +192,12 @@ bool PreviewGenerator::retrieve_preview(const QString& hash) {
   if (!found) {
     for (int i=0;i<footage_->video_tracks.size();i++) {
       FootageStream& ms = footage_->video_tracks[i];
+      ms.keyframe_index.clear();
       ms.preview_done = false;
     }
     for (int i=0;i<footage_->audio_tracks.size();i++) {
       FootageStream& ms = footage_->audio_tracks[i];
-      ms.audio_preview.clear();
+      ms.audio_preview = nullptr;
       ms.preview_done = false;
     }
   }
@@ -230,7 +244,7 @@ void PreviewGenerator::invalidate_media(const QString &error_msg)
   footage_->ready_lock.unlock();
 }
 
-void PreviewGenerator::generate_waveform() {
+void PreviewGenerator::generate_waveform(const QString& hash) {
   SwsContext* sws_ctx;
   SwrContext* swr_ctx;
   AVFrame* temp_frame = av_frame_alloc();
@@ -241,18 +255,26 @@ void PreviewGenerator::generate_waveform() {
   // stores media lengths while scanning in case the format has no duration metadata
   int64_t* media_lengths = new int64_t[fmt_ctx_->nb_streams]{0};
 
-  // stores samples while scanning before they get sent to preview file
-  qint8*** waveform_cache_data = new qint8** [fmt_ctx_->nb_streams];
-  int waveform_cache_count = 0;
+  // builds each audio stream's waveform while scanning before it gets saved to a preview file
+  WaveformBuilder** waveform_builders = new WaveformBuilder* [fmt_ctx_->nb_streams];
 
   // defaults to false, sets to true if we find a valid stream to make a preview of
   bool create_previews = false;
 
+  // if any video streams need a keyframe index, we'll need to read every packet in the file
+  bool index_keyframes = false;
+  for (int i=0;i<footage_->video_tracks.size();i++) {
+    if (!footage_->video_tracks.at(i).infinite_length) {
+      index_keyframes = true;
+      break;
+    }
+  }
+
   for (unsigned int i=0;i<fmt_ctx_->nb_streams;i++) {
 
     // default to nullptr values for easier memory management later
     codec_ctx[i] = nullptr;
-    waveform_cache_data[i] = nullptr;
+    waveform_builders[i] = nullptr;
 
     // we only generate previews for video and audio
     // and only if the thumbnail and waveform sizes are > 0
@@ -271,13 +293,9 @@ void PreviewGenerator::generate_waveform() {
         // audio specific functions
         if (fmt_ctx_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
 
-          // allocate sample cache for this stream
-          waveform_cache_data[i] = new qint8* [fmt_ctx_->streams[i]->codecpar->channels];
-
-          // each channel gets a min and a max value so we allocate two ints for each one
-          for (int j=0;j<fmt_ctx_->streams[i]->codecpar->channels;j++) {
-            waveform_cache_data[i][j] = new qint8[2];
-          }
+          waveform_builders[i] = new WaveformBuilder(fmt_ctx_->streams[i]->codecpar->channels,
+                                                     fmt_ctx_->streams[i]->codecpar->sample_rate,
+                                                     olive::config.waveform_resolution);
 
           // if codec context has no defined channel layout, guess it from the channel count
           if (codec_ctx[i]->channel_layout == 0) {
@@ -290,6 +308,11 @@ void PreviewGenerator::generate_waveform() {
         create_previews = true;
       }
     }
+
+    // don't demux packets of streams we won't decode
+    if (codec_ctx[i] == nullptr) {
+      fmt_ctx_->streams[i]->discard = get_discard_level(int(i));
+    }
   }
 
   if (create_previews) {
@@ -300,9 +323,14 @@ void PreviewGenerator::generate_waveform() {
 
     bool end_of_file = false;
 
+    analysis_timer_.start();
+    last_progress_report_ = 0;
+
     // get the ball rolling
     do {
       av_read_frame(fmt_ctx_, packet);
+      add_to_keyframe_index(packet);
+      report_progress(packet);
     } while (codec_ctx[packet->stream_index] == nullptr);
     avcodec_send_packet(codec_ctx[packet->stream_index], packet);
 
@@ -316,6 +344,8 @@ void PreviewGenerator::generate_waveform() {
           if (read_ret != AVERROR_EOF) qCritical() << "Failed to read packet for preview generation" << read_ret;
           break;
         }
+        add_to_keyframe_index(packet);
+        report_progress(packet);
         if (codec_ctx[packet->stream_index] != nullptr) {
           int send_ret = avcodec_send_packet(codec_ctx[packet->stream_index], packet);
           if (send_ret < 0 && send_ret != AVERROR(EAGAIN)) {
@@ -370,7 +400,11 @@ void PreviewGenerator::generate_waveform() {
 
               if (!retrieve_duration_) {
                 avcodec_close(codec_ctx[packet->stream_index]);
-                codec_ctx[packet->stream_index] = nullptr;
+                avcodec_free_context(&codec_ctx[packet->stream_index]);
+
+                // we only needed one frame, stop demuxing the rest of this stream (except what the keyframe index
+                // needs)
+                fmt_ctx_->streams[packet->stream_index]->discard = get_discard_level(packet->stream_index);
               }
             }
             media_lengths[packet->stream_index]++;
@@ -378,7 +412,7 @@ void PreviewGenerator::generate_waveform() {
             AVFrame* swr_frame = av_frame_alloc();
             swr_frame->channel_layout = temp_frame->channel_layout;
             swr_frame->sample_rate = temp_frame->sample_rate;
-            swr_frame->format = AV_SAMPLE_FMT_U8P;
+            swr_frame->format = AV_SAMPLE_FMT_FLTP;
 
             swr_ctx = swr_alloc_set_opts(
                   nullptr,
@@ -396,61 +430,9 @@ void PreviewGenerator::generate_waveform() {
 
             swr_convert_frame(swr_ctx, swr_frame, temp_frame);
 
-            // `config.waveform_resolution` determines how many samples per second are stored in waveform.
-            // `sample_rate` is samples per second, so `interval` is how many samples are averaged in
-            // each "point" of the waveform
-            int interval = qFloor((temp_frame->sample_rate/olive::config.waveform_resolution)/4)*4;
-
-            // get the amount of bytes in an audio sample
-            int sample_size = av_get_bytes_per_sample(static_cast<AVSampleFormat>(swr_frame->format));
-
-            // total amount of data in this frame
-            int nb_bytes = swr_frame->nb_samples * sample_size;
-
-            // loop through entire frame
-            for (int i=0;i<nb_bytes;i+=sample_size) {
-
-              // check if we've hit sample threshold
-              if (waveform_cache_count == interval) {
-
-                // if so, we dump our cached values into the preview and reset them
-                // for the next interval
-                for (int j=0;j<swr_frame->channels;j++) {
-                  qint8& min = waveform_cache_data[packet->stream_index][j][0];
-                  qint8& max = waveform_cache_data[packet->stream_index][j][1];
-
-                  s->audio_preview.append(min);
-                  s->audio_preview.append(max);
-                }
-
-                waveform_cache_count = 0;
-              }
-
-              // standard processing for each channel of information
-              for (int j=0;j<swr_frame->channels;j++) {
-                qint8& min = waveform_cache_data[packet->stream_index][j][0];
-                qint8& max = waveform_cache_data[packet->stream_index][j][1];
-
-                // if we're starting over, reset cache to zero
-                if (waveform_cache_count == 0) {
-                  min = 0;
-                  max = 0;
-                }
-
-                // Convert unsigned 8-bit PCM sample to signed
-                qint8 sample = qint8(int(swr_frame->data[j][i]-128));
-
-                // Store most minimum and most maximum samples of this interval
-                min = qMin(min, sample);
-                max = qMax(max, sample);
-              }
-
-              waveform_cache_count++;
-
-              if (cancelled_) {
-                break;
-              }
-            }
+            // add this frame's samples to the stream's waveform
+            waveform_builders[packet->stream_index]->AddSamples(reinterpret_cast<const float* const*>(swr_frame->data),
+                                                                swr_frame->nb_samples);
 
             swr_free(&swr_ctx);
             av_frame_free(&swr_frame);
@@ -465,7 +447,7 @@ void PreviewGenerator::generate_waveform() {
         // check if we've got all our previews
         if (retrieve_duration_) {
           done = false;
-        } else if (footage_->audio_tracks.size() == 0) {
+        } else if (footage_->audio_tracks.size() == 0 && !index_keyframes) {
           done = true;
           for (int i=0;i<footage_->video_tracks.size();i++) {
             if (!footage_->video_tracks.at(i).preview_done) {
@@ -486,11 +468,21 @@ void PreviewGenerator::generate_waveform() {
     av_packet_free(&packet);
 
     for (unsigned int i=0;i<fmt_ctx_->nb_streams;i++) {
-      if (waveform_cache_data[i] != nullptr) {
-        for (int j=0;j<codec_ctx[i]->channels;j++) {
-          delete [] waveform_cache_data[i][j];
+      if (waveform_builders[i] != nullptr) {
+        FootageStream* s = footage_->get_stream_from_file_index(false, int(i));
+
+        // save the waveform to a preview file and map it back in for drawing
+        if (s != nullptr && !cancelled_) {
+          QString waveform_path = get_waveform_path(hash, *s);
+          if (waveform_builders[i]->Save(waveform_path)) {
+            WaveformPyramidPtr waveform = std::make_shared<WaveformPyramid>();
+            if (waveform->Open(waveform_path)) {
+              s->audio_preview = waveform;
+            }
+          }
         }
-        delete [] waveform_cache_data[i];
+
+        delete waveform_builders[i];
       }
 
       if (codec_ctx[i] != nullptr) {
@@ -503,6 +495,23 @@ void PreviewGenerator::generate_waveform() {
     for (int i=0;i<footage_->audio_tracks.size();i++) {
       footage_->audio_tracks[i].preview_done = true;
     }
+
+    if (!cancelled_) {
+      double seconds = analysis_timer_.elapsed() * 0.001;
+      qInfo() << "Analyzed" << footage_->name << "in" << seconds << "seconds -"
+              << (bytes_read_ / 1048576.0) / qMax(seconds, 0.001) << "MB/s";
+    }
+
+    // analysis is over, so stop showing its progress
+    QMetaObject::invokeMethod(this, "set_media_progress", Qt::QueuedConnection, Q_ARG(QString, QString()));
+
+    // packets are read in decode order, but the index is searched by timestamp
+    for (int i=0;i<footage_->video_tracks.size();i++) {
+      QVector<FootageKeyframe>& index = footage_->video_tracks[i].keyframe_index;
+      std::sort(index.begin(), index.end(), [](const FootageKeyframe& a, const FootageKeyframe& b) {
+        return a.pts < b.pts;
+      });
+    }
   }
 
   if (retrieve_duration_) {
@@ -520,11 +529,77 @@ void PreviewGenerator::generate_waveform() {
     finalize_media();
   }
 
-  delete [] waveform_cache_data;
+  delete [] waveform_builders;
   delete [] media_lengths;
   delete [] codec_ctx;
 }
 
+AVDiscard PreviewGenerator::get_discard_level(int stream_index)
+{
+  FootageStream* s = footage_->get_stream_from_file_index(true, stream_index);
+
+  if (s != nullptr) {
+    if (retrieve_duration_) {
+      // every frame needs to be counted to find the duration
+      return AVDISCARD_DEFAULT;
+    } else if (!s->infinite_length) {
+      // the keyframe index still needs the keyframe packets
+      return AVDISCARD_NONKEY;
+    }
+  }
+
+  return AVDISCARD_ALL;
+}
+
+void PreviewGenerator::report_progress(AVPacket *packet)
+{
+  // image sequences open a separate AVIOContext per file, count the packets instead
+  if (fmt_ctx_->pb != nullptr) {
+    bytes_read_ = fmt_ctx_->pb->bytes_read;
+  } else if (packet->size > 0) {
+    bytes_read_ += packet->size;
+  }
+
+  qint64 elapsed = analysis_timer_.elapsed();
+  if (elapsed - last_progress_report_ < kProgressInterval) {
+    return;
+  }
+
+  olive::analysis_scheduler.ReportBytesRead(bytes_read_ - reported_bytes_);
+
+  double throughput = double(bytes_read_ - reported_bytes_) / 1048576.0 * 1000.0 / double(elapsed - last_progress_report_);
+
+  reported_bytes_ = bytes_read_;
+  last_progress_report_ = elapsed;
+
+  // estimate progress from how far into the file this packet is
+  int progress = -1;
+  if (fmt_ctx_->duration > 0 && packet->dts != AV_NOPTS_VALUE) {
+    AVStream* stream = fmt_ctx_->streams[packet->stream_index];
+    int64_t start = (stream->start_time == AV_NOPTS_VALUE) ? 0 : stream->start_time;
+    int64_t position = av_rescale_q(packet->dts - start, stream->time_base, AV_TIME_BASE_Q);
+    progress = int(qBound(int64_t(0), position * 100 / fmt_ctx_->duration, int64_t(100)));
+  } else if (fmt_ctx_->pb != nullptr && avio_size(fmt_ctx_->pb) > 0) {
+    progress = int(qBound(int64_t(0), avio_tell(fmt_ctx_->pb) * 100 / avio_size(fmt_ctx_->pb), int64_t(100)));
+  }
+
+  QString throughput_str = QString::number(throughput, 'f', 1);
+  QString progress_str;
+  if (progress >= 0) {
+    progress_str = tr("Analyzing: %1% (%2 MB/s)").arg(QString::number(progress), throughput_str);
+  } else {
+    progress_str = tr("Analyzing: %1 MB/s").arg(throughput_str);
+  }
+
+  // the project model reads the Media from the main thread, so it's updated there
+  QMetaObject::invokeMethod(this, "set_media_progress", Qt::QueuedConnection, Q_ARG(QString, progress_str));
+}
+
+void PreviewGenerator::set_media_progress(const QString &progress)
+{
+  media_->set_progress(progress);
+}
+
 QString PreviewGenerator::get_thumbnail_path(const QString& hash, const FootageStream& ms) {
   return data_dir_.filePath(QString("%1t%2").arg(hash, QString::number(ms.file_index)));
 }
@@ -533,6 +608,30 @@ QString PreviewGenerator::get_waveform_path(const QString& hash, const FootageSt
   return data_dir_.filePath(QString("%1w%2").arg(hash, QString::number(ms.file_index)));
 }
 
+QString PreviewGenerator::get_keyframe_index_path(const QString &hash, const FootageStream &ms) {
+  return data_dir_.filePath(QString("%1k%2").arg(hash, QString::number(ms.file_index)));
+}
+
+void PreviewGenerator::add_to_keyframe_index(AVPacket *packet) {
+  if (!(packet->flags & AV_PKT_FLAG_KEY)
+      || fmt_ctx_->streams[packet->stream_index]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    return;
+  }
+
+  FootageStream* s = footage_->get_stream_from_file_index(true, packet->stream_index);
+  if (s == nullptr || s->infinite_length) {
+    return;
+  }
+
+  FootageKeyframe k;
+  k.pts = (packet->pts == AV_NOPTS_VALUE) ? packet->dts : packet->pts;
+  k.pos = packet->pos;
+
+  if (k.pts != AV_NOPTS_VALUE) {
+    s->keyframe_index.append(k);
+  }
+}
+
 void PreviewGenerator::run() {
   Q_ASSERT(footage_ != nullptr);
   Q_ASSERT(media_ != nullptr);
@@ -573,10 +672,10 @@ void PreviewGenerator::run() {
       QString hash = get_file_hash(footage_->url);
 
       if (retrieve_preview(hash)) {
-        sem.acquire();
+        olive::analysis_scheduler.Acquire();
 
         if (!cancelled_) {
-          generate_waveform();
+          generate_waveform(hash);
 
           if (!cancelled_) {
             // save preview to file
@@ -584,19 +683,19 @@ void PreviewGenerator::run() {
               FootageStream& ms = footage_->video_tracks[i];
               ms.video_preview.save(get_thumbnail_path(hash, ms), "PNG");
               //dout << "saved" << ms->file_index << "thumbnail to" << get_thumbnail_path(hash, ms);
-            }
-            for (int i=0;i<footage_->audio_tracks.size();i++) {
-              FootageStream& ms = footage_->audio_tracks[i];
-              QFile f(get_waveform_path(hash, ms));
-              f.open(QFile::WriteOnly);
-              f.write(reinterpret_cast<const char*>(ms.audio_preview.constData()), ms.audio_preview.size());
-              f.close();
-              //dout << "saved" << ms->file_index << "waveform to" << get_waveform_path(hash, ms);
+
+              if (!ms.infinite_length) {
+                QFile f(get_keyframe_index_path(hash, ms));
+                f.open(QFile::WriteOnly);
+                f.write(reinterpret_cast<const char*>(ms.keyframe_index.constData()),
+                        ms.keyframe_index.size() * int(sizeof(FootageKeyframe)));
+                f.close();
+              }
             }
           }
         }
 
-        sem.release();
+        olive::analysis_scheduler.Release();
       }
     }
     avformat_close_input(&fmt_ctx_);
@@ -22,8 +22,8 @@
 #define PREVIEWGENERATOR_H
 
 #include <QThread>
-#include <QSemaphore>
 #include <QDir>
+#include <QElapsedTimer>
 
 #include "project/footage.h"
 #include "project/media.h"
@@ -44,14 +44,20 @@ public:
   void cancel();
 
   static void AnalyzeMedia(Media*);
+private slots:
+  void set_media_progress(const QString& progress);
 private:
   void parse_media();
   bool retrieve_preview(const QString &hash);
-  void generate_waveform();
+  void generate_waveform(const QString& hash);
   void finalize_media();
   void invalidate_media(const QString& error_msg);
   QString get_thumbnail_path(const QString &hash, const FootageStream &ms);
   QString get_waveform_path(const QString& hash, const FootageStream &ms);
+  QString get_keyframe_index_path(const QString& hash, const FootageStream &ms);
+  void add_to_keyframe_index(AVPacket* packet);
+  AVDiscard get_discard_level(int stream_index);
+  void report_progress(AVPacket* packet);
 
   AVFormatContext* fmt_ctx_;
   Media* media_;
@@ -60,6 +66,12 @@ private:
   bool contains_still_image_;
   bool cancelled_;
   QDir data_dir_;
+
+  // analysis throughput/progress
+  QElapsedTimer analysis_timer_;
+  qint64 last_progress_report_;
+  qint64 bytes_read_;
+  qint64 reported_bytes_;
 };
 
 #endif // PREVIEWGENERATOR_H
@@ -0,0 +1,352 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "waveformpyramid.h"
+
+#include <QDebug>
+#include <QtMath>
+#include <cstring>
+
+namespace {
+
+struct WaveformPyramidHeader {
+  char magic[4];
+  qint32 version;
+  qint32 channels;
+  qint32 sample_rate;
+  qint32 base_decimation;
+  qint32 level_count;
+  qint64 point_count;
+};
+
+const char kWaveformPyramidMagic[4] = {'O', 'W', 'A', 'V'};
+const qint32 kWaveformPyramidVersion = 1;
+
+qint64 LevelSize(qint64 point_count, int level)
+{
+  // each level halves the one before it, rounding up so the last point of an odd-sized level isn't dropped
+  for (int i=0;i<level;i++) {
+    point_count = (point_count + 1) / 2;
+  }
+  return point_count;
+}
+
+int LevelCount(qint64 point_count)
+{
+  int levels = 1;
+  while (point_count > 1 && levels < WaveformPyramid::kMaxLevels) {
+    point_count = (point_count + 1) / 2;
+    levels++;
+  }
+  return levels;
+}
+
+qint8 QuantizeSample(double value)
+{
+  return qint8(qBound(-127, qRound(value * 127.0), 127));
+}
+
+}
+
+WaveformPyramid::WaveformPyramid() :
+  map_(nullptr),
+  channels_(0),
+  sample_rate_(0),
+  base_decimation_(1),
+  level_count_(0)
+{
+  for (int i=0;i<kMaxLevels;i++) {
+    levels_[i] = nullptr;
+    level_sizes_[i] = 0;
+  }
+}
+
+WaveformPyramid::~WaveformPyramid()
+{
+  if (map_ != nullptr) {
+    file_.unmap(map_);
+  }
+}
+
+bool WaveformPyramid::Open(const QString &filename)
+{
+  file_.setFileName(filename);
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  WaveformPyramidHeader header;
+  if (file_.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header))
+      || memcmp(header.magic, kWaveformPyramidMagic, sizeof(header.magic)) != 0
+      || header.version != kWaveformPyramidVersion
+      || header.channels <= 0
+      || header.base_decimation <= 0
+      || header.point_count < 0
+      || header.level_count != LevelCount(header.point_count)) {
+    qWarning() << "Invalid waveform file" << filename;
+    file_.close();
+    return false;
+  }
+
+  qint64 total_points = 0;
+  for (int i=0;i<header.level_count;i++) {
+    level_sizes_[i] = LevelSize(header.point_count, i);
+    total_points += level_sizes_[i];
+  }
+
+  if (file_.size() != qint64(sizeof(header)) + total_points * header.channels * qint64(sizeof(WaveformPoint))) {
+    qWarning() << "Invalid waveform file" << filename;
+    file_.close();
+    return false;
+  }
+
+  channels_ = header.channels;
+  sample_rate_ = header.sample_rate;
+  base_decimation_ = header.base_decimation;
+  level_count_ = header.level_count;
+
+  map_ = file_.map(0, file_.size());
+  if (map_ == nullptr) {
+    qWarning() << "Failed to map waveform file" << filename;
+    file_.close();
+    return false;
+  }
+
+  // the file can be closed once it's mapped
+  file_.close();
+
+  const WaveformPoint* points = reinterpret_cast<const WaveformPoint*>(map_ + sizeof(header));
+  for (int i=0;i<level_count_;i++) {
+    levels_[i] = points;
+    points += level_sizes_[i] * channels_;
+  }
+
+  return true;
+}
+
+int WaveformPyramid::channels() const
+{
+  return channels_;
+}
+
+int WaveformPyramid::sample_rate() const
+{
+  return sample_rate_;
+}
+
+int WaveformPyramid::level_count() const
+{
+  return level_count_;
+}
+
+int WaveformPyramid::decimation(int level) const
+{
+  return base_decimation_ << level;
+}
+
+qint64 WaveformPyramid::level_size(int level) const
+{
+  return level_sizes_[level];
+}
+
+const WaveformPoint *WaveformPyramid::level(int level) const
+{
+  return levels_[level];
+}
+
+int WaveformPyramid::FindLevel(double points_per_pixel) const
+{
+  int level = 0;
+
+  while (level + 1 < level_count_ && points_per_pixel >= 2.0) {
+    points_per_pixel *= 0.5;
+    level++;
+  }
+
+  return level;
+}
+
+WaveformPoint WaveformPyramid::Summarize(int level, int channel, qint64 start, qint64 end) const
+{
+  WaveformPoint summary = {0, 0, 0};
+
+  qint64 size = level_sizes_[level];
+
+  if (size == 0) {
+    return summary;
+  }
+
+  start = qBound(qint64(0), start, size - 1);
+  end = qBound(start + 1, end, size);
+
+  const WaveformPoint* points = levels_[level];
+
+  summary = points[start * channels_ + channel];
+
+  double square_sum = double(summary.rms) * summary.rms;
+
+  for (qint64 i=start+1;i<end;i++) {
+    const WaveformPoint& p = points[i * channels_ + channel];
+    summary.min = qMin(summary.min, p.min);
+    summary.max = qMax(summary.max, p.max);
+    square_sum += double(p.rms) * p.rms;
+  }
+
+  summary.rms = qint8(qRound(qSqrt(square_sum / double(end - start))));
+
+  return summary;
+}
+
+WaveformBuilder::WaveformBuilder(int channels, int sample_rate, int points_per_second) :
+  channels_(channels),
+  sample_rate_(sample_rate),
+  decimation_(1),
+  count_(0),
+  min_(channels),
+  max_(channels),
+  square_sum_(channels)
+{
+  // use the largest power of two that gives at least the requested resolution
+  int samples_per_point = sample_rate_ / qMax(1, points_per_second);
+  while (decimation_ * 2 <= samples_per_point) {
+    decimation_ *= 2;
+  }
+}
+
+void WaveformBuilder::AddSamples(const float * const *planes, int frames)
+{
+  int i = 0;
+
+  while (i < frames) {
+    int count = qMin(frames - i, decimation_ - count_);
+
+    for (int j=0;j<channels_;j++) {
+      const float* in = planes[j] + i;
+
+      float min = (count_ == 0) ? in[0] : min_[j];
+      float max = (count_ == 0) ? in[0] : max_[j];
+      double square_sum = (count_ == 0) ? 0.0 : square_sum_[j];
+
+      for (int k=0;k<count;k++) {
+        min = qMin(min, in[k]);
+        max = qMax(max, in[k]);
+        square_sum += double(in[k]) * in[k];
+      }
+
+      min_[j] = min;
+      max_[j] = max;
+      square_sum_[j] = square_sum;
+    }
+
+    count_ += count;
+    i += count;
+
+    if (count_ == decimation_) {
+      AddPoint();
+    }
+  }
+}
+
+bool WaveformBuilder::Save(const QString &filename)
+{
+  // include whatever samples were left over at the end of the stream
+  if (count_ > 0) {
+    AddPoint();
+  }
+
+  qint64 point_count = points_.size() / channels_;
+
+  WaveformPyramidHeader header;
+  memcpy(header.magic, kWaveformPyramidMagic, sizeof(header.magic));
+  header.version = kWaveformPyramidVersion;
+  header.channels = channels_;
+  header.sample_rate = sample_rate_;
+  header.base_decimation = decimation_;
+  header.level_count = LevelCount(point_count);
+  header.point_count = point_count;
+
+  QFile f(filename + ".part");
+  if (!f.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to open waveform file" << filename;
+    return false;
+  }
+
+  bool ok = (f.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header)));
+
+  // each level is built from the one before it
+  QVector<WaveformPoint> level = points_;
+
+  for (int i=0;i<header.level_count && ok;i++) {
+    if (i > 0) {
+      qint64 previous_size = level.size() / channels_;
+      qint64 size = (previous_size + 1) / 2;
+
+      for (qint64 j=0;j<size;j++) {
+        for (int k=0;k<channels_;k++) {
+          const WaveformPoint& a = level.at(int((j * 2) * channels_ + k));
+
+          WaveformPoint merged = a;
+
+          if (j * 2 + 1 < previous_size) {
+            const WaveformPoint& b = level.at(int((j * 2 + 1) * channels_ + k));
+            merged.min = qMin(a.min, b.min);
+            merged.max = qMax(a.max, b.max);
+            merged.rms = qint8(qRound(qSqrt((double(a.rms) * a.rms + double(b.rms) * b.rms) * 0.5)));
+          }
+
+          // the merged level is never larger than the one it's built from, so it's safe to overwrite in place
+          level[int(j * channels_ + k)] = merged;
+        }
+      }
+
+      level.resize(int(size * channels_));
+    }
+
+    qint64 bytes = qint64(level.size()) * qint64(sizeof(WaveformPoint));
+    ok = (f.write(reinterpret_cast<const char*>(level.constData()), bytes) == bytes);
+  }
+
+  f.close();
+
+  if (ok) {
+    QFile::remove(filename);
+    ok = f.rename(filename);
+  }
+
+  if (!ok) {
+    f.remove();
+    qWarning() << "Failed to save waveform file" << filename;
+  }
+
+  return ok;
+}
+
+void WaveformBuilder::AddPoint()
+{
+  for (int i=0;i<channels_;i++) {
+    WaveformPoint p;
+    p.min = QuantizeSample(min_.at(i));
+    p.max = QuantizeSample(max_.at(i));
+    p.rms = QuantizeSample(qSqrt(square_sum_.at(i) / count_));
+    points_.append(p);
+  }
+
+  count_ = 0;
+}
@@ -0,0 +1,251 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef WAVEFORMPYRAMID_H
+#define WAVEFORMPYRAMID_H
+
+#include <memory>
+#include <QFile>
+#include <QVector>
+
+/**
+ * @brief One point of a waveform, summarizing a range of samples in one channel
+ *
+ * Values are scaled so that -127 to 127 corresponds to -1.0 to 1.0.
+ */
+struct WaveformPoint {
+  qint8 min;
+  qint8 max;
+  qint8 rms;
+};
+
+/**
+ * @brief The WaveformPyramid class
+ *
+ * A multi-resolution waveform of one audio stream, used for drawing waveforms in the Timeline and Viewer.
+ *
+ * Level 0 stores one WaveformPoint per channel for every decimation(0) samples of the stream. Each level after that
+ * merges pairs of points from the level before it, so level N summarizes `decimation(0) << N` samples per point. When
+ * drawing, FindLevel() picks the coarsest level that still has at least one point per pixel, so drawing an hour-long
+ * clip zoomed out costs about as much as drawing a few seconds of it zoomed in.
+ *
+ * Pyramids are created by WaveformBuilder and stored as one file per stream in the preview directory, which is
+ * memory-mapped so only the levels and ranges actually drawn are ever read from disk.
+ *
+ * WaveformPyramid objects are read-only once opened, so they can be used from any thread.
+ */
+class WaveformPyramid {
+public:
+  /**
+   * @brief Maximum number of levels in a pyramid
+   */
+  static const int kMaxLevels = 32;
+
+  /**
+   * @brief WaveformPyramid Constructor
+   */
+  WaveformPyramid();
+
+  /**
+   * @brief WaveformPyramid Destructor
+   *
+   * Unmaps the file.
+   */
+  ~WaveformPyramid();
+
+  /**
+   * @brief Map a waveform file created by WaveformBuilder
+   *
+   * @return
+   *
+   * **TRUE** if the file exists and is a valid waveform file.
+   */
+  bool Open(const QString& filename);
+
+  /**
+   * @brief Returns the number of channels in the stream
+   */
+  int channels() const;
+
+  /**
+   * @brief Returns the sample rate of the stream
+   */
+  int sample_rate() const;
+
+  /**
+   * @brief Returns the number of levels in the pyramid
+   */
+  int level_count() const;
+
+  /**
+   * @brief Returns how many samples of the stream each point in a level summarizes
+   */
+  int decimation(int level) const;
+
+  /**
+   * @brief Returns the number of points (per channel) in a level
+   */
+  qint64 level_size(int level) const;
+
+  /**
+   * @brief Returns the points of a level
+   *
+   * @return
+   *
+   * Array of level_size() * channels() points, interleaved by channel.
+   */
+  const WaveformPoint* level(int level) const;
+
+  /**
+   * @brief Find the level to draw from at a certain zoom
+   *
+   * @param points_per_pixel
+   *
+   * Number of level 0 points that fall within each pixel at the current zoom.
+   *
+   * @return
+   *
+   * The coarsest level that still has at least one point per pixel, or 0 if even level 0 has fewer points than pixels.
+   */
+  int FindLevel(double points_per_pixel) const;
+
+  /**
+   * @brief Merge a range of points in one channel into a single point
+   *
+   * @param level
+   *
+   * Level to read from
+   *
+   * @param channel
+   *
+   * Channel to read from
+   *
+   * @param start
+   *
+   * Index of the first point in the range
+   *
+   * @param end
+   *
+   * Index directly after the last point in the range. If this is not after `start`, only the point at `start` is
+   * used. The range is clamped to the level's size.
+   *
+   * @return
+   *
+   * The minimum and maximum of all points in the range and their average RMS.
+   */
+  WaveformPoint Summarize(int level, int channel, qint64 start, qint64 end) const;
+
+private:
+  QFile file_;
+
+  uchar* map_;
+
+  int channels_;
+
+  int sample_rate_;
+
+  int base_decimation_;
+
+  int level_count_;
+
+  const WaveformPoint* levels_[kMaxLevels];
+
+  qint64 level_sizes_[kMaxLevels];
+};
+
+using WaveformPyramidPtr = std::shared_ptr<WaveformPyramid>;
+
+/**
+ * @brief The WaveformBuilder class
+ *
+ * Builds a WaveformPyramid file from a stream's samples as they're decoded (see PreviewGenerator).
+ */
+class WaveformBuilder {
+public:
+  /**
+   * @brief WaveformBuilder Constructor
+   *
+   * @param channels
+   *
+   * Number of channels in the stream
+   *
+   * @param sample_rate
+   *
+   * Sample rate of the stream
+   *
+   * @param points_per_second
+   *
+   * Approximate resolution of the pyramid's first level. The actual resolution will be rounded so that each point
+   * summarizes a power of two samples (see Config::waveform_resolution).
+   */
+  WaveformBuilder(int channels, int sample_rate, int points_per_second);
+
+  /**
+   * @brief Add the next samples of the stream
+   *
+   * @param planes
+   *
+   * One array of float samples for each channel.
+   *
+   * @param frames
+   *
+   * Number of samples in each array.
+   */
+  void AddSamples(const float* const* planes, int frames);
+
+  /**
+   * @brief Build the rest of the pyramid's levels and save it to a file
+   *
+   * @return
+   *
+   * **TRUE** if the file was written successfully.
+   */
+  bool Save(const QString& filename);
+
+private:
+  /**
+   * @brief Add a level 0 point from the samples accumulated so far
+   */
+  void AddPoint();
+
+  int channels_;
+
+  int sample_rate_;
+
+  int decimation_;
+
+  /**
+   * @brief Number of samples accumulated into the current point
+   */
+  int count_;
+
+  QVector<float> min_;
+
+  QVector<float> max_;
+
+  QVector<double> square_sum_;
+
+  /**
+   * @brief Level 0 points, interleaved by channel
+   */
+  QVector<WaveformPoint> points_;
+};
+
+#endif // WAVEFORMPYRAMID_H
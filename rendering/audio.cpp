@@ -29,6 +29,8 @@
 #include "global/config.h"
 #include "ui/audiomonitor.h"
 #include "rendering/renderfunctions.h"
+#include "rendering/audiodsp.h"
+#include "rendering/audiorendercontext.h"
 #include "global/debug.h"
 
 #include <QApplication>
@@ -37,27 +39,21 @@
 #include <QtMath>
 #include <QFile>
 #include <QDir>
+#include <QMutexLocker>
 #include <QComboBox>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
 
-QAudioOutput* audio_output;
-QIODevice* audio_io_device;
 bool audio_device_set = false;
-bool audio_scrub = false;
-QMutex audio_write_lock;
+AudioRenderContext* audio_scrub_context = nullptr;
 QAudioInput* audio_input = nullptr;
 QFile output_recording;
 bool recording = false;
 
-int audio_rendering_rate = 0;
-
-float audio_ibuffer[audio_ibuffer_size];
-qint64 audio_ibuffer_read = 0;
-long audio_ibuffer_frame = 0;
-double audio_ibuffer_timecode = 0;
+// rate of the audio currently being processed on each thread, 0 if unset
+thread_local int thread_audio_freq = 0;
 
 AudioSenderThread* audio_thread = nullptr;
 
@@ -97,13 +93,14 @@ QAudioDeviceInfo get_audio_device(QAudio::Mode mode) {
 void init_audio() {
   stop_audio();
 
+  // mixing is always done in float, but 16-bit integer output is what nearly every backend accepts natively
   QAudioFormat audio_format;
   audio_format.setSampleRate(olive::config.audio_rate);
   audio_format.setChannelCount(2);
-  audio_format.setSampleSize(32);
+  audio_format.setSampleSize(16);
   audio_format.setCodec("audio/pcm");
   audio_format.setByteOrder(QAudioFormat::LittleEndian);
-  audio_format.setSampleType(QAudioFormat::Float);
+  audio_format.setSampleType(QAudioFormat::SignedInt);
 
   QAudioDeviceInfo info = get_audio_device(QAudio::AudioOutput);
 
@@ -113,128 +110,210 @@ void init_audio() {
     audio_format = info.nearestFormat(audio_format);
   }
 
-  audio_output = new QAudioOutput(info, audio_format);
-  audio_output->moveToThread(QApplication::instance()->thread());
-  audio_output->setNotifyInterval(5);
-
-  // connect
-  audio_io_device = audio_output->start();
-  if (audio_io_device == nullptr) {
-    qWarning() << "Received nullptr audio device. No compatible audio output was found.";
-  } else {
+  // start sender thread, which opens the output on itself
+  audio_thread = new AudioSenderThread(info, audio_format);
+  if (audio_thread->StartOutput()) {
     audio_device_set = true;
-
-    // start sender thread
-    audio_thread = new AudioSenderThread();
-    QObject::connect(audio_output, SIGNAL(notify()), audio_thread, SLOT(notifyReceiver()));
-    audio_thread->start(QThread::TimeCriticalPriority);
-
-    clear_audio_ibuffer();
+  } else {
+    qWarning() << "Failed to start audio output. No compatible audio output was found.";
+    audio_thread = nullptr;
   }
 }
 
 void stop_audio() {
   if (audio_device_set) {
     audio_thread->stop();
-
-    audio_output->stop();
-    delete audio_output;
+    audio_thread = nullptr;
     audio_device_set = false;
   }
 }
 
-void clear_audio_ibuffer() {
+void reset_audio_context(AudioRenderContext *context, long start_frame, double frame_rate) {
+  // playback always renders at the output device's rate, even while an export is running at another rate
+  int sample_rate = audio_device_set ? audio_thread->format().sampleRate() : olive::config.audio_rate;
+
   if (audio_thread != nullptr) audio_thread->lock.lock();
-  audio_write_lock.lock();
-  memset(audio_ibuffer, 0, audio_ibuffer_size * sizeof(float));
-  audio_ibuffer_read = 0;
-  audio_write_lock.unlock();
+  context->Reset(start_frame, frame_rate, sample_rate);
   if (audio_thread != nullptr) audio_thread->lock.unlock();
 }
 
 int current_audio_freq() {
-  return olive::Global->is_exporting()
-      ? audio_rendering_rate : audio_output->format().sampleRate();
+  if (thread_audio_freq > 0) {
+    return thread_audio_freq;
+  }
+  return audio_device_set ? audio_thread->format().sampleRate() : olive::config.audio_rate;
 }
 
-qint64 get_buffer_offset_from_frame(double framerate, long frame) {
-  if (frame >= audio_ibuffer_frame) {
-    int multiplier = av_get_channel_layout_nb_channels(AV_CH_LAYOUT_STEREO);
-    return qFloor((double(frame - audio_ibuffer_frame)/framerate)*current_audio_freq())*multiplier;
-  } else {
-    qWarning() << "Invalid values passed to get_buffer_offset_from_frame" << frame << "<" << audio_ibuffer_frame;
-    return 0;
-  }
+void set_thread_audio_freq(int rate) {
+  thread_audio_freq = rate;
 }
 
-AudioSenderThread::AudioSenderThread() : close(false) {
-  connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
+AudioOutputDevice::AudioOutputDevice(const QAudioFormat &format, QMutex *lock) :
+  format_(format),
+  lock_(lock),
+  bytes_per_frame_(format.bytesPerFrame()),
+  period_size_(olive::config.audio_period_size)
+{
+  samples_.resize(period_size_ * format_.channelCount());
+  peaks_.resize(format_.channelCount());
+
+  if (!(format_.sampleType() == QAudioFormat::SignedInt && format_.sampleSize() == 16)
+      && !(format_.sampleType() == QAudioFormat::Float && format_.sampleSize() == 32)) {
+    qWarning() << "Audio output sample format is not supported, audio will be silent";
+  }
 }
 
-void AudioSenderThread::stop() {
-  close = true;
-  cond.wakeAll();
-  wait();
+bool AudioOutputDevice::isSequential() const
+{
+  return true;
 }
 
-void AudioSenderThread::notifyReceiver() {
-  cond.wakeAll();
+qint64 AudioOutputDevice::bytesAvailable() const
+{
+  // audio is generated on demand, so there's always at least one period available
+  return period_size_ * bytes_per_frame_ + QIODevice::bytesAvailable();
 }
 
-void AudioSenderThread::run() {
-  // start data loop
-  send_audio_to_output(0, audio_ibuffer_size);
-
-  lock.lock();
-  while (true) {
-    cond.wait(&lock);
-    if (close) {
-      break;
-    } else if (panel_sequence_viewer->playing || panel_footage_viewer->playing || audio_scrub) {
-
-      int adjusted_read_index = (audio_ibuffer_read%audio_ibuffer_size);
-      int max_write = (audio_ibuffer_size - adjusted_read_index) * sizeof(float);
-      int actual_write = send_audio_to_output(adjusted_read_index, max_write);
-      if (actual_write == max_write) {
-        // got all the bytes, write again
-        send_audio_to_output(0, audio_ibuffer_size);
-      }
+qint64 AudioOutputDevice::readData(char *data, qint64 maxlen)
+{
+  int channels = format_.channelCount();
+  qint64 frames = maxlen / bytes_per_frame_;
+  qint64 written = 0;
+
+  while (frames > 0) {
+    int period = int(qMin(frames, qint64(period_size_)));
+    int count = period * channels;
+    qint64 period_bytes = qint64(period) * bytes_per_frame_;
+
+    bool mixed = MixPeriod(count);
+
+    const float* samples = samples_.constData();
 
-      audio_scrub = false;
+    if (format_.sampleType() == QAudioFormat::SignedInt && format_.sampleSize() == 16) {
+      olive::dsp::FloatToInt16(samples, reinterpret_cast<int16_t*>(data), count);
+    } else if (format_.sampleType() == QAudioFormat::Float && format_.sampleSize() == 32) {
+      memcpy(data, samples, size_t(period_bytes));
+    } else {
+      memset(data, 0, size_t(period_bytes));
     }
+
+    if (mixed && !panel_timeline.isEmpty()) {
+      // send peaks to audio monitor
+      olive::dsp::Peak(samples, period, channels, peaks_.data());
+      panel_timeline.first()->audio_monitor->PushPeaks(peaks_.constData(), channels);
+    }
+
+    data += period_bytes;
+    written += period_bytes;
+    frames -= period;
   }
-  lock.unlock();
+
+  return written;
 }
 
-int AudioSenderThread::send_audio_to_output(qint64 offset, int max) {
-  // send audio to device
-  audio_write_lock.lock();
+qint64 AudioOutputDevice::writeData(const char *, qint64)
+{
+  return -1;
+}
+
+bool AudioOutputDevice::MixPeriod(int count)
+{
+  QMutexLocker locker(lock_);
+
+  // mix the contexts of every viewer that's currently producing audio
+  QVector<AudioRenderContext*> contexts;
+  if (panel_sequence_viewer != nullptr && panel_sequence_viewer->playing) {
+    contexts.append(panel_sequence_viewer->audio_context());
+  }
+  if (panel_footage_viewer != nullptr && panel_footage_viewer->playing) {
+    contexts.append(panel_footage_viewer->audio_context());
+  }
 
-  qint64 actual_write = audio_io_device->write(reinterpret_cast<const char*>(&audio_ibuffer[offset]), max);
+  AudioRenderContext* scrub_context = audio_scrub_context;
+  audio_scrub_context = nullptr;
+  if (scrub_context != nullptr && !contexts.contains(scrub_context)) {
+    contexts.append(scrub_context);
+  }
 
-  if (actual_write > 0) {
-    // average values and send to audio monitor
-    int channels = audio_output->format().channelCount();
-    qint64 lim = offset + (actual_write/sizeof(float));
-    QVector<float> averages;
-    averages.resize(channels);
-    averages.fill(0.0);
+  samples_.resize(count);
+  if (contexts.isEmpty()) {
+    samples_.fill(0.0f);
+    return false;
+  }
+
+  contexts.first()->mixer()->Mix(samples_.data(), count);
 
-    for (qint64 i=offset;i<lim;i++) {
-      int channel = i%channels;
-      averages[channel] = qMax(qAbs(audio_ibuffer[i]), averages[channel]);
+  if (contexts.size() > 1) {
+    mix_samples_.resize(count);
+
+    for (int i=1;i<contexts.size();i++) {
+      contexts.at(i)->mixer()->Mix(mix_samples_.data(), count);
+      olive::dsp::MixAdd(samples_.data(), mix_samples_.constData(), count);
     }
+  }
+
+  return true;
+}
+
+AudioSenderThread::AudioSenderThread(const QAudioDeviceInfo &info, const QAudioFormat &format) :
+  info_(info),
+  format_(format),
+  start_done_(false),
+  start_succeeded_(false)
+{
+  connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
+}
+
+bool AudioSenderThread::StartOutput()
+{
+  start_lock_.lock();
+
+  start_done_ = false;
+  start(QThread::TimeCriticalPriority);
 
-    panel_timeline.first()->audio_monitor->set_value(averages);
+  while (!start_done_) {
+    start_cond_.wait(&start_lock_);
   }
 
-  memset(&audio_ibuffer[offset], 0, actual_write);
+  start_lock_.unlock();
 
-  audio_ibuffer_read += (actual_write / sizeof(float));
+  return start_succeeded_;
+}
 
-  audio_write_lock.unlock();
+void AudioSenderThread::stop() {
+  quit();
+  wait();
+}
+
+QAudioFormat AudioSenderThread::format()
+{
+  return format_;
+}
+
+void AudioSenderThread::run() {
+  AudioOutputDevice device(format_, &lock);
+  device.open(QIODevice::ReadOnly);
+
+  // the output is created on this thread so its requests for more audio are handled by this thread's event loop
+  QAudioOutput output(info_, format_);
+
+  // buffer two periods so one can be played while the next is mixed
+  output.setBufferSize(olive::config.audio_period_size * format_.bytesPerFrame() * 2);
+  output.start(&device);
+
+  bool started = (output.error() == QAudio::NoError && output.state() != QAudio::StoppedState);
+
+  start_lock_.lock();
+  start_succeeded_ = started;
+  start_done_ = true;
+  start_cond_.wakeAll();
+  start_lock_.unlock();
+
+  if (started) {
+    exec();
+  }
 
-  return actual_write;
+  output.stop();
 }
 
 double log_volume(double linear) {
@@ -348,7 +427,7 @@ bool start_recording() {
     return false;
   }
 
-  QAudioFormat audio_format = audio_output->format();
+  QAudioFormat audio_format = audio_thread->format();
   if (olive::config.recording_mode != audio_format.channelCount()) {
     audio_format.setChannelCount(olive::config.recording_mode);
   }
@@ -27,54 +27,144 @@
 #include <QMutex>
 #include <QIODevice>
 #include <QAudioOutput>
+#include <QAudioDeviceInfo>
 #include <QComboBox>
 
 #include "timeline/sequence.h"
 
+class AudioRenderContext;
+
+/**
+ * @brief The AudioOutputDevice class
+ *
+ * The read-only QIODevice that the audio output pulls sample data from. Every time the output device needs more
+ * audio, readData() mixes the contexts of every viewer that's currently producing audio in periods of
+ * Config::audio_period_size sample frames, converts them to the output's sample format, and submits their peaks to
+ * the AudioMonitor.
+ *
+ * When nothing is playing, silence is returned so the output keeps running with a small buffer and new audio (e.g.
+ * from starting playback or scrubbing) is heard within a period or two.
+ */
+class AudioOutputDevice : public QIODevice {
+public:
+  /**
+   * @brief AudioOutputDevice Constructor
+   *
+   * @param format
+   *
+   * Format of the audio output this device will be read by.
+   *
+   * @param lock
+   *
+   * Mutex held while mixing, used to keep audio contexts from being reset mid-mix (see reset_audio_context()).
+   */
+  AudioOutputDevice(const QAudioFormat& format, QMutex* lock);
+
+  virtual bool isSequential() const override;
+  virtual qint64 bytesAvailable() const override;
+
+protected:
+  virtual qint64 readData(char *data, qint64 maxlen) override;
+  virtual qint64 writeData(const char *data, qint64 len) override;
+
+private:
+  /**
+   * @brief Mix one period of audio into samples_
+   *
+   * @return
+   *
+   * **TRUE** if any audio was mixed, **FALSE** if nothing is producing audio and samples_ was filled with silence.
+   */
+  bool MixPeriod(int count);
+
+  QAudioFormat format_;
+  QMutex* lock_;
+  int bytes_per_frame_;
+  int period_size_;
+  QVector<float> samples_;
+  QVector<float> mix_samples_;
+  QVector<float> peaks_;
+};
+
+/**
+ * @brief The AudioSenderThread class
+ *
+ * Owns the audio output and runs its event loop at time critical priority, so the output's requests for more audio
+ * (and therefore the mixing done in AudioOutputDevice::readData()) are handled here rather than on the main thread.
+ */
 class AudioSenderThread : public QThread {
   Q_OBJECT
 public:
-  AudioSenderThread();
-  void run();
+  AudioSenderThread(const QAudioDeviceInfo& info, const QAudioFormat& format);
+
+  /**
+   * @brief Start the thread and open the audio output on it
+   *
+   * @return
+   *
+   * **TRUE** if the audio output started successfully. If not, the thread has already exited.
+   */
+  bool StartOutput();
+
+  /**
+   * @brief Stop the audio output and wait for the thread to exit
+   */
   void stop();
-  QWaitCondition cond;
-  bool close;
+
+  /**
+   * @brief Returns the format the audio output was opened with
+   */
+  QAudioFormat format();
+
+  /**
+   * @brief Mutex held while audio is being mixed
+   */
   QMutex lock;
-public slots:
-  void notifyReceiver();
+
+protected:
+  virtual void run() override;
+
 private:
-  QVector<qint16> samples;
-  int send_audio_to_output(qint64 offset, int max);
+  QAudioDeviceInfo info_;
+  QAudioFormat format_;
+
+  QMutex start_lock_;
+  QWaitCondition start_cond_;
+  bool start_done_;
+  bool start_succeeded_;
 };
 
 double log_volume(double linear);
 
-extern QAudioOutput* audio_output;
-extern QIODevice* audio_io_device;
 extern AudioSenderThread* audio_thread;
-extern QMutex audio_write_lock;
-
-#define audio_ibuffer_size 192000
-extern float audio_ibuffer[audio_ibuffer_size];
-extern qint64 audio_ibuffer_read;
-extern long audio_ibuffer_frame;
-extern double audio_ibuffer_timecode;
-extern bool audio_scrub;
+
+extern AudioRenderContext* audio_scrub_context;
 extern bool recording;
-extern int audio_rendering_rate;
-void clear_audio_ibuffer();
+void reset_audio_context(AudioRenderContext* context, long start_frame, double frame_rate);
 
 QObject *GetAudioWakeObject();
 void SetAudioWakeObject(QObject* o);
 void WakeAudioWakeObject();
 
+/**
+ * @brief Returns the sample rate of the audio being processed on the calling thread
+ *
+ * Falls back to the output device's rate on threads that haven't called set_thread_audio_freq().
+ */
 int current_audio_freq();
 
+/**
+ * @brief Sets the sample rate of the audio processed on the calling thread
+ *
+ * Playback and exports render audio at different rates, possibly at the same time, so effects that need the rate
+ * (e.g. VST plugins) query it per thread rather than from a global.
+ */
+void set_thread_audio_freq(int rate);
+
 bool is_audio_device_set();
 
 void init_audio();
 void stop_audio();
-qint64 get_buffer_offset_from_frame(double framerate, long frame);
 
 bool start_recording();
 void stop_recording();
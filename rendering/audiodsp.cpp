@@ -0,0 +1,465 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiodsp.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OLIVE_DSP_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OLIVE_DSP_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OLIVE_DSP_NEON
+#endif
+
+void olive::dsp::Interleave(const float * const *in, float *out, int channels, int frames, int in_step)
+{
+  int i = 0;
+
+  if (channels == 2 && in_step == 1) {
+    const float* l = in[0];
+    const float* r = in[1];
+
+#if defined(OLIVE_DSP_SSE2)
+    for (;i+4<=frames;i+=4) {
+      __m128 a = _mm_loadu_ps(l + i);
+      __m128 b = _mm_loadu_ps(r + i);
+      _mm_storeu_ps(out + i*2, _mm_unpacklo_ps(a, b));
+      _mm_storeu_ps(out + i*2 + 4, _mm_unpackhi_ps(a, b));
+    }
+#elif defined(OLIVE_DSP_NEON)
+    for (;i+4<=frames;i+=4) {
+      float32x4x2_t v;
+      v.val[0] = vld1q_f32(l + i);
+      v.val[1] = vld1q_f32(r + i);
+      vst2q_f32(out + i*2, v);
+    }
+#endif
+
+    for (;i<frames;i++) {
+      out[i*2] = l[i];
+      out[i*2 + 1] = r[i];
+    }
+
+    return;
+  }
+
+  for (int c=0;c<channels;c++) {
+    const float* src = in[c];
+    float* dst = out + c;
+    for (int j=0;j<frames;j++) {
+      dst[j*channels] = src[j*in_step];
+    }
+  }
+}
+
+void olive::dsp::Deinterleave(const float *in, float * const *out, int channels, int frames)
+{
+  int i = 0;
+
+  if (channels == 2) {
+    float* l = out[0];
+    float* r = out[1];
+
+#if defined(OLIVE_DSP_SSE2)
+    for (;i+4<=frames;i+=4) {
+      __m128 a = _mm_loadu_ps(in + i*2);
+      __m128 b = _mm_loadu_ps(in + i*2 + 4);
+      _mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#elif defined(OLIVE_DSP_NEON)
+    for (;i+4<=frames;i+=4) {
+      float32x4x2_t v = vld2q_f32(in + i*2);
+      vst1q_f32(l + i, v.val[0]);
+      vst1q_f32(r + i, v.val[1]);
+    }
+#endif
+
+    for (;i<frames;i++) {
+      l[i] = in[i*2];
+      r[i] = in[i*2 + 1];
+    }
+
+    return;
+  }
+
+  for (int c=0;c<channels;c++) {
+    const float* src = in + c;
+    float* dst = out[c];
+    for (int j=0;j<frames;j++) {
+      dst[j] = src[j*channels];
+    }
+  }
+}
+
+void olive::dsp::Gain(float *samples, int count, float gain)
+{
+  int i = 0;
+
+#if defined(OLIVE_DSP_AVX2)
+  __m256 g8 = _mm256_set1_ps(gain);
+  for (;i+8<=count;i+=8) {
+    _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g8));
+  }
+#endif
+
+#if defined(OLIVE_DSP_SSE2)
+  __m128 g = _mm_set1_ps(gain);
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+  }
+#elif defined(OLIVE_DSP_NEON)
+  float32x4_t g = vdupq_n_f32(gain);
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), g));
+  }
+#endif
+
+  for (;i<count;i++) {
+    samples[i] *= gain;
+  }
+}
+
+void olive::dsp::GainRamp(float *samples, int count, float start, float end)
+{
+  if (count <= 0) {
+    return;
+  }
+
+  float step = (end - start) / float(count);
+
+  if (step == 0.0f) {
+    Gain(samples, count, start);
+    return;
+  }
+
+  int i = 0;
+
+  // every lane computes start + step * i from its own index so the vector paths match the scalar path exactly
+#if defined(OLIVE_DSP_SSE2)
+  __m128 s = _mm_set1_ps(start);
+  __m128 d = _mm_set1_ps(step);
+  __m128i index = _mm_set_epi32(3, 2, 1, 0);
+  const __m128i four = _mm_set1_epi32(4);
+  for (;i+4<=count;i+=4) {
+    __m128 g = _mm_add_ps(s, _mm_mul_ps(d, _mm_cvtepi32_ps(index)));
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+    index = _mm_add_epi32(index, four);
+  }
+#elif defined(OLIVE_DSP_NEON)
+  float32x4_t s = vdupq_n_f32(start);
+  float32x4_t d = vdupq_n_f32(step);
+  const int32_t first_index[4] = {0, 1, 2, 3};
+  int32x4_t index = vld1q_s32(first_index);
+  const int32x4_t four = vdupq_n_s32(4);
+  for (;i+4<=count;i+=4) {
+    float32x4_t g = vaddq_f32(s, vmulq_f32(d, vcvtq_f32_s32(index)));
+    vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), g));
+    index = vaddq_s32(index, four);
+  }
+#endif
+
+  for (;i<count;i++) {
+    samples[i] *= start + step * float(i);
+  }
+}
+
+void olive::dsp::Envelope(float *samples, const float *envelope, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_DSP_AVX2)
+  for (;i+8<=count;i+=8) {
+    _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), _mm256_loadu_ps(envelope + i)));
+  }
+#endif
+
+#if defined(OLIVE_DSP_SSE2)
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(envelope + i)));
+  }
+#elif defined(OLIVE_DSP_NEON)
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), vld1q_f32(envelope + i)));
+  }
+#endif
+
+  for (;i<count;i++) {
+    samples[i] *= envelope[i];
+  }
+}
+
+void olive::dsp::MultiplyAdd(float *samples, const float *multiply, const float *add, int count)
+{
+  int i = 0;
+
+  // multiply and add are kept as separate instructions (not fused) to round the same way as the scalar path
+#if defined(OLIVE_DSP_AVX2)
+  for (;i+8<=count;i+=8) {
+    __m256 v = _mm256_mul_ps(_mm256_loadu_ps(samples + i), _mm256_loadu_ps(multiply + i));
+    _mm256_storeu_ps(samples + i, _mm256_add_ps(v, _mm256_loadu_ps(add + i)));
+  }
+#endif
+
+#if defined(OLIVE_DSP_SSE2)
+  for (;i+4<=count;i+=4) {
+    __m128 v = _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(multiply + i));
+    _mm_storeu_ps(samples + i, _mm_add_ps(v, _mm_loadu_ps(add + i)));
+  }
+#elif defined(OLIVE_DSP_NEON)
+  for (;i+4<=count;i+=4) {
+    float32x4_t v = vmulq_f32(vld1q_f32(samples + i), vld1q_f32(multiply + i));
+    vst1q_f32(samples + i, vaddq_f32(v, vld1q_f32(add + i)));
+  }
+#endif
+
+  for (;i<count;i++) {
+    samples[i] = samples[i] * multiply[i] + add[i];
+  }
+}
+
+void olive::dsp::MixAdd(float *dst, const float *src, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_DSP_AVX2)
+  for (;i+8<=count;i+=8) {
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+  }
+#endif
+
+#if defined(OLIVE_DSP_SSE2)
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+  }
+#elif defined(OLIVE_DSP_NEON)
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+  }
+#endif
+
+  for (;i<count;i++) {
+    dst[i] += src[i];
+  }
+}
+
+void olive::dsp::Reverse(float *samples, int count)
+{
+  int front = 0;
+  int back = count;
+
+  // swap four samples from each end at a time, reversing them on the way
+#if defined(OLIVE_DSP_SSE2)
+  for (;back-front>=8;front+=4,back-=4) {
+    __m128 a = _mm_loadu_ps(samples + front);
+    __m128 b = _mm_loadu_ps(samples + back - 4);
+    _mm_storeu_ps(samples + front, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)));
+    _mm_storeu_ps(samples + back - 4, _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 1, 2, 3)));
+  }
+#elif defined(OLIVE_DSP_NEON)
+  for (;back-front>=8;front+=4,back-=4) {
+    float32x4_t a = vld1q_f32(samples + front);
+    float32x4_t b = vld1q_f32(samples + back - 4);
+    a = vrev64q_f32(a);
+    b = vrev64q_f32(b);
+    vst1q_f32(samples + front, vcombine_f32(vget_high_f32(b), vget_low_f32(b)));
+    vst1q_f32(samples + back - 4, vcombine_f32(vget_high_f32(a), vget_low_f32(a)));
+  }
+#endif
+
+  std::reverse(samples + front, samples + back);
+}
+
+void olive::dsp::Resample(const float *in, int64_t in_count, double position, double step, float *out, int frames)
+{
+  // same tolerance as qFuzzyCompare(step, 1.0)
+  if (std::fabs(step - 1.0) * 1000000000000.0 <= std::min(std::fabs(step), 1.0)) {
+    // round half up like qRound64 so both callers land on the same sample
+    int64_t first = int64_t(std::floor(position + 0.5));
+
+    // silence before the start, a straight copy of whatever overlaps `in` and silence after the end
+    int lead = int(std::min<int64_t>(frames, std::max<int64_t>(0, -first)));
+    int copy = int(std::max<int64_t>(0, std::min<int64_t>(frames - lead, in_count - (first + lead))));
+
+    std::fill(out, out + lead, 0.0f);
+    std::copy(in + first + lead, in + first + lead + copy, out + lead);
+    std::fill(out + lead + copy, out + frames, 0.0f);
+    return;
+  }
+
+  // linear interpolation for reverse and speed changes
+  for (int i=0;i<frames;i++) {
+    double pos = position + i * step;
+    int64_t index = int64_t(std::floor(pos));
+    float t = float(pos - index);
+    float a = (index >= 0 && index < in_count) ? in[index] : 0.0f;
+    float b = (index + 1 >= 0 && index + 1 < in_count) ? in[index + 1] : 0.0f;
+    out[i] = a + (b - a) * t;
+  }
+}
+
+void olive::dsp::Peak(const float *in, int frames, int channels, float *peaks)
+{
+  for (int c=0;c<channels;c++) {
+    peaks[c] = 0.0f;
+  }
+
+  int count = frames * channels;
+  int i = 0;
+
+  // with 1, 2 or 4 channels every vector lane always holds the same channel (lane % channels)
+  if (channels == 1 || channels == 2 || channels == 4) {
+#if defined(OLIVE_DSP_SSE2)
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 max = _mm_setzero_ps();
+    for (;i+4<=count;i+=4) {
+      max = _mm_max_ps(max, _mm_and_ps(_mm_loadu_ps(in + i), abs_mask));
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, max);
+    for (int j=0;j<4;j++) {
+      peaks[j%channels] = std::max(peaks[j%channels], lanes[j]);
+    }
+#elif defined(OLIVE_DSP_NEON)
+    float32x4_t max = vdupq_n_f32(0.0f);
+    for (;i+4<=count;i+=4) {
+      max = vmaxq_f32(max, vabsq_f32(vld1q_f32(in + i)));
+    }
+
+    float lanes[4];
+    vst1q_f32(lanes, max);
+    for (int j=0;j<4;j++) {
+      peaks[j%channels] = std::max(peaks[j%channels], lanes[j]);
+    }
+#endif
+  }
+
+  // i is always a multiple of the channel count here
+  for (;i<count;i++) {
+    int c = i%channels;
+    peaks[c] = std::max(peaks[c], std::fabs(in[i]));
+  }
+}
+
+void olive::dsp::Rms(const float *in, int frames, int channels, float *rms)
+{
+  if (frames <= 0) {
+    for (int c=0;c<channels;c++) {
+      rms[c] = 0.0f;
+    }
+    return;
+  }
+
+  // squares are summed in double precision, summing hundreds of thousands of floats loses too much otherwise
+  double sums[8] = {};
+  double* sum = (channels <= 8) ? sums : new double[channels]();
+
+  int count = frames * channels;
+  int i = 0;
+
+  if (channels == 1 || channels == 2) {
+#if defined(OLIVE_DSP_SSE2)
+    // each double vector holds samples [n, n+1], which are always the same channels as lanes 0 and 1
+    __m128d acc = _mm_setzero_pd();
+    for (;i+4<=count;i+=4) {
+      __m128 v = _mm_loadu_ps(in + i);
+      __m128d lo = _mm_cvtps_pd(v);
+      __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+      acc = _mm_add_pd(acc, _mm_add_pd(_mm_mul_pd(lo, lo), _mm_mul_pd(hi, hi)));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    sum[0] += lanes[0];
+    sum[1 % channels] += lanes[1];
+#elif defined(OLIVE_DSP_NEON) && defined(__aarch64__)
+    float64x2_t acc = vdupq_n_f64(0.0);
+    for (;i+4<=count;i+=4) {
+      float32x4_t v = vld1q_f32(in + i);
+      float64x2_t lo = vcvt_f64_f32(vget_low_f32(v));
+      float64x2_t hi = vcvt_f64_f32(vget_high_f32(v));
+      acc = vaddq_f64(acc, vaddq_f64(vmulq_f64(lo, lo), vmulq_f64(hi, hi)));
+    }
+
+    sum[0] += vgetq_lane_f64(acc, 0);
+    sum[1 % channels] += vgetq_lane_f64(acc, 1);
+#endif
+  }
+
+  for (;i<count;i++) {
+    double v = in[i];
+    sum[i%channels] += v * v;
+  }
+
+  for (int c=0;c<channels;c++) {
+    rms[c] = float(std::sqrt(sum[c] / frames));
+  }
+
+  if (sum != sums) {
+    delete [] sum;
+  }
+}
+
+void olive::dsp::FloatToInt16(const float *in, int16_t *out, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_DSP_SSE2)
+  const __m128 scale = _mm_set1_ps(32767.0f);
+  const __m128 min = _mm_set1_ps(-1.0f);
+  const __m128 max = _mm_set1_ps(1.0f);
+  for (;i+8<=count;i+=8) {
+    __m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), min), max), scale);
+    __m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), min), max), scale);
+
+    // cvtps rounds to the nearest integer, packs saturates the results to 16-bit
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+  }
+#elif defined(OLIVE_DSP_NEON)
+  const float32x4_t scale = vdupq_n_f32(32767.0f);
+  const float32x4_t min = vdupq_n_f32(-1.0f);
+  const float32x4_t max = vdupq_n_f32(1.0f);
+  const uint32x4_t sign = vdupq_n_u32(0x80000000);
+  const uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+  for (;i+8<=count;i+=8) {
+    float32x4_t a = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + i), min), max), scale);
+    float32x4_t b = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + i + 4), min), max), scale);
+
+    // vcvtq truncates, so add 0.5 away from zero first to round to the nearest integer
+    a = vaddq_f32(a, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(a), sign), half)));
+    b = vaddq_f32(b, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(b), sign), half)));
+
+    vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b))));
+  }
+#endif
+
+  for (;i<count;i++) {
+    out[i] = int16_t(std::lrint(std::min(1.0f, std::max(-1.0f, in[i])) * 32767.0f));
+  }
+}
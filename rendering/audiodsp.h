@@ -0,0 +1,145 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIODSP_H
+#define AUDIODSP_H
+
+#include <cstdint>
+
+/**
+ * Vectorized kernels for the audio hot loops (interleaving, gain, mixing, reversing and metering).
+ *
+ * Each kernel has an SSE2 (x86/x64) or NEON (ARM) path picked at compile time, an AVX2 path where it helps that's
+ * used when the compiler targets AVX2 (e.g. -mavx2 or /arch:AVX2), and a scalar path that handles anything the vector
+ * paths don't (remainders, unusual channel counts, other architectures) and defines the expected results.
+ *
+ * All pointers may be unaligned. Samples are 32-bit float unless stated otherwise.
+ */
+namespace olive {
+namespace dsp {
+
+/**
+ * @brief Interleave planar channels into one buffer
+ *
+ * @param in
+ *
+ * Array of `channels` pointers to planar samples
+ *
+ * @param out
+ *
+ * Buffer to write `frames * channels` interleaved samples to
+ *
+ * @param in_step
+ *
+ * Distance between the samples read from each channel, e.g. 2 to only take every other sample when playing at double
+ * speed. The fast paths only apply to a step of 1.
+ */
+void Interleave(const float* const* in, float* out, int channels, int frames, int in_step = 1);
+
+/**
+ * @brief Split interleaved samples into planar channels
+ *
+ * @param in
+ *
+ * Buffer of `frames * channels` interleaved samples
+ *
+ * @param out
+ *
+ * Array of `channels` pointers to write `frames` planar samples to each
+ */
+void Deinterleave(const float* in, float* const* out, int channels, int frames);
+
+/**
+ * @brief Multiply samples by a constant gain
+ */
+void Gain(float* samples, int count, float gain);
+
+/**
+ * @brief Multiply samples by a gain that moves linearly from `start` to `end`
+ *
+ * Sample `i` is multiplied by `start + (end - start) * i / count`, so `end` itself is the gain of the sample after the
+ * last one (i.e. where the next block's ramp should start).
+ */
+void GainRamp(float* samples, int count, float start, float end);
+
+/**
+ * @brief Multiply each sample by the corresponding value in an envelope (e.g. per-sample keyframed volume)
+ */
+void Envelope(float* samples, const float* envelope, int count);
+
+/**
+ * @brief Set `samples[i] = samples[i] * multiply[i] + add[i]` (e.g. mixing a generated signal into a channel)
+ */
+void MultiplyAdd(float* samples, const float* multiply, const float* add, int count);
+
+/**
+ * @brief Add `src` into `dst`
+ */
+void MixAdd(float* dst, const float* src, int count);
+
+/**
+ * @brief Reverse the order of samples in a planar channel
+ */
+void Reverse(float* samples, int count);
+
+/**
+ * @brief Read samples from a planar channel starting at a fractional position and moving a fixed step per sample
+ *
+ * A step of 1 copies samples directly (starting at the sample nearest to `position`), anything else (speed changes,
+ * negative steps for reverse) is linearly interpolated. Positions outside of `in` read as silence.
+ *
+ * @param in
+ *
+ * Array of `in_count` samples
+ *
+ * @param out
+ *
+ * Buffer to write `frames` samples to
+ */
+void Resample(const float* in, int64_t in_count, double position, double step, float* out, int frames);
+
+/**
+ * @brief Find the peak (maximum absolute value) of each channel of interleaved samples
+ *
+ * @param peaks
+ *
+ * Array of `channels` values to write each channel's peak to
+ */
+void Peak(const float* in, int frames, int channels, float* peaks);
+
+/**
+ * @brief Find the RMS (root mean square) of each channel of interleaved samples
+ *
+ * @param rms
+ *
+ * Array of `channels` values to write each channel's RMS to. 0 if `frames` is 0.
+ */
+void Rms(const float* in, int frames, int channels, float* rms);
+
+/**
+ * @brief Convert samples to signed 16-bit integers, rounding to the nearest value and clipping anything outside of
+ * -1.0 to 1.0
+ */
+void FloatToInt16(const float* in, int16_t* out, int count);
+
+}
+}
+
+#endif // AUDIODSP_H
@@ -0,0 +1,284 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiomixdown.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+#include <QtMath>
+#include <QDebug>
+#include <cstring>
+
+#include "rendering/audiodsp.h"
+#include "rendering/cacher.h"
+#include "timeline/sequence.h"
+#include "timeline/clip.h"
+#include "timeline/track.h"
+#include "project/footage.h"
+#include "project/media.h"
+#include "global/timing.h"
+
+// sample frames mixed at a time, large enough that per-block overhead (effects, keyframes) is negligible
+const int kMixdownBlockSize = 8192;
+
+AudioMixdown::AudioMixdown(Sequence *sequence, long start_frame, long end_frame, int sample_rate) :
+  sequence_(sequence),
+  start_frame_(start_frame),
+  end_frame_(end_frame),
+  sample_rate_(sample_rate),
+  position_(0),
+  buffer_start_(0),
+  buffer_frames_(0),
+  buffer_read_(0)
+{
+  length_ = FrameToSample(end_frame_);
+
+  buffer_.resize(kMixdownBlockSize * kChannels);
+
+  frame_ = av_frame_alloc();
+  frame_->format = AV_SAMPLE_FMT_FLTP;
+  frame_->channel_layout = AV_CH_LAYOUT_STEREO;
+  frame_->channels = kChannels;
+  frame_->sample_rate = sample_rate_;
+  frame_->nb_samples = kMixdownBlockSize;
+  if (av_frame_get_buffer(frame_, 0) < 0) {
+    qCritical() << "Could not allocate buffer for audio mixdown";
+    av_frame_free(&frame_);
+  }
+}
+
+AudioMixdown::~AudioMixdown()
+{
+  av_frame_free(&frame_);
+}
+
+bool AudioMixdown::Prepare()
+{
+  sources_.clear();
+
+  if (frame_ == nullptr) {
+    return false;
+  }
+
+  QVector<Clip*> nests;
+  return CollectSources(sequence_, nests);
+}
+
+int AudioMixdown::Render(float *out, int frames)
+{
+  int rendered = int(qBound(qint64(0), length_ - position_, qint64(frames)));
+
+  int copied = 0;
+  while (copied < frames) {
+    if (buffer_read_ == buffer_frames_) {
+      MixBlock();
+    }
+
+    int count = qMin(frames - copied, buffer_frames_ - buffer_read_);
+    memcpy(out + copied * kChannels,
+           buffer_.constData() + buffer_read_ * kChannels,
+           size_t(count * kChannels) * sizeof(float));
+
+    copied += count;
+    buffer_read_ += count;
+  }
+
+  position_ += frames;
+
+  return rendered;
+}
+
+qint64 AudioMixdown::position()
+{
+  return position_;
+}
+
+qint64 AudioMixdown::length()
+{
+  return length_;
+}
+
+int AudioMixdown::sample_rate()
+{
+  return sample_rate_;
+}
+
+bool AudioMixdown::CollectSources(Sequence *sequence, QVector<Clip*> &nests)
+{
+  QVector<Track*> tracks = sequence->GetTrackList(olive::kTypeAudio);
+
+  for (int i=0;i<tracks.size();i++) {
+    Track* t = tracks.at(i);
+
+    if (t->IsEffectivelyMuted()) {
+      continue;
+    }
+
+    QVector<Clip*> clips = t->GetAllClips();
+
+    for (int j=0;j<clips.size();j++) {
+      Clip* c = clips.at(j);
+
+      if (!c->enabled()) {
+        continue;
+      }
+
+      if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
+        nests.append(c);
+        bool ok = CollectSources(c->media()->to_sequence().get(), nests);
+        nests.removeLast();
+
+        if (!ok) {
+          return false;
+        }
+
+        continue;
+      }
+
+      // range the clip is audible in and where its media starts (which may be before it's audible)
+      double frame_rate = sequence->frame_rate();
+      long media_start = c->timeline_in(true) - c->clip_in(true);
+      long in = c->timeline_in(true);
+      long out = qMin(c->timeline_out(true), media_start + c->media_length());
+
+      // map the range to the top-level sequence
+      for (int k=nests.size()-1;k>=0;k--) {
+        Clip* nest = nests.at(k);
+        double nest_frame_rate = nest->track()->sequence()->frame_rate();
+        long offset = nest->timeline_in(true) - nest->clip_in(true);
+
+        media_start = rescale_frame_number(media_start, frame_rate, nest_frame_rate) + offset;
+        in = qMax(rescale_frame_number(in, frame_rate, nest_frame_rate) + offset, nest->timeline_in(true));
+        out = qMin(rescale_frame_number(out, frame_rate, nest_frame_rate) + offset, nest->timeline_out(true));
+
+        frame_rate = nest_frame_rate;
+      }
+
+      in = qMax(in, start_frame_);
+      out = qMin(out, end_frame_);
+
+      if (in >= out) {
+        continue;
+      }
+
+      Source s;
+      s.clip = c;
+      s.nests = nests;
+      s.start = FrameToSample(in);
+      s.end = FrameToSample(out);
+      s.clip_time = double(start_frame_ - media_start) / frame_rate;
+      s.source_start = 0;
+      s.source_step = 0;
+
+      if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+        Footage* m = c->media()->to_footage();
+        const FootageStream* ms = c->media_stream();
+
+        if (m->invalid || ms == nullptr) {
+          continue;
+        }
+
+        double speed = c->speed().value * m->speed;
+        if (!qFuzzyCompare(speed, 1.0) && c->speed().maintain_audio_pitch) {
+          qInfo() << "Clip" << c->name() << "needs pitch correction, audio can't be mixed down offline";
+          return false;
+        }
+
+        s.audio = olive::conformed_audio_cache.Get(m, ms, sample_rate_, true);
+        if (s.audio == nullptr) {
+          qWarning() << "Failed to conform audio of clip" << c->name();
+          return false;
+        }
+
+        // position in the media of output sample frame 0
+        double clip_frame_rate = c->track()->sequence()->frame_rate();
+        double media_time = s.clip_time;
+        double step = 1.0 / sample_rate_;
+        if (c->reversed()) {
+          media_time = double(c->media_length() - 1) / clip_frame_rate - media_time;
+          step = -step;
+        }
+
+        s.source_start = media_time * speed * sample_rate_;
+        s.source_step = step * speed * sample_rate_;
+      }
+
+      sources_.append(s);
+    }
+  }
+
+  return true;
+}
+
+qint64 AudioMixdown::FrameToSample(long frame)
+{
+  return qint64(floor(double(frame - start_frame_) / sequence_->frame_rate() * sample_rate_));
+}
+
+void AudioMixdown::MixBlock()
+{
+  buffer_start_ += buffer_frames_;
+  buffer_frames_ = kMixdownBlockSize;
+  buffer_read_ = 0;
+
+  buffer_.fill(0.0f);
+
+  qint64 block_end = buffer_start_ + buffer_frames_;
+
+  for (int i=0;i<sources_.size();i++) {
+    const Source& s = sources_.at(i);
+
+    qint64 start = qMax(s.start, buffer_start_);
+    qint64 end = qMin(s.end, block_end);
+
+    if (start < end) {
+      RenderSource(s, start, int(end - start), buffer_.data() + (start - buffer_start_) * kChannels);
+    }
+  }
+}
+
+void AudioMixdown::RenderSource(const Source &source, qint64 position, int frames, float *out)
+{
+  if (source.audio != nullptr) {
+    source.audio->Read(source.source_start + position * source.source_step,
+                       source.source_step,
+                       frames,
+                       reinterpret_cast<float**>(frame_->data));
+  } else {
+    // clips without media only output what their effects generate
+    for (int i=0;i<kChannels;i++) {
+      memset(frame_->data[i], 0, size_t(frames) * sizeof(float));
+    }
+  }
+
+  frame_->nb_samples = frames;
+  apply_audio_effects(source.clip,
+                      source.clip_time + double(position) / sample_rate_,
+                      frame_,
+                      frames,
+                      kChannels,
+                      source.nests);
+
+  scratch_.resize(frames * kChannels);
+  olive::dsp::Interleave(reinterpret_cast<float**>(frame_->data), scratch_.data(), kChannels, frames);
+  olive::dsp::MixAdd(out, scratch_.constData(), frames * kChannels);
+}
@@ -0,0 +1,191 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOMIXDOWN_H
+#define AUDIOMIXDOWN_H
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include <QVector>
+
+#include "rendering/conformedaudio.h"
+
+class Sequence;
+class Clip;
+
+/**
+ * @brief The AudioMixdown class
+ *
+ * Renders a Sequence's audio offline in large blocks on the calling thread.
+ *
+ * Playback has each audio Clip's Cacher thread write into an AudioRenderContext and the consumer waits for all of them
+ * to catch up, which paces rendering by thread handoffs rather than by the CPU. AudioMixdown instead reads each Clip's
+ * samples straight from its conformed audio (see ConformedAudioCache), runs them through the Clip's effects,
+ * transitions and nesting, and sums them into the output, so an export can render audio as fast as the CPU allows.
+ *
+ * Clips that change speed while maintaining pitch need the Cacher's time-stretching filter, which AudioMixdown doesn't
+ * reproduce. Prepare() returns **FALSE** if the range contains any so the caller can fall back to the real-time path.
+ *
+ * Not thread-safe, an AudioMixdown should only be used by the thread that created it.
+ */
+class AudioMixdown {
+public:
+  /**
+   * @brief AudioMixdown Constructor
+   *
+   * @param sequence
+   *
+   * Sequence to render
+   *
+   * @param start_frame
+   *
+   * First Sequence frame to render. Output sample 0 corresponds to the start of this frame.
+   *
+   * @param end_frame
+   *
+   * Sequence frame to stop rendering at (exclusive)
+   *
+   * @param sample_rate
+   *
+   * Sample rate to render at
+   */
+  AudioMixdown(Sequence* sequence, long start_frame, long end_frame, int sample_rate);
+
+  /**
+   * @brief AudioMixdown Destructor
+   */
+  ~AudioMixdown();
+
+  /**
+   * @brief Find every audio Clip in the range and retrieve its conformed audio
+   *
+   * Blocks until any footage that hasn't been conformed at this sample rate yet has been.
+   *
+   * @return
+   *
+   * **TRUE** if every Clip can be rendered offline, **FALSE** if the caller should use the real-time path instead.
+   */
+  bool Prepare();
+
+  /**
+   * @brief Render the next block of audio
+   *
+   * @param out
+   *
+   * Buffer to render interleaved stereo float samples into
+   *
+   * @param frames
+   *
+   * Amount of sample frames (i.e. samples per channel) to render. Anything after the end of the range is silent.
+   *
+   * @return
+   *
+   * Amount of sample frames rendered that were still inside the range
+   */
+  int Render(float* out, int frames);
+
+  /**
+   * @brief Returns the amount of sample frames rendered so far
+   */
+  qint64 position();
+
+  /**
+   * @brief Returns the total amount of sample frames in the range
+   */
+  qint64 length();
+
+  /**
+   * @brief Returns the sample rate this mixdown renders at
+   */
+  int sample_rate();
+
+  /**
+   * @brief Amount of output channels
+   */
+  static const int kChannels = ConformedAudio::kChannels;
+
+private:
+  struct Source {
+    Clip* clip;
+
+    // nested sequence Clips that `clip` is inside of, outermost first
+    QVector<Clip*> nests;
+
+    // range of output sample frames this Clip is audible in
+    qint64 start;
+    qint64 end;
+
+    // clip time (in seconds) of output sample frame 0, used for effects
+    double clip_time;
+
+    // position in the conformed audio of output sample frame 0 and how far it moves for every output sample frame
+    double source_start;
+    double source_step;
+
+    // `nullptr` for clips without media, which only produce the audio their effects generate
+    ConformedAudioPtr audio;
+  };
+
+  /**
+   * @brief Add every audio Clip in a Sequence to sources_, recursing into nested sequences
+   */
+  bool CollectSources(Sequence* sequence, QVector<Clip*>& nests);
+
+  /**
+   * @brief Convert a top-level Sequence frame to an output sample frame
+   */
+  qint64 FrameToSample(long frame);
+
+  /**
+   * @brief Mix the next kMixdownBlockSize sample frames of every Source into buffer_
+   */
+  void MixBlock();
+
+  /**
+   * @brief Render part of a Source and add it into interleaved output
+   */
+  void RenderSource(const Source& source, qint64 position, int frames, float* out);
+
+  Sequence* sequence_;
+  long start_frame_;
+  long end_frame_;
+  int sample_rate_;
+
+  qint64 position_;
+  qint64 length_;
+
+  QVector<Source> sources_;
+
+  // interleaved block of mixed audio that Render() is reading from
+  QVector<float> buffer_;
+  qint64 buffer_start_;
+  int buffer_frames_;
+  int buffer_read_;
+
+  // planar scratch frame each Source is rendered into before its effects are applied
+  AVFrame* frame_;
+
+  // interleaved copy of frame_ that's added into buffer_
+  QVector<float> scratch_;
+};
+
+#endif // AUDIOMIXDOWN_H
@@ -0,0 +1,216 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiomixer.h"
+
+#include <QThread>
+#include <cstring>
+
+#include "rendering/audiodsp.h"
+
+const qint64 kInputMask = AudioMixer::kInputCapacity - 1;
+
+AudioMixerInput::AudioMixerInput(AudioMixer *mixer) :
+  mixer_(mixer),
+  generation_(mixer->generation_.loadAcquire()),
+  end_(-1),
+  finished_(-1)
+{
+  buffer_ = new float[AudioMixer::kInputCapacity];
+}
+
+AudioMixerInput::~AudioMixerInput()
+{
+  delete [] buffer_;
+}
+
+void AudioMixerInput::Write(qint64 position, const float *samples, int count)
+{
+  int generation = mixer_->generation_.loadAcquire();
+  qint64 end = end_.loadAcquire();
+
+  if (generation_.loadAcquire() != generation) {
+    // the mixer was cleared so nothing written before is valid anymore. end_ is invalidated first so the mixer never
+    // sees the new generation with the old end position.
+    end = -1;
+    end_.storeRelease(end);
+    generation_.storeRelease(generation);
+  }
+
+  qint64 read = mixer_->read_position();
+
+  // skip samples that have already been mixed
+  if (position < read) {
+    qint64 skip = qMin(qint64(count), read - position);
+    samples += skip;
+    count -= int(skip);
+    position = read;
+  }
+
+  // don't overwrite samples that haven't been mixed yet
+  count = int(qMin(qint64(count), read + AudioMixer::kInputCapacity - position));
+
+  if (count <= 0) {
+    return;
+  }
+
+  // fill any gap since the last write with silence
+  for (qint64 i=qMax(end, read);i<position;i++) {
+    buffer_[i & kInputMask] = 0.0f;
+  }
+
+  int offset = int(position & kInputMask);
+  int first = qMin(count, AudioMixer::kInputCapacity - offset);
+  memcpy(buffer_ + offset, samples, size_t(first) * sizeof(float));
+  memcpy(buffer_, samples + first, size_t(count - first) * sizeof(float));
+
+  // publish the new samples to the mixer
+  end_.storeRelease(qMax(end, position + count));
+}
+
+void AudioMixerInput::Finish()
+{
+  finished_.storeRelease(mixer_->generation_.loadAcquire());
+}
+
+AudioMixer::AudioMixer() :
+  read_(0),
+  generation_(0),
+  mix_counter_(0)
+{
+  for (int i=0;i<kMaxInputs;i++) {
+    inputs_[i].storeRelease(nullptr);
+  }
+}
+
+AudioMixer::~AudioMixer()
+{
+  for (int i=0;i<kMaxInputs;i++) {
+    delete inputs_[i].loadAcquire();
+  }
+}
+
+AudioMixerInput *AudioMixer::AddInput()
+{
+  AudioMixerInput* input = new AudioMixerInput(this);
+
+  for (int i=0;i<kMaxInputs;i++) {
+    if (inputs_[i].testAndSetOrdered(nullptr, input)) {
+      return input;
+    }
+  }
+
+  delete input;
+  return nullptr;
+}
+
+void AudioMixer::RemoveInput(AudioMixerInput *input)
+{
+  if (input == nullptr) {
+    return;
+  }
+
+  for (int i=0;i<kMaxInputs;i++) {
+    if (inputs_[i].testAndSetOrdered(input, nullptr)) {
+      break;
+    }
+  }
+
+  // if a mix is in progress it may still be reading from this input
+  int counter = mix_counter_.loadAcquire();
+  if (counter & 1) {
+    while (mix_counter_.loadAcquire() == counter) {
+      QThread::yieldCurrentThread();
+    }
+  }
+
+  delete input;
+}
+
+void AudioMixer::Mix(float *out, int count)
+{
+  mix_counter_.fetchAndAddOrdered(1);
+
+  qint64 read = read_.loadAcquire();
+  int generation = generation_.loadAcquire();
+
+  memset(out, 0, size_t(count) * sizeof(float));
+
+  for (int i=0;i<kMaxInputs;i++) {
+    AudioMixerInput* input = inputs_[i].loadAcquire();
+
+    if (input == nullptr || input->generation_.loadAcquire() != generation) {
+      continue;
+    }
+
+    qint64 end = input->end_.loadAcquire();
+    if (end <= read) {
+      continue;
+    }
+
+    int available = int(qMin(qint64(count), end - read));
+    int offset = int(read & kInputMask);
+    int first = qMin(available, kInputCapacity - offset);
+
+    olive::dsp::MixAdd(out, input->buffer_ + offset, first);
+    olive::dsp::MixAdd(out + first, input->buffer_, available - first);
+  }
+
+  read_.storeRelease(read + count);
+
+  mix_counter_.fetchAndAddOrdered(1);
+}
+
+bool AudioMixer::IsReady(qint64 position)
+{
+  // counts as mixing so RemoveInput() won't free an input we're still checking
+  mix_counter_.fetchAndAddOrdered(1);
+
+  int generation = generation_.loadAcquire();
+  bool ready = true;
+
+  for (int i=0;i<kMaxInputs;i++) {
+    AudioMixerInput* input = inputs_[i].loadAcquire();
+
+    if (input == nullptr || input->finished_.loadAcquire() == generation) {
+      continue;
+    }
+
+    if (input->generation_.loadAcquire() != generation || input->end_.loadAcquire() < position) {
+      ready = false;
+      break;
+    }
+  }
+
+  mix_counter_.fetchAndAddOrdered(1);
+
+  return ready;
+}
+
+void AudioMixer::Clear()
+{
+  generation_.fetchAndAddOrdered(1);
+  read_.storeRelease(0);
+}
+
+qint64 AudioMixer::read_position()
+{
+  return read_.loadAcquire();
+}
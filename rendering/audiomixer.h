@@ -0,0 +1,217 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+
+class AudioMixer;
+
+/**
+ * @brief The AudioMixerInput class
+ *
+ * One source of audio for the AudioMixer (usually one audio Clip's Cacher). Each input owns a ring buffer of
+ * interleaved samples addressed by the same absolute sample positions as the mixer, so several inputs can write audio
+ * at the same time without sharing any memory or locks.
+ *
+ * An input is designed for exactly one writing thread (the one calling Write()) and the mixing thread.
+ *
+ * Create inputs with AudioMixer::AddInput() and destroy them with AudioMixer::RemoveInput().
+ */
+class AudioMixerInput {
+public:
+  /**
+   * @brief Write samples to this input
+   *
+   * Samples must be interleaved and in the mixer's channel layout. Any gap between the last samples written and
+   * `position` is filled with silence. Samples before the mixer's current read position (see
+   * AudioMixer::read_position()) have already been mixed and are discarded, as are samples more than
+   * AudioMixer::kInputCapacity past it.
+   *
+   * @param position
+   *
+   * Absolute position (in samples) of the first sample to write.
+   *
+   * @param samples
+   *
+   * Array of samples to write.
+   *
+   * @param count
+   *
+   * Number of samples in `samples`.
+   */
+  void Write(qint64 position, const float* samples, int count);
+
+  /**
+   * @brief Mark this input as having written all of its audio
+   *
+   * Tells AudioMixer::IsReady() not to wait for any more samples from this input until the mixer is next cleared
+   * (e.g. because its clip ended before the position being waited on).
+   */
+  void Finish();
+
+private:
+  friend class AudioMixer;
+
+  AudioMixerInput(AudioMixer* mixer);
+  ~AudioMixerInput();
+
+  AudioMixer* mixer_;
+
+  float* buffer_;
+
+  /**
+   * @brief The mixer's generation (see AudioMixer::Clear()) that the samples in this input were written in
+   */
+  QAtomicInt generation_;
+
+  /**
+   * @brief Absolute position directly after the last valid sample in this input, or -1 if there are none
+   */
+  QAtomicInteger<qint64> end_;
+
+  /**
+   * @brief The mixer's generation that Finish() was last called in, or -1 if it hasn't been called
+   */
+  QAtomicInt finished_;
+};
+
+/**
+ * @brief The AudioMixer class
+ *
+ * Sums the audio of every AudioMixerInput into blocks of interleaved samples for the audio output (or the exporter).
+ *
+ * Every input writes into its own ring buffer, and Mix() adds together whatever each input has written up to the
+ * current read position. Inputs that haven't written far enough yet simply contribute silence for the rest of the
+ * block. No function takes a lock, so audio Cachers never wait on each other or on the output device.
+ *
+ * Positions are absolute sample counts since the mixer was last cleared, with position 0 corresponding to the start
+ * frame of the AudioRenderContext that owns the mixer.
+ *
+ * Mix(), IsReady() and Clear() must only be called from one thread at a time (the thread consuming the audio).
+ * AddInput() and RemoveInput() can be called from any thread.
+ */
+class AudioMixer {
+public:
+  /**
+   * @brief Number of samples each input can hold. Must be a power of two.
+   */
+  static const int kInputCapacity = 131072;
+
+  /**
+   * @brief How far ahead of the read position (in samples) inputs should write audio
+   */
+  static const int kMaxWriteAhead = 96000;
+
+  /**
+   * @brief Maximum number of inputs that can be added at once
+   */
+  static const int kMaxInputs = 256;
+
+  /**
+   * @brief AudioMixer Constructor
+   */
+  AudioMixer();
+
+  /**
+   * @brief AudioMixer Destructor
+   *
+   * Frees any inputs that are still added.
+   */
+  ~AudioMixer();
+
+  /**
+   * @brief Create a new input that will be mixed into the output
+   *
+   * @return
+   *
+   * A new input that must be freed with RemoveInput(), or `nullptr` if the mixer already has kMaxInputs inputs.
+   */
+  AudioMixerInput* AddInput();
+
+  /**
+   * @brief Remove an input from the mixer and free it
+   *
+   * If Mix() is currently running on another thread, waits for it to finish before freeing the input.
+   */
+  void RemoveInput(AudioMixerInput* input);
+
+  /**
+   * @brief Mix the next block of audio
+   *
+   * Sums all inputs from the current read position into `out` and advances the read position past them.
+   *
+   * @param out
+   *
+   * Array to fill with `count` interleaved samples.
+   *
+   * @param count
+   *
+   * Number of samples to mix.
+   */
+  void Mix(float* out, int count);
+
+  /**
+   * @brief Returns whether every input has written its audio up to a certain position
+   *
+   * Inputs that have called AudioMixerInput::Finish() since the mixer was last cleared are considered ready. Used by
+   * consumers that pull audio synchronously (e.g. exporting) to make sure Mix() won't miss samples that simply
+   * haven't been written yet.
+   *
+   * @param position
+   *
+   * Absolute position (in samples) that inputs must have written up to.
+   */
+  bool IsReady(qint64 position);
+
+  /**
+   * @brief Discard all audio written to the inputs and reset the read position to 0
+   *
+   * Used when playback starts from a new position.
+   */
+  void Clear();
+
+  /**
+   * @brief Returns the absolute position of the next sample Mix() will return
+   */
+  qint64 read_position();
+
+private:
+  friend class AudioMixerInput;
+
+  QAtomicPointer<AudioMixerInput> inputs_[kMaxInputs];
+
+  QAtomicInteger<qint64> read_;
+
+  /**
+   * @brief Incremented by Clear() so inputs can tell their samples are no longer valid
+   */
+  QAtomicInt generation_;
+
+  /**
+   * @brief Incremented at the start and end of Mix(), i.e. odd while mixing is in progress
+   */
+  QAtomicInt mix_counter_;
+};
+
+#endif // AUDIOMIXER_H
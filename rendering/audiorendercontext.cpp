@@ -0,0 +1,103 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "audiorendercontext.h"
+
+#include <QtMath>
+#include <QDebug>
+
+#include "global/config.h"
+
+AudioRenderContext::AudioRenderContext(bool synchronous) :
+  start_frame_(0),
+  start_timecode_(0),
+  sample_rate_(olive::config.audio_rate),
+  synchronous_(synchronous)
+{
+}
+
+void AudioRenderContext::Reset(long start_frame, double frame_rate, int sample_rate)
+{
+  start_frame_ = start_frame;
+  start_timecode_ = double(start_frame) / frame_rate;
+  sample_rate_ = sample_rate;
+
+  mixer_.Clear();
+}
+
+qint64 AudioRenderContext::GetBufferOffsetFromFrame(double frame_rate, long frame)
+{
+  if (frame >= start_frame_) {
+    // audio is always mixed in stereo
+    const int channels = 2;
+    return qFloor((double(frame - start_frame_)/frame_rate)*sample_rate_)*channels;
+  } else {
+    qWarning() << "Invalid values passed to GetBufferOffsetFromFrame" << frame << "<" << start_frame_;
+    return 0;
+  }
+}
+
+bool AudioRenderContext::WaitForAudio(qint64 position, unsigned long timeout)
+{
+  QMutexLocker locker(&wait_lock_);
+
+  while (!mixer_.IsReady(position)) {
+    if (!wait_cond_.wait(&wait_lock_, timeout)) {
+      return mixer_.IsReady(position);
+    }
+  }
+
+  return true;
+}
+
+void AudioRenderContext::NotifyWritten()
+{
+  if (synchronous_) {
+    wait_lock_.lock();
+    wait_cond_.wakeAll();
+    wait_lock_.unlock();
+  }
+}
+
+bool AudioRenderContext::synchronous()
+{
+  return synchronous_;
+}
+
+AudioMixer *AudioRenderContext::mixer()
+{
+  return &mixer_;
+}
+
+long AudioRenderContext::start_frame()
+{
+  return start_frame_;
+}
+
+double AudioRenderContext::start_timecode()
+{
+  return start_timecode_;
+}
+
+int AudioRenderContext::sample_rate()
+{
+  return sample_rate_;
+}
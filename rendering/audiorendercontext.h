@@ -0,0 +1,161 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef AUDIORENDERCONTEXT_H
+#define AUDIORENDERCONTEXT_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "rendering/audiomixer.h"
+
+/**
+ * @brief The AudioRenderContext class
+ *
+ * Everything a consumer of rendered audio needs to render a Sequence's audio independently of any other consumer: the
+ * AudioMixer that Clips' Cachers write into (and its read/write positions), the frame and time that mixer position 0
+ * corresponds to, and the sample rate audio is rendered at.
+ *
+ * Each consumer (the Sequence Viewer, the Footage Viewer and the ExportThread) owns its own context, so exporting
+ * no longer competes with playback for the same buffer and each can run at its own sample rate. A Clip routes its
+ * audio to whichever context last rendered it (see Clip::SetAudioContext()).
+ *
+ * Real-time consumers simply mix whatever has been written when the output device needs more audio. Synchronous
+ * consumers (see AudioRenderContext()) can instead block with WaitForAudio() until every Cacher has written the
+ * block they're about to mix.
+ */
+class AudioRenderContext {
+public:
+  /**
+   * @brief AudioRenderContext Constructor
+   *
+   * @param synchronous
+   *
+   * **TRUE** if this context's consumer will use WaitForAudio(). Cachers only signal contexts that are synchronous,
+   * so real-time playback never takes a lock.
+   */
+  AudioRenderContext(bool synchronous = false);
+
+  /**
+   * @brief Discard all audio and start rendering again from a certain frame
+   *
+   * Must not be called while another thread is mixing this context's audio.
+   *
+   * @param start_frame
+   *
+   * Sequence frame that corresponds to mixer position 0.
+   *
+   * @param frame_rate
+   *
+   * Frame rate of the Sequence being rendered.
+   *
+   * @param sample_rate
+   *
+   * Sample rate to render audio at. Cachers that were opened at a different sample rate must be reopened.
+   */
+  void Reset(long start_frame, double frame_rate, int sample_rate);
+
+  /**
+   * @brief Convert a Sequence frame to an absolute mixer position
+   *
+   * @param frame_rate
+   *
+   * Frame rate that `frame` is in (this may be a nested Sequence's frame rate rather than the one passed to Reset()).
+   *
+   * @param frame
+   *
+   * Frame to convert. Must not be before start_frame().
+   *
+   * @return
+   *
+   * Position (in interleaved stereo samples) in this context's mixer.
+   */
+  qint64 GetBufferOffsetFromFrame(double frame_rate, long frame);
+
+  /**
+   * @brief Block until every input has written audio up to a certain position
+   *
+   * Only valid on synchronous contexts.
+   *
+   * @param position
+   *
+   * Absolute position (in samples) that must be ready (see AudioMixer::IsReady()).
+   *
+   * @param timeout
+   *
+   * Maximum time to wait (in milliseconds).
+   *
+   * @return
+   *
+   * **TRUE** if the audio is ready, **FALSE** if the timeout expired first.
+   */
+  bool WaitForAudio(qint64 position, unsigned long timeout);
+
+  /**
+   * @brief Signal that new audio has been written to this context's mixer
+   *
+   * Called by Cachers after writing to or finishing their AudioMixerInput. Does nothing if the context isn't
+   * synchronous.
+   */
+  void NotifyWritten();
+
+  /**
+   * @brief Returns whether this context's consumer pulls audio synchronously (see AudioRenderContext())
+   */
+  bool synchronous();
+
+  /**
+   * @brief Returns the mixer that Cachers write this context's audio into
+   */
+  AudioMixer* mixer();
+
+  /**
+   * @brief Returns the Sequence frame that mixer position 0 corresponds to
+   */
+  long start_frame();
+
+  /**
+   * @brief Returns start_frame() in seconds
+   */
+  double start_timecode();
+
+  /**
+   * @brief Returns the sample rate audio is rendered at
+   */
+  int sample_rate();
+
+private:
+  AudioMixer mixer_;
+
+  long start_frame_;
+
+  double start_timecode_;
+
+  int sample_rate_;
+
+  bool synchronous_;
+
+  QMutex wait_lock_;
+
+  QWaitCondition wait_cond_;
+};
+
+#endif // AUDIORENDERCONTEXT_H
@@ -0,0 +1,357 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiostretcher.h"
+
+#include <QtMath>
+
+#include "rendering/audiodsp.h"
+
+// length of each WSOLA window in seconds, long enough to hold a few periods of most voices and instruments without
+// smearing transients too much
+const double kStretchWindowLength = 0.03;
+
+// only every Nth sample is compared when searching for the best window offset, which is plenty for finding where two
+// waveforms line up and saves a lot of time
+const int kCorrelationStep = 4;
+
+AudioStretcher::AudioStretcher() :
+  channels_(0),
+  sample_rate_(0),
+  speed_(0),
+  maintain_pitch_(false),
+  input_size_(0),
+  output_start_(0),
+  output_end_(0),
+  position_(0),
+  window_size_(0),
+  tolerance_(0),
+  first_window_(true),
+  previous_window_(0)
+{
+  Configure(2, 48000, 1.0, false);
+}
+
+void AudioStretcher::Configure(int channels, int sample_rate, double speed, bool maintain_pitch)
+{
+  if (channels == channels_
+      && sample_rate == sample_rate_
+      && qFuzzyCompare(speed, speed_)
+      && maintain_pitch == maintain_pitch_) {
+    return;
+  }
+
+  channels_ = channels;
+  sample_rate_ = sample_rate;
+  speed_ = speed;
+  maintain_pitch_ = maintain_pitch;
+
+  input_.resize(channels_);
+  output_.resize(channels_);
+  overlap_.resize(channels_);
+
+  window_size_ = qMax(32, qRound(sample_rate_ * kStretchWindowLength)) & ~1;
+  tolerance_ = window_size_ / 8;
+
+  window_.resize(window_size_);
+  for (int i=0;i<window_size_;i++) {
+    window_[i] = float(0.5 - 0.5 * qCos(2.0 * M_PI * i / window_size_));
+  }
+
+  for (int i=0;i<channels_;i++) {
+    overlap_[i].resize(window_size_ / 2);
+  }
+
+  Flush();
+}
+
+bool AudioStretcher::IsPassthrough() const
+{
+  return qFuzzyCompare(speed_, 1.0);
+}
+
+void AudioStretcher::Push(const float * const *planes, int frames)
+{
+  if (frames <= 0) {
+    return;
+  }
+
+  if (IsPassthrough()) {
+    ReserveOutput(frames);
+    for (int i=0;i<channels_;i++) {
+      memcpy(output_[i].data() + output_end_, planes[i], size_t(frames) * sizeof(float));
+    }
+    output_end_ += frames;
+    return;
+  }
+
+  for (int i=0;i<channels_;i++) {
+    if (input_[i].size() < input_size_ + frames) {
+      input_[i].resize(input_size_ + frames);
+    }
+    memcpy(input_[i].data() + input_size_, planes[i], size_t(frames) * sizeof(float));
+  }
+  input_size_ += frames;
+
+  Process();
+}
+
+int AudioStretcher::Pull(float * const *planes, int max_frames)
+{
+  int frames = qMin(max_frames, available());
+
+  if (frames <= 0) {
+    return 0;
+  }
+
+  for (int i=0;i<channels_;i++) {
+    memcpy(planes[i], output_[i].constData() + output_start_, size_t(frames) * sizeof(float));
+  }
+
+  output_start_ += frames;
+
+  if (output_start_ == output_end_) {
+    output_start_ = 0;
+    output_end_ = 0;
+  }
+
+  return frames;
+}
+
+int AudioStretcher::available() const
+{
+  return output_end_ - output_start_;
+}
+
+void AudioStretcher::Flush()
+{
+  input_size_ = 0;
+  output_start_ = 0;
+  output_end_ = 0;
+  position_ = 0;
+  first_window_ = true;
+  previous_window_ = 0;
+}
+
+void AudioStretcher::Process()
+{
+  if (maintain_pitch_) {
+    ProcessStretch();
+  } else {
+    ProcessResample();
+  }
+}
+
+void AudioStretcher::ProcessResample()
+{
+  // each output sample is interpolated from one input sample before its position and two after it
+  int count = 0;
+  double end_position = position_;
+  while (int(end_position) + 2 < input_size_) {
+    count++;
+    end_position += speed_;
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  ReserveOutput(count);
+
+  for (int i=0;i<channels_;i++) {
+    const float* in = input_[i].constData();
+    float* out = output_[i].data() + output_end_;
+    double pos = position_;
+
+    for (int j=0;j<count;j++) {
+      int index = int(pos);
+      float t = float(pos - index);
+
+      // 4-point Catmull-Rom spline
+      float xm1 = in[qMax(index - 1, 0)];
+      float x0 = in[index];
+      float x1 = in[index + 1];
+      float x2 = in[index + 2];
+
+      float c1 = 0.5f * (x1 - xm1);
+      float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+      float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+
+      out[j] = ((c3 * t + c2) * t + c1) * t + x0;
+
+      pos += speed_;
+    }
+  }
+
+  output_end_ += count;
+  position_ = end_position;
+
+  DiscardInput(int(position_) - 1);
+}
+
+void AudioStretcher::ProcessStretch()
+{
+  const int half = window_size_ / 2;
+
+  // windows overlap by half, so each one outputs `half` samples while moving `half * speed` samples through the input
+  const double hop = half * speed_;
+
+  while (true) {
+    int nominal = qRound(position_);
+
+    if (nominal + tolerance_ + window_size_ > input_size_) {
+      break;
+    }
+
+    int start = nominal;
+    if (!first_window_) {
+      start += FindBestOffset(nominal);
+    }
+
+    ReserveOutput(half);
+
+    for (int i=0;i<channels_;i++) {
+      const float* in = input_[i].constData() + start;
+      float* out = output_[i].data() + output_end_;
+      float* overlap = overlap_[i].data();
+
+      memcpy(out, in, size_t(half) * sizeof(float));
+
+      // the very first window is output as-is rather than fading in from silence
+      if (!first_window_) {
+        olive::dsp::MultiplyAdd(out, window_.constData(), overlap, half);
+      }
+
+      memcpy(overlap, in + half, size_t(half) * sizeof(float));
+      olive::dsp::Envelope(overlap, window_.constData() + half, half);
+    }
+
+    output_end_ += half;
+    first_window_ = false;
+    previous_window_ = start;
+    position_ += hop;
+  }
+
+  // keep whatever the next window search and its comparison with the last window will need
+  int keep = qRound(position_) - tolerance_;
+  if (!first_window_) {
+    keep = qMin(keep, previous_window_ + half);
+  }
+  DiscardInput(keep);
+}
+
+int AudioStretcher::FindBestOffset(int nominal)
+{
+  const int half = window_size_ / 2;
+
+  int lowest = qMax(-tolerance_, -nominal);
+  int highest = tolerance_;
+
+  // the best window is the one whose first half most resembles the audio that followed the last window, since
+  // that's what it'll be overlapped with
+  int candidates_start = nominal + lowest;
+  int candidates_length = highest - lowest + half;
+
+  search_.resize(half + candidates_length);
+  float* reference = search_.data();
+  float* candidates = search_.data() + half;
+
+  const int reference_start = previous_window_ + half;
+
+  memcpy(reference, input_.at(0).constData() + reference_start, size_t(half) * sizeof(float));
+  memcpy(candidates, input_.at(0).constData() + candidates_start, size_t(candidates_length) * sizeof(float));
+  for (int i=1;i<channels_;i++) {
+    olive::dsp::MixAdd(reference, input_.at(i).constData() + reference_start, half);
+    olive::dsp::MixAdd(candidates, input_.at(i).constData() + candidates_start, candidates_length);
+  }
+
+  // normalized cross-correlation so louder candidates aren't favored
+  auto similarity = [&](int offset) {
+    const float* c = candidates + (offset - lowest);
+    double dot = 0;
+    double energy = 0;
+    for (int j=0;j<half;j+=kCorrelationStep) {
+      dot += double(reference[j]) * c[j];
+      energy += double(c[j]) * c[j];
+    }
+    return dot / qSqrt(energy + 1e-9);
+  };
+
+  // search every other offset, then refine around the best one
+  int best = 0;
+  double best_similarity = -1e30;
+  for (int i=lowest;i<=highest;i+=2) {
+    double s = similarity(i);
+    if (s > best_similarity) {
+      best_similarity = s;
+      best = i;
+    }
+  }
+
+  int coarse_best = best;
+  for (int i=coarse_best-1;i<=coarse_best+1;i+=2) {
+    if (i >= lowest && i <= highest) {
+      double s = similarity(i);
+      if (s > best_similarity) {
+        best_similarity = s;
+        best = i;
+      }
+    }
+  }
+
+  return best;
+}
+
+void AudioStretcher::ReserveOutput(int frames)
+{
+  // move any unread samples back to the start rather than letting the buffer grow
+  if (output_start_ > 0) {
+    int unread = output_end_ - output_start_;
+    for (int i=0;i<channels_;i++) {
+      memmove(output_[i].data(), output_[i].constData() + output_start_, size_t(unread) * sizeof(float));
+    }
+    output_start_ = 0;
+    output_end_ = unread;
+  }
+
+  for (int i=0;i<channels_;i++) {
+    if (output_[i].size() < output_end_ + frames) {
+      output_[i].resize(output_end_ + frames);
+    }
+  }
+}
+
+void AudioStretcher::DiscardInput(int frames)
+{
+  frames = qMin(frames, input_size_);
+
+  if (frames <= 0) {
+    return;
+  }
+
+  input_size_ -= frames;
+
+  for (int i=0;i<channels_;i++) {
+    memmove(input_[i].data(), input_[i].constData() + frames, size_t(input_size_) * sizeof(float));
+  }
+
+  position_ -= frames;
+  previous_window_ -= frames;
+}
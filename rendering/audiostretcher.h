@@ -0,0 +1,207 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOSTRETCHER_H
+#define AUDIOSTRETCHER_H
+
+#include <QVector>
+
+/**
+ * @brief The AudioStretcher class
+ *
+ * A streaming speed change stage for planar float audio. Samples are pushed in at the source's sample rate and pulled
+ * out at the same sample rate, with their duration scaled by 1/speed.
+ *
+ * Without pitch correction, the audio is simply resampled (varispeed). With pitch correction, the audio is time
+ * stretched using WSOLA (waveform similarity overlap-add), which joins overlapping windows of the input at the offset
+ * where they line up best to avoid phasing artifacts. Either way, any speed is handled in a single pass, unlike
+ * FFmpeg's atempo filter which needs to be chained for speeds outside 0.5x-2.0x.
+ *
+ * All state is kept in buffers that are reused between Flush() calls, so seeking only costs discarding the buffered
+ * samples rather than reconfiguring a filter graph. Buffers are only reallocated when they need to grow.
+ *
+ * Not thread-safe, each AudioStretcher should only be used by one thread at a time.
+ */
+class AudioStretcher {
+public:
+  /**
+   * @brief AudioStretcher Constructor
+   *
+   * The stretcher starts as a stereo passthrough at 48000Hz. Use Configure() to change this.
+   */
+  AudioStretcher();
+
+  /**
+   * @brief Set up the stretcher for a certain format and speed
+   *
+   * If the format and speed are unchanged, this does nothing. Otherwise any buffered samples are discarded (as in
+   * Flush()).
+   *
+   * @param channels
+   *
+   * Number of channels (planes) of audio that will be pushed.
+   *
+   * @param sample_rate
+   *
+   * Sample rate of the audio, used to size the WSOLA windows.
+   *
+   * @param speed
+   *
+   * Playback speed multiplier, e.g. 2.0 halves the audio's duration. Must be greater than 0.
+   *
+   * @param maintain_pitch
+   *
+   * **TRUE** to time stretch the audio without changing its pitch, **FALSE** to resample it (changing its pitch along
+   * with its speed).
+   */
+  void Configure(int channels, int sample_rate, double speed, bool maintain_pitch);
+
+  /**
+   * @brief Returns **TRUE** if the stretcher is configured for a speed of 1.0 and will output audio unchanged
+   */
+  bool IsPassthrough() const;
+
+  /**
+   * @brief Add audio to the stretcher
+   *
+   * @param planes
+   *
+   * One array of samples for each channel set in Configure().
+   *
+   * @param frames
+   *
+   * Number of samples in each array.
+   */
+  void Push(const float* const* planes, int frames);
+
+  /**
+   * @brief Retrieve processed audio from the stretcher
+   *
+   * @param planes
+   *
+   * One array for each channel set in Configure() that will be filled with up to `max_frames` samples.
+   *
+   * @return
+   *
+   * Number of samples written to each array.
+   */
+  int Pull(float* const* planes, int max_frames);
+
+  /**
+   * @brief Returns the number of processed samples per channel that can currently be retrieved with Pull()
+   */
+  int available() const;
+
+  /**
+   * @brief Discard all buffered audio and start again from a clean state
+   *
+   * Call after seeking. Keeps all allocated buffers so no memory is allocated or freed.
+   */
+  void Flush();
+
+private:
+  /**
+   * @brief Process as much of the buffered input as possible into the output buffer
+   */
+  void Process();
+
+  void ProcessResample();
+
+  void ProcessStretch();
+
+  /**
+   * @brief Find the offset from `nominal` that best continues the previous WSOLA window
+   */
+  int FindBestOffset(int nominal);
+
+  /**
+   * @brief Make room for `frames` more samples at the end of the output buffer
+   */
+  void ReserveOutput(int frames);
+
+  /**
+   * @brief Remove samples from the start of the input buffer once they're no longer needed
+   */
+  void DiscardInput(int frames);
+
+  int channels_;
+  int sample_rate_;
+  double speed_;
+  bool maintain_pitch_;
+
+  /**
+   * @brief Buffered input samples (one vector per channel), only the first `input_size_` samples are valid
+   */
+  QVector< QVector<float> > input_;
+  int input_size_;
+
+  /**
+   * @brief Processed samples (one vector per channel), valid from `output_start_` to `output_end_`
+   */
+  QVector< QVector<float> > output_;
+  int output_start_;
+  int output_end_;
+
+  /**
+   * @brief Position in the input buffer (in samples) of the next output sample or WSOLA window
+   */
+  double position_;
+
+  // WSOLA state
+  /**
+   * @brief Length of each WSOLA window in samples, always even
+   */
+  int window_size_;
+
+  /**
+   * @brief Maximum distance a window is allowed to move from its nominal position to line up with the last one
+   */
+  int tolerance_;
+
+  /**
+   * @brief **TRUE** if no window has been output since flushing
+   */
+  bool first_window_;
+
+  /**
+   * @brief Position in the input buffer of the last window used
+   *
+   * Can be negative once the first half of the last window has been discarded from the input buffer, since only its
+   * second half is still needed.
+   */
+  int previous_window_;
+
+  /**
+   * @brief Periodic Hann window of `window_size_` samples (overlapping two halves sums to 1.0)
+   */
+  QVector<float> window_;
+
+  /**
+   * @brief Second half of the last window, which the next window's first half is added to
+   */
+  QVector< QVector<float> > overlap_;
+
+  /**
+   * @brief Mono mix of the input used to compare window offsets
+   */
+  QVector<float> search_;
+};
+
+#endif // AUDIOSTRETCHER_H
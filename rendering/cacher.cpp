@@ -36,7 +36,11 @@
 #include "panels/panels.h"
 #include "project/projectelements.h"
 #include "rendering/audio.h"
+#include "rendering/audiodsp.h"
+#include "rendering/audiomixer.h"
 #include "rendering/renderfunctions.h"
+#include "rendering/framecache.h"
+#include "rendering/framepool.h"
 #include "global/timing.h"
 #include "global/config.h"
 #include "global/global.h"
@@ -48,6 +52,15 @@
 
 const AVSampleFormat kDestSampleFmt = AV_SAMPLE_FMT_FLTP;
 
+// channels in kDestSampleFmt audio (the filter stack always outputs stereo)
+const int kDestChannels = 2;
+
+// samples per channel read from conformed audio at a time
+const int kConformedBlockSize = 4096;
+
+// samples per channel retrieved from the AudioStretcher at a time
+const int kStretchBlockSize = 4096;
+
 double samples_to_seconds(int nb_samples, int nb_channels, int sample_rate) {
   return (double(nb_samples) / double(nb_channels) / double(sample_rate));
 }
@@ -57,6 +70,9 @@ int samples_to_bytes(int nb_samples, int nb_channels) {
 }
 
 void apply_audio_effects(Clip* clip, double timecode_start, AVFrame* frame, int nb_samples, int nb_channels, QVector<Clip*> nests) {
+  // let effects that query the rate (e.g. VST plugins) see the rate of this frame rather than the output device's
+  set_thread_audio_freq(frame->sample_rate);
+
   // perform all audio effects
   double timecode_end;
   timecode_end = timecode_start + samples_to_seconds(nb_samples, frame->channels, frame->sample_rate);
@@ -110,6 +126,11 @@ void Cacher::CacheAudioWorker() {
   // main thread waits until cacher starts fully, wake it up here
   WakeMainThread();
 
+  // nothing to render audio into
+  if (audio_context_ == nullptr) {
+    return;
+  }
+
   bool audio_just_reset = false;
 
   // for audio clips, something may have triggered an audio reset (common if the user seeked)
@@ -160,6 +181,12 @@ void Cacher::CacheAudioWorker() {
     timeline_out = temp;
   }
 
+  if (conformed_audio_ != nullptr) {
+    CacheConformedAudio(timeline_in + frame_skip, timeline_out, target_frame, last_fr, temp_reverse);
+    WakeAudioWakeObject();
+    return;
+  }
+
   while (true) {
     AVFrame* frame;
     int nb_samples = INT_MAX;
@@ -174,9 +201,9 @@ void Cacher::CacheAudioWorker() {
         frame_->pts += nb_samples;
         frame_sample_index_ = 0;
         if (audio_buffer_write == 0) {
-          audio_buffer_write = get_buffer_offset_from_frame(last_fr, qMax(timeline_in, target_frame));
+          audio_buffer_write = audio_context_->GetBufferOffsetFromFrame(last_fr, qMax(timeline_in, target_frame));
         }
-        int offset = audio_ibuffer_read - audio_buffer_write;
+        qint64 offset = audio_context_->mixer()->read_position() - audio_buffer_write;
         if (offset > 0) {
           audio_buffer_write += offset;
           frame_sample_index_ += offset;
@@ -197,6 +224,7 @@ void Cacher::CacheAudioWorker() {
 
           if (reverse_audio && !audio_just_reset) {
             avcodec_flush_buffers(codecCtx);
+            stretcher_.Flush();
             reached_end = false;
             int64_t backtrack_seek = qMax(reverse_target_ - static_cast<int64_t>(av_q2d(av_inv_q(stream->time_base))),
                                           static_cast<int64_t>(0));
@@ -213,7 +241,7 @@ void Cacher::CacheAudioWorker() {
 
             int ret;
 
-            while ((ret = av_buffersink_get_frame(buffersink_ctx, frame)) == AVERROR(EAGAIN)) {
+            while ((ret = RetrieveAudioFrame(frame)) == AVERROR(EAGAIN)) {
               ret = RetrieveFrameFromDecoder(frame_);
               if (ret >= 0) {
                 if ((ret = av_buffersrc_add_frame_flags(buffersrc_ctx, frame_, AV_BUFFERSRC_FLAG_KEEP_REF)) < 0) {
@@ -262,18 +290,18 @@ void Cacher::CacheAudioWorker() {
                     rev_frame->nb_samples = 0;
                     rev_frame->pts = frame_->pkt_pts;
                   }
-                  int offset = rev_frame->nb_samples * av_get_bytes_per_sample(static_cast<AVSampleFormat>(rev_frame->format)) * rev_frame->channels;
 #ifdef AUDIOWARNINGS
-                  dout << "offset 1:" << offset;
                   dout << "retrieved samples:" << frame->nb_samples << "size:" << (frame->nb_samples * av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format)) * frame->channels);
 #endif
-                  memcpy(
-                        rev_frame->data[0]+offset,
-                      frame->data[0],
-                      (frame->nb_samples * av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format)) * frame->channels)
-                      );
+
+                  // frames are planar, append each channel to its own plane
+                  for (int i=0;i<rev_frame->channels;i++) {
+                    memcpy(reinterpret_cast<float*>(rev_frame->data[i]) + rev_frame->nb_samples,
+                           frame->data[i],
+                           size_t(frame->nb_samples) * sizeof(float));
+                  }
 #ifdef AUDIOWARNINGS
-                  dout << "pts:" << frame_->pts << "dur:" << frame_->pkt_duration << "rev_target:" << reverse_target << "offset:" << offset << "limit:" << rev_frame->linesize[0];
+                  dout << "pts:" << frame_->pts << "dur:" << frame_->pkt_duration << "rev_target:" << reverse_target << "limit:" << rev_frame->linesize[0];
 #endif
                 }
 
@@ -298,24 +326,14 @@ void Cacher::CacheAudioWorker() {
                   dout << "pre cutoff deets::: rev_frame.pts:" << rev_frame->pts << "rev_frame.nb_samples" << rev_frame->nb_samples << "rev_target:" << reverse_target;
 #endif
                   double playback_speed_ = clip->speed().value * clip->media()->to_footage()->speed;
-                  rev_frame->nb_samples = qRound64(double(reverse_target_ - rev_frame->pts) * timebase * (current_audio_freq() / playback_speed_));
+                  rev_frame->nb_samples = qRound64(double(reverse_target_ - rev_frame->pts) * timebase * (audio_sample_rate_ / playback_speed_));
 #ifdef AUDIOWARNINGS
                   dout << "post cutoff deets::" << rev_frame->nb_samples;
 #endif
 
-                  int frame_size = rev_frame->nb_samples * rev_frame->channels * av_get_bytes_per_sample(static_cast<AVSampleFormat>(rev_frame->format));
-                  int half_frame_size = frame_size >> 1;
-
-                  int sample_size = rev_frame->channels*av_get_bytes_per_sample(static_cast<AVSampleFormat>(rev_frame->format));
-                  char* temp_chars = new char[sample_size];
-                  for (int i=0;i<half_frame_size;i+=sample_size) {
-                    memcpy(temp_chars, &rev_frame->data[0][i], sample_size);
-
-                    memcpy(&rev_frame->data[0][i], &rev_frame->data[0][frame_size-i-sample_size], sample_size);
-
-                    memcpy(&rev_frame->data[0][frame_size-i-sample_size], temp_chars, sample_size);
+                  for (int i=0;i<rev_frame->channels;i++) {
+                    olive::dsp::Reverse(reinterpret_cast<float*>(rev_frame->data[i]), rev_frame->nb_samples);
                   }
-                  delete [] temp_chars;
 
                   reverse_target_ = rev_frame->pts;
                   frame = rev_frame;
@@ -355,7 +373,7 @@ void Cacher::CacheAudioWorker() {
           int64_t stream_start = qMax(static_cast<int64_t>(0), stream->start_time);
           double frame_sts = ((frame->pts - stream_start) * timebase);
 
-          int nb_samples = qRound64((target_sts - frame_sts)*current_audio_freq());
+          int nb_samples = qRound64((target_sts - frame_sts)*audio_sample_rate_);
           frame_sample_index_ = nb_samples * 4;
 #ifdef AUDIOWARNINGS
           dout << "fsts:" << frame_sts << "tsts:" << target_sts << "nbs:" << nb_samples << "nbb:" << nb_bytes << "rev_targetToSec:" << (reverse_target * timebase);
@@ -369,16 +387,16 @@ void Cacher::CacheAudioWorker() {
         dout << "fsi-post-post:" << frame_sample_index;
 #endif
         if (audio_buffer_write == 0) {
-          audio_buffer_write = get_buffer_offset_from_frame(last_fr, qMax(timeline_in, target_frame));
+          audio_buffer_write = audio_context_->GetBufferOffsetFromFrame(last_fr, qMax(timeline_in, target_frame));
 
           if (frame_skip > 0) {
-            int target = get_buffer_offset_from_frame(last_fr, qMax(timeline_in + frame_skip, target_frame));
+            int target = audio_context_->GetBufferOffsetFromFrame(last_fr, qMax(timeline_in + frame_skip, target_frame));
             frame_sample_index_ += (target - audio_buffer_write);
             audio_buffer_write = target;
           }
         }
 
-        int offset = audio_ibuffer_read - audio_buffer_write;
+        qint64 offset = audio_context_->mixer()->read_position() - audio_buffer_write;
         if (offset > 0) {
           audio_buffer_write += offset;
           frame_sample_index_ += offset;
@@ -403,8 +421,8 @@ void Cacher::CacheAudioWorker() {
       }
       if (new_frame) {
         apply_audio_effects(clip,
-                            samples_to_seconds(audio_buffer_write, 2, current_audio_freq())
-                              + audio_ibuffer_timecode
+                            samples_to_seconds(audio_buffer_write, 2, audio_sample_rate_)
+                              + audio_context_->start_timecode()
                               + (double(clip->clip_in(true))/clip->track()->sequence()->frame_rate())
                               - (double(timeline_in)/last_fr),
                             frame,
@@ -414,46 +432,63 @@ void Cacher::CacheAudioWorker() {
       }
     }
 
-    // mix audio into internal buffer
+    // send audio to the mixer
     if (frame->nb_samples == 0) {
+      // no more audio is coming, don't make synchronous consumers wait for it
+      if (audio_input_ != nullptr) {
+        audio_input_->Finish();
+        audio_context_->NotifyWritten();
+      }
       break;
     } else {
-      qint64 buffer_timeline_out = get_buffer_offset_from_frame(clip->track()->sequence()->frame_rate(), timeline_out);
-
-      audio_write_lock.lock();
+      qint64 buffer_timeline_out = audio_context_->GetBufferOffsetFromFrame(clip->track()->sequence()->frame_rate(), timeline_out);
+      qint64 write_limit = qMin(audio_context_->mixer()->read_position() + AudioMixer::kMaxWriteAhead, buffer_timeline_out);
+
+      int channels = frame->channels;
+      int sample_step = qMax(1, qAbs(playback_speed_));
+
+      // count how many sample frames we can send (each one is written as long as it starts before the limit)
+      int frames = 0;
+      if (frame_sample_index_ < nb_samples && audio_buffer_write < write_limit) {
+        int frames_available = (nb_samples - frame_sample_index_ + sample_step - 1) / sample_step;
+        int frames_writable = int((write_limit - audio_buffer_write + channels - 1) / channels);
+        frames = qMin(frames_available, frames_writable);
+      }
 
-      int sample_skip = qMax(0, qAbs(playback_speed_)-1);
+      if (audio_reset_) return;
 
-      while (frame_sample_index_ < nb_samples
-             && audio_buffer_write < audio_ibuffer_read+(audio_ibuffer_size>>1)
-             && audio_buffer_write < buffer_timeline_out) {
-        for (int i=0;i<frame->channels;i++) {
-          int buffer_index = audio_buffer_write%audio_ibuffer_size;
+      if (frames > 0) {
+        audio_block_.resize(frames * channels);
+        float* block = audio_block_.data();
 
-          audio_ibuffer[buffer_index] += reinterpret_cast<float*>(frame->data[i])[frame_sample_index_];
+        // interleave the planar frame into the block
+        const float* planes[AV_NUM_DATA_POINTERS];
+        for (int i=0;i<channels;i++) {
+          planes[i] = reinterpret_cast<float*>(frame->data[i]) + frame_sample_index_;
+        }
+        olive::dsp::Interleave(planes, block, channels, frames, sample_step);
 
-          audio_buffer_write++;
+        if (audio_input_ != nullptr) {
+          audio_input_->Write(audio_buffer_write, block, audio_block_.size());
         }
 
-        frame_sample_index_++;
+        audio_buffer_write += audio_block_.size();
+        frame_sample_index_ += frames * sample_step;
 
-        frame_sample_index_ += sample_skip;
+        if (audio_input_ != nullptr) {
+          // the clip ends here, don't make synchronous consumers wait for any more of it
+          if (audio_buffer_write >= buffer_timeline_out) {
+            audio_input_->Finish();
+          }
 
-        if (audio_reset_) break;
+          audio_context_->NotifyWritten();
+        }
       }
 
 #ifdef AUDIOWARNINGS
       if (audio_buffer_write >= buffer_timeline_out) dout << "timeline out at fsi" << frame_sample_index << "of frame ts" << frame_->pts;
 #endif
 
-      audio_write_lock.unlock();
-
-      if (audio_reset_) return;
-
-      if (scrubbing_) {
-        if (audio_thread != nullptr) audio_thread->notifyReceiver();
-      }
-
       if (frame_sample_index_ >= nb_samples) {
         frame_sample_index_ = -1;
       } else {
@@ -475,6 +510,118 @@ void Cacher::CacheAudioWorker() {
   WakeAudioWakeObject();
 }
 
+void Cacher::CacheConformedAudio(long timeline_in, long timeline_out, long target_frame, double frame_rate, bool temp_reverse)
+{
+  const int channels = ConformedAudio::kChannels;
+
+  long start_frame = qMax(timeline_in, target_frame);
+  if (start_frame >= timeline_out) {
+    if (audio_input_ != nullptr) {
+      audio_input_->Finish();
+      audio_context_->NotifyWritten();
+    }
+    return;
+  }
+
+  AudioMixer* mixer = audio_context_->mixer();
+
+  qint64 start_position = audio_context_->GetBufferOffsetFromFrame(frame_rate, start_frame);
+  qint64 end_position = audio_context_->GetBufferOffsetFromFrame(frame_rate, timeline_out);
+
+  // don't write anything that's already been mixed
+  audio_buffer_write = qMax(audio_buffer_write, qMax(start_position, mixer->read_position()));
+
+  qint64 write_limit = qMin(mixer->read_position() + AudioMixer::kMaxWriteAhead, end_position);
+
+  // time into the clip (in seconds at sequence speed) of start_frame. With reverse playback the frames have been
+  // mirrored, so the clip plays from its end.
+  double clip_frame_rate = clip->track()->sequence()->frame_rate();
+  double clip_start = double(clip->clip_in(true)) / clip_frame_rate
+      + double(temp_reverse ? timeline_out - start_frame : start_frame - timeline_in) / frame_rate;
+  double clip_step = double(qMax(1, qAbs(playback_speed_))) / audio_sample_rate_;
+  if (temp_reverse) {
+    clip_step = -clip_step;
+  }
+
+  // convert to the position in the conformed audio
+  double speed = clip->speed().value * clip->media()->to_footage()->speed;
+  double source_start = clip_start;
+  double source_step = clip_step;
+  if (clip->reversed()) {
+    source_start = double(clip->media_length() - 1) / clip_frame_rate - source_start;
+    source_step = -source_step;
+  }
+  source_start *= speed * audio_sample_rate_;
+  source_step *= speed * audio_sample_rate_;
+
+  while (audio_buffer_write < write_limit && !audio_reset_) {
+    int frames = int(qMin(qint64(kConformedBlockSize),
+                          (write_limit - audio_buffer_write + channels - 1) / channels));
+    qint64 n = (audio_buffer_write - start_position) / channels;
+    double source_pos = source_start + n * source_step;
+
+    // read samples from the conformed audio, anything outside of it is silence
+    conformed_audio_->Read(source_pos, source_step, frames, reinterpret_cast<float**>(conformed_frame_->data));
+
+    conformed_frame_->nb_samples = frames;
+    apply_audio_effects(clip, clip_start + n * clip_step, conformed_frame_, frames, channels, nests_);
+
+    audio_block_.resize(frames * channels);
+    float* block = audio_block_.data();
+    olive::dsp::Interleave(reinterpret_cast<float**>(conformed_frame_->data), block, channels, frames);
+
+    if (audio_input_ != nullptr) {
+      audio_input_->Write(audio_buffer_write, block, audio_block_.size());
+    }
+
+    audio_buffer_write += audio_block_.size();
+
+    if (audio_input_ != nullptr) {
+      if (audio_buffer_write >= end_position) {
+        audio_input_->Finish();
+      }
+
+      audio_context_->NotifyWritten();
+    }
+
+    // the output picks up scrub audio on its next period, one block is all it needs
+    if (scrubbing_) {
+      break;
+    }
+  }
+}
+
+void Cacher::UpdateConformedAudio(bool wait)
+{
+  if (!use_conformed_audio_ || conformed_audio_ != nullptr) {
+    return;
+  }
+
+  conformed_audio_ = olive::conformed_audio_cache.Get(clip->media()->to_footage(),
+                                                      clip->media_stream(),
+                                                      audio_sample_rate_,
+                                                      wait);
+
+  if (conformed_audio_ != nullptr && conformed_frame_ == nullptr) {
+    conformed_frame_ = av_frame_alloc();
+    conformed_frame_->format = kDestSampleFmt;
+    conformed_frame_->channel_layout = AV_CH_LAYOUT_STEREO;
+    conformed_frame_->channels = ConformedAudio::kChannels;
+    conformed_frame_->sample_rate = audio_sample_rate_;
+    conformed_frame_->nb_samples = kConformedBlockSize;
+    if (av_frame_get_buffer(conformed_frame_, 0) < 0) {
+      qCritical() << "Could not allocate buffer for conformed audio";
+      av_frame_free(&conformed_frame_);
+      conformed_audio_ = nullptr;
+    }
+  }
+}
+
+DecodeScheduler::Priority Cacher::CacheAheadPriority()
+{
+  return (playback_speed_ != 0) ? DecodeScheduler::kPriorityLookahead : DecodeScheduler::kPriorityPrefetch;
+}
+
 bool Cacher::IsReversed()
 {
   // Here, the Clip reverse and reversed playback speed cancel each other out to produce normal playback
@@ -500,11 +647,9 @@ void Cacher::CacheVideoWorker() {
 
       if (RetrieveFrameAndProcess(&still_image_frame) >= 0) {
 
-        queue_.lock();
-        queue_.append(still_image_frame);
-        queue_.unlock();
-
         SetRetrievedFrame(still_image_frame);
+
+        queue_.append(still_image_frame);
       }
 
     }
@@ -515,6 +660,26 @@ void Cacher::CacheVideoWorker() {
     // main thread waits until cacher starts fully, wake it up here
     WakeMainThread();
 
+    // a frame that's needed right now takes precedence over caching ahead
+    DecodeScheduler::Priority priority = (retrieved_frame == nullptr && !preroll_)
+        ? DecodeScheduler::kPriorityVisible
+        : CacheAheadPriority();
+
+    // follow changes to this decoder's share of the codec threads as other clips open and close
+    if (codec_threads_ > 0) {
+      int codec_threads = olive::decode_scheduler.RebalanceDecoder(codec_threads_);
+
+      if (codec_threads != codec_threads_) {
+        avcodec_free_context(&codecCtx);
+
+        codec_threads_ = codec_threads;
+        OpenCodec(codec_threads_);
+
+        // the new decoder has to seek before it can continue where the old one left off
+        decoder_synced_ = false;
+      }
+    }
+
     // determine if this media is reversed, which will affect how the queue is constructed
     bool reversed = IsReversed();
 
@@ -524,65 +689,68 @@ void Cacher::CacheVideoWorker() {
     // get the value of one second in terms of the media's timebase
     int64_t second_pts = seconds_to_timestamp(clip, 1); // FIXME: possibly magic number?
 
-    // check which range of frames we have in the queue
+    // check which range of frames we have in the queue (the queue is always chronological)
     int64_t earliest_pts = INT64_MAX;
     int64_t latest_pts = INT64_MIN;
     int frames_greater_than_target = 0;
 
-    for (int i=0;i<queue_.size();i++) {
-      // cache earliest and latest timestamps in the queue
-      earliest_pts = qMin(earliest_pts, queue_.at(i)->pts);
-      latest_pts = qMax(latest_pts, queue_.at(i)->pts);
+    if (!queue_.isEmpty()) {
+      earliest_pts = queue_.first()->pts;
+      latest_pts = queue_.last()->pts;
 
       // count upcoming frames
-      if (queue_.at(i)->pts > target_pts) {
-        frames_greater_than_target++;
-      }
+      frames_greater_than_target = queue_.size() - queue_.countUpTo(target_pts);
     }
 
     // If we have to seek ahead, we may want to re-use the frame we retrieved later in the pipeline.
     AVFrame* decoded_frame;
     bool have_existing_frame_to_use = false;
     bool seeked_to_zero = false;
+    bool seek_failed = false;
 
     // check if the frame is within this queue or if we'll have to seek elsewhere to get it
-    // (we check for one second of time after latest_pts, because if it's within that range it'll likely be faster to
-    // play up to that frame than seek to it)
-    if (target_pts < earliest_pts || target_pts > latest_pts + second_pts || queue_.size() == 0) {
+    // (if we have a keyframe index, we only seek if there's a keyframe between the queue and the target since decoding
+    // forward is otherwise just as fast; without one, we check for one second of time after latest_pts, because if
+    // it's within that range it'll likely be faster to play up to that frame than seek to it)
+    bool seek_ahead;
+    if (use_keyframe_index_) {
+      int64_t target_keyframe = clip->media_stream()->get_keyframe_before(target_pts);
+      seek_ahead = (target_keyframe != AV_NOPTS_VALUE && target_keyframe > latest_pts);
+    } else {
+      seek_ahead = (target_pts > latest_pts + second_pts);
+    }
+
+    if (target_pts < earliest_pts || seek_ahead || queue_.size() == 0) {
       // we need to seek to retrieve this frame
 
-      int retrieve_code;
-      int64_t seek_ts = target_pts;
-      int64_t zero = 0;
+      // another clip using the same footage may have already decoded this frame, in which case we don't need to seek
+      // the decoder at all (RetrieveNextFrame() will seek later if it runs out of shared frames)
+      decoded_frame = nullptr;
+      if (cache_key_.footage != nullptr) {
+        decoded_frame = olive::frame_cache.GetFrameAt(cache_key_, target_pts);
+      }
 
-      // Some formats don't seek reliably to the last keyframe, as a result we need to seek in a loop to ensure we
-      // get a frame prior to the timestamp
-      do {
+      int seek_code = 0;
+      if (decoded_frame != nullptr) {
+        decoder_synced_ = false;
+      } else {
+        seek_code = SeekDecoder(target_pts, &decoded_frame, &seeked_to_zero);
+      }
 
-        // if we already allocated a frame here, we'd better free it
-        if (have_existing_frame_to_use) {
-          av_frame_free(&decoded_frame);
+      if (seek_code < 0) {
+        // the seek didn't produce a frame (an EOF isn't an error, the target is just past the end of the media)
+        if (seek_code != AVERROR_EOF) {
+          qCritical() << "Failed to seek decoder." << seek_code;
         }
-
-        // If we already seeked to a timestamp of zero, there's no further we can go, so we have to exit the loop if so
-        seeked_to_zero = (seek_ts == 0);
-
-        avcodec_flush_buffers(codecCtx);
-        av_seek_frame(formatCtx, clip->media_stream_index(), seek_ts, AVSEEK_FLAG_BACKWARD);
-
-        retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
-
-        //qDebug() << "Target:" << target_pts << "Seek:" << seek_ts << "Frame:" << decoded_frame->pts;
-
-        seek_ts = qMax(zero, seek_ts - second_pts);
-
+        av_frame_free(&decoded_frame);
+        seek_failed = true;
+      } else {
+        last_pts_ = decoded_frame->pts;
         have_existing_frame_to_use = true;
-      } while (retrieve_code >= 0 && decoded_frame->pts > target_pts && !seeked_to_zero);
+      }
 
       // also we assume none of the frames in the queue are usable
-      queue_.lock();
       queue_.clear();
-      queue_.unlock();
 
       // reset upcoming frame count and latest pts for later calculations
       frames_greater_than_target = 0;
@@ -637,7 +805,7 @@ void Cacher::CacheVideoWorker() {
     }
 
     // if we already have the maximum number of upcoming frames, don't bother running the retrieving any frames at all
-    bool start_loop = true;
+    bool start_loop = !seek_failed;
     if ((upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES && frames_greater_than_target >= maximum_ts)
         || (upcoming_queue_type == olive::FRAME_QUEUE_TYPE_SECONDS && latest_pts > maximum_ts)) {
       start_loop = false;
@@ -654,7 +822,7 @@ void Cacher::CacheVideoWorker() {
 
         // if we retrieved a perfectly good frame earlier by checking the seek, use that here
         if (!have_existing_frame_to_use) {
-          retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
+          retrieve_code = RetrieveNextFrame(&decoded_frame);
         } else {
           have_existing_frame_to_use = false;
         }
@@ -704,9 +872,7 @@ void Cacher::CacheVideoWorker() {
             }
 
             // add the frame to the queue
-            queue_.lock();
             queue_.append(decoded_frame);
-            queue_.unlock();
 
             // check the amount of previous frames in the queue by using the current queue size for if we need to
             // remove any old entries (assumes the queue is chronological)
@@ -719,23 +885,12 @@ void Cacher::CacheVideoWorker() {
                 previous_frame_count = queue_.size();
               } else {
                 // if this frame is after the target frame, clean up any previous frames before it
-                // TODO is there a faster way to do this?
-
-                for (int i=0;i<queue_.size();i++) {
-                  if (queue_.at(i)->pts > target_pts) {
-                    break;
-                  } else {
-                    previous_frame_count++;
-                  }
-                }
-
+                previous_frame_count = queue_.countUpTo(target_pts);
               }
 
               // remove frames while the amount of previous frames exceeds the maximum
               while (previous_frame_count > minimum_ts) {
-                queue_.lock();
                 queue_.removeFirst();
-                queue_.unlock();
                 previous_frame_count--;
               }
 
@@ -789,6 +944,18 @@ void Cacher::CacheVideoWorker() {
           break;
 
         }
+
+        // once the requested frame has been found, the rest of this cycle is only caching ahead, so let other clips
+        // that are waiting on a frame they need right now decode first and continue once it's our turn again
+        if (priority == DecodeScheduler::kPriorityVisible && retrieved_frame != nullptr) {
+          priority = CacheAheadPriority();
+        }
+        if (olive::decode_scheduler.ShouldYield(priority)) {
+          queued_ = true;
+          olive::decode_scheduler.Schedule(this, priority);
+          return;
+        }
+
       } while (!interrupt_);
 
     }
@@ -816,10 +983,25 @@ void Cacher::Reset() {
 
     const FootageStream* ms = clip->media_stream();
     if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+      // conformed audio is read straight from memory, so there's no need to seek at all
+      UpdateConformedAudio(false);
+      if (conformed_audio_ != nullptr) {
+        audio_target_frame = playhead_;
+        frame_sample_index_ = -1;
+        return;
+      }
+
       // flush ffmpeg codecs
       avcodec_flush_buffers(codecCtx);
       reached_end = false;
 
+      // discard audio from before the seek, picking up any change to the clip's speed since the last reset
+      stretcher_.Configure(kDestChannels,
+                           audio_sample_rate_,
+                           clip->speed().value * clip->media()->to_footage()->speed,
+                           clip->speed().maintain_audio_pitch);
+      stretcher_.Flush();
+
       // seek (target_frame represents timeline timecode in frames, not clip timecode)
 
       int64_t timestamp = qRound64(playhead_to_clip_seconds(clip, playhead_) / av_q2d(stream->time_base));
@@ -845,7 +1027,12 @@ void Cacher::SetRetrievedFrame(AVFrame *f)
 {
   if (retrieved_frame == nullptr) {
     retrieve_lock_.lock();
-    retrieved_frame = f;
+
+    // keep our own reference so the frame stays valid even if the queue removes it
+    if (f != nullptr) {
+      retrieved_frame = av_frame_clone(f);
+    }
+
     retrieve_wait_.wakeAll();
     retrieve_lock_.unlock();
   }
@@ -866,6 +1053,18 @@ Cacher::Cacher(Clip* c) :
   opts(nullptr),
   filter_graph(nullptr),
   codecCtx(nullptr),
+  filtered_frame_(nullptr),
+  sws_ctx_(nullptr),
+  codec_threads_(0),
+  worker_open_(false),
+  requested_audio_context_(nullptr),
+  audio_context_(nullptr),
+  requested_exporting_(false),
+  exporting_(false),
+  audio_sample_rate_(0),
+  audio_input_(nullptr),
+  use_conformed_audio_(false),
+  conformed_frame_(nullptr),
   is_valid_state_(false)
 {}
 
@@ -875,16 +1074,25 @@ void Cacher::OpenWorker() {
     audio_reset_ = false;
     frame_sample_index_ = -1;
     audio_buffer_write = 0;
+
+    // without a context there's nowhere to send audio, but the resampler still needs a valid rate
+    audio_sample_rate_ = (audio_context_ != nullptr) ? audio_context_->sample_rate() : olive::config.audio_rate;
   }
   reached_end = false;
 
+  cache_key_.footage = nullptr;
+  use_keyframe_index_ = false;
+  decoder_last_pts_ = AV_NOPTS_VALUE;
+  last_pts_ = AV_NOPTS_VALUE;
+  decoder_synced_ = true;
+
   if (clip->media() == nullptr) {
     if (clip->type() == olive::kTypeAudio) {
       frame_ = av_frame_alloc();
       frame_->format = kDestSampleFmt;
       frame_->channel_layout = clip->track()->sequence()->audio_layout();
       frame_->channels = av_get_channel_layout_nb_channels(frame_->channel_layout);
-      frame_->sample_rate = current_audio_freq();
+      frame_->sample_rate = audio_sample_rate_;
       frame_->nb_samples = 2048;
       av_frame_make_writable(frame_);
       if (av_frame_get_buffer(frame_, 0)) {
@@ -900,10 +1108,11 @@ void Cacher::OpenWorker() {
     QByteArray ba;
 
     // do we have a proxy?
-    if ((!olive::Global->is_exporting() || !olive::config.dont_use_proxies_on_export)
-        && m->proxy
-        && !m->proxy_path.isEmpty()
-        && QFileInfo::exists(m->proxy_path)) {
+    bool use_proxy = ((!exporting_ || !olive::config.dont_use_proxies_on_export)
+                      && m->proxy
+                      && !m->proxy_path.isEmpty()
+                      && QFileInfo::exists(m->proxy_path));
+    if (use_proxy) {
       ba = m->proxy_path.toUtf8();
     } else {
       ba = m->url.toUtf8();
@@ -912,6 +1121,24 @@ void Cacher::OpenWorker() {
     const char* filename = ba.constData();
     const FootageStream* ms = clip->media_stream();
 
+    // still images only decode one frame, so there's little benefit to sharing them
+    if (clip->type() == olive::kTypeVideo && !ms->infinite_length) {
+      cache_key_.footage = m;
+      cache_key_.stream = ms->file_index;
+      cache_key_.proxy = use_proxy;
+      cache_key_.interlacing = ms->video_interlacing;
+
+      // size the frame queue to fit the previous and upcoming frames set in the config (with some room for the frame
+      // that overshoots the upcoming limit and ends the cache cycle)
+      int previous_frames = (olive::config.previous_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) ?
+            qCeil(olive::config.previous_queue_size) : qCeil(olive::config.previous_queue_size * ms->video_frame_rate);
+      int upcoming_frames = (olive::config.upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) ?
+            qCeil(olive::config.upcoming_queue_size) : qCeil(olive::config.upcoming_queue_size * ms->video_frame_rate);
+      queue_.SetCapacity(previous_frames + upcoming_frames + 8);
+
+      use_keyframe_index_ = (!use_proxy && !ms->keyframe_index.isEmpty());
+    }
+
     // for image sequences that don't start at 0, set the index where it does start
     AVDictionary* format_opts = nullptr;
     if (m->start_number > 0) {
@@ -929,7 +1156,9 @@ void Cacher::OpenWorker() {
       char err[1024];
       av_strerror(errCode, err, 1024);
       qCritical() << "Could not open" << filename << "-" << err;
-      olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
+      if (olive::MainWindow != nullptr) {
+        olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
+      }
       return;
     }
 
@@ -938,7 +1167,9 @@ void Cacher::OpenWorker() {
       char err[1024];
       av_strerror(errCode, err, 1024);
       qCritical() << "Could not open" << filename << "-" << err;
-      olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
+      if (olive::MainWindow != nullptr) {
+        olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
+      }
       return;
     }
 
@@ -946,23 +1177,14 @@ void Cacher::OpenWorker() {
 
     stream = formatCtx->streams[ms->file_index];
     codec = avcodec_find_decoder(stream->codecpar->codec_id);
-    codecCtx = avcodec_alloc_context3(codec);
-    avcodec_parameters_to_context(codecCtx, stream->codecpar);
-
-    opts = nullptr;
-
-    // enable multithreading on decoding
-    av_dict_set(&opts, "threads", "auto", 0);
-
-    // enable extra optimization code on h264 (not even sure if they help)
-    if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
-      av_dict_set(&opts, "tune", "fastdecode", 0);
-      av_dict_set(&opts, "tune", "zerolatency", 0);
-    }
 
-    // Open codec
-    if (avcodec_open2(codecCtx, codec, &opts) < 0) {
-      qCritical() << "Could not open codec";
+    // enable multithreading on decoding, limited to this decoder's share of the global codec thread budget (still
+    // images and audio barely benefit from codec threads, so they only decode in the cacher's own thread)
+    if (clip->type() == olive::kTypeVideo && !ms->infinite_length) {
+      codec_threads_ = olive::decode_scheduler.RegisterDecoder();
+      OpenCodec(codec_threads_);
+    } else {
+      OpenCodec(1);
     }
 
     // allocate filtergraph
@@ -1018,17 +1240,18 @@ void Cacher::OpenWorker() {
         media_pixel_format_ = olive::PIX_FMT_RGBA16;
       }
 
-      const char* chosen_format = av_get_pix_fmt_name(pix_fmt);
-      snprintf(filter_args, sizeof(filter_args), "pix_fmts=%s", chosen_format);
+      cache_key_.pixel_format = pix_fmt;
 
-      AVFilterContext* format_conv;
-      avfilter_graph_create_filter(&format_conv, avfilter_get_by_name("format"), "fmt", filter_args, nullptr, filter_graph);
-      avfilter_link(last_filter, 0, format_conv, 0);
+      // the conversion to RGBA is done by RetrieveFrameAndProcess() into frames from the shared FramePool rather than
+      // by a format filter, so the converted frames' memory can be reused
+      output_pix_fmt_ = pix_fmt;
 
-      avfilter_link(format_conv, 0, buffersink_ctx, 0);
+      avfilter_link(last_filter, 0, buffersink_ctx, 0);
 
       avfilter_graph_config(filter_graph, nullptr);
 
+      filtered_frame_ = av_frame_alloc();
+
     } else if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
       if (codecCtx->channel_layout == 0) codecCtx->channel_layout = av_get_default_channel_layout(stream->codecpar->channels);
 
@@ -1039,7 +1262,7 @@ void Cacher::OpenWorker() {
         AVFrame* reverse_frame = av_frame_alloc();
 
         reverse_frame->format = kDestSampleFmt;
-        reverse_frame->nb_samples = current_audio_freq()*10;
+        reverse_frame->nb_samples = audio_sample_rate_*10;
         reverse_frame->channel_layout = clip->track()->sequence()->audio_layout();
         reverse_frame->channels = av_get_channel_layout_nb_channels(clip->track()->sequence()->audio_layout());
         av_frame_get_buffer(reverse_frame, 0);
@@ -1068,46 +1291,19 @@ void Cacher::OpenWorker() {
         qCritical() << "Could not set output sample format";
       }
 
-      int target_sample_rate = current_audio_freq();
-
-      double playback_speed_ = clip->speed().value * m->speed;
-
-      if (qFuzzyCompare(playback_speed_, 1.0)) {
-        avfilter_link(buffersrc_ctx, 0, buffersink_ctx, 0);
-      } else if (clip->speed().maintain_audio_pitch) {
-        AVFilterContext* previous_filter = buffersrc_ctx;
-        AVFilterContext* last_filter = buffersrc_ctx;
-
-        char speed_param[10];
+      // the filter stack only converts the audio to the sequence's format, speed changes are applied afterwards by
+      // stretcher_ so they never require reconfiguring the filter stack
+      avfilter_link(buffersrc_ctx, 0, buffersink_ctx, 0);
 
-        double base = (playback_speed_ > 1.0) ? 2.0 : 0.5;
+      stretcher_.Configure(kDestChannels,
+                           audio_sample_rate_,
+                           clip->speed().value * m->speed,
+                           clip->speed().maintain_audio_pitch);
+      stretcher_.Flush();
 
-        double speedlog = log(playback_speed_) / log(base);
-        int whole2 = qFloor(speedlog);
-        speedlog -= whole2;
+      filtered_frame_ = av_frame_alloc();
 
-        if (whole2 > 0) {
-          snprintf(speed_param, sizeof(speed_param), "%f", base);
-          for (int i=0;i<whole2;i++) {
-            AVFilterContext* tempo_filter = nullptr;
-            avfilter_graph_create_filter(&tempo_filter, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, filter_graph);
-            avfilter_link(previous_filter, 0, tempo_filter, 0);
-            previous_filter = tempo_filter;
-          }
-        }
-
-        snprintf(speed_param, sizeof(speed_param), "%f", qPow(base, speedlog));
-        last_filter = nullptr;
-        avfilter_graph_create_filter(&last_filter, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, filter_graph);
-        avfilter_link(previous_filter, 0, last_filter, 0);
-
-        avfilter_link(last_filter, 0, buffersink_ctx, 0);
-      } else {
-        target_sample_rate = qRound64(target_sample_rate / playback_speed_);
-        avfilter_link(buffersrc_ctx, 0, buffersink_ctx, 0);
-      }
-
-      int sample_rates[] = { target_sample_rate, 0 };
+      int sample_rates[] = { audio_sample_rate_, 0 };
       if (av_opt_set_int_list(buffersink_ctx, "sample_rates", sample_rates, 0, AV_OPT_SEARCH_CHILDREN) < 0) {
         qCritical() << "Could not set output sample rates";
       }
@@ -1121,11 +1317,50 @@ void Cacher::OpenWorker() {
     frame_ = av_frame_alloc();
   }
 
+  // read footage audio from its conformed copy if possible. Pitch-corrected speed changes still need the stretcher.
+  if (clip->type() == olive::kTypeAudio && audio_context_ != nullptr
+      && clip->media() != nullptr && clip->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+    double speed = clip->speed().value * clip->media()->to_footage()->speed;
+    use_conformed_audio_ = (qFuzzyCompare(speed, 1.0) || !clip->speed().maintain_audio_pitch);
+
+    // synchronous consumers (i.e. exporting) would rather wait for the audio to conform than decode it in real time
+    UpdateConformedAudio(audio_context_->synchronous());
+  }
+
+  // only add an input once the clip has opened successfully, otherwise synchronous consumers would wait on it forever
+  if (clip->type() == olive::kTypeAudio && audio_context_ != nullptr) {
+    audio_input_ = audio_context_->mixer()->AddInput();
+    if (audio_input_ == nullptr) {
+      qWarning() << "Too many audio clips are open, this clip will not be heard";
+    }
+  }
+
   qInfo() << "Clip opened on track" << clip->track();
 
   is_valid_state_ = true;
 }
 
+void Cacher::OpenCodec(int threads)
+{
+  codecCtx = avcodec_alloc_context3(codec);
+  avcodec_parameters_to_context(codecCtx, stream->codecpar);
+
+  av_dict_free(&opts);
+
+  av_dict_set(&opts, "threads", QString::number(threads).toUtf8(), 0);
+
+  // enable extra optimization code on h264 (not even sure if they help)
+  if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
+    av_dict_set(&opts, "tune", "fastdecode", 0);
+    av_dict_set(&opts, "tune", "zerolatency", 0);
+  }
+
+  // Open codec
+  if (avcodec_open2(codecCtx, codec, &opts) < 0) {
+    qCritical() << "Could not open codec";
+  }
+}
+
 void Cacher::CacheWorker() {
   if (clip->type() == olive::kTypeVideo) {
     // clip is a video track, start caching video
@@ -1137,16 +1372,36 @@ void Cacher::CacheWorker() {
 }
 
 void Cacher::CloseWorker() {
-  retrieved_frame = nullptr;
-  queue_.lock();
+  retrieve_lock_.lock();
+  av_frame_free(&retrieved_frame);
+  retrieve_lock_.unlock();
+
   queue_.clear();
-  queue_.unlock();
+
+  if (audio_input_ != nullptr) {
+    audio_context_->mixer()->RemoveInput(audio_input_);
+    audio_input_ = nullptr;
+  }
+  audio_block_.clear();
+
+  use_conformed_audio_ = false;
+  conformed_audio_ = nullptr;
+  av_frame_free(&conformed_frame_);
 
   if (frame_ != nullptr) {
     av_frame_free(&frame_);
     frame_ = nullptr;
   }
 
+  if (filtered_frame_ != nullptr) {
+    av_frame_free(&filtered_frame_);
+  }
+
+  if (sws_ctx_ != nullptr) {
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = nullptr;
+  }
+
   if (pkt != nullptr) {
     av_packet_free(&pkt);
     pkt = nullptr;
@@ -1164,6 +1419,11 @@ void Cacher::CloseWorker() {
       codecCtx = nullptr;
     }
 
+    if (codec_threads_ > 0) {
+      olive::decode_scheduler.UnregisterDecoder(codec_threads_);
+      codec_threads_ = 0;
+    }
+
     if (opts != nullptr) {
       av_dict_free(&opts);
     }
@@ -1176,6 +1436,10 @@ void Cacher::CloseWorker() {
     }
   }
 
+  if (clip->type() == olive::kTypeVideo) {
+    qInfo() << "Frame pool:" << olive::frame_pool.hits() << "hits," << olive::frame_pool.misses() << "misses";
+  }
+
   qInfo() << "Clip closed on track" << clip->track();
 }
 
@@ -1210,15 +1474,68 @@ void Cacher::run() {
   clip->cache_lock.unlock();
 }
 
+void Cacher::RunDecodeJob(DecodeScheduler::Priority)
+{
+  clip->cache_lock.lock();
+
+  if (!worker_open_) {
+    OpenWorker();
+    worker_open_ = true;
+
+    clip->state_change_lock.unlock();
+  }
+
+  if (!caching_) {
+
+    is_valid_state_ = false;
+
+    CloseWorker();
+    worker_open_ = false;
+
+    clip->state_change_lock.unlock();
+
+  } else if (queued_) {
+
+    queued_ = false;
+
+    if (is_valid_state_) {
+      CacheWorker();
+    } else {
+      // main thread waits until cacher starts fully, but the cacher can't run, so we just wake it up here
+      WakeMainThread();
+    }
+
+  }
+
+  clip->cache_lock.unlock();
+}
+
 void Cacher::Open()
 {
-  wait();
+  // wait for the last session to finish closing
+  if (clip->type() == olive::kTypeVideo) {
+    olive::decode_scheduler.Wait(this);
+  } else {
+    wait();
+  }
+
+  // nothing is running, so it's safe to switch contexts now
+  audio_context_ = requested_audio_context_;
+  exporting_ = requested_exporting_;
 
   // set variable defaults for caching
   caching_ = true;
   queued_ = false;
+  preroll_ = false;
 
-  start((clip->type() == olive::kTypeVideo) ? QThread::HighPriority : QThread::TimeCriticalPriority);
+  if (clip->type() == olive::kTypeVideo) {
+    // video is decoded on the DecodeScheduler's worker pool, so it doesn't need a thread of its own
+    worker_open_ = false;
+    olive::decode_scheduler.Schedule(this, DecodeScheduler::kPriorityVisible);
+  } else {
+    // audio still needs its own thread with an elevated priority to keep the output buffer filled
+    start(QThread::TimeCriticalPriority);
+  }
 }
 
 void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playback_speed)
@@ -1231,7 +1548,11 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   if (clip->media_stream() != nullptr
       && queue_.size() > 0
       && clip->media_stream()->infinite_length) {
-    retrieved_frame = queue_.at(0);
+    retrieve_lock_.lock();
+    if (retrieved_frame == nullptr) {
+      retrieved_frame = queue_.CloneFirst();
+    }
+    retrieve_lock_.unlock();
     return;
   }
 
@@ -1239,35 +1560,21 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   nests_ = nests;
   scrubbing_ = scrubbing;
   playback_speed_ = playback_speed;
+  preroll_ = false;
   queued_ = true;
 
   bool wait_for_cacher_to_respond = true;
 
   if (clip->media() != nullptr) {
-    // see if we already have this frame
+    // see if we already have this frame (either with the exact timestamp or a close timestamp that we'll assume is
+    // different due to a rounding error)
     retrieve_lock_.lock();
-    queue_.lock();
-    retrieved_frame = nullptr;
+    av_frame_free(&retrieved_frame);
     int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
-    for (int i=0;i<queue_.size();i++) {
-
-      if (queue_.at(i)->pts == target_pts) {
-
-        // the queue has a frame with the exact timestamp
-
-        retrieved_frame = queue_.at(i);
-        wait_for_cacher_to_respond = false;
-        break;
-      } else if (i > 0 && queue_.at(i-1)->pts < target_pts && queue_.at(i)->pts > target_pts) {
-
-        // the queue has a frame with a close timestamp that we'll assume is different due to a rounding error
-
-        retrieved_frame = queue_.at(i-1);
-        wait_for_cacher_to_respond = false;
-        break;
-      }
+    retrieved_frame = queue_.CloneFrameAt(target_pts);
+    if (retrieved_frame != nullptr) {
+      wait_for_cacher_to_respond = false;
     }
-    queue_.unlock();
     retrieve_lock_.unlock();
   }
 
@@ -1276,7 +1583,11 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   }
 
   // wake up cacher
-  wait_cond_.wakeAll();
+  if (clip->type() == olive::kTypeVideo) {
+    olive::decode_scheduler.Schedule(this, wait_for_cacher_to_respond ? DecodeScheduler::kPriorityVisible : CacheAheadPriority());
+  } else {
+    wait_cond_.wakeAll();
+  }
 
   // if not, wait for cacher to respond
   if (wait_for_cacher_to_respond) {
@@ -1305,11 +1616,10 @@ AVFrame *Cacher::Retrieve()
     // wait for cacher to finish caching
 
 
-    if (clip->cache_lock.tryLock()) {
+    if (!olive::decode_scheduler.IsScheduled(this)) {
 
-      // If the queue could lock, the cacher isn't running which means no frame is coming. This is an error.
+      // If no job is queued or running, no frame is coming. This is an error.
       qCritical() << "Cacher frame was null while the cacher wasn't running on clip" << clip->name();
-      clip->cache_lock.unlock();
 
     } else {
 
@@ -1320,31 +1630,82 @@ AVFrame *Cacher::Retrieve()
 
   }
 
+  // give the caller its own reference so it can use the frame without worrying about the cacher freeing it
+  AVFrame* frame = nullptr;
+  if (retrieved_frame != nullptr) {
+    frame = av_frame_clone(retrieved_frame);
+  }
+
   retrieve_lock_.unlock();
 
-  return retrieved_frame;
+  return frame;
+}
+
+void Cacher::Preroll(long playhead, QVector<Clip *> &nests, int playback_speed)
+{
+  if (!is_valid_state_
+      || clip->type() != olive::kTypeVideo
+      || (preroll_ && playhead_ == playhead && playback_speed_ == playback_speed)) {
+    return;
+  }
+
+  playhead_ = playhead;
+  nests_ = nests;
+  scrubbing_ = false;
+  playback_speed_ = playback_speed;
+  preroll_ = true;
+  queued_ = true;
+
+  // wake up cacher, but unlike Cache() nothing is waiting on this frame yet so we don't wait for a response
+  olive::decode_scheduler.Schedule(this, CacheAheadPriority());
 }
 
 void Cacher::Close(bool wait_for_finish)
 {
   caching_ = false;
-  wait_cond_.wakeAll();
 
-  if (wait_for_finish) {
-    wait();
+  if (clip->type() == olive::kTypeVideo) {
+    // stop the current cache cycle so the worker gets to closing sooner
+    interrupt_ = true;
+    olive::decode_scheduler.Schedule(this, DecodeScheduler::kPriorityVisible);
+
+    if (wait_for_finish) {
+      olive::decode_scheduler.Wait(this);
+    }
+  } else {
+    wait_cond_.wakeAll();
+
+    if (wait_for_finish) {
+      wait();
+    }
   }
 }
 
 void Cacher::ResetAudio()
 {
-  // using audio_write_lock seems like a good idea, but hasn't been tested yet. If there are audio issues when seeking,
-  // try uncommenting them
-
-//  audio_write_lock.lock();
   audio_reset_ = true;
   frame_sample_index_ = -1;
   audio_buffer_write = 0;
-//  audio_write_lock.unlock();
+}
+
+void Cacher::SetAudioContext(AudioRenderContext *context)
+{
+  requested_audio_context_ = context;
+}
+
+AudioRenderContext *Cacher::audio_context()
+{
+  return audio_context_;
+}
+
+void Cacher::SetExporting(bool exporting)
+{
+  requested_exporting_ = exporting;
+}
+
+bool Cacher::exporting()
+{
+  return exporting_;
 }
 
 int Cacher::media_width()
@@ -1417,13 +1778,13 @@ int Cacher::RetrieveFrameFromDecoder(AVFrame* f) {
 int Cacher::RetrieveFrameAndProcess(AVFrame **f)
 {
   // error codes from FFmpeg
-  int retrieve_code, read_code, send_code;
+  int retrieve_code, read_code = 0, send_code;
 
-  // frame for FFmpeg to decode into
-  *f = av_frame_alloc();
+  *f = nullptr;
 
   // loop to pull frames from the AVFilter stack
-  while ((retrieve_code = av_buffersink_get_frame(buffersink_ctx, *f)) == AVERROR(EAGAIN)) {
+  av_frame_unref(filtered_frame_);
+  while ((retrieve_code = av_buffersink_get_frame(buffersink_ctx, filtered_frame_)) == AVERROR(EAGAIN)) {
 
     // retrieve frame from decoder
     read_code = RetrieveFrameFromDecoder(frame_);
@@ -1452,8 +1813,194 @@ int Cacher::RetrieveFrameAndProcess(AVFrame **f)
     }
   }
 
+  if (retrieve_code >= 0) {
+    // convert the filtered frame to RGBA into a frame from the shared pool
+    *f = olive::frame_pool.Get(filtered_frame_->width, filtered_frame_->height, output_pix_fmt_);
+
+    if (*f == nullptr) {
+      qCritical() << "Failed to retrieve frame from frame pool";
+      retrieve_code = AVERROR(ENOMEM);
+    } else {
+      sws_ctx_ = sws_getCachedContext(sws_ctx_,
+                                      filtered_frame_->width,
+                                      filtered_frame_->height,
+                                      static_cast<AVPixelFormat>(filtered_frame_->format),
+                                      filtered_frame_->width,
+                                      filtered_frame_->height,
+                                      output_pix_fmt_,
+                                      SWS_BILINEAR,
+                                      nullptr,
+                                      nullptr,
+                                      nullptr);
+
+      sws_scale(sws_ctx_,
+                filtered_frame_->data,
+                filtered_frame_->linesize,
+                0,
+                filtered_frame_->height,
+                (*f)->data,
+                (*f)->linesize);
+
+      av_frame_copy_props(*f, filtered_frame_);
+    }
+
+    av_frame_unref(filtered_frame_);
+  }
+
+  // callers expect a valid (if empty) frame even if we couldn't retrieve one
+  if (retrieve_code < 0 || read_code == AVERROR_EOF) {
+    if (*f == nullptr) {
+      *f = av_frame_alloc();
+    }
+  }
+
   if (read_code == AVERROR_EOF) {
     return AVERROR_EOF;
   }
+
+  // share this frame with any other clips using the same footage
+  if (retrieve_code >= 0 && cache_key_.footage != nullptr && (*f)->pts != AV_NOPTS_VALUE) {
+    olive::frame_cache.Insert(cache_key_, *f, decoder_last_pts_);
+    decoder_last_pts_ = (*f)->pts;
+  }
+
+  return retrieve_code;
+}
+
+int Cacher::RetrieveAudioFrame(AVFrame *f)
+{
+  if (stretcher_.IsPassthrough()) {
+    return av_buffersink_get_frame(buffersink_ctx, f);
+  }
+
+  // feed the stretcher until it has a full block ready
+  while (stretcher_.available() < kStretchBlockSize) {
+    int ret = av_buffersink_get_frame(buffersink_ctx, filtered_frame_);
+
+    if (ret < 0) {
+      // the filter stack has ended, return whatever's left in the stretcher
+      if (stretcher_.available() > 0 && ret == AVERROR_EOF) {
+        break;
+      }
+      return ret;
+    }
+
+    stretcher_.Push(reinterpret_cast<const float* const*>(filtered_frame_->data), filtered_frame_->nb_samples);
+    av_frame_unref(filtered_frame_);
+  }
+
+  f->format = kDestSampleFmt;
+  f->channel_layout = AV_CH_LAYOUT_STEREO;
+  f->channels = kDestChannels;
+  f->sample_rate = audio_sample_rate_;
+  f->nb_samples = qMin(stretcher_.available(), kStretchBlockSize);
+
+  int ret = av_frame_get_buffer(f, 0);
+  if (ret < 0) {
+    qCritical() << "Could not allocate buffer for time stretched audio" << ret;
+    return ret;
+  }
+
+  stretcher_.Pull(reinterpret_cast<float**>(f->data), f->nb_samples);
+
+  return 0;
+}
+
+int Cacher::SeekDecoder(int64_t target_pts, AVFrame **f, bool *seeked_to_zero)
+{
+  int retrieve_code;
+  int64_t seek_ts = target_pts;
+  int64_t zero = 0;
+  bool has_frame = false;
+  bool at_zero;
+
+  // if we know where the keyframes are, jump straight to the right one
+  if (use_keyframe_index_) {
+    int64_t keyframe = clip->media_stream()->get_keyframe_before(target_pts);
+    if (keyframe != AV_NOPTS_VALUE) {
+      seek_ts = qMax(zero, keyframe);
+    }
+  }
+
+  // get the value of one second in terms of the media's timebase
+  int64_t second_pts = seconds_to_timestamp(clip, 1);
+
+  // Some formats don't seek reliably to the last keyframe, as a result we need to seek in a loop to ensure we
+  // get a frame prior to the timestamp (with a keyframe index, this should only ever take one iteration)
+  do {
+
+    // if we already allocated a frame here, we'd better free it
+    if (has_frame) {
+      av_frame_free(f);
+    }
+
+    // If we already seeked to a timestamp of zero, there's no further we can go, so we have to exit the loop if so
+    at_zero = (seek_ts == 0);
+
+    avcodec_flush_buffers(codecCtx);
+    av_seek_frame(formatCtx, clip->media_stream_index(), seek_ts, AVSEEK_FLAG_BACKWARD);
+
+    // the next decoded frame won't follow the last one, so don't link them in the shared frame cache
+    decoder_last_pts_ = AV_NOPTS_VALUE;
+
+    retrieve_code = RetrieveFrameAndProcess(f);
+
+    seek_ts = qMax(zero, seek_ts - second_pts);
+
+    has_frame = true;
+  } while (retrieve_code >= 0 && (*f)->pts > target_pts && !at_zero);
+
+  decoder_synced_ = true;
+
+  if (seeked_to_zero != nullptr) {
+    *seeked_to_zero = at_zero;
+  }
+
+  return retrieve_code;
+}
+
+int Cacher::RetrieveNextFrame(AVFrame **f)
+{
+  int retrieve_code;
+
+  if (last_pts_ != AV_NOPTS_VALUE) {
+
+    // check if another clip has already decoded the next frame
+    if (cache_key_.footage != nullptr) {
+      AVFrame* shared_frame = olive::frame_cache.GetNext(cache_key_, last_pts_);
+
+      if (shared_frame != nullptr) {
+        *f = shared_frame;
+        last_pts_ = shared_frame->pts;
+        decoder_synced_ = false;
+        return 0;
+      }
+    }
+
+    // if we used frames from the shared cache, the decoder is behind and needs to catch up to last_pts_
+    if (!decoder_synced_) {
+      retrieve_code = SeekDecoder(last_pts_, f, nullptr);
+
+      while (retrieve_code >= 0
+             && (*f)->pts != AV_NOPTS_VALUE
+             && (*f)->pts <= last_pts_) {
+        av_frame_free(f);
+        retrieve_code = RetrieveFrameAndProcess(f);
+      }
+
+      if (retrieve_code >= 0 && (*f)->pts != AV_NOPTS_VALUE) {
+        last_pts_ = (*f)->pts;
+      }
+
+      return retrieve_code;
+    }
+  }
+
+  retrieve_code = RetrieveFrameAndProcess(f);
+
+  if (retrieve_code >= 0 && (*f)->pts != AV_NOPTS_VALUE) {
+    last_pts_ = (*f)->pts;
+  }
+
   return retrieve_code;
 }
@@ -42,11 +42,48 @@ extern "C" {
 #include <QWaitCondition>
 #include <QMutex>
 
+#include "rendering/audiorendercontext.h"
+#include "rendering/audiostretcher.h"
 #include "rendering/clipqueue.h"
+#include "rendering/conformedaudio.h"
+#include "rendering/decodescheduler.h"
+#include "rendering/framecache.h"
 #include "rendering/pixelformats.h"
 
 class Clip;
 
+/**
+ * @brief Run a block of audio through a Clip's effects and transitions
+ *
+ * After the Clip's own effects, the block is passed through the effects of every nested sequence Clip it's inside of,
+ * from the innermost outwards.
+ *
+ * @param clip
+ *
+ * Clip the audio belongs to
+ *
+ * @param timecode_start
+ *
+ * Clip time (in seconds) of the first sample in the block
+ *
+ * @param frame
+ *
+ * Planar float frame containing the audio. Processed in place.
+ *
+ * @param nb_samples
+ *
+ * Amount of samples per channel in the block
+ *
+ * @param nb_channels
+ *
+ * Amount of channels in the block
+ *
+ * @param nests
+ *
+ * Nested sequence Clips that `clip` is inside of, outermost first
+ */
+void apply_audio_effects(Clip* clip, double timecode_start, AVFrame* frame, int nb_samples, int nb_channels, QVector<Clip*> nests);
+
 /**
  * @brief The Cacher class
  *
@@ -58,6 +95,10 @@ class Clip;
  * RGBA/S16LE for the rest of the workflow (using libavfilter/libswscale/libswresample), and memory handling routines
  * for keeping the cache within limits defined by the user (see Config::upcoming_queue_type).
  *
+ * Video clips don't keep a thread of their own. Their work is run as a DecodeJob on the DecodeScheduler's worker pool,
+ * so that the amount of clips decoding at once is limited and the most urgent frames are decoded first. Audio clips
+ * still run in their own high priority thread to keep the output buffer filled.
+ *
  * Generally the Cacher workflow starts by calling Open() which will start the thread, open a file handle, and create a
  * decoding instance. Open() is usually called directly from the parent Clip's Clip::Open() and thus expects the
  * Clip::state_change_lock to be locked. It will unlock it when it's finished opening and is ready to start caching,
@@ -81,8 +122,8 @@ class Clip;
  * **For audio:**
  *
  * After the Cacher has finished opening, calling Cache() will handle most of the work. It will decode the audio,
- * convert to the correct sample rate and format, reverse or adjust speed if necessary, and send it to the audio
- * buffer ready to be played by the output device. It is important to continually call Cache() as it doesn't get
+ * convert to the correct sample rate and format, reverse or adjust speed if necessary, and send it to the
+ * AudioMixer of its AudioRenderContext ready to be played by the output device (or mixed by the exporter). It is important to continually call Cache() as it doesn't get
  * signalled when more samples are available in the audio buffer. Instead, it'll check every time it's called and
  * fill as much of the buffer as it can.
  *
@@ -98,7 +139,7 @@ class Clip;
  *
  * Cacher expects to be multithreaded and all of its public functions are thread-safe.
  */
-class Cacher : public QThread
+class Cacher : public QThread, public DecodeJob
 {
   Q_OBJECT
 public:
@@ -114,8 +155,8 @@ public:
   /**
    * @brief The main QThread loop
    *
-   * Once the thread has started, all Cacher functions will be called from here until the Cacher closes at which point
-   * it will close and exit gracefully.
+   * Only used by audio clips. Once the thread has started, all Cacher functions will be called from here until the
+   * Cacher closes at which point it will close and exit gracefully.
    */
   void run();
 
@@ -174,11 +215,35 @@ public:
    *
    * @return
    *
-   * The frame requested by Cache(), or `nullptr` if there was an error (e.g. the cacher wasn't running and no frame was
-   * available).
+   * A new reference to the frame requested by Cache() that the caller must free with av_frame_free(), or `nullptr`
+   * if there was an error (e.g. the cacher wasn't running and no frame was available).
    */
   AVFrame* Retrieve();
 
+  /**
+   * @brief Start caching a clip that isn't active yet in the background
+   *
+   * Used to get an upcoming clip ready before the playhead reaches it. Like Cache(), this signals the cacher to seek to
+   * and cache frames from the given playhead, but it never waits for the cacher to respond and the decoding runs at
+   * the DecodeScheduler's lookahead/prefetch priority rather than taking precedence over clips that are currently
+   * visible. Calling it again with the same playhead does nothing.
+   *
+   * Only used for video, and does nothing if the cacher hasn't finished opening yet.
+   *
+   * @param playhead
+   *
+   * The Timeline position in frames to start caching from (usually the clip's in point)
+   *
+   * @param nests
+   *
+   * A hierarchy of nested sequences, if the playback traversed any to get to this clip.
+   *
+   * @param playback_speed
+   *
+   * The current playback speed (controlled by Shuttle Left/Stop/Right)
+   */
+  void Preroll(long playhead, QVector<Clip*>& nests, int playback_speed);
+
   /**
    * @brief Close the cacher and free any allocated memory
    *
@@ -203,6 +268,32 @@ public:
    */
   void ResetAudio();
 
+  /**
+   * @brief Set the context to render audio into
+   *
+   * Only for audio clips. Takes effect the next time the Cacher is opened, since the Cacher's resampler is set up for
+   * the context's sample rate when opening.
+   */
+  void SetAudioContext(AudioRenderContext* context);
+
+  /**
+   * @brief Returns the context the Cacher was last opened for
+   */
+  AudioRenderContext* audio_context();
+
+  /**
+   * @brief Set whether the Cacher is opened for an export rather than playback
+   *
+   * Exporting Cachers only use proxies if Config::dont_use_proxies_on_export is off. Like SetAudioContext(), this
+   * takes effect the next time the Cacher is opened.
+   */
+  void SetExporting(bool exporting);
+
+  /**
+   * @brief Returns whether the Cacher was last opened for an export
+   */
+  bool exporting();
+
   /**
    * @brief Retrieve current media width
    *
@@ -264,6 +355,15 @@ public:
    */
   const olive::PixelFormat& media_pixel_format();
 
+protected:
+  /**
+   * @brief Run one cycle of a video Cacher on the DecodeScheduler's worker pool
+   *
+   * The pool equivalent of one iteration of run(): opens the Cacher if it hasn't opened yet, then either caches
+   * frames if Cache() or Preroll() queued a cycle, or closes the Cacher if Close() was called.
+   */
+  virtual void RunDecodeJob(DecodeScheduler::Priority priority) override;
+
 private:
   /**
    * @brief Reference to the parent clip. Set in the constructor and never changed during this object's lifetime.
@@ -361,6 +461,11 @@ private:
    */
   bool interrupt_;
 
+  /**
+   * @brief Set by Preroll() and cleared by Cache(), used to tell whether anyone is waiting on the current cache cycle
+   */
+  bool preroll_;
+
   // ffmpeg media handling
   /**
    * @brief FFmpeg format/file context - used for media decoding
@@ -393,8 +498,8 @@ private:
   /**
    * @brief Retrieved frame reference for Retrieve()
    *
-   * If a frame was found by either Cache() or CacheVideoWorker(), it's set here. If no frame is ready yet, this is set
-   * to `nullptr`.
+   * If a frame was found by either Cache() or CacheVideoWorker(), a reference to it is set here (owned by the Cacher
+   * and protected by retrieve_lock_). If no frame is ready yet, this is set to `nullptr`.
    */
   AVFrame* retrieved_frame = nullptr;
 
@@ -402,9 +507,9 @@ private:
   /**
    * @brief FFmpeg filter stack
    *
-   * Used for conversion from the media's pixel format to RGBA for OpenGL. Also any other FFmpeg filters are implemented
-   * here if necessary (e.g. yadif for deinterlacing). GLSL effects are preferred when available since FFmpeg filters
-   * aren't always fast enough for realtime playback.
+   * Used for audio conversion and any FFmpeg video filters if necessary (e.g. yadif for deinterlacing). Video
+   * conversion to RGBA is done separately with sws_ctx_ so the output frames can come from the shared FramePool. GLSL
+   * effects are preferred when available since FFmpeg filters aren't always fast enough for realtime playback.
    */
   AVFilterGraph* filter_graph;
 
@@ -422,6 +527,21 @@ private:
    */
   AVFilterContext* buffersink_ctx;
 
+  /**
+   * @brief Frame retrieved from the filter stack before it's converted into a frame from the FramePool
+   */
+  AVFrame* filtered_frame_;
+
+  /**
+   * @brief Pixel format conversion context used to convert filtered frames to RGBA
+   */
+  SwsContext* sws_ctx_;
+
+  /**
+   * @brief The RGBA pixel format frames are converted to (determined by the media's bit depth)
+   */
+  AVPixelFormat output_pix_fmt_;
+
   /**
    * @brief FFmpeg codec reference
    */
@@ -432,6 +552,16 @@ private:
    */
   AVDictionary* opts;
 
+  /**
+   * @brief Codec threads this Cacher's decoder was given by the DecodeScheduler, or 0 if it isn't registered with it
+   */
+  int codec_threads_;
+
+  /**
+   * @brief Whether OpenWorker() has run for the current session of a video Cacher (see RunDecodeJob())
+   */
+  bool worker_open_;
+
   // audio playback variables
   /**
    * @brief Internal audio reset variable
@@ -462,6 +592,64 @@ private:
    */
   qint64 audio_buffer_write;
 
+  /**
+   * @brief Context set with SetAudioContext() that the next Open() will render audio into
+   */
+  AudioRenderContext* requested_audio_context_;
+
+  /**
+   * @brief Context this Cacher renders audio into. Only changed in Open() while the thread isn't running.
+   */
+  AudioRenderContext* audio_context_;
+
+  /**
+   * @brief Value set with SetExporting() that the next Open() will use
+   */
+  bool requested_exporting_;
+
+  /**
+   * @brief Whether this Cacher was opened for an export. Only changed in Open() while the Cacher isn't running.
+   */
+  bool exporting_;
+
+  /**
+   * @brief Sample rate of `audio_context_` at the time the Cacher was opened
+   */
+  int audio_sample_rate_;
+
+  /**
+   * @brief This clip's input into the context's AudioMixer, added in OpenWorker() and removed in CloseWorker()
+   */
+  AudioMixerInput* audio_input_;
+
+  /**
+   * @brief Reusable buffer that CacheAudioWorker() interleaves samples into before writing them to `audio_input_`
+   */
+  QVector<float> audio_block_;
+
+  /**
+   * @brief Applies the clip's speed to decoded audio (see RetrieveAudioFrame())
+   *
+   * Kept for as long as the Cacher is open and flushed by Reset() when seeking, so seeking never needs to rebuild
+   * `filter_graph`.
+   */
+  AudioStretcher stretcher_;
+
+  /**
+   * @brief **TRUE** if this clip's audio can be read from a ConformedAudio (i.e. footage without pitch correction)
+   */
+  bool use_conformed_audio_;
+
+  /**
+   * @brief This clip's footage audio conformed to `audio_sample_rate_`, or `nullptr` if it isn't ready
+   */
+  ConformedAudioPtr conformed_audio_;
+
+  /**
+   * @brief Planar frame that CacheConformedAudio() reads samples into before applying effects
+   */
+  AVFrame* conformed_frame_;
+
   /**
    * @brief Internal variable that holds the playhead the last time the audio state was reset
    */
@@ -482,6 +670,44 @@ private:
    */
   bool is_valid_state_;
 
+  /**
+   * @brief Key identifying this Cacher's decoded frames in the shared FrameCache
+   *
+   * Set by OpenWorker(). FrameCacheKey::footage is `nullptr` if this Cacher's frames shouldn't be shared (e.g. audio or
+   * still images).
+   */
+  FrameCacheKey cache_key_;
+
+  /**
+   * @brief Timestamp of the last frame this Cacher's decoder produced
+   *
+   * Used to link consecutive frames together in the shared FrameCache. Reset to AV_NOPTS_VALUE whenever the decoder
+   * seeks.
+   */
+  int64_t decoder_last_pts_;
+
+  /**
+   * @brief Timestamp of the last frame returned by RetrieveNextFrame()
+   *
+   * This may have come from either the decoder or the shared FrameCache.
+   */
+  int64_t last_pts_;
+
+  /**
+   * @brief Whether the decoder is positioned directly after last_pts_
+   *
+   * If frames were taken from the shared FrameCache rather than decoded, the decoder will be behind and must seek
+   * before it can decode the next frame.
+   */
+  bool decoder_synced_;
+
+  /**
+   * @brief Whether FootageStream::keyframe_index can be used to seek this media
+   *
+   * The index is generated from the original file, so it's not used when a proxy is open.
+   */
+  bool use_keyframe_index_;
+
   /**
    * @brief Internal function for opening the file handles and decoder
    *
@@ -494,6 +720,11 @@ private:
    */
   void OpenWorker();
 
+  /**
+   * @brief Internal function for (re)creating and opening the decoder context with a certain amount of threads
+   */
+  void OpenCodec(int threads);
+
   /**
    * @brief Internal function for starting a cache cycle
    *
@@ -562,9 +793,9 @@ private:
    *
    * @param f
    *
-   * A pointer to an AVFrame object. It does not need to be allocated, as this function allocates an AVFrame itself.
-   * You'll also need to free it later with av_frame_free() (though ClipQueue will do this automatically if the frame is
-   * added to it).
+   * A pointer to an AVFrame object. It does not need to be allocated, as this function retrieves one from the shared
+   * FramePool itself. You'll also need to free it later with av_frame_free() (though ClipQueue will do this
+   * automatically if the frame is added to it), which returns its buffer to the pool.
    *
    * @return
    *
@@ -572,6 +803,66 @@ private:
    */
   int RetrieveFrameAndProcess(AVFrame **f);
 
+  /**
+   * @brief Retrieve converted audio from the filter stack and change its speed if necessary
+   *
+   * A drop-in replacement for av_buffersink_get_frame() on `buffersink_ctx` for audio. Frames pulled from the filter
+   * stack are run through `stretcher_`, so if the clip's speed has changed, this may need several frames from the
+   * filter stack before it can return one.
+   *
+   * @param f
+   *
+   * Frame to fill with planar float audio at `audio_sample_rate_`.
+   *
+   * @return
+   *
+   * FFmpeg error code (>= 0 on success, AVERROR(EAGAIN) if the filter stack needs more decoded audio, or another
+   * negative error code on failure)
+   */
+  int RetrieveAudioFrame(AVFrame* f);
+
+  /**
+   * @brief Seek the decoder to a frame at or before a certain timestamp
+   *
+   * If the media has a keyframe index (see FootageStream::keyframe_index), this seeks directly to the last keyframe at
+   * or before the timestamp. Otherwise, since some formats don't seek reliably to the last keyframe, this function seeks
+   * in a loop (backing off one second at a time) until it retrieves a frame at or before the timestamp.
+   *
+   * @param target_pts
+   *
+   * The timestamp to seek to in the media's timebase
+   *
+   * @param f
+   *
+   * A pointer to an AVFrame object that will be set to the first frame retrieved after the seek. See
+   * RetrieveFrameAndProcess().
+   *
+   * @param seeked_to_zero
+   *
+   * Set to **TRUE** if the seek had to go all the way back to the start of the media.
+   *
+   * @return
+   *
+   * FFmpeg error code (>= 0 on success, a negative error code on failure)
+   */
+  int SeekDecoder(int64_t target_pts, AVFrame** f, bool* seeked_to_zero);
+
+  /**
+   * @brief Retrieve the next frame after last_pts_
+   *
+   * Uses the shared FrameCache if another Cacher has already decoded the next frame, otherwise decodes it (seeking
+   * first if the decoder fell behind while frames were being taken from the FrameCache).
+   *
+   * @param f
+   *
+   * See RetrieveFrameAndProcess().
+   *
+   * @return
+   *
+   * FFmpeg error code (>= 0 on success, a negative error code on failure)
+   */
+  int RetrieveNextFrame(AVFrame** f);
+
   /**
    * @brief Internal video caching function
    *
@@ -588,11 +879,40 @@ private:
    */
   void CacheAudioWorker();
 
+  /**
+   * @brief Internal audio caching function for footage with conformed audio
+   *
+   * Called by CacheAudioWorker() instead of decoding when `conformed_audio_` is available. Reads the samples for the
+   * clip's current range straight out of the conformed audio (backwards if reversed, interpolated if the speed has
+   * changed), applies effects and sends them to the mixer.
+   *
+   * All frame parameters are in `frame_rate` and have already been adjusted for nesting and reverse playback by
+   * CacheAudioWorker().
+   */
+  void CacheConformedAudio(long timeline_in, long timeline_out, long target_frame, double frame_rate, bool temp_reverse);
+
+  /**
+   * @brief Try to retrieve this clip's conformed audio from the ConformedAudioCache if it isn't set already
+   *
+   * @param wait
+   *
+   * **TRUE** to wait for the audio to finish conforming if it hasn't yet.
+   */
+  void UpdateConformedAudio(bool wait);
+
   /**
    * @brief Internal function using the Cacher's known information to determine whether this media is playing in reverse
    */
   bool IsReversed();
 
+  /**
+   * @brief Internal function returning the DecodeScheduler priority for caching frames after the requested one
+   *
+   * Frames after the requested frame are only needed soon if the sequence is playing, otherwise they're prefetched in
+   * case playback starts.
+   */
+  DecodeScheduler::Priority CacheAheadPriority();
+
   /**
    * @brief Internal struct holding bit depth information for the current media
    */
@@ -20,86 +20,226 @@
 
 #include "clipqueue.h"
 
+#include <QThread>
 
-ClipQueue::ClipQueue()
-{
+const int kDefaultQueueCapacity = 32;
 
+ClipQueue::ClipQueue() :
+  slots_(nullptr),
+  capacity_(0),
+  mask_(0),
+  head_(0),
+  tail_(0)
+{
+  SetCapacity(kDefaultQueueCapacity);
 }
 
 ClipQueue::~ClipQueue()
 {
   clear();
+  delete [] slots_;
 }
 
-void ClipQueue::lock()
+void ClipQueue::SetCapacity(int capacity)
 {
-  queue_lock.lock();
-}
+  quint32 new_capacity = 1;
+  while (new_capacity < quint32(capacity)) {
+    new_capacity <<= 1;
+  }
 
-bool ClipQueue::tryLock()
-{
-  return queue_lock.tryLock();
-}
+  if (new_capacity == capacity_) {
+    return;
+  }
 
-void ClipQueue::unlock()
-{
-  queue_lock.unlock();
+  clear();
+  delete [] slots_;
+
+  slots_ = new Slot[new_capacity];
+  for (quint32 i=0;i<new_capacity;i++) {
+    slots_[i].frame = nullptr;
+  }
+
+  capacity_ = new_capacity;
+  mask_ = new_capacity - 1;
 }
 
 void ClipQueue::append(AVFrame *frame)
 {
-  queue.append(frame);
+  if (quint32(size()) == capacity_) {
+    removeFirst();
+  }
+
+  quint32 tail = tail_.loadAcquire();
+  Slot& s = slot(tail);
+
+  // a reader may still be copying the frame that used to be in this slot
+  while (s.refs.loadAcquire() != 0) {
+    QThread::yieldCurrentThread();
+  }
+
+  s.frame = frame;
+  s.pts.storeRelease(frame->pts);
+  s.generation.fetchAndAddRelease(1);
+  s.refs.storeRelease(1);
+
+  tail_.storeRelease(tail + 1);
 }
 
 AVFrame *ClipQueue::at(int i)
 {
-  return queue.at(i);
+  return slot(head_.loadAcquire() + quint32(i)).frame;
 }
 
 AVFrame *ClipQueue::first()
 {
-  return queue.first();
+  return at(0);
 }
 
 AVFrame *ClipQueue::last()
 {
-  return queue.last();
+  return at(size()-1);
 }
 
 void ClipQueue::removeFirst()
 {
-  removeAt(0);
+  quint32 head = head_.loadAcquire();
+  Slot& s = slot(head);
+  AVFrame* frame = s.frame;
+
+  // readers stop finding this frame before we release our reference
+  head_.storeRelease(head + 1);
+
+  Unref(s, frame);
 }
 
 void ClipQueue::removeLast()
 {
-  removeAt(queue.size()-1);
+  quint32 tail = tail_.loadAcquire() - 1;
+  Slot& s = slot(tail);
+  AVFrame* frame = s.frame;
+
+  tail_.storeRelease(tail);
+
+  Unref(s, frame);
 }
 
-void ClipQueue::removeAt(int i)
+void ClipQueue::clear()
 {
-  av_frame_free(&queue[i]);
-  queue.removeAt(i);
+  while (!isEmpty()) {
+    removeFirst();
+  }
 }
 
-void ClipQueue::clear()
+int ClipQueue::countUpTo(int64_t pts)
 {
-  while (queue.size() > 0) {
-    removeAt(0);
+  quint32 head = head_.loadAcquire();
+  quint32 low = head;
+  quint32 high = tail_.loadAcquire();
+
+  while (low != high) {
+    quint32 mid = low + (high - low) / 2;
+    if (slot(mid).pts.loadAcquire() <= pts) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
   }
+
+  return int(low - head);
 }
 
 int ClipQueue::size()
 {
-  return queue.size();
+  return int(tail_.loadAcquire() - head_.loadAcquire());
 }
 
 bool ClipQueue::isEmpty()
 {
-  return queue.isEmpty();
+  return size() == 0;
+}
+
+AVFrame *ClipQueue::CloneFrameAt(int64_t pts)
+{
+  quint32 head = head_.loadAcquire();
+  quint32 tail = tail_.loadAcquire();
+
+  // binary search for the last frame with a timestamp <= pts
+  quint32 low = head;
+  quint32 high = tail;
+  while (low != high) {
+    quint32 mid = low + (high - low) / 2;
+    if (slot(mid).pts.loadAcquire() <= pts) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  if (low == head) {
+    return nullptr;
+  }
+
+  quint32 index = low - 1;
+  qint64 found_pts = slot(index).pts.loadAcquire();
+
+  // if this isn't the exact frame, only use it if we know there's a frame after it (otherwise the correct frame may
+  // still be on its way)
+  if (found_pts != pts && low == tail) {
+    return nullptr;
+  }
+
+  return CloneSlot(index, found_pts);
+}
+
+AVFrame *ClipQueue::CloneFirst()
+{
+  quint32 head = head_.loadAcquire();
+
+  if (head == tail_.loadAcquire()) {
+    return nullptr;
+  }
+
+  return CloneSlot(head, slot(head).pts.loadAcquire());
 }
 
-bool ClipQueue::contains(AVFrame *frame)
+ClipQueue::Slot &ClipQueue::slot(quint32 index)
 {
-  return queue.contains(frame);
+  return slots_[index & mask_];
+}
+
+AVFrame *ClipQueue::CloneSlot(quint32 index, qint64 expected_pts)
+{
+  Slot& s = slot(index);
+
+  int generation = s.generation.loadAcquire();
+
+  // pin the frame so the producer can't free it while we're copying it
+  int refs;
+  do {
+    refs = s.refs.loadAcquire();
+    if (refs == 0) {
+      // the frame was already removed
+      return nullptr;
+    }
+  } while (!s.refs.testAndSetOrdered(refs, refs + 1));
+
+  AVFrame* frame = s.frame;
+  AVFrame* clone = nullptr;
+
+  // make sure the slot wasn't reused for another frame between finding it and pinning it
+  if (s.generation.loadAcquire() == generation && s.pts.loadAcquire() == expected_pts) {
+    clone = av_frame_clone(frame);
+  }
+
+  Unref(s, frame);
+
+  return clone;
+}
+
+void ClipQueue::Unref(Slot &s, AVFrame *frame)
+{
+  // whoever releases the last reference frees the frame
+  if (s.refs.fetchAndSubOrdered(1) == 1) {
+    av_frame_free(&frame);
+  }
 }
@@ -25,13 +25,22 @@ extern "C" {
 #include <libavformat/avformat.h>
 }
 
-#include <QVector>
-#include <QMutex>
+#include <QAtomicInt>
+#include <QAtomicInteger>
 
 /**
  * @brief The ClipQueue class
  *
- * A fairly simple wrapper for a QVector and QMutex that cleans up AVFrames automatically when removing them.
+ * A fixed-capacity ring buffer of AVFrames ordered by timestamp that cleans up AVFrames automatically when removing
+ * them.
+ *
+ * ClipQueue is designed for one producer thread (the Cacher that owns it) and any number of reader threads without
+ * any locking. Only the producer may add, remove, or directly access frames (append(), removeFirst(), at(), etc.).
+ * Other threads can only retrieve frames through CloneFrameAt() and CloneFirst(), which pin the frame while copying
+ * a new reference to it so the producer can never free it out from under them.
+ *
+ * Frames must be appended in chronological order (i.e. ascending timestamps), which allows frames to be looked up by
+ * timestamp with a binary search.
  */
 class ClipQueue {
 public:
@@ -47,42 +56,27 @@ public:
    */
   ~ClipQueue();
 
-  // Thread safety (QMutex compatible)
-  /**
-   * @brief Lock queue mutex
-   *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. See QMutex::lock() for more
-   * information.
-   */
-  void lock();
-
   /**
-   * @brief Try to lock queue mutex
+   * @brief Set the maximum amount of frames the queue can hold
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. Tries to lock, but doesn't block
-   * the calling thread and wait if it can't lock it. See QMutex::tryLock() for more information.
+   * Must only be called by the producer while the queue is empty and no other threads are reading from it (e.g. while
+   * the Cacher is opening).
    *
-   * @return
-   *
-   * **TRUE** if the lock succeeded, **FALSE** if not.
-   */
-  bool tryLock();
-
-  /**
-   * @brief Unlock queue mutex
+   * @param capacity
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. See QMutex::unlock() for more
-   * information.
+   * Minimum number of frames to hold. Will be rounded up to the next power of two.
    */
-  void unlock();
+  void SetCapacity(int capacity);
 
-  // Array handling (QVector compatible)
+  // Producer functions
   /**
    * @brief Add a frame to the end of the queue
    *
+   * The queue takes ownership of the frame. If the queue is already full, the first frame is removed to make room.
+   *
    * @param frame
    *
-   * The frame to add
+   * The frame to add. Its timestamp must be later than the last frame in the queue.
    */
   void append(AVFrame* frame);
 
@@ -120,42 +114,47 @@ public:
   /**
    * @brief Remove first frame in the queue
    *
-   * Frees all memory occupied by this frame and removes it from the queue
+   * Frees all memory occupied by this frame (once no other threads are using it) and removes it from the queue
    */
   void removeFirst();
 
   /**
    * @brief Remove last frame in the queue
    *
-   * Frees all memory occupied by this frame and removes it from the queue
+   * Frees all memory occupied by this frame (once no other threads are using it) and removes it from the queue
    */
   void removeLast();
 
   /**
-   * @brief Remove frame in the queue at a certain index
-   *
-   * Frees all memory occupied by this frame and removes it from the queue
-   *
-   * @param i
+   * @brief Clear entire queue
    *
-   * Index to remove a frame at
+   * Frees all memory occupied by all frames and clears the entire queue
    */
-  void removeAt(int i);
+  void clear();
 
   /**
-   * @brief Clear entire queue
+   * @brief Count the frames with a timestamp less than or equal to a certain timestamp
    *
-   * Frees all memory occupied by all frames and clears the entire queue
+   * @param pts
+   *
+   * Timestamp to compare against
+   *
+   * @return
+   *
+   * The amount of frames at the start of the queue with a timestamp <= pts, found with a binary search.
    */
-  void clear();
+  int countUpTo(int64_t pts);
 
+  // Thread-safe functions
   /**
    * @brief Retrieve current size of the queue
    *
+   * Can be called from any thread, but if called by a thread other than the producer, the size may have changed by
+   * the time this function returns.
+   *
    * @return
    *
-   * Current the current size of the queue. All indexes in the queue are guaranteed to be valid references to an
-   * AVFrame.
+   * Current the current size of the queue.
    */
   int size();
 
@@ -169,17 +168,61 @@ public:
   bool isEmpty();
 
   /**
-   * @brief Returns whether the queue contains a frame or not
+   * @brief Retrieve a new reference to the frame that should be shown at a certain timestamp
+   *
+   * Safe to call from any thread.
+   *
+   * @param pts
+   *
+   * Timestamp to look up. A frame matches if it has this exact timestamp, or if it's the last frame before this
+   * timestamp and is followed by a frame after it (i.e. the timestamp fell between two frames due to rounding).
+   *
+   * @return
+   *
+   * A new reference to the frame (see av_frame_clone()) that the caller must free with av_frame_free(), or `nullptr`
+   * if no matching frame was found.
+   */
+  AVFrame* CloneFrameAt(int64_t pts);
+
+  /**
+   * @brief Retrieve a new reference to the first frame in the queue
+   *
+   * Safe to call from any thread.
    *
    * @return
    *
-   * **TRUE** if the queue contains the specified frame, **FALSE** if not.
+   * A new reference to the frame (see av_frame_clone()) that the caller must free with av_frame_free(), or `nullptr`
+   * if the queue is empty.
    */
-  bool contains(AVFrame* frame);
+  AVFrame* CloneFirst();
 
 private:
-  QVector<AVFrame*> queue;
-  QMutex queue_lock;
+  struct Slot {
+    AVFrame* frame;
+
+    // copy of frame->pts so readers can search the queue without touching the frame
+    QAtomicInteger<qint64> pts;
+
+    // the queue holds one reference while the frame is in the queue, readers hold one while copying it
+    QAtomicInt refs;
+
+    // incremented each time this slot is reused so readers can tell if the frame changed while pinning it
+    QAtomicInt generation;
+  };
+
+  Slot& slot(quint32 index);
+
+  AVFrame* CloneSlot(quint32 index, qint64 expected_pts);
+
+  void Unref(Slot& s, AVFrame* frame);
+
+  Slot* slots_;
+  quint32 capacity_;
+  quint32 mask_;
+
+  // head_ and tail_ are ever-increasing counters, the index into slots_ is the counter masked by mask_
+  QAtomicInteger<quint32> head_;
+  QAtomicInteger<quint32> tail_;
 };
 
 #endif // CLIPQUEUE_H
@@ -0,0 +1,359 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "conformedaudio.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <cstring>
+
+#include "decoders/ffmpegdecoder.h"
+#include "rendering/audiodsp.h"
+#include "global/path.h"
+#include "project/footage.h"
+
+ConformedAudioCache olive::conformed_audio_cache;
+
+namespace {
+
+struct ConformedAudioHeader {
+  char magic[4];
+  qint32 version;
+  qint32 sample_rate;
+  qint32 channels;
+  qint64 sample_count;
+};
+
+const char kConformedAudioMagic[4] = {'O', 'C', 'A', 'F'};
+const qint32 kConformedAudioVersion = 1;
+
+// number of samples (per channel) decoded or copied at a time while conforming
+const int kConformBlockSize = 16384;
+
+}
+
+ConformedAudio::ConformedAudio() :
+  map_(nullptr),
+  sample_count_(0),
+  sample_rate_(0)
+{
+  for (int i=0;i<kChannels;i++) {
+    channels_[i] = nullptr;
+  }
+}
+
+ConformedAudio::~ConformedAudio()
+{
+  if (map_ != nullptr) {
+    file_.unmap(map_);
+  }
+}
+
+bool ConformedAudio::Open(const QString &filename)
+{
+  file_.setFileName(filename);
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  ConformedAudioHeader header;
+  if (file_.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header))
+      || memcmp(header.magic, kConformedAudioMagic, sizeof(header.magic)) != 0
+      || header.version != kConformedAudioVersion
+      || header.channels != kChannels
+      || header.sample_count < 0
+      || file_.size() != qint64(sizeof(header)) + header.sample_count * kChannels * qint64(sizeof(float))) {
+    qWarning() << "Invalid conformed audio file" << filename;
+    file_.close();
+    return false;
+  }
+
+  sample_count_ = header.sample_count;
+  sample_rate_ = header.sample_rate;
+
+  map_ = file_.map(0, file_.size());
+  if (map_ == nullptr) {
+    qWarning() << "Failed to map conformed audio file" << filename;
+    file_.close();
+    return false;
+  }
+
+  // the file can be closed once it's mapped
+  file_.close();
+
+  const float* planes = reinterpret_cast<const float*>(map_ + sizeof(header));
+  for (int i=0;i<kChannels;i++) {
+    channels_[i] = planes + sample_count_ * i;
+  }
+
+  return true;
+}
+
+const float *ConformedAudio::channel(int channel)
+{
+  return channels_[channel];
+}
+
+void ConformedAudio::Read(double position, double step, int frames, float * const *out)
+{
+  for (int i=0;i<kChannels;i++) {
+    olive::dsp::Resample(channels_[i], sample_count_, position, step, out[i], frames);
+  }
+}
+
+qint64 ConformedAudio::sample_count()
+{
+  return sample_count_;
+}
+
+int ConformedAudio::sample_rate()
+{
+  return sample_rate_;
+}
+
+ConformedAudioCache::ConformedAudioCache() :
+  quit_(0)
+{
+}
+
+ConformedAudioCache::~ConformedAudioCache()
+{
+  quit_.storeRelease(1);
+
+  lock_.lock();
+  job_queued_.wakeAll();
+  lock_.unlock();
+
+  wait();
+}
+
+ConformedAudioPtr ConformedAudioCache::Get(Footage *footage, const FootageStream *stream, int sample_rate, bool wait)
+{
+  QString filename = QDir(get_data_dir().filePath("previews")).filePath(
+        QString("%1c%2r%3").arg(get_file_hash(footage->url),
+                                QString::number(stream->file_index),
+                                QString::number(sample_rate)));
+
+  QMutexLocker locker(&lock_);
+
+  QHash<QString, ConformedAudioPtr>::const_iterator finished = finished_.constFind(filename);
+  if (finished != finished_.constEnd()) {
+    return finished.value();
+  }
+
+  bool queued = (current_ == filename);
+  for (int i=0;i<queue_.size() && !queued;i++) {
+    queued = (queue_.at(i).filename == filename);
+  }
+
+  if (!queued) {
+    // the stream may have been conformed in a previous session
+    ConformedAudioPtr audio = std::make_shared<ConformedAudio>();
+    if (audio->Open(filename)) {
+      finished_.insert(filename, audio);
+      return audio;
+    }
+
+    Job job;
+    job.media_filename = footage->url;
+    job.stream_index = stream->file_index;
+    job.sample_rate = sample_rate;
+    job.filename = filename;
+    queue_.append(job);
+
+    if (!isRunning()) {
+      start(QThread::LowPriority);
+    }
+    job_queued_.wakeAll();
+  }
+
+  if (!wait) {
+    return nullptr;
+  }
+
+  while (!finished_.contains(filename)) {
+    job_finished_.wait(&lock_);
+  }
+
+  return finished_.value(filename);
+}
+
+void ConformedAudioCache::run()
+{
+  lock_.lock();
+
+  while (!quit_.loadAcquire()) {
+    if (queue_.isEmpty()) {
+      job_queued_.wait(&lock_);
+      continue;
+    }
+
+    Job job = queue_.takeFirst();
+    current_ = job.filename;
+
+    lock_.unlock();
+
+    ConformedAudioPtr audio;
+    if (Conform(job)) {
+      audio = std::make_shared<ConformedAudio>();
+      if (!audio->Open(job.filename)) {
+        audio = nullptr;
+      }
+    }
+
+    lock_.lock();
+
+    current_.clear();
+
+    // failures are stored too so Cachers fall back to decoding rather than requesting the stream again
+    finished_.insert(job.filename, audio);
+    job_finished_.wakeAll();
+  }
+
+  // nothing will process the rest of the queue, don't leave anyone waiting on it
+  for (int i=0;i<queue_.size();i++) {
+    finished_.insert(queue_.at(i).filename, nullptr);
+  }
+  queue_.clear();
+  job_finished_.wakeAll();
+
+  lock_.unlock();
+}
+
+bool ConformedAudioCache::Conform(const Job &job)
+{
+  const int channels = ConformedAudio::kChannels;
+
+  FFmpegDecoder decoder;
+  decoder.SetAudioOutputFormat(job.sample_rate, AV_CH_LAYOUT_STEREO);
+  if (!decoder.Open(job.media_filename, job.stream_index)) {
+    qWarning() << "Failed to open" << job.media_filename << "for conforming audio";
+    return false;
+  }
+
+  QDir().mkpath(QFileInfo(job.filename).absolutePath());
+
+  // the decoder returns interleaved samples and the total length isn't known until the whole stream has been
+  // decoded, so decode into a temporary file first
+  QFile interleaved(job.filename + ".tmp");
+  if (!interleaved.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to create" << interleaved.fileName();
+    return false;
+  }
+
+  QVector<float> block(kConformBlockSize * channels);
+  qint64 first_sample = qRound64(decoder.start_time() * job.sample_rate);
+  qint64 sample_count = 0;
+  bool ok = true;
+
+  while (!quit_.loadAcquire()) {
+    int read = decoder.RetrieveAudio(double(first_sample + sample_count) / job.sample_rate,
+                                     kConformBlockSize,
+                                     block.data());
+    if (read < 0) {
+      qWarning() << "Failed to decode audio for conforming" << job.media_filename << read;
+      ok = false;
+      break;
+    } else if (read == 0) {
+      break;
+    }
+
+    qint64 bytes = qint64(read) * channels * qint64(sizeof(float));
+    if (interleaved.write(reinterpret_cast<const char*>(block.constData()), bytes) != bytes) {
+      qWarning() << "Failed to write" << interleaved.fileName();
+      ok = false;
+      break;
+    }
+
+    sample_count += read;
+  }
+
+  decoder.Close();
+  interleaved.close();
+
+  ok = ok && !quit_.loadAcquire();
+
+  // deinterleave the temporary file into the final planar file
+  QFile planar(job.filename + ".part");
+
+  if (ok && interleaved.open(QFile::ReadOnly) && planar.open(QFile::WriteOnly | QFile::Truncate)) {
+    ConformedAudioHeader header;
+    memcpy(header.magic, kConformedAudioMagic, sizeof(header.magic));
+    header.version = kConformedAudioVersion;
+    header.sample_rate = job.sample_rate;
+    header.channels = channels;
+    header.sample_count = sample_count;
+    planar.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const float* source = nullptr;
+    uchar* map = nullptr;
+    if (sample_count > 0) {
+      map = interleaved.map(0, interleaved.size());
+      source = reinterpret_cast<const float*>(map);
+      ok = (map != nullptr);
+    }
+
+    // deinterleave a block of every channel at a time, then write each one into its place in its channel's plane
+    float* planes[ConformedAudio::kChannels];
+    for (int i=0;i<channels;i++) {
+      planes[i] = block.data() + i * kConformBlockSize;
+    }
+
+    for (qint64 j=0;j<sample_count && ok;j+=kConformBlockSize) {
+      int count = int(qMin(qint64(kConformBlockSize), sample_count - j));
+
+      olive::dsp::Deinterleave(source + j * channels, planes, channels, count);
+
+      for (int i=0;i<channels && ok;i++) {
+        qint64 bytes = qint64(count) * qint64(sizeof(float));
+        ok = planar.seek(qint64(sizeof(header)) + (qint64(i) * sample_count + j) * qint64(sizeof(float)))
+            && planar.write(reinterpret_cast<const char*>(planes[i]), bytes) == bytes;
+      }
+    }
+
+    if (map != nullptr) {
+      interleaved.unmap(map);
+    }
+    planar.close();
+  } else {
+    ok = false;
+  }
+
+  interleaved.close();
+  interleaved.remove();
+
+  if (ok) {
+    QFile::remove(job.filename);
+    ok = planar.rename(job.filename);
+  }
+
+  if (!ok) {
+    planar.remove();
+    qWarning() << "Failed to conform audio from" << job.media_filename;
+  }
+
+  return ok;
+}
@@ -0,0 +1,236 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef CONFORMEDAUDIO_H
+#define CONFORMEDAUDIO_H
+
+#include <memory>
+#include <QAtomicInt>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+class Footage;
+struct FootageStream;
+
+/**
+ * @brief The ConformedAudio class
+ *
+ * One audio stream decoded and resampled once to a certain sample rate in stereo, and stored as a file of planar
+ * float samples in the preview cache directory. The file is memory-mapped so any range of samples can be read
+ * instantly from any thread, which lets Cachers play, scrub, reverse and export audio without seeking or decoding.
+ *
+ * Sample 0 corresponds to the start of the stream (i.e. the same time Cacher considers the start of the media).
+ *
+ * ConformedAudio objects are created by ConformedAudioCache and are read-only once opened.
+ */
+class ConformedAudio {
+public:
+  /**
+   * @brief Channel count of all conformed audio (the same as the AudioMixer's)
+   */
+  static const int kChannels = 2;
+
+  /**
+   * @brief ConformedAudio Constructor
+   */
+  ConformedAudio();
+
+  /**
+   * @brief ConformedAudio Destructor
+   *
+   * Unmaps the file.
+   */
+  ~ConformedAudio();
+
+  /**
+   * @brief Map a conformed audio file created by ConformedAudioCache
+   *
+   * @return
+   *
+   * **TRUE** if the file exists and is a valid conformed audio file.
+   */
+  bool Open(const QString& filename);
+
+  /**
+   * @brief Returns the samples of one channel
+   *
+   * @param channel
+   *
+   * Channel index, must be less than kChannels.
+   *
+   * @return
+   *
+   * Array of sample_count() samples.
+   */
+  const float* channel(int channel);
+
+  /**
+   * @brief Read every channel starting at a fractional sample position and moving a fixed step per sample
+   *
+   * See olive::dsp::Resample(), positions outside of the audio read as silence.
+   *
+   * @param position
+   *
+   * Sample to start reading from
+   *
+   * @param step
+   *
+   * Samples to move per sample written, e.g. 0.5 for half speed or -1.0 to read backwards
+   *
+   * @param out
+   *
+   * Array of kChannels pointers to write `frames` planar samples to each
+   */
+  void Read(double position, double step, int frames, float* const* out);
+
+  /**
+   * @brief Returns the number of samples per channel
+   */
+  qint64 sample_count();
+
+  /**
+   * @brief Returns the sample rate the audio was conformed to
+   */
+  int sample_rate();
+
+private:
+  QFile file_;
+
+  uchar* map_;
+
+  const float* channels_[kChannels];
+
+  qint64 sample_count_;
+
+  int sample_rate_;
+};
+
+using ConformedAudioPtr = std::shared_ptr<ConformedAudio>;
+
+/**
+ * @brief The ConformedAudioCache class
+ *
+ * Creates and keeps track of ConformedAudio for every footage audio stream and sample rate that's been requested.
+ *
+ * Conforming runs on the cache's own background thread, one stream at a time. Files are named after the footage's
+ * hash (see get_file_hash()) so a stream is only ever conformed once per sample rate, even across sessions.
+ *
+ * All functions are thread-safe.
+ */
+class ConformedAudioCache : public QThread {
+public:
+  /**
+   * @brief ConformedAudioCache Constructor
+   *
+   * The thread isn't started until the first stream needs conforming.
+   */
+  ConformedAudioCache();
+
+  /**
+   * @brief ConformedAudioCache Destructor
+   *
+   * Cancels any conforming in progress and waits for the thread to finish.
+   */
+  virtual ~ConformedAudioCache() override;
+
+  /**
+   * @brief Retrieve the conformed audio of a footage stream
+   *
+   * If the stream hasn't been conformed to this sample rate yet, it's queued for conforming.
+   *
+   * @param footage
+   *
+   * Footage the stream belongs to
+   *
+   * @param stream
+   *
+   * Audio stream to retrieve
+   *
+   * @param sample_rate
+   *
+   * Sample rate the audio should be conformed to
+   *
+   * @param wait
+   *
+   * **TRUE** to block until the stream has been conformed, **FALSE** to return immediately.
+   *
+   * @return
+   *
+   * The conformed audio, or `nullptr` if it isn't ready yet (or conforming it failed).
+   */
+  ConformedAudioPtr Get(Footage* footage, const FootageStream* stream, int sample_rate, bool wait);
+
+protected:
+  /**
+   * @brief Background thread that conforms queued streams
+   */
+  virtual void run() override;
+
+private:
+  struct Job {
+    QString media_filename;
+    int stream_index;
+    int sample_rate;
+    QString filename;
+  };
+
+  /**
+   * @brief Decode and resample a stream into a conformed audio file
+   *
+   * @return
+   *
+   * **TRUE** if the file was created successfully.
+   */
+  bool Conform(const Job& job);
+
+  QMutex lock_;
+
+  QWaitCondition job_queued_;
+
+  QWaitCondition job_finished_;
+
+  QVector<Job> queue_;
+
+  /**
+   * @brief Filenames of streams that have finished conforming, mapped to their audio (`nullptr` if conforming failed)
+   */
+  QHash<QString, ConformedAudioPtr> finished_;
+
+  /**
+   * @brief Filename of the stream currently being conformed
+   */
+  QString current_;
+
+  QAtomicInt quit_;
+};
+
+namespace olive {
+  /**
+   * @brief Global cache of conformed audio shared by all Cachers
+   */
+  extern ConformedAudioCache conformed_audio_cache;
+}
+
+#endif // CONFORMEDAUDIO_H
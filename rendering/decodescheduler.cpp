@@ -0,0 +1,315 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decodescheduler.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+#include "global/config.h"
+
+DecodeScheduler olive::decode_scheduler;
+
+/**
+ * @brief Worker thread of the DecodeScheduler's pool
+ */
+class DecodeWorker : public QThread {
+public:
+  DecodeWorker(DecodeScheduler* scheduler) :
+    scheduler_(scheduler)
+  {}
+
+protected:
+  virtual void run() override {
+    scheduler_->WorkerLoop();
+  }
+
+private:
+  DecodeScheduler* scheduler_;
+};
+
+DecodeScheduler::DecodeScheduler() :
+  active_jobs_(0),
+  quit_(false),
+  open_decoders_(0),
+  codec_threads_(0)
+{
+  for (int i=0;i<kPriorityCount;i++) {
+    waiting_jobs_[i] = 0;
+  }
+}
+
+DecodeScheduler::~DecodeScheduler()
+{
+  lock_.lock();
+  quit_ = true;
+  slot_freed_.wakeAll();
+  lock_.unlock();
+
+  for (int i=0;i<workers_.size();i++) {
+    workers_.at(i)->wait();
+    delete workers_.at(i);
+  }
+}
+
+void DecodeScheduler::Schedule(DecodeJob *job, DecodeScheduler::Priority priority)
+{
+  QMutexLocker locker(&lock_);
+
+  if (job->running_) {
+
+    // queue it again once it's finished
+    if (!job->requeue_ || priority < job->requeue_priority_) {
+      job->requeue_priority_ = priority;
+    }
+    job->requeue_ = true;
+
+  } else if (job->queued_) {
+
+    // move it up if it's needed more urgently now
+    if (priority < job->priority_) {
+      queued_jobs_[job->priority_].removeOne(job);
+      waiting_jobs_[job->priority_]--;
+      job->queued_ = false;
+
+      Enqueue(job, priority);
+    }
+
+  } else {
+
+    Enqueue(job, priority);
+
+  }
+}
+
+void DecodeScheduler::Wait(DecodeJob *job)
+{
+  QMutexLocker locker(&lock_);
+
+  while (job->queued_ || job->running_) {
+    job_finished_.wait(&lock_);
+  }
+}
+
+bool DecodeScheduler::IsScheduled(DecodeJob *job)
+{
+  QMutexLocker locker(&lock_);
+
+  return job->queued_ || job->running_;
+}
+
+void DecodeScheduler::Acquire(DecodeScheduler::Priority priority)
+{
+  QMutexLocker locker(&lock_);
+
+  waiting_jobs_[priority]++;
+
+  while (active_jobs_ >= thread_budget() || HigherPriorityWaiting(priority)) {
+    slot_freed_.wait(&lock_);
+  }
+
+  waiting_jobs_[priority]--;
+  active_jobs_++;
+
+  // if there are more free slots, let the next job in line check for them
+  slot_freed_.wakeAll();
+}
+
+void DecodeScheduler::Release()
+{
+  QMutexLocker locker(&lock_);
+
+  active_jobs_--;
+
+  slot_freed_.wakeAll();
+}
+
+bool DecodeScheduler::ShouldYield(DecodeScheduler::Priority priority)
+{
+  QMutexLocker locker(&lock_);
+
+  return active_jobs_ >= thread_budget() && HigherPriorityWaiting(priority);
+}
+
+int DecodeScheduler::RegisterDecoder()
+{
+  QMutexLocker locker(&lock_);
+
+  open_decoders_++;
+
+  return GrantCodecThreads();
+}
+
+int DecodeScheduler::RebalanceDecoder(int threads)
+{
+  QMutexLocker locker(&lock_);
+
+  ReturnCodecThreads(threads);
+
+  return GrantCodecThreads();
+}
+
+void DecodeScheduler::UnregisterDecoder(int threads)
+{
+  QMutexLocker locker(&lock_);
+
+  ReturnCodecThreads(threads);
+
+  open_decoders_--;
+}
+
+void DecodeScheduler::WorkerLoop()
+{
+  QMutexLocker locker(&lock_);
+
+  while (!quit_) {
+    DecodeJob* job = TakeJob();
+
+    if (job == nullptr) {
+      slot_freed_.wait(&lock_);
+      continue;
+    }
+
+    active_jobs_++;
+
+    locker.unlock();
+
+    job->RunDecodeJob(job->priority_);
+
+    locker.relock();
+
+    active_jobs_--;
+    job->running_ = false;
+
+    if (job->requeue_) {
+      job->requeue_ = false;
+      Enqueue(job, job->requeue_priority_);
+    }
+
+    job_finished_.wakeAll();
+    slot_freed_.wakeAll();
+  }
+}
+
+void DecodeScheduler::StartWorkers()
+{
+  while (workers_.size() < thread_budget()) {
+    QThread* worker = new DecodeWorker(this);
+    workers_.append(worker);
+    worker->start();
+  }
+}
+
+void DecodeScheduler::Enqueue(DecodeJob *job, DecodeScheduler::Priority priority)
+{
+  // the budget may have been raised since the workers were started
+  StartWorkers();
+
+  job->priority_ = priority;
+  job->queued_ = true;
+
+  queued_jobs_[priority].append(job);
+  waiting_jobs_[priority]++;
+
+  slot_freed_.wakeAll();
+}
+
+DecodeJob *DecodeScheduler::TakeJob()
+{
+  if (active_jobs_ >= thread_budget()) {
+    return nullptr;
+  }
+
+  for (int i=0;i<kPriorityCount;i++) {
+    if (!queued_jobs_[i].isEmpty()) {
+
+      // if a more urgent thread is waiting in Acquire(), let it take the slot first
+      if (HigherPriorityWaiting(static_cast<Priority>(i))) {
+        return nullptr;
+      }
+
+      DecodeJob* job = queued_jobs_[i].takeFirst();
+      waiting_jobs_[i]--;
+
+      job->queued_ = false;
+      job->running_ = true;
+
+      return job;
+    }
+  }
+
+  return nullptr;
+}
+
+int DecodeScheduler::GrantCodecThreads()
+{
+  int budget = thread_budget();
+
+  int threads = qMin(budget / qMax(1, open_decoders_), budget - codec_threads_);
+
+  // a single codec thread decodes in the calling thread, so it doesn't take anything from the budget
+  if (threads < 2) {
+    return 1;
+  }
+
+  codec_threads_ += threads;
+
+  return threads;
+}
+
+void DecodeScheduler::ReturnCodecThreads(int threads)
+{
+  if (threads > 1) {
+    codec_threads_ -= threads;
+  }
+}
+
+int DecodeScheduler::thread_budget()
+{
+  if (olive::config.decode_threads > 0) {
+    return olive::config.decode_threads;
+  }
+
+  return qMax(1, QThread::idealThreadCount());
+}
+
+bool DecodeScheduler::HigherPriorityWaiting(DecodeScheduler::Priority priority)
+{
+  for (int i=0;i<priority;i++) {
+    if (waiting_jobs_[i] > 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+DecodeJob::DecodeJob() :
+  queued_(false),
+  running_(false),
+  priority_(DecodeScheduler::kPriorityBackground),
+  requeue_(false),
+  requeue_priority_(DecodeScheduler::kPriorityBackground)
+{
+}
+
+DecodeJob::~DecodeJob()
+{
+}
@@ -0,0 +1,297 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODESCHEDULER_H
+#define DECODESCHEDULER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QVector>
+#include <QThread>
+
+class DecodeJob;
+
+/**
+ * @brief The DecodeScheduler class
+ *
+ * Limits how many clips decode at the same time and in which order, so that a timeline with many open clips doesn't
+ * oversubscribe the CPU.
+ *
+ * Decoding work is submitted as DecodeJobs with a priority describing how urgently their frames are needed. The
+ * scheduler runs them on a fixed pool of worker threads (one per decode slot) rather than each clip keeping a thread
+ * of its own. Queued jobs are started in priority order, and long running jobs regularly check ShouldYield() to end
+ * early and reschedule themselves if a more urgent job is waiting. Code that decodes on its own thread can still
+ * compete for the same slots with Acquire() and Release().
+ *
+ * The scheduler also splits a global budget of codec threads between the decoders that are open so that each decoder
+ * doesn't spawn one thread per core of its own (as `threads=auto` would). Shares are recalculated whenever a decoder
+ * opens or closes, and the codec threads handed out never add up to more than the budget.
+ *
+ * The amount of decode slots and the codec thread budget are set by Config::decode_threads.
+ *
+ * All functions are thread-safe.
+ */
+class DecodeScheduler {
+public:
+  /**
+   * @brief Job priorities, from most to least urgent
+   */
+  enum Priority {
+    /** A frame that has to be shown right now (e.g. Cache() is waiting on it) */
+    kPriorityVisible,
+
+    /** Frames that will be shown soon during playback */
+    kPriorityLookahead,
+
+    /** Speculative caching that isn't needed yet (e.g. filling the queue while paused) */
+    kPriorityPrefetch,
+
+    /** Previews that are only drawn in the UI (e.g. timeline thumbnails) */
+    kPriorityBackground,
+
+    kPriorityCount
+  };
+
+  /**
+   * @brief DecodeScheduler Constructor
+   *
+   * The worker threads aren't started until the first job is scheduled.
+   */
+  DecodeScheduler();
+
+  /**
+   * @brief DecodeScheduler Destructor
+   *
+   * Stops and waits for the worker threads. Any job still queued at this point is never run.
+   */
+  ~DecodeScheduler();
+
+  /**
+   * @brief Queue a job to run on the worker pool
+   *
+   * If the job is already queued, it's moved up to `priority` if that's more urgent. If it's currently running, it's
+   * queued again once it finishes so that work requested while it was running isn't lost.
+   *
+   * @param job
+   *
+   * Job to run. It must stay valid until it has finished running (see Wait()).
+   *
+   * @param priority
+   *
+   * Urgency of the job
+   */
+  void Schedule(DecodeJob* job, Priority priority);
+
+  /**
+   * @brief Block until a job is neither queued nor running
+   */
+  void Wait(DecodeJob* job);
+
+  /**
+   * @brief Returns whether a job is currently queued or running
+   */
+  bool IsScheduled(DecodeJob* job);
+
+  /**
+   * @brief Acquire a decode slot
+   *
+   * For decoding outside of the worker pool. Blocks until a slot is free and no job with a higher priority is waiting
+   * for one. Every call must be paired with a call to Release().
+   *
+   * @param priority
+   *
+   * Urgency of the job that will run in this slot
+   */
+  void Acquire(Priority priority);
+
+  /**
+   * @brief Release a decode slot acquired with Acquire()
+   */
+  void Release();
+
+  /**
+   * @brief Check whether a job should give up its slot
+   *
+   * @param priority
+   *
+   * Priority of the job currently running
+   *
+   * @return
+   *
+   * **TRUE** if all slots are in use and a job with a higher priority than `priority` is waiting for one. A job
+   * running on the worker pool should then Schedule() itself again and return, freeing its worker for the more urgent
+   * job.
+   */
+  bool ShouldYield(Priority priority);
+
+  /**
+   * @brief Register a newly opened decoder
+   *
+   * Every call must be paired with a call to UnregisterDecoder() when the decoder is closed.
+   *
+   * @return
+   *
+   * The amount of threads this decoder's codec should use. This is the codec thread budget divided between all open
+   * decoders, but never more than what's left of the budget, so a decoder may get less than its share until the
+   * others call RebalanceDecoder(). A single thread decodes in the calling thread, so it doesn't count towards the
+   * budget.
+   */
+  int RegisterDecoder();
+
+  /**
+   * @brief Recalculate the codec threads of a registered decoder
+   *
+   * Should be called regularly by every open decoder (e.g. before each decoding job) so that shares follow decoders
+   * opening and closing. If the returned value differs from `threads`, the decoder should be reopened with the new
+   * amount.
+   *
+   * @param threads
+   *
+   * The amount of threads the decoder currently uses, as last returned by RegisterDecoder() or RebalanceDecoder()
+   *
+   * @return
+   *
+   * The amount of threads the decoder should use from now on.
+   */
+  int RebalanceDecoder(int threads);
+
+  /**
+   * @brief Unregister a decoder registered with RegisterDecoder()
+   *
+   * @param threads
+   *
+   * The amount of threads the decoder was using
+   */
+  void UnregisterDecoder(int threads);
+
+private:
+  friend class DecodeWorker;
+
+  /**
+   * @brief Main loop of each worker thread
+   */
+  void WorkerLoop();
+
+  /**
+   * @brief Start worker threads until there's one per decode slot. Expects lock_ to be locked.
+   */
+  void StartWorkers();
+
+  /**
+   * @brief Add a job that isn't running to the queue of its priority. Expects lock_ to be locked.
+   */
+  void Enqueue(DecodeJob* job, Priority priority);
+
+  /**
+   * @brief Remove and return the next job a worker should run, or `nullptr` if none can run yet. Expects lock_ to be
+   * locked.
+   */
+  DecodeJob* TakeJob();
+
+  /**
+   * @brief Hand out codec threads to a decoder from what's left of the budget. Expects lock_ to be locked.
+   */
+  int GrantCodecThreads();
+
+  /**
+   * @brief Return codec threads handed out by GrantCodecThreads() to the budget. Expects lock_ to be locked.
+   */
+  void ReturnCodecThreads(int threads);
+
+  /**
+   * @brief Returns the current maximum amount of slots/codec threads from Config::decode_threads
+   */
+  static int thread_budget();
+
+  /**
+   * @brief Returns whether a job more urgent than `priority` is waiting. Expects lock_ to be locked.
+   */
+  bool HigherPriorityWaiting(Priority priority);
+
+  QMutex lock_;
+
+  QWaitCondition slot_freed_;
+
+  QWaitCondition job_finished_;
+
+  int active_jobs_;
+
+  /**
+   * @brief Jobs waiting for a slot per priority, both queued DecodeJobs and threads blocking in Acquire()
+   */
+  int waiting_jobs_[kPriorityCount];
+
+  QList<DecodeJob*> queued_jobs_[kPriorityCount];
+
+  QVector<QThread*> workers_;
+
+  bool quit_;
+
+  int open_decoders_;
+
+  /**
+   * @brief Codec threads currently handed out to decoders using more than one
+   */
+  int codec_threads_;
+};
+
+/**
+ * @brief The DecodeJob class
+ *
+ * Base class for work that runs on the DecodeScheduler's worker pool. The scheduler makes sure a job never runs on
+ * two workers at the same time.
+ */
+class DecodeJob {
+public:
+  DecodeJob();
+  virtual ~DecodeJob();
+
+protected:
+  /**
+   * @brief Do the decoding work this job was scheduled for
+   *
+   * Called on one of the scheduler's worker threads.
+   *
+   * @param priority
+   *
+   * Priority the job was scheduled with
+   */
+  virtual void RunDecodeJob(DecodeScheduler::Priority priority) = 0;
+
+private:
+  friend class DecodeScheduler;
+
+  // all protected by DecodeScheduler::lock_
+  bool queued_;
+  bool running_;
+  DecodeScheduler::Priority priority_;
+  bool requeue_;
+  DecodeScheduler::Priority requeue_priority_;
+};
+
+namespace olive {
+  /**
+   * @brief Global decode scheduler shared by all Cachers
+   */
+  extern DecodeScheduler decode_scheduler;
+}
+
+#endif // DECODESCHEDULER_H
@@ -0,0 +1,91 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "exportframequeue.h"
+
+#include <QMutexLocker>
+
+ExportFrameQueue::ExportFrameQueue(int capacity) :
+  capacity_(capacity),
+  finished_(false),
+  cancelled_(false)
+{
+}
+
+ExportFrameQueue::~ExportFrameQueue()
+{
+  while (!frames_.isEmpty()) {
+    AVFrame* frame = frames_.dequeue();
+    av_frame_free(&frame);
+  }
+}
+
+bool ExportFrameQueue::Push(AVFrame *frame)
+{
+  QMutexLocker locker(&lock_);
+
+  while (!cancelled_ && frames_.size() >= capacity_) {
+    frame_popped_.wait(&lock_);
+  }
+
+  if (cancelled_) {
+    return false;
+  }
+
+  frames_.enqueue(frame);
+  frame_pushed_.wakeOne();
+
+  return true;
+}
+
+AVFrame *ExportFrameQueue::Pop()
+{
+  QMutexLocker locker(&lock_);
+
+  while (!cancelled_ && !finished_ && frames_.isEmpty()) {
+    frame_pushed_.wait(&lock_);
+  }
+
+  if (cancelled_ || frames_.isEmpty()) {
+    return nullptr;
+  }
+
+  AVFrame* frame = frames_.dequeue();
+  frame_popped_.wakeOne();
+
+  return frame;
+}
+
+void ExportFrameQueue::Finish()
+{
+  QMutexLocker locker(&lock_);
+
+  finished_ = true;
+  frame_pushed_.wakeAll();
+}
+
+void ExportFrameQueue::Cancel()
+{
+  QMutexLocker locker(&lock_);
+
+  cancelled_ = true;
+  frame_pushed_.wakeAll();
+  frame_popped_.wakeAll();
+}
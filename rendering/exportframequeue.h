@@ -0,0 +1,109 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef EXPORTFRAMEQUEUE_H
+#define EXPORTFRAMEQUEUE_H
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+/**
+ * @brief The ExportFrameQueue class
+ *
+ * A bounded first-in-first-out queue of AVFrames that passes frames between two stages of the export pipeline (see
+ * ExportThread). A stage that gets ahead of the next one blocks in Push() until there's room, so the whole pipeline
+ * runs at the speed of its slowest stage without using unbounded memory.
+ *
+ * The queue owns any frames it contains and frees them when destroyed.
+ *
+ * All functions are thread-safe.
+ */
+class ExportFrameQueue {
+public:
+  /**
+   * @brief ExportFrameQueue Constructor
+   *
+   * @param capacity
+   *
+   * Maximum amount of frames the queue can hold before Push() blocks
+   */
+  ExportFrameQueue(int capacity);
+
+  /**
+   * @brief ExportFrameQueue Destructor
+   *
+   * Frees any frames still in the queue.
+   */
+  ~ExportFrameQueue();
+
+  /**
+   * @brief Add a frame to the end of the queue, waiting for room if the queue is full
+   *
+   * @return
+   *
+   * **TRUE** if the queue took ownership of the frame, **FALSE** if the queue was cancelled (in which case the caller
+   * retains ownership).
+   */
+  bool Push(AVFrame* frame);
+
+  /**
+   * @brief Take the first frame from the queue, waiting for one if the queue is empty
+   *
+   * @return
+   *
+   * The frame, which the caller takes ownership of, or `nullptr` if the queue was cancelled or finished and has no
+   * more frames.
+   */
+  AVFrame* Pop();
+
+  /**
+   * @brief Signal that no more frames will be pushed
+   *
+   * Pop() returns the remaining frames and then `nullptr` instead of waiting.
+   */
+  void Finish();
+
+  /**
+   * @brief Wake any stages waiting on this queue and make all further calls fail immediately
+   */
+  void Cancel();
+
+private:
+  QMutex lock_;
+
+  QWaitCondition frame_pushed_;
+
+  QWaitCondition frame_popped_;
+
+  QQueue<AVFrame*> frames_;
+
+  int capacity_;
+
+  bool finished_;
+
+  bool cancelled_;
+};
+
+#endif // EXPORTFRAMEQUEUE_H
@@ -31,20 +31,55 @@ extern "C" {
 #include <QOffscreenSurface>
 #include <QOpenGLPaintDevice>
 #include <QPainter>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
 #include <QtMath>
 
 #include "global/global.h"
-#include "panels/panels.h"
-#include "ui/viewerwidget.h"
 #include "rendering/renderthread.h"
 #include "rendering/renderfunctions.h"
 #include "rendering/audio.h"
+#include "rendering/audiomixdown.h"
 #include "ui/mainwindow.h"
 #include "global/debug.h"
 
+// RGBA frames that can be in the video pipeline at once (being rendered, waiting for readback, queued, or converting)
+const int kRenderedFrameCount = 5;
+
+// frames that can wait between two stages of the video pipeline
+const int kPipelineQueueSize = 2;
+
+// keyframe interval used to align segments if the encoder's default is used (in seconds)
+const double kSegmentKeyframeInterval = 2.0;
+
+// how often a segmented export reports the progress of its segments (in milliseconds)
+const int kSegmentProgressInterval = 500;
+
+ExportThread::Stage::Stage(ExportThread *exporter, void (ExportThread::*function)()) :
+  exporter_(exporter),
+  function_(function)
+{
+}
+
+void ExportThread::Stage::run()
+{
+  (exporter_->*function_)();
+}
+
 ExportThread::ExportThread(const ExportParams &params,
                            const VideoCodecParams& vparams,
                            QObject *parent) :
+  ExportThread(params, vparams, parent, true)
+{
+}
+
+ExportThread::ExportThread(const ExportParams &params,
+                           const VideoCodecParams &vparams,
+                           QObject *parent,
+                           bool take_snapshot) :
   QThread(parent),
   params_(params),
   vcodec_params_(vparams),
@@ -53,39 +88,61 @@ ExportThread::ExportThread(const ExportParams &params,
   video_stream(nullptr),
   vcodec(nullptr),
   vcodec_ctx(nullptr),
-  video_frame(nullptr),
   sws_ctx(nullptr),
   audio_stream(nullptr),
   acodec(nullptr),
   audio_frame(nullptr),
-  sws_frame(nullptr),
   swr_frame(nullptr),
   acodec_ctx(nullptr),
   swr_ctx(nullptr),
   vpkt_alloc(false),
   apkt_alloc(false),
-  c_filename(nullptr)
+  c_filename(nullptr),
+  renderer_ready_(false),
+  free_frames_(kRenderedFrameCount),
+  rendered_frames_(kPipelineQueueSize),
+  converted_frames_(kPipelineQueueSize),
+  video_converter_(this, &ExportThread::ConvertVideo),
+  video_encoder_(this, &ExportThread::EncodeVideo),
+  encode_failed_(0),
+  audio_context_(true),
+  renderer_(nullptr),
+  audio_segment_(nullptr),
+  progress_(0)
 {
-  // Create offscreen surface for rendering while exporting
-  surface.create();
+  if (take_snapshot) {
+    snapshot_ = params.sequence->Snapshot();
+    params_.sequence = snapshot_.get();
+  }
+
+  // an export that won't be split renders everything itself (whether one that may be split does is decided in run())
+  if (take_snapshot && !SegmentsRequested()) {
+    PrepareRender();
+  }
+}
+
+ExportThread::~ExportThread()
+{
+  delete renderer_;
 }
 
 bool ExportThread::Encode(AVFormatContext* ofmt_ctx, AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* packet, AVStream* stream) {
-  ret = avcodec_send_frame(codec_ctx, frame);
-  if (ret < 0) {
-    qCritical() << "Failed to send frame to encoder." << ret;
-    export_error = tr("failed to send frame to encoder (%1)").arg(QString::number(ret));
+  // video and audio are encoded on different threads, so this function doesn't use the shared `ret`
+  int err = avcodec_send_frame(codec_ctx, frame);
+  if (err < 0) {
+    qCritical() << "Failed to send frame to encoder." << err;
+    SetError(tr("failed to send frame to encoder (%1)").arg(QString::number(err)));
     return false;
   }
 
-  while (ret >= 0) {
-    ret = avcodec_receive_packet(codec_ctx, packet);
-    if (ret == AVERROR(EAGAIN)) {
+  while (err >= 0) {
+    err = avcodec_receive_packet(codec_ctx, packet);
+    if (err == AVERROR(EAGAIN)) {
       return true;
-    } else if (ret < 0) {
-      if (ret != AVERROR_EOF) {
-        qCritical() << "Failed to receive packet from encoder." << ret;
-        export_error = tr("failed to receive packet from encoder (%1)").arg(QString::number(ret));
+    } else if (err < 0) {
+      if (err != AVERROR_EOF) {
+        qCritical() << "Failed to receive packet from encoder." << err;
+        SetError(tr("failed to receive packet from encoder (%1)").arg(QString::number(err)));
       }
       return false;
     }
@@ -94,12 +151,21 @@ bool ExportThread::Encode(AVFormatContext* ofmt_ctx, AVCodecContext* codec_ctx,
 
     av_packet_rescale_ts(packet, codec_ctx->time_base, stream->time_base);
 
+    output_lock_.lock();
     av_interleaved_write_frame(ofmt_ctx, packet);
+    output_lock_.unlock();
+
     av_packet_unref(packet);
   }
   return true;
 }
 
+void ExportThread::SetError(const QString &error)
+{
+  QMutexLocker locker(&output_lock_);
+  export_error = error;
+}
+
 bool ExportThread::SetupVideo() {
   // if video is disabled, no setup necessary
   if (!params_.video_enabled) return true;
@@ -143,6 +209,9 @@ bool ExportThread::SetupVideo() {
   }
   vcodec_ctx->time_base = av_inv_q(vcodec_ctx->framerate);
   video_stream->time_base = vcodec_ctx->time_base;
+  if (vcodec_params_.gop_size > 0) {
+    vcodec_ctx->gop_size = vcodec_params_.gop_size;
+  }
 
   if (fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
     vcodec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
@@ -188,13 +257,15 @@ bool ExportThread::SetupVideo() {
     return false;
   }
 
-  // Create raw AVFrame that will contain the RGBA buffer straight from compositing
-  video_frame = av_frame_alloc();
-  av_frame_make_writable(video_frame);
-  video_frame->format = AV_PIX_FMT_RGBA;
-  video_frame->width = params_.sequence->width();
-  video_frame->height = params_.sequence->height();
-  av_frame_get_buffer(video_frame, 0);
+  // Create raw AVFrames that will contain the RGBA buffers straight from compositing
+  for (int i=0;i<kRenderedFrameCount;i++) {
+    AVFrame* rendered_frame = av_frame_alloc();
+    rendered_frame->format = AV_PIX_FMT_RGBA;
+    rendered_frame->width = params_.sequence->width();
+    rendered_frame->height = params_.sequence->height();
+    av_frame_get_buffer(rendered_frame, 0);
+    free_frames_.Push(rendered_frame);
+  }
 
   av_init_packet(&video_pkt);
 
@@ -238,9 +309,6 @@ bool ExportThread::SetupAudio() {
   // Set audio stream's ID to 1
   audio_stream->id = 1;
 
-  // set sample rate to use for project
-  audio_rendering_rate = params_.audio_sampling_rate;
-
   // Allocate encoding context
   acodec_ctx = avcodec_alloc_context3(acodec);
   if (!acodec_ctx) {
@@ -289,7 +357,7 @@ bool ExportThread::SetupAudio() {
         acodec_ctx->sample_fmt,
         acodec_ctx->sample_rate,
         params_.sequence->audio_layout(),
-        AV_SAMPLE_FMT_S16,
+        AV_SAMPLE_FMT_FLT,
         acodec_ctx->sample_rate,
         0,
         nullptr
@@ -309,7 +377,7 @@ bool ExportThread::SetupAudio() {
   // TODO change this to support surround/mono sound in the future (this is whatever format they're held in the internal buffer)
   audio_frame->channel_layout = AV_CH_LAYOUT_STEREO;
 
-  audio_frame->format = AV_SAMPLE_FMT_S16;
+  audio_frame->format = AV_SAMPLE_FMT_FLT;
   audio_frame->channels = av_get_channel_layout_nb_channels(audio_frame->channel_layout);
   av_frame_make_writable(audio_frame);
   ret = av_frame_get_buffer(audio_frame, 0);
@@ -400,117 +468,117 @@ void ExportThread::Export()
   // Count audio samples in file (used for calculating PTS)
   long file_audio_samples = 0;
 
+  // Mix audio down offline if every clip supports it, otherwise render it through the clips' Cachers like playback
+  AudioMixdown mixdown(params_.sequence, params_.start_frame, params_.end_frame + 1, params_.audio_sampling_rate);
+  bool offline_audio = (params_.audio_enabled && mixdown.Prepare());
+
+  // Start rendering audio from the first frame at the export's sample rate
+  audio_context_.Reset(params_.start_frame, params_.sequence->frame_rate(), params_.audio_sampling_rate);
+  int aframe_samples = aframe_bytes / int(sizeof(float));
+
   // Set up timing variables, used for determining rendering ETA
   qint64 frame_start_time, frame_time, avg_time, eta, total_time = 0;
 
   // Frame counters - used for generating encoding statistics (e.g. average frame time, ETA, etc.)
   long remaining_frames, frame_count = 1;
 
-  // Use Sequence Viewer's render thread - TODO separate this into a new render thread for background rendering
-  RenderThread* renderer = panel_sequence_viewer->viewer_widget()->get_renderer();
+  // Video is exported through a pipeline where each stage works on a different frame at the same time:
+  //
+  // - This thread composites frames on the RenderThread, which reads each one back asynchronously while the next one
+  //   is composited (so a frame's pixels have only arrived once the frame after it has rendered)
+  // - The converter stage converts the RGBA frames to the encoder's pixel format
+  // - The encoder stage encodes the converted frames and writes them to the file
+  //
+  // The stages are connected by bounded queues, so the export runs at the speed of its slowest stage.
+  if (params_.video_enabled) {
+    video_converter_.start();
+    video_encoder_.start();
+  }
 
-  // Override connection from RenderThread
-  disconnect(renderer, SIGNAL(ready()), panel_sequence_viewer->viewer_widget(), SLOT(queue_repaint()));
-  connect(renderer, SIGNAL(ready()), this, SLOT(wake()));
+  // The most recently rendered frame, waiting for its readback to complete
+  AVFrame* rendered_frame = nullptr;
 
   // Loop from now (set to the beginning frame earlier) to the end of the frame
-  while (params_.sequence->playhead <= params_.end_frame && !interrupt_) {
+  while (params_.sequence->playhead <= params_.end_frame && !interrupt_ && !encode_failed_.loadAcquire()) {
 
     // Start timing how long this frame will take
     frame_start_time = QDateTime::currentMSecsSinceEpoch();
 
-    // If we're exporting audio, run compose_audio() which will write mixed audio to the internal audio buffer
-    if (params_.audio_enabled) {
-      waiting_for_audio_ = true;
-      SetAudioWakeObject(this);
-      olive::rendering::compose_audio(nullptr, params_.sequence, 1, true);
+    // If we're exporting audio in real-time, run compose_audio() which will write audio to the export's audio context
+    if (params_.audio_enabled && !offline_audio) {
+      olive::rendering::compose_audio(nullptr, params_.sequence, &audio_context_, 1, true);
     }
 
+    // Get the current sequence playhead in seconds (used for timestamp calculations later on)
+    double timecode_secs = double(params_.sequence->playhead - params_.start_frame) / params_.sequence->frame_rate();
+
     // If we're exporting video, trigger a render on the RenderThread
     if (params_.video_enabled) {
+
+      // Get an RGBA frame to render into (if the pipeline is full, this waits for the converter to free one)
+      AVFrame* frame = free_frames_.Pop();
+      if (frame == nullptr) {
+        break;
+      }
+
       do {
-        // TODO optimize by rendering the next frame while encoding the last
-        renderer->start_render(nullptr, params_.sequence, 1, nullptr, video_frame->data[0], video_frame->linesize[0]/4);
+        renderer_->start_render(nullptr, params_.sequence, 1, nullptr, frame->data[0], frame->linesize[0]/4);
 
         // Wait for RenderThread to return
-        waitCond.wait(&mutex);
-
-        if (interrupt_) {
-          return;
-        }
+        WaitForRenderer();
 
         // If the RenderThread failed, do another render
-      } while (renderer->did_texture_fail());
+      } while (renderer_->did_texture_fail() && !interrupt_);
 
-      if (interrupt_) {
-        return;
+      // Interrupted before the frame rendered successfully, in which case it was never read back
+      if (renderer_->did_texture_fail()) {
+        av_frame_free(&frame);
+        break;
       }
 
-    }
+      frame->pts = qRound(timecode_secs/av_q2d(vcodec_ctx->time_base));
 
-    // Get the current sequence playhead in seconds (used for timestamp calculations later on)
-    double timecode_secs = double(params_.sequence->playhead - params_.start_frame) / params_.sequence->frame_rate();
-
-    // If we're exporting video, construct an AVFrame in the destination codec's pixel format to convert the raw RGBA
-    // OpenGL buffer to
-    if (params_.video_enabled) {
-
-      //
-      // - I'm not sure why, but we have to alloc/free sws_frame every frame, or it breaks GIF exporting.
-      // - (i.e. GIFs get stuck on the first frame)
-      // - The same problem/solution can be seen here: https://stackoverflow.com/a/38997739
-      // - Perhaps this is the intended way to use swscale, but it seems inefficient.
-      // - Anyway, here we are.
-      //
-
-      // Construct destination pixel format frame
-      sws_frame = av_frame_alloc();
-      sws_frame->format = vcodec_ctx->pix_fmt;
-      sws_frame->width = params_.video_width;
-      sws_frame->height = params_.video_height;
-      av_frame_get_buffer(sws_frame, 0);
-
-      // Convert raw RGBA buffer to format expected by the encoder
-      sws_scale(sws_ctx, video_frame->data, video_frame->linesize, 0, video_frame->height, sws_frame->data, sws_frame->linesize);
-      sws_frame->pts = qRound(timecode_secs/av_q2d(vcodec_ctx->time_base));
-
-      // Send frame to encoder
-      if (!Encode(fmt_ctx, vcodec_ctx, sws_frame, &video_pkt, video_stream)) {
-        return;
+      // Now that this frame has rendered, the previous frame's readback is complete and it can be converted
+      if (rendered_frame != nullptr && !rendered_frames_.Push(rendered_frame)) {
+        av_frame_free(&rendered_frame);
       }
+      rendered_frame = frame;
 
-      av_frame_free(&sws_frame);
-      sws_frame = nullptr;
+      if (interrupt_) {
+        break;
+      }
     }
 
     // If we're exporting audio, copy audio from the buffer into an AVFrame for encoding
     if (params_.audio_enabled) {
 
-      if (waiting_for_audio_ && !interrupt_) {
-        waitCond.wait(&mutex);
-      }
-
-      // Make sure nothing is writing while we're retrieving
-      audio_write_lock.lock();
-
       // Check if the count of encoded samples exceeds the current Sequence playhead, in which case we don't need to
       // encode any audio at this moment
       while (!interrupt_ && file_audio_samples <= (timecode_secs*params_.audio_sampling_rate)) {
 
-        // Copy samples from audio buffer to AVFrame
-        int adjusted_read = audio_ibuffer_read%audio_ibuffer_size;
-        int copylen = qMin(aframe_bytes, audio_ibuffer_size-adjusted_read);
-        memcpy(audio_frame->data[0], audio_ibuffer+adjusted_read, copylen);
-        memset(audio_ibuffer+adjusted_read, 0, copylen);
-        audio_ibuffer_read += copylen;
-
-        // If we reached the end of the buffer without reaching the end of the frame, do another copy from the start
-        // of the buffer
-        if (copylen < aframe_bytes) {
-          int remainder_len = aframe_bytes-copylen;
-          memcpy(audio_frame->data[0]+copylen, audio_ibuffer, remainder_len);
-          memset(audio_ibuffer, 0, remainder_len);
-          audio_ibuffer_read += remainder_len;
+        if (offline_audio) {
+
+          // Render the next block of the mixdown straight into the AVFrame
+          mixdown.Render(reinterpret_cast<float*>(audio_frame->data[0]), audio_frame->nb_samples);
+
+        } else {
+
+          // Wait until every clip has written the samples we're about to mix. A clip that was still opening when
+          // compose_audio() ran won't have started caching yet, so ask again if it's taking too long.
+          qint64 mix_end = audio_context_.mixer()->read_position() + aframe_samples;
+          int attempts = 0;
+          while (!interrupt_ && !audio_context_.WaitForAudio(mix_end, 100)) {
+            attempts++;
+            if (attempts == 50) {
+              qWarning() << "Timed out waiting for audio at frame" << params_.sequence->playhead;
+              break;
+            }
+            olive::rendering::compose_audio(nullptr, params_.sequence, &audio_context_, 1, true);
+          }
+
+          // Mix samples from the audio context into the AVFrame
+          audio_context_.mixer()->Mix(reinterpret_cast<float*>(audio_frame->data[0]), aframe_samples);
+
         }
 
         // Convert raw audio samples to the destination codec's sample format
@@ -521,15 +589,14 @@ void ExportThread::Export()
 
         // Send frame to encoder
         if (!Encode(fmt_ctx, acodec_ctx, swr_frame, &audio_pkt, audio_stream)) {
-          return;
+          encode_failed_.storeRelease(1);
+          break;
         }
 
         // Increment by the frame's number of samples
         file_audio_samples += swr_frame->nb_samples;
       }
 
-      audio_write_lock.unlock();
-
     }
 
     // Generating encoding statistics (e.g. the time it took to encode this frame/estimated remaining time)
@@ -540,7 +607,8 @@ void ExportThread::Export()
     eta = (remaining_frames*avg_time);
 
     // Emit a signal for the percent of the sequence that's been encoded so far
-    emit ProgressChanged(qRound((double(params_.sequence->playhead - params_.start_frame) / double(params_.end_frame - params_.start_frame)) * 100.0), eta);
+    // (100% is only emitted once the file has been completely written)
+    SetProgress(qMin(99, qRound((double(params_.sequence->playhead - params_.start_frame) / double(params_.end_frame - params_.start_frame)) * 100.0)), eta);
 
     // Increment sequence playhead
     params_.sequence->playhead++;
@@ -549,19 +617,29 @@ void ExportThread::Export()
     frame_count++;
   }
 
-  // Restore original connection from RenderThread
-  disconnect(renderer, SIGNAL(ready()), this, SLOT(wake()));
-  connect(renderer, SIGNAL(ready()), panel_sequence_viewer->viewer_widget(), SLOT(queue_repaint()));
+  if (params_.video_enabled) {
+    // Complete the last frame's readback, the RenderThread must not write into it once it's been freed
+    renderer_->finish_readback();
+    WaitForRenderer();
 
-  if (interrupt_) {
+    if (rendered_frame != nullptr
+        && (interrupt_ || encode_failed_.loadAcquire() || !rendered_frames_.Push(rendered_frame))) {
+      av_frame_free(&rendered_frame);
+    }
+
+    // Let the converter and encoder finish the rest of the frames
+    rendered_frames_.Finish();
+    video_converter_.wait();
+    video_encoder_.wait();
+  }
+
+  if (interrupt_ || encode_failed_.loadAcquire()) {
     return;
   }
 
   if (params_.video_enabled) vpkt_alloc = true;
   if (params_.audio_enabled) apkt_alloc = true;
 
-  olive::Global->set_export_state(false);
-
   // If audio is enabled, flush the rest of the audio out of swresample
   if (params_.audio_enabled) {
 
@@ -599,7 +677,7 @@ void ExportThread::Export()
     return;
   }
 
-  emit ProgressChanged(100, 0);
+  SetProgress(100, 0);
 }
 
 void ExportThread::Cleanup()
@@ -627,10 +705,6 @@ void ExportThread::Cleanup()
     avcodec_free_context(&vcodec_ctx);
   }
 
-  if (video_frame != nullptr) {
-    av_frame_free(&video_frame);
-  }
-
   if (vpkt_alloc) {
     av_packet_unref(&video_pkt);
   }
@@ -647,30 +721,59 @@ void ExportThread::Cleanup()
     av_frame_free(&swr_frame);
   }
 
-  if (sws_frame != nullptr) {
-    av_frame_free(&sws_frame);
-  }
-
   delete [] c_filename;
 }
 
 void ExportThread::run() {
-  // Ensure sequence isn't currently playing
-  panel_sequence_viewer->pause();
+  if (SegmentsRequested()) {
+    PlanSegments();
+  }
 
-  // Seek to the first frame we're exporting
-  panel_sequence_viewer->seek(params_.start_frame);
+  if (!segments_.isEmpty()) {
 
-  // Lock mutex (used for thread synchronizations)
-  mutex.lock();
+    // Export the segments on the child threads and join them together
+    ExportSegments();
 
-  // Run export function (which will return if there's a failure)
-  Export();
+  } else if (!passthrough_.filename.isEmpty() && (CopySourcePackets() || interrupt_)) {
 
-  mutex.unlock();
+    // This segment was copied from its source file, so there's nothing to render
+
+  } else {
+
+    // A segment that couldn't be copied after all has to render from its own snapshot, which is taken on the main thread
+    if (snapshot_ == nullptr || (params_.video_enabled && renderer_ == nullptr)) {
+      QMetaObject::invokeMethod(this, "PrepareRender", Qt::BlockingQueuedConnection);
+    }
 
-  // Clean up anything that was allocated in Export() (whether it succeeded or not)
-  Cleanup();
+    // Start from the first frame we're exporting
+    params_.sequence->playhead = params_.start_frame;
+
+    if (renderer_ != nullptr) {
+      renderer_->start(QThread::HighestPriority);
+    }
+
+    // Lock mutex (used for thread synchronizations)
+    mutex.lock();
+
+    // Run export function (which will return if there's a failure)
+    Export();
+
+    mutex.unlock();
+
+    // Make sure the pipeline stages have stopped before freeing anything they use
+    CancelPipeline();
+    video_converter_.wait();
+    video_encoder_.wait();
+
+    // Stop the renderer, which closes the snapshot's clips in its context
+    if (renderer_ != nullptr) {
+      renderer_->cancel();
+    }
+
+    // Clean up anything that was allocated in Export() (whether it succeeded or not)
+    Cleanup();
+
+  }
 }
 
 const QString &ExportThread::GetError() {
@@ -684,22 +787,794 @@ bool ExportThread::WasInterrupted()
 
 void ExportThread::Interrupt()
 {
+  for (int i=0;i<segments_.size();i++) {
+    segments_.at(i)->Interrupt();
+  }
+  if (audio_segment_ != nullptr) {
+    audio_segment_->Interrupt();
+  }
+
+  // wake any stage waiting on a queue first, the export thread may be waiting on one while holding the mutex
+  CancelPipeline();
+
   mutex.lock();
   interrupt_ = true;
   waitCond.wakeAll();
   mutex.unlock();
 }
 
-void ExportThread::play_wake()
+void ExportThread::SetProgress(int value, qint64 remaining_ms)
+{
+  progress_.storeRelease(value);
+  emit ProgressChanged(value, remaining_ms);
+}
+
+bool ExportThread::SegmentsRequested()
+{
+  return params_.video_enabled && (vcodec_params_.segments > 1 || vcodec_params_.smart_render);
+}
+
+void ExportThread::PlanSegments()
 {
+  // the segments are joined by their timestamps, which formats like image sequences don't have
+  QByteArray filename = params_.filename.toUtf8();
+  AVOutputFormat* format = av_guess_format(nullptr, filename.constData(), nullptr);
+  if (format == nullptr || (format->flags & AVFMT_NOTIMESTAMPS)) {
+    qWarning() << "Segmented export isn't supported by this format, exporting a single stream instead";
+    return;
+  }
+
+  // find the parts of the range that can be copied from their source files rather than rendered (this opens the
+  // files, which is why it's done on this thread rather than in the constructor)
+  if (vcodec_params_.smart_render) {
+    passthrough_ranges_ = olive::passthrough::find_ranges(params_.sequence, params_, vcodec_params_);
+  }
+
+  // the child threads take their snapshots of the sequence on the main thread
+  QMetaObject::invokeMethod(this, "CreateSegments", Qt::BlockingQueuedConnection);
+}
+
+void ExportThread::CreateSegments()
+{
+  const QVector<PassthroughRange>& passthrough = passthrough_ranges_;
+
+  VideoCodecParams segment_vparams = vcodec_params_;
+  segment_vparams.segments = 1;
+  segment_vparams.smart_render = false;
+
+  if (vcodec_params_.segments > 1) {
+    // each segment starts with a keyframe, so rendered ranges are split on multiples of the keyframe interval to keep
+    // the joined file's keyframes where a single stream export would put them
+    if (segment_vparams.gop_size <= 0) {
+      segment_vparams.gop_size = qMax(1, qRound(params_.video_frame_rate * kSegmentKeyframeInterval));
+    }
+
+    // share the CPU between the segments' encoders rather than letting every encoder use all of it
+    if (segment_vparams.threads == 0) {
+      segment_vparams.threads = qMax(1, QThread::idealThreadCount() / vcodec_params_.segments);
+    }
+  }
+
+  // render the frames between the copied ranges
+  long position = params_.start_frame;
+  for (int i=0;i<passthrough.size();i++) {
+    const PassthroughRange& range = passthrough.at(i);
+
+    AddRenderSegments(position, range.start_frame - 1, segment_vparams);
+
+    AddSegment(range.start_frame, range.end_frame, segment_vparams)->passthrough_ = range;
+
+    position = range.end_frame + 1;
+  }
+  AddRenderSegments(position, params_.end_frame, segment_vparams);
+
+  // if there's nothing to copy and the range is too short to split, just export a single stream
+  if (passthrough.isEmpty() && segments_.size() < 2) {
+    qDeleteAll(segments_);
+    segments_.clear();
+    return;
+  }
+
+  // only the segments that render need a snapshot and renderer of their own
+  for (int i=0;i<segments_.size();i++) {
+    if (segments_.at(i)->passthrough_.filename.isEmpty()) {
+      segments_.at(i)->PrepareRender();
+    }
+  }
+
+  if (!passthrough.isEmpty()) {
+    long copied_frames = 0;
+    for (int i=0;i<passthrough.size();i++) {
+      copied_frames += passthrough.at(i).end_frame - passthrough.at(i).start_frame + 1;
+    }
+    qInfo() << "Copying" << copied_frames << "of" << (params_.end_frame - params_.start_frame + 1)
+            << "frames from their source files";
+  }
+
+  // the audio isn't split, it's exported once alongside the video segments
+  if (params_.audio_enabled) {
+    ExportParams audio_params = params_;
+
+    audio_params.filename = SegmentFilename("audio");
+    audio_params.video_enabled = false;
+
+    audio_segment_ = new ExportThread(audio_params, segment_vparams, this, false);
+    audio_segment_->PrepareRender();
+
+    connect(audio_segment_, SIGNAL(finished()), this, SLOT(SegmentFinished()), Qt::DirectConnection);
+  }
+}
+
+QString ExportThread::SegmentFilename(const QString &name)
+{
+  // segment files are written next to the output file, e.g. "movie.segment0.mp4"
+  QFileInfo output_info(params_.filename);
+  return QString("%1.%2.%3").arg(output_info.dir().filePath(output_info.completeBaseName()),
+                                 name,
+                                 output_info.suffix());
+}
+
+ExportThread* ExportThread::AddSegment(long start_frame, long end_frame, const VideoCodecParams &vparams)
+{
+  ExportParams segment_params = params_;
+
+  segment_params.filename = SegmentFilename(QString("segment%1").arg(segments_.size()));
+  segment_params.audio_enabled = false;
+  segment_params.start_frame = start_frame;
+  segment_params.end_frame = end_frame;
+
+  // the segment's params point to this thread's snapshot until it takes its own (see PrepareRender())
+  ExportThread* segment = new ExportThread(segment_params, vparams, this, false);
+  segments_.append(segment);
+
+  // children signal from their own threads while ExportSegments() is waiting for them
+  connect(segment, SIGNAL(finished()), this, SLOT(SegmentFinished()), Qt::DirectConnection);
+
+  return segment;
+}
+
+void ExportThread::AddRenderSegments(long start_frame, long end_frame, const VideoCodecParams &vparams)
+{
+  if (end_frame < start_frame) {
+    return;
+  }
+
+  if (vcodec_params_.segments < 2) {
+    AddSegment(start_frame, end_frame, vparams);
+    return;
+  }
+
+  // split the range into up to VideoCodecParams::segments parts on keyframe boundaries
+  long length = end_frame - start_frame + 1;
+  long gop_count = (length + vparams.gop_size - 1) / vparams.gop_size;
+  int segment_count = int(qMin(long(vcodec_params_.segments), gop_count));
+
+  for (int i=0;i<segment_count;i++) {
+    long segment_start = start_frame + (gop_count * i / segment_count) * vparams.gop_size;
+    long segment_end = (i == segment_count - 1) ?
+          end_frame : start_frame + (gop_count * (i + 1) / segment_count) * vparams.gop_size - 1;
+
+    AddSegment(segment_start, segment_end, vparams);
+  }
+}
+
+void ExportThread::ExportSegments()
+{
+  // the audio is exported alongside all of the video segments
+  if (audio_segment_ != nullptr) {
+    audio_segment_->start();
+  }
+
+  // amount of video segments exported at the same time
+  int concurrency = qMax(1, vcodec_params_.segments);
+  int next_segment = 0;
+  bool failed = false;
+
+  QElapsedTimer timer;
+  timer.start();
+  qint64 last_progress_time = 0;
+  double total_frames = double(params_.end_frame - params_.start_frame + 1);
+
+  // Start the segments in order as others finish, and report their combined progress until every child has finished
   mutex.lock();
-  waiting_for_audio_ = false;
-  waitCond.wakeAll();
+
+  bool running = true;
+  while (running) {
+
+    int active = 0;
+    for (int i=0;i<next_segment;i++) {
+      if (!segments_.at(i)->isFinished()) {
+        active++;
+      }
+    }
+
+    while (!failed && !interrupt_ && active < concurrency && next_segment < segments_.size()) {
+      segments_.at(next_segment)->start();
+      next_segment++;
+      active++;
+    }
+
+    QVector<ExportThread*> started = segments_.mid(0, next_segment);
+    if (audio_segment_ != nullptr) {
+      started.append(audio_segment_);
+    }
+
+    running = (!failed && !interrupt_ && next_segment < segments_.size());
+
+    for (int i=0;i<started.size();i++) {
+      ExportThread* child = started.at(i);
+
+      if (!child->isFinished()) {
+        running = true;
+      } else if (!failed && child->progress_.loadAcquire() != 100 && !child->WasInterrupted()) {
+        // if one child fails, there's no point in finishing the others
+        failed = true;
+
+        for (int j=0;j<started.size();j++) {
+          if (!started.at(j)->isFinished()) {
+            started.at(j)->Interrupt();
+          }
+        }
+      }
+    }
+
+    // sleep until a child finishes, the export is interrupted or it's time to report progress again
+    if (running) {
+      waitCond.wait(&mutex, qMax(qint64(1), kSegmentProgressInterval - (timer.elapsed() - last_progress_time)));
+    }
+
+    if (timer.elapsed() - last_progress_time >= kSegmentProgressInterval) {
+      last_progress_time = timer.elapsed();
+
+      double finished_frames = 0;
+      for (int i=0;i<segments_.size();i++) {
+        ExportThread* segment = segments_.at(i);
+        double segment_frames = double(segment->params_.end_frame - segment->params_.start_frame + 1);
+        finished_frames += segment_frames * segment->progress_.loadAcquire() / 100.0;
+      }
+
+      // (100% is only emitted once the segments have been joined)
+      int progress = qMin(99, qFloor(finished_frames / total_frames * 100.0));
+      qint64 eta = 0;
+      if (progress > 0) {
+        eta = last_progress_time * (100 - progress) / progress;
+      }
+      emit ProgressChanged(progress, eta);
+    }
+  }
+
   mutex.unlock();
+
+  QVector<ExportThread*> children = segments_;
+  if (audio_segment_ != nullptr) {
+    children.append(audio_segment_);
+  }
+
+  bool succeeded = (!interrupt_ && !failed);
+
+  for (int i=0;i<children.size();i++) {
+    ExportThread* child = children.at(i);
+
+    // (returns immediately for segments that were never started)
+    child->wait();
+
+    if (child->progress_.loadAcquire() != 100) {
+      succeeded = false;
+
+      // report the error that caused the export to stop (children that were interrupted have no error)
+      if (export_error.isEmpty()) {
+        export_error = child->GetError();
+      }
+    }
+  }
+
+  if (succeeded) {
+    succeeded = ConcatenateSegments();
+  }
+
+  for (int i=0;i<children.size();i++) {
+    QFile::remove(children.at(i)->params_.filename);
+  }
+
+  if (succeeded) {
+    SetProgress(100, 0);
+  }
+}
+
+bool ExportThread::CopySourcePackets()
+{
+  QByteArray source_filename = passthrough_.filename.toUtf8();
+  QByteArray filename = params_.filename.toUtf8();
+
+  AVFormatContext* input = nullptr;
+  AVFormatContext* output = nullptr;
+  AVStream* source = nullptr;
+  AVStream* stream = nullptr;
+  QString reason;
+  bool ok = true;
+
+  // Open the source file and set up the segment file with a copy of its video stream
+  if (avformat_open_input(&input, source_filename.constData(), nullptr, nullptr) < 0
+      || avformat_find_stream_info(input, nullptr) < 0
+      || passthrough_.stream_index >= int(input->nb_streams)) {
+    reason = "couldn't open the source file";
+    ok = false;
+  }
+
+  if (ok) {
+    source = input->streams[passthrough_.stream_index];
+
+    avformat_alloc_output_context2(&output, nullptr, nullptr, filename.constData());
+    if (output == nullptr) {
+      reason = "couldn't create an output context";
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    stream = avformat_new_stream(output, nullptr);
+    if (stream == nullptr || avcodec_parameters_copy(stream->codecpar, source->codecpar) < 0) {
+      reason = "couldn't create the output stream";
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    stream->codecpar->codec_tag = 0;
+    stream->time_base = source->time_base;
+
+    if (avio_open(&output->pb, filename.constData(), AVIO_FLAG_WRITE) < 0
+        || avformat_write_header(output, nullptr) < 0) {
+      reason = "couldn't write the segment file";
+      ok = false;
+    }
+  }
+
+  if (ok && av_seek_frame(input, source->index, passthrough_.start_pts, AVSEEK_FLAG_BACKWARD) < 0) {
+    reason = "couldn't seek the source file";
+    ok = false;
+  }
+
+  long expected_frames = params_.end_frame - params_.start_frame + 1;
+  long copied_frames = 0;
+
+  if (ok) {
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = nullptr;
+    packet.size = 0;
+
+    bool started = false;
+
+    // Copy every packet from the first keyframe up to (but not including) the last keyframe
+    while (!interrupt_ && av_read_frame(input, &packet) >= 0) {
+      if (packet.stream_index != source->index) {
+        av_packet_unref(&packet);
+        continue;
+      }
+
+      bool keyframe = (packet.flags & AV_PKT_FLAG_KEY);
+
+      if (!started) {
+        // skip the packets before the first keyframe that the seek landed before
+        if (!keyframe || packet.pts == AV_NOPTS_VALUE || packet.pts < passthrough_.start_pts) {
+          av_packet_unref(&packet);
+          continue;
+        }
+        started = true;
+      } else if (keyframe && packet.pts >= passthrough_.end_pts) {
+        av_packet_unref(&packet);
+        break;
+      }
+
+      // frames from outside the range in between (e.g. open GOPs, where frames before a keyframe are decoded after
+      // it) would need frames that aren't being copied to decode them
+      if (packet.pts == AV_NOPTS_VALUE || packet.pts < passthrough_.start_pts || packet.pts >= passthrough_.end_pts) {
+        reason = "the source's frames don't stay between its keyframes";
+        av_packet_unref(&packet);
+        ok = false;
+        break;
+      }
+
+      // segment timestamps start at the segment's first frame
+      packet.pts -= passthrough_.start_pts;
+      if (packet.dts != AV_NOPTS_VALUE) {
+        packet.dts -= passthrough_.start_pts;
+      }
+
+      packet.stream_index = stream->index;
+      av_packet_rescale_ts(&packet, source->time_base, stream->time_base);
+
+      if (av_interleaved_write_frame(output, &packet) < 0) {
+        reason = "couldn't write to the segment file";
+        ok = false;
+        break;
+      }
+
+      copied_frames++;
+
+      int progress = int(qMin(99L, copied_frames * 100 / expected_frames));
+      if (progress != progress_.loadAcquire()) {
+        SetProgress(progress, 0);
+      }
+    }
+
+    av_packet_unref(&packet);
+  }
+
+  // The copied frames must line up with the frames the rest of the export renders around them
+  if (ok && !interrupt_ && copied_frames != expected_frames) {
+    reason = QString("copied %1 frames instead of %2").arg(QString::number(copied_frames),
+                                                          QString::number(expected_frames));
+    ok = false;
+  }
+
+  if (ok && !interrupt_ && av_write_trailer(output) < 0) {
+    reason = "couldn't write the segment file's trailer";
+    ok = false;
+  }
+
+  avformat_close_input(&input);
+
+  if (output != nullptr) {
+    avio_closep(&output->pb);
+    avformat_free_context(output);
+  }
+
+  if (interrupt_) {
+    return false;
+  }
+
+  if (!ok) {
+    qInfo() << "Rendering frames" << params_.start_frame << "to" << params_.end_frame
+            << "instead of copying them," << reason;
+    return false;
+  }
+
+  SetProgress(100, 0);
+
+  return true;
+}
+
+// reads the next packet of a segment file's only stream, returns false at the end of the file
+static bool read_segment_packet(AVFormatContext* input, AVPacket* packet) {
+  while (av_read_frame(input, packet) >= 0) {
+    if (packet->stream_index == 0) {
+      return true;
+    }
+    av_packet_unref(packet);
+  }
+  return false;
+}
+
+// adds a stream to the output with the same parameters as a segment file's stream
+static AVStream* copy_segment_stream(AVFormatContext* output, AVStream* input) {
+  AVStream* stream = avformat_new_stream(output, nullptr);
+  if (stream == nullptr || avcodec_parameters_copy(stream->codecpar, input->codecpar) < 0) {
+    return nullptr;
+  }
+  stream->codecpar->codec_tag = 0;
+  stream->time_base = input->time_base;
+  return stream;
+}
+
+// the timestamp packets are interleaved by
+static int64_t packet_time(AVPacket* packet) {
+  return (packet->dts == AV_NOPTS_VALUE) ? packet->pts : packet->dts;
+}
+
+bool ExportThread::ConcatenateSegments()
+{
+  QVector<ExportThread*> sources = segments_;
+  if (audio_segment_ != nullptr) {
+    sources.append(audio_segment_);
+  }
+
+  QVector<AVFormatContext*> inputs;
+  AVFormatContext* output = nullptr;
+  AVStream* video_out = nullptr;
+  AVStream* audio_out = nullptr;
+  AVFormatContext* audio_in = nullptr;
+  bool ok = true;
+  int err;
+
+  // Open every segment file
+  for (int i=0;i<sources.size();i++) {
+    AVFormatContext* input = nullptr;
+    QByteArray source_filename = sources.at(i)->params_.filename.toUtf8();
+
+    err = avformat_open_input(&input, source_filename.constData(), nullptr, nullptr);
+    if (err >= 0) {
+      err = avformat_find_stream_info(input, nullptr);
+    }
+    if (err >= 0 && input->nb_streams == 0) {
+      err = AVERROR_INVALIDDATA;
+    }
+
+    if (err < 0) {
+      qCritical() << "Could not open export segment" << sources.at(i)->params_.filename << err;
+      export_error = tr("could not open export segment (%1)").arg(QString::number(err));
+      avformat_close_input(&input);
+      ok = false;
+      break;
+    }
+
+    inputs.append(input);
+  }
+
+  // Set up the output file with the same streams as the segments
+  QByteArray filename = params_.filename.toUtf8();
+
+  if (ok) {
+    avformat_alloc_output_context2(&output, nullptr, nullptr, filename.constData());
+    if (output == nullptr) {
+      qCritical() << "Could not create output context";
+      export_error = tr("could not create output format context");
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    video_out = copy_segment_stream(output, inputs.first()->streams[0]);
+
+    if (audio_segment_ != nullptr) {
+      audio_in = inputs.last();
+      audio_out = copy_segment_stream(output, audio_in->streams[0]);
+    }
+
+    if (video_out == nullptr || (audio_in != nullptr && audio_out == nullptr)) {
+      qCritical() << "Could not copy segment streams to output file";
+      export_error = tr("could not copy segment streams to output file");
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    err = avio_open(&output->pb, filename.constData(), AVIO_FLAG_WRITE);
+    if (err >= 0) {
+      err = avformat_write_header(output, nullptr);
+    }
+    if (err < 0) {
+      qCritical() << "Could not write output file header." << err;
+      export_error = tr("could not write output file header (%1)").arg(QString::number(err));
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    AVPacket video_pkt;
+    AVPacket audio_pkt;
+    av_init_packet(&video_pkt);
+    av_init_packet(&audio_pkt);
+    video_pkt.data = nullptr;
+    video_pkt.size = 0;
+    audio_pkt.data = nullptr;
+    audio_pkt.size = 0;
+
+    // Segments were exported with timestamps starting at their own first frame, so they're offset by the position of
+    // the segment in the range (calculated the same way Export() calculates timestamps)
+    AVRational frame_time_base = av_inv_q(av_d2q(params_.video_frame_rate, INT_MAX));
+
+    int segment = 0;
+    bool have_video = false;
+    int64_t last_video_dts = AV_NOPTS_VALUE;
+
+    // segment whose codec parameters the output's decoder will be using (see olive::passthrough)
+    int configured_segment = 0;
+
+    bool have_audio = (audio_in != nullptr && read_segment_packet(audio_in, &audio_pkt));
+    if (have_audio) {
+      av_packet_rescale_ts(&audio_pkt, audio_in->streams[0]->time_base, audio_out->time_base);
+    }
+
+    while (ok && !interrupt_) {
+
+      // Get the next video packet, moving on to the next segment once the current one runs out
+      while (!have_video && segment < segments_.size()) {
+        AVStream* segment_stream = inputs.at(segment)->streams[0];
+
+        if (read_segment_packet(inputs.at(segment), &video_pkt)) {
+
+          // copied segments and rendered ones can use different parameter sets, which have to be repeated in the
+          // stream where they change
+          if (segment != configured_segment) {
+            if (!olive::passthrough::update_parameter_sets(&video_pkt,
+                                                           inputs.at(configured_segment)->streams[0]->codecpar,
+                                                           segment_stream->codecpar)) {
+              qCritical() << "Could not update parameter sets between export segments";
+              export_error = tr("could not update parameter sets between export segments");
+              ok = false;
+            }
+            configured_segment = segment;
+          }
+
+          double offset_secs = double(segments_.at(segment)->params_.start_frame - params_.start_frame)
+              / params_.sequence->frame_rate();
+          int64_t offset = av_rescale_q(qRound64(offset_secs / av_q2d(frame_time_base)),
+                                        frame_time_base,
+                                        segment_stream->time_base);
+
+          if (video_pkt.pts != AV_NOPTS_VALUE) video_pkt.pts += offset;
+          if (video_pkt.dts != AV_NOPTS_VALUE) video_pkt.dts += offset;
+
+          av_packet_rescale_ts(&video_pkt, segment_stream->time_base, video_out->time_base);
+
+          // rounding can make a segment's first packet collide with the previous segment's last packet
+          if (video_pkt.dts != AV_NOPTS_VALUE) {
+            if (last_video_dts != AV_NOPTS_VALUE && video_pkt.dts <= last_video_dts) {
+              video_pkt.dts = last_video_dts + 1;
+              if (video_pkt.pts != AV_NOPTS_VALUE && video_pkt.pts < video_pkt.dts) {
+                video_pkt.pts = video_pkt.dts;
+              }
+            }
+            last_video_dts = video_pkt.dts;
+          }
+
+          have_video = true;
+        } else {
+          segment++;
+        }
+      }
+
+      if (!ok || (!have_video && !have_audio)) {
+        break;
+      }
+
+      // Write whichever packet comes first
+      bool write_video = have_video
+          && (!have_audio
+              || av_compare_ts(packet_time(&video_pkt), video_out->time_base,
+                               packet_time(&audio_pkt), audio_out->time_base) <= 0);
+
+      AVPacket* packet = write_video ? &video_pkt : &audio_pkt;
+      packet->stream_index = write_video ? video_out->index : audio_out->index;
+
+      // (takes ownership of the packet's data)
+      err = av_interleaved_write_frame(output, packet);
+      if (err < 0) {
+        qCritical() << "Could not write packet to output file." << err;
+        export_error = tr("could not write packet to output file (%1)").arg(QString::number(err));
+        ok = false;
+      }
+
+      if (write_video) {
+        have_video = false;
+      } else {
+        have_audio = read_segment_packet(audio_in, &audio_pkt);
+        if (have_audio) {
+          av_packet_rescale_ts(&audio_pkt, audio_in->streams[0]->time_base, audio_out->time_base);
+        }
+      }
+    }
+
+    av_packet_unref(&video_pkt);
+    av_packet_unref(&audio_pkt);
+
+    ok = (ok && !interrupt_);
+
+    if (ok) {
+      err = av_write_trailer(output);
+      if (err < 0) {
+        qCritical() << "Could not write output file trailer." << err;
+        export_error = tr("could not write output file trailer (%1)").arg(QString::number(err));
+        ok = false;
+      }
+    }
+  }
+
+  for (int i=0;i<inputs.size();i++) {
+    avformat_close_input(&inputs[i]);
+  }
+
+  if (output != nullptr) {
+    avio_closep(&output->pb);
+    avformat_free_context(output);
+  }
+
+  return ok;
+}
+
+void ExportThread::WaitForRenderer()
+{
+  // renders are always waited for, even when interrupted, so the RenderThread is never left writing into a frame that
+  // has been freed
+  while (!renderer_ready_) {
+    waitCond.wait(&mutex);
+  }
+  renderer_ready_ = false;
+}
+
+void ExportThread::ConvertVideo()
+{
+  AVFrame* rendered;
+
+  while ((rendered = rendered_frames_.Pop()) != nullptr) {
+
+    //
+    // - I'm not sure why, but we have to alloc/free sws_frame every frame, or it breaks GIF exporting.
+    // - (i.e. GIFs get stuck on the first frame)
+    // - The same problem/solution can be seen here: https://stackoverflow.com/a/38997739
+    // - Perhaps this is the intended way to use swscale, but it seems inefficient.
+    // - Anyway, here we are.
+    //
+
+    // Construct destination pixel format frame
+    AVFrame* sws_frame = av_frame_alloc();
+    sws_frame->format = vcodec_ctx->pix_fmt;
+    sws_frame->width = params_.video_width;
+    sws_frame->height = params_.video_height;
+    av_frame_get_buffer(sws_frame, 0);
+
+    // Convert raw RGBA buffer to format expected by the encoder
+    sws_scale(sws_ctx, rendered->data, rendered->linesize, 0, rendered->height, sws_frame->data, sws_frame->linesize);
+    sws_frame->pts = rendered->pts;
+
+    // Give the RGBA frame back to be rendered into again
+    if (!free_frames_.Push(rendered)) {
+      av_frame_free(&rendered);
+    }
+
+    if (!converted_frames_.Push(sws_frame)) {
+      av_frame_free(&sws_frame);
+      break;
+    }
+  }
+
+  converted_frames_.Finish();
+}
+
+void ExportThread::EncodeVideo()
+{
+  AVFrame* frame;
+
+  while ((frame = converted_frames_.Pop()) != nullptr) {
+    bool encoded = Encode(fmt_ctx, vcodec_ctx, frame, &video_pkt, video_stream);
+
+    av_frame_free(&frame);
+
+    if (!encoded) {
+      // stop the rest of the pipeline, Export() will return once it notices
+      encode_failed_.storeRelease(1);
+      CancelPipeline();
+      break;
+    }
+  }
+}
+
+void ExportThread::CancelPipeline()
+{
+  free_frames_.Cancel();
+  rendered_frames_.Cancel();
+  converted_frames_.Cancel();
 }
 
 void ExportThread::wake() {
+  mutex.lock();
+  renderer_ready_ = true;
+  waitCond.wakeAll();
+  mutex.unlock();
+}
+
+void ExportThread::SegmentFinished()
+{
   mutex.lock();
   waitCond.wakeAll();
   mutex.unlock();
 }
+
+void ExportThread::PrepareRender()
+{
+  // segments render from their own copy of their parent's snapshot, taken once they know they'll need it
+  if (snapshot_ == nullptr) {
+    snapshot_ = params_.sequence->Snapshot();
+    params_.sequence = snapshot_.get();
+  }
+
+  // the audio is mixed without a renderer
+  if (params_.video_enabled && renderer_ == nullptr) {
+    renderer_ = new RenderThread(true, true);
+
+    // the renderer signals from its own thread while this thread is waiting for it
+    connect(renderer_, SIGNAL(ready()), this, SLOT(wake()), Qt::DirectConnection);
+  }
+}
@@ -26,11 +26,16 @@ extern "C" {
 }
 
 #include <QThread>
-#include <QOffscreenSurface>
+#include <QAtomicInt>
 #include <QMutex>
+#include <QVector>
 #include <QWaitCondition>
 
 #include "timeline/sequence.h"
+#include "rendering/audiorendercontext.h"
+#include "rendering/exportframequeue.h"
+#include "rendering/passthrough.h"
+#include "rendering/renderthread.h"
 
 struct AVFormatContext;
 struct AVCodecContext;
@@ -73,12 +78,41 @@ struct ExportParams {
 struct VideoCodecParams {
   int pix_fmt;
   int threads;
+
+  // maximum interval between keyframes, 0 = encoder default
+  int gop_size;
+
+  // amount of parts of the video to export in parallel before joining them into one file, 1 = single stream
+  int segments;
+
+  // copy frames that the sequence shows unaltered from their source files instead of re-encoding them
+  bool smart_render;
 };
 
+/**
+ * @brief The ExportThread class
+ *
+ * Exports a Sequence to a file. The export works on a snapshot of the Sequence (see Sequence::Snapshot()) taken when
+ * the ExportThread is constructed, and renders it on its own RenderThread with a private OpenGL context, so the
+ * Sequence can continue to be edited and played back (or exported again) while the export runs.
+ *
+ * If VideoCodecParams::segments is more than 1, the range is split into segments that start on keyframes, each of
+ * which is exported to a temporary file by a child ExportThread with its own snapshot and renderer. The audio is
+ * exported once by another child with a snapshot but no renderer. Once they've all finished, their packets are joined into the output file without
+ * re-encoding them (see ConcatenateSegments()).
+ *
+ * If VideoCodecParams::smart_render is set, ranges where the Sequence shows a source file's frames unaltered are
+ * exported by children that copy the source's packets instead (see olive::passthrough), and only the frames around
+ * them are rendered. At most VideoCodecParams::segments children export video at the same time.
+ *
+ * Must be constructed from the main thread, and the main thread's event loop must keep running while it exports (the
+ * segments are created on it).
+ */
 class ExportThread : public QThread {
   Q_OBJECT
 public:
   ExportThread(const ExportParams& params, const VideoCodecParams& vparams, QObject* parent = nullptr);
+  virtual ~ExportThread() override;
   virtual void run() override;
 
   const QString& GetError();
@@ -88,20 +122,117 @@ signals:
   void ProgressChanged(int value, qint64 remaining_ms);
 public slots:
   void Interrupt();
-
-  void play_wake();
 private:
+  /**
+   * @brief A thread running one stage of the video export pipeline
+   */
+  class Stage : public QThread {
+  public:
+    Stage(ExportThread* exporter, void (ExportThread::*function)());
+  protected:
+    virtual void run() override;
+  private:
+    ExportThread* exporter_;
+    void (ExportThread::*function_)();
+  };
+
+  /**
+   * @brief Constructor used for segments, which start out sharing their parent's snapshot (see PrepareRender())
+   */
+  ExportThread(const ExportParams& params, const VideoCodecParams& vparams, QObject* parent, bool take_snapshot);
+
   bool Encode(AVFormatContext* ofmt_ctx, AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* packet, AVStream* stream);
+  void SetError(const QString& error);
   bool SetupVideo();
   bool SetupAudio();
   bool SetupContainer();
   void Export();
   void Cleanup();
 
-  QOffscreenSurface surface;
+  /**
+   * @brief Returns whether VideoCodecParams asks for this thread's range to be exported in segments
+   */
+  bool SegmentsRequested();
+
+  /**
+   * @brief Find the ranges that can be copied and create the child ExportThreads that export this thread's range
+   *
+   * Called from run(). Does nothing if the output format can't be joined back together.
+   */
+  void PlanSegments();
+
+  /**
+   * @brief Returns the filename of a temporary segment file next to the output file
+   */
+  QString SegmentFilename(const QString& name);
+
+  /**
+   * @brief Create a child ExportThread that exports part of this thread's range without audio
+   */
+  ExportThread* AddSegment(long start_frame, long end_frame, const VideoCodecParams& vparams);
+
+  /**
+   * @brief Create the child ExportThreads that render part of this thread's range, split on keyframe boundaries
+   */
+  void AddRenderSegments(long start_frame, long end_frame, const VideoCodecParams& vparams);
+
+  /**
+   * @brief Run the child ExportThreads and join their files into the output file
+   */
+  void ExportSegments();
+
+  /**
+   * @brief Copy this segment's frames from passthrough_'s source file
+   *
+   * Checks every packet as it's copied, and gives up if the source turns out not to line up with the frames the rest
+   * of the export renders (in which case the segment is rendered instead).
+   *
+   * @return
+   *
+   * **TRUE** if the segment file was written successfully.
+   */
+  bool CopySourcePackets();
+
+  /**
+   * @brief Copy the packets of every segment file (and the audio file) into the output file
+   *
+   * The segments' timestamps are offset by the segment's position in the range, and the video and audio packets are
+   * interleaved by their timestamps. No packets are decoded or re-encoded.
+   *
+   * @return
+   *
+   * **TRUE** if the output file was written successfully.
+   */
+  bool ConcatenateSegments();
+
+  /**
+   * @brief Emit ProgressChanged() and store the value for a parent ExportThread to read
+   */
+  void SetProgress(int value, qint64 remaining_ms);
+
+  /**
+   * @brief Wait for the RenderThread to emit ready(). Expects mutex to be locked.
+   */
+  void WaitForRenderer();
+
+  /**
+   * @brief Video pipeline stage that converts rendered RGBA frames to the encoder's pixel format
+   */
+  void ConvertVideo();
+
+  /**
+   * @brief Video pipeline stage that encodes converted frames and writes them to the file
+   */
+  void EncodeVideo();
+
+  /**
+   * @brief Wake all pipeline stages and make them stop as soon as possible
+   */
+  void CancelPipeline();
+
   bool interrupt_;
 
-  // params imported from dialogs
+  // params imported from dialogs (the sequence is replaced with snapshot_)
   ExportParams params_;
   VideoCodecParams vcodec_params_;
 
@@ -109,8 +240,6 @@ private:
   AVStream* video_stream;
   AVCodec* vcodec;
   AVCodecContext* vcodec_ctx;
-  AVFrame* video_frame;
-  AVFrame* sws_frame;
   SwsContext* sws_ctx;
   AVStream* audio_stream;
   AVCodec* acodec;
@@ -130,12 +259,66 @@ private:
 
   QMutex mutex;
   QWaitCondition waitCond;
+  bool renderer_ready_;
 
   QString export_error;
 
-  bool waiting_for_audio_;
+  // video export pipeline (see Export())
+  ExportFrameQueue free_frames_;
+  ExportFrameQueue rendered_frames_;
+  ExportFrameQueue converted_frames_;
+  Stage video_converter_;
+  Stage video_encoder_;
+
+  // guards writing to the container and export_error, which are shared by the pipeline's threads
+  QMutex output_lock_;
+
+  // set if encoding failed on any thread
+  QAtomicInt encode_failed_;
+
+  // the export renders audio separately from playback and pulls it synchronously
+  AudioRenderContext audio_context_;
+
+  // private copy of the sequence being exported and the renderer that renders it (see PrepareRender())
+  SequencePtr snapshot_;
+  RenderThread* renderer_;
+
+  // child threads exporting the video in segments and the audio separately (see CreateSegments())
+  QVector<ExportThread*> segments_;
+  ExportThread* audio_segment_;
+
+  // source packets this segment copies rather than rendering (filename is empty if it's rendered)
+  PassthroughRange passthrough_;
+
+  // ranges of the sequence that the segments copy from their source files (see PlanSegments())
+  QVector<PassthroughRange> passthrough_ranges_;
+
+  // last progress emitted, read by a parent ExportThread
+  QAtomicInt progress_;
 private slots:
   void wake();
+
+  /**
+   * @brief Wakes ExportSegments() when a child ExportThread finishes
+   */
+  void SegmentFinished();
+
+  /**
+   * @brief Create the child ExportThreads that export this thread's range in segments from passthrough_ranges_
+   *
+   * Does nothing if nothing can be copied and the range is too short to be split. Must be called from the main thread,
+   * PlanSegments() calls it with a Qt::BlockingQueuedConnection.
+   */
+  void CreateSegments();
+
+  /**
+   * @brief Take this thread's own snapshot and create its renderer if it doesn't have them yet
+   *
+   * Segments only do this once they know they'll render, so those that copy their frames from the source file don't
+   * copy the sequence (and the audio segment doesn't create a renderer). Must be called from the main thread, the
+   * export thread calls it with a Qt::BlockingQueuedConnection.
+   */
+  void PrepareRender();
 };
 
 #endif // EXPORTTHREAD_H
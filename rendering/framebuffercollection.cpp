@@ -8,13 +8,14 @@ FramebufferCollection::FramebufferCollection()
 void FramebufferCollection::Create(QOpenGLContext* ctx,
                                    int width,
                                    int height,
-                                   int count)
+                                   int count,
+                                   bool exporting)
 {
   Q_ASSERT(count > 1);
 
   fbo_.resize(count);
   for (int i=0;i<fbo_.size();i++) {
-    fbo_[i].Create(ctx, width, height);
+    fbo_[i].Create(ctx, width, height, exporting);
   }
   fbo_index_ = -1;
 }
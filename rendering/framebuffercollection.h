@@ -10,7 +10,7 @@ class FramebufferCollection
 public:
   FramebufferCollection();
 
-  void Create(QOpenGLContext *ctx, int width, int height, int count);
+  void Create(QOpenGLContext *ctx, int width, int height, int count, bool exporting);
   void Destroy();
 
   GLuint CurrentTexture();
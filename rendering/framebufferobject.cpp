@@ -25,7 +25,6 @@
 #include <QDebug>
 
 #include "global/config.h"
-#include "global/global.h"
 #include "pixelformats.h"
 
 FramebufferObject::FramebufferObject() :
@@ -44,7 +43,7 @@ bool FramebufferObject::IsCreated()
   return ctx_ != nullptr;
 }
 
-void FramebufferObject::Create(QOpenGLContext *ctx, int width, int height)
+void FramebufferObject::Create(QOpenGLContext *ctx, int width, int height, bool exporting)
 {
   // free any previous textures
   Destroy();
@@ -67,7 +66,7 @@ void FramebufferObject::Create(QOpenGLContext *ctx, int width, int height)
   f->glBindTexture(GL_TEXTURE_2D, texture_);
 
   // allocate storage for texture
-  const olive::PixelFormatInfo& bit_depth = olive::pixel_formats.at(olive::Global->is_exporting() ?
+  const olive::PixelFormatInfo& bit_depth = olive::pixel_formats.at(exporting ?
                                                                       olive::config.export_bit_depth :
                                                                       olive::config.playback_bit_depth);
 
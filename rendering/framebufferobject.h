@@ -30,7 +30,7 @@ public:
   ~FramebufferObject();
 
   bool IsCreated();
-  void Create(QOpenGLContext* ctx, int width, int height);
+  void Create(QOpenGLContext* ctx, int width, int height, bool exporting);
   void Destroy();
 
   const GLuint& buffer() const;
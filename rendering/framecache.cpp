@@ -0,0 +1,243 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framecache.h"
+
+#include <QMutexLocker>
+
+#include "global/config.h"
+
+FrameCache olive::frame_cache;
+
+bool operator==(const FrameCacheKey &a, const FrameCacheKey &b)
+{
+  return a.footage == b.footage
+      && a.stream == b.stream
+      && a.pixel_format == b.pixel_format
+      && a.proxy == b.proxy
+      && a.interlacing == b.interlacing;
+}
+
+uint qHash(const FrameCacheKey &key, uint seed)
+{
+  return qHash(key.footage, seed)
+      ^ qHash(key.stream, seed)
+      ^ qHash((key.pixel_format << 8) | (key.interlacing << 1) | int(key.proxy), seed);
+}
+
+FrameCache::FrameCache() :
+  access_counter_(0),
+  memory_usage_(0)
+{
+}
+
+FrameCache::~FrameCache()
+{
+  Clear();
+}
+
+AVFrame *FrameCache::GetFrameAt(const FrameCacheKey &key, int64_t pts)
+{
+  QMutexLocker locker(&lock_);
+
+  QHash<FrameCacheKey, StreamFrames>::iterator s = streams_.find(key);
+  if (s == streams_.end()) {
+    return nullptr;
+  }
+
+  StreamFrames& frames = s.value();
+
+  // find the last frame with a timestamp <= pts
+  StreamFrames::iterator i = frames.upperBound(pts);
+  if (i == frames.begin()) {
+    return nullptr;
+  }
+  i--;
+
+  // if this isn't the exact frame, we can only use it if we know the next frame starts after pts
+  if (i.key() != pts
+      && (i.value().next_pts == AV_NOPTS_VALUE || i.value().next_pts <= pts)) {
+    return nullptr;
+  }
+
+  Touch(key, i.key(), i.value());
+
+  return av_frame_clone(i.value().frame);
+}
+
+AVFrame *FrameCache::GetNext(const FrameCacheKey &key, int64_t pts)
+{
+  QMutexLocker locker(&lock_);
+
+  QHash<FrameCacheKey, StreamFrames>::iterator s = streams_.find(key);
+  if (s == streams_.end()) {
+    return nullptr;
+  }
+
+  StreamFrames& frames = s.value();
+
+  StreamFrames::iterator current = frames.find(pts);
+  if (current == frames.end() || current.value().next_pts == AV_NOPTS_VALUE) {
+    return nullptr;
+  }
+
+  StreamFrames::iterator next = frames.find(current.value().next_pts);
+  if (next == frames.end()) {
+    return nullptr;
+  }
+
+  Touch(key, next.key(), next.value());
+
+  return av_frame_clone(next.value().frame);
+}
+
+void FrameCache::Insert(const FrameCacheKey &key, AVFrame *frame, int64_t previous_pts)
+{
+  qint64 budget = qint64(olive::config.frame_cache_size) * 1048576;
+
+  // a budget of 0 disables the cache
+  if (budget <= 0 || frame->pts == AV_NOPTS_VALUE) {
+    return;
+  }
+
+  QMutexLocker locker(&lock_);
+
+  StreamFrames& frames = streams_[key];
+
+  // link the previous frame to this one
+  if (previous_pts != AV_NOPTS_VALUE) {
+    StreamFrames::iterator previous = frames.find(previous_pts);
+    if (previous != frames.end()) {
+      previous.value().next_pts = frame->pts;
+    }
+  }
+
+  StreamFrames::iterator existing = frames.find(frame->pts);
+  if (existing != frames.end()) {
+    // another Cacher already decoded this frame, just update its access time
+    Touch(key, existing.key(), existing.value());
+    return;
+  }
+
+  Entry e;
+  e.frame = av_frame_clone(frame);
+  if (e.frame == nullptr) {
+    return;
+  }
+  e.next_pts = AV_NOPTS_VALUE;
+  e.size = 0;
+  for (int i=0;i<AV_NUM_DATA_POINTERS && frame->buf[i] != nullptr;i++) {
+    e.size += frame->buf[i]->size;
+  }
+  e.access = 0;
+
+  memory_usage_ += e.size;
+
+  StreamFrames::iterator inserted = frames.insert(frame->pts, e);
+  Touch(key, inserted.key(), inserted.value());
+
+  EvictToBudget(budget);
+}
+
+void FrameCache::RemoveFootage(Footage *footage)
+{
+  QMutexLocker locker(&lock_);
+
+  QHash<FrameCacheKey, StreamFrames>::iterator s = streams_.begin();
+  while (s != streams_.end()) {
+    if (s.key().footage == footage) {
+      for (StreamFrames::iterator i=s.value().begin();i!=s.value().end();i++) {
+        FreeEntry(i.value());
+      }
+      s = streams_.erase(s);
+    } else {
+      s++;
+    }
+  }
+}
+
+void FrameCache::Clear()
+{
+  QMutexLocker locker(&lock_);
+
+  for (QHash<FrameCacheKey, StreamFrames>::iterator s=streams_.begin();s!=streams_.end();s++) {
+    for (StreamFrames::iterator i=s.value().begin();i!=s.value().end();i++) {
+      av_frame_free(&i.value().frame);
+    }
+  }
+
+  streams_.clear();
+  lru_.clear();
+  memory_usage_ = 0;
+}
+
+qint64 FrameCache::memory_usage()
+{
+  QMutexLocker locker(&lock_);
+  return memory_usage_;
+}
+
+void FrameCache::Touch(const FrameCacheKey& key, int64_t pts, Entry &e)
+{
+  if (e.access > 0) {
+    lru_.remove(e.access);
+  }
+
+  access_counter_++;
+  e.access = access_counter_;
+
+  LRULocation loc;
+  loc.key = key;
+  loc.pts = pts;
+  lru_.insert(e.access, loc);
+}
+
+void FrameCache::EvictToBudget(qint64 budget)
+{
+  while (memory_usage_ > budget && !lru_.isEmpty()) {
+    QMap<quint64, LRULocation>::iterator oldest = lru_.begin();
+
+    QHash<FrameCacheKey, StreamFrames>::iterator s = streams_.find(oldest.value().key);
+    if (s == streams_.end()) {
+      lru_.erase(oldest);
+      continue;
+    }
+
+    StreamFrames::iterator i = s.value().find(oldest.value().pts);
+    if (i == s.value().end()) {
+      lru_.erase(oldest);
+      continue;
+    }
+
+    FreeEntry(i.value());
+    s.value().erase(i);
+
+    if (s.value().isEmpty()) {
+      streams_.erase(s);
+    }
+  }
+}
+
+void FrameCache::FreeEntry(Entry &e)
+{
+  lru_.remove(e.access);
+  memory_usage_ -= e.size;
+  av_frame_free(&e.frame);
+}
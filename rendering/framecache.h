@@ -0,0 +1,222 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+
+class Footage;
+
+/**
+ * @brief The FrameCacheKey struct
+ *
+ * Identifies one decoded stream of frames in the FrameCache. Two Cachers that produce identical frames for the same
+ * timestamp will produce identical keys.
+ */
+struct FrameCacheKey {
+  /**
+   * @brief Footage the frames were decoded from
+   */
+  Footage* footage;
+
+  /**
+   * @brief File index of the stream inside the footage file (see FootageStream::file_index)
+   */
+  int stream;
+
+  /**
+   * @brief AVPixelFormat the frames were converted to by the Cacher's filter graph
+   */
+  int pixel_format;
+
+  /**
+   * @brief **TRUE** if these frames were decoded from the Footage's proxy rather than the original file
+   */
+  bool proxy;
+
+  /**
+   * @brief Interlacing mode used to deinterlace these frames (see FootageStream::video_interlacing)
+   */
+  int interlacing;
+};
+
+bool operator==(const FrameCacheKey& a, const FrameCacheKey& b);
+uint qHash(const FrameCacheKey& key, uint seed = 0);
+
+/**
+ * @brief The FrameCache class
+ *
+ * A process-wide cache of decoded and converted video frames shared between all Cachers. Clips that reference the
+ * same footage (e.g. a source file that's been cut into several clips) can retrieve frames another Clip's Cacher has
+ * already decoded rather than decoding them a second time.
+ *
+ * Frames are stored as reference-counted clones (see av_frame_clone()) so storing a frame here doesn't copy its pixel
+ * data. Each frame also stores the timestamp of the frame decoded directly after it, which allows a Cacher to follow
+ * a run of cached frames forward without knowing the stream's frame rate.
+ *
+ * Memory usage is limited by Config::frame_cache_size. When the limit is exceeded, the least recently used frames are
+ * removed first.
+ *
+ * All functions are thread-safe.
+ */
+class FrameCache {
+public:
+  /**
+   * @brief FrameCache Constructor
+   */
+  FrameCache();
+
+  /**
+   * @brief FrameCache Destructor
+   *
+   * Frees all frames currently stored in the cache.
+   */
+  ~FrameCache();
+
+  /**
+   * @brief Retrieve the frame that should be displayed at a certain timestamp
+   *
+   * @param key
+   *
+   * Stream to retrieve a frame from
+   *
+   * @param pts
+   *
+   * Timestamp to retrieve. Returns either a frame with this exact timestamp, or the frame directly preceding it if
+   * the cache knows that no other frame exists between them.
+   *
+   * @return
+   *
+   * A new reference to the frame that the caller takes ownership of (free with av_frame_free()), or `nullptr` if the
+   * cache doesn't contain a suitable frame.
+   */
+  AVFrame* GetFrameAt(const FrameCacheKey& key, int64_t pts);
+
+  /**
+   * @brief Retrieve the frame that comes directly after another frame
+   *
+   * @param key
+   *
+   * Stream to retrieve a frame from
+   *
+   * @param pts
+   *
+   * Timestamp of the current frame.
+   *
+   * @return
+   *
+   * A new reference to the next frame that the caller takes ownership of (free with av_frame_free()), or `nullptr`
+   * if the cache doesn't know which frame comes next or no longer contains it.
+   */
+  AVFrame* GetNext(const FrameCacheKey& key, int64_t pts);
+
+  /**
+   * @brief Add a frame to the cache
+   *
+   * The cache stores its own reference to the frame, the caller retains ownership of `frame`.
+   *
+   * @param key
+   *
+   * Stream this frame was decoded from
+   *
+   * @param frame
+   *
+   * Frame to add. Must have a valid timestamp.
+   *
+   * @param previous_pts
+   *
+   * Timestamp of the frame the same decoder returned directly before this one, used to link the two frames together.
+   * Set to AV_NOPTS_VALUE if the decoder has just seeked or the previous frame is unknown.
+   */
+  void Insert(const FrameCacheKey& key, AVFrame* frame, int64_t previous_pts);
+
+  /**
+   * @brief Remove all frames decoded from a certain Footage
+   *
+   * Must be called whenever a Footage object is deleted or changed in a way that would change its decoded frames.
+   */
+  void RemoveFootage(Footage* footage);
+
+  /**
+   * @brief Remove all frames from the cache
+   */
+  void Clear();
+
+  /**
+   * @brief Returns the amount of memory (in bytes) currently referenced by frames in the cache
+   */
+  qint64 memory_usage();
+
+private:
+  struct Entry {
+    AVFrame* frame;
+    int64_t next_pts;
+    qint64 size;
+    quint64 access;
+  };
+
+  struct LRULocation {
+    FrameCacheKey key;
+    int64_t pts;
+  };
+
+  typedef QMap<int64_t, Entry> StreamFrames;
+
+  /**
+   * @brief Mark an entry as most recently used. Expects lock_ to be locked.
+   */
+  void Touch(const FrameCacheKey &key, int64_t pts, Entry& e);
+
+  /**
+   * @brief Remove least recently used entries until memory usage is within budget. Expects lock_ to be locked.
+   */
+  void EvictToBudget(qint64 budget);
+
+  /**
+   * @brief Free an entry's frame and remove it from the LRU index. Expects lock_ to be locked.
+   */
+  void FreeEntry(Entry& e);
+
+  QHash<FrameCacheKey, StreamFrames> streams_;
+
+  QMap<quint64, LRULocation> lru_;
+
+  quint64 access_counter_;
+
+  qint64 memory_usage_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+  /**
+   * @brief Global frame cache shared by all Cachers
+   */
+  extern FrameCache frame_cache;
+}
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framepool.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+#include <QMutexLocker>
+
+// Buffer alignment used for pooled frames (matches FFmpeg's largest SIMD alignment requirement)
+const int kFramePoolAlignment = 32;
+
+FramePool olive::frame_pool;
+
+bool FramePool::Key::operator==(const FramePool::Key &other) const
+{
+  return width == other.width && height == other.height && format == other.format;
+}
+
+uint qHash(const FramePool::Key &key, uint seed)
+{
+  return qHash(key.width, seed) ^ qHash(key.height << 16, seed) ^ qHash(key.format << 8, seed);
+}
+
+FramePool::FramePool() :
+  requests_(0),
+  misses_(0)
+{
+}
+
+FramePool::~FramePool()
+{
+  for (QHash<Key, AVBufferPool*>::iterator i=pools_.begin();i!=pools_.end();i++) {
+    av_buffer_pool_uninit(&i.value());
+  }
+}
+
+AVFrame *FramePool::Get(int width, int height, AVPixelFormat format)
+{
+  int size = av_image_get_buffer_size(format, width, height, kFramePoolAlignment);
+  if (size < 0) {
+    return nullptr;
+  }
+
+  Key key;
+  key.width = width;
+  key.height = height;
+  key.format = format;
+
+  lock_.lock();
+  AVBufferPool*& pool = pools_[key];
+  if (pool == nullptr) {
+    pool = av_buffer_pool_init2(size, this, AllocBuffer, nullptr);
+  }
+  lock_.unlock();
+
+  if (pool == nullptr) {
+    return nullptr;
+  }
+
+  // av_buffer_pool_get() is thread-safe itself, so we don't need to hold the lock here
+  requests_.fetchAndAddRelaxed(1);
+  AVBufferRef* buf = av_buffer_pool_get(pool);
+  if (buf == nullptr) {
+    return nullptr;
+  }
+
+  AVFrame* frame = av_frame_alloc();
+  if (frame == nullptr) {
+    av_buffer_unref(&buf);
+    return nullptr;
+  }
+
+  frame->width = width;
+  frame->height = height;
+  frame->format = format;
+  frame->buf[0] = buf;
+
+  av_image_fill_arrays(frame->data, frame->linesize, buf->data, format, width, height, kFramePoolAlignment);
+
+  return frame;
+}
+
+quint64 FramePool::hits()
+{
+  return requests_.loadAcquire() - misses_.loadAcquire();
+}
+
+quint64 FramePool::misses()
+{
+  return misses_.loadAcquire();
+}
+
+AVBufferRef *FramePool::AllocBuffer(void *opaque, int size)
+{
+  // the pool only calls this when it has no free buffers left, so every call is a miss
+  static_cast<FramePool*>(opaque)->misses_.fetchAndAddRelaxed(1);
+
+  return av_buffer_alloc(size);
+}
@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/buffer.h>
+#include <libavutil/pixfmt.h>
+}
+
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInteger>
+
+/**
+ * @brief The FramePool class
+ *
+ * A pool of video frame buffers shared between all Cachers. Buffers are grouped into size classes by width, height,
+ * and pixel format, and a buffer returns to its pool automatically once every AVFrame referencing it has been freed
+ * (e.g. when ClipQueue removes the frame). In steady-state playback, this means the decode path reuses the same
+ * buffers rather than allocating and freeing a full frame of memory for every frame.
+ *
+ * All functions are thread-safe.
+ */
+class FramePool {
+public:
+  /**
+   * @brief FramePool Constructor
+   */
+  FramePool();
+
+  /**
+   * @brief FramePool Destructor
+   *
+   * Releases all pools. Any buffers still in use are freed once their last reference is freed.
+   */
+  ~FramePool();
+
+  /**
+   * @brief Retrieve a frame with an allocated buffer from the pool
+   *
+   * @param width
+   *
+   * Frame width in pixels
+   *
+   * @param height
+   *
+   * Frame height in pixels
+   *
+   * @param format
+   *
+   * Frame pixel format
+   *
+   * @return
+   *
+   * A frame with its data and linesizes set up for the requested size and format, or `nullptr` on failure. Free with
+   * av_frame_free() as usual.
+   */
+  AVFrame* Get(int width, int height, AVPixelFormat format);
+
+  /**
+   * @brief Returns the amount of buffers requested from the pool that reused an existing buffer
+   */
+  quint64 hits();
+
+  /**
+   * @brief Returns the amount of buffers requested from the pool that had to be newly allocated
+   */
+  quint64 misses();
+
+private:
+  struct Key {
+    int width;
+    int height;
+    int format;
+
+    bool operator==(const Key& other) const;
+  };
+
+  friend uint qHash(const Key& key, uint seed);
+
+  static AVBufferRef* AllocBuffer(void* opaque, int size);
+
+  QHash<Key, AVBufferPool*> pools_;
+
+  QMutex lock_;
+
+  QAtomicInteger<quint64> requests_;
+
+  QAtomicInteger<quint64> misses_;
+};
+
+namespace olive {
+  /**
+   * @brief Global frame buffer pool shared by all Cachers
+   */
+  extern FramePool frame_pool;
+}
+
+#endif // FRAMEPOOL_H
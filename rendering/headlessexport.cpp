@@ -0,0 +1,423 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "headlessexport.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSettings>
+#include <QtMath>
+#include <QDebug>
+
+#include <OpenColorIO/OpenColorIO.h>
+namespace OCIO = OCIO_NAMESPACE::v1;
+
+#include "effects/effectloaders.h"
+#include "global/config.h"
+#include "global/global.h"
+#include "global/path.h"
+#include "project/footage.h"
+#include "project/loadthread.h"
+#include "project/projectmodel.h"
+#include "ui/icons.h"
+
+// how often to check whether the sequence's footage has finished being analyzed
+const int kFootageCheckInterval = 100;
+
+/**
+ * @brief Collect every Footage used by a Sequence, including by any Sequences nested in it
+ */
+void collect_footage(Sequence* s, QVector<Footage*>& footage, QVector<Sequence*>& visited) {
+  if (visited.contains(s)) {
+    return;
+  }
+  visited.append(s);
+
+  QVector<Clip*> all_clips = s->GetAllClips();
+  for (int i=0;i<all_clips.size();i++) {
+    Media* m = all_clips.at(i)->media();
+
+    if (m == nullptr) {
+      continue;
+    }
+
+    if (m->get_type() == MEDIA_TYPE_FOOTAGE) {
+      if (!footage.contains(m->to_footage())) {
+        footage.append(m->to_footage());
+      }
+    } else if (m->get_type() == MEDIA_TYPE_SEQUENCE) {
+      collect_footage(m->to_sequence().get(), footage, visited);
+    }
+  }
+}
+
+/**
+ * @brief Find the ID of an encoder from an FFmpeg encoder name (e.g. "libx264") or codec name (e.g. "h264")
+ */
+AVCodecID find_encoder(const QString& name) {
+  QByteArray n = name.toUtf8();
+
+  AVCodec* encoder = avcodec_find_encoder_by_name(n.constData());
+  if (encoder != nullptr) {
+    return encoder->id;
+  }
+
+  const AVCodecDescriptor* descriptor = avcodec_descriptor_get_by_name(n.constData());
+  if (descriptor != nullptr && avcodec_find_encoder(descriptor->id) != nullptr) {
+    return descriptor->id;
+  }
+
+  return AV_CODEC_ID_NONE;
+}
+
+/**
+ * @brief Format milliseconds as H:MM:SS
+ */
+QString format_time(qint64 ms) {
+  int seconds = qFloor(ms*0.001)%60;
+  int minutes = qFloor(ms/60000)%60;
+  int hours = qFloor(ms/3600000);
+
+  return QString("%1:%2:%3").arg(QString::number(hours),
+                                 QString::number(minutes).rightJustified(2, '0'),
+                                 QString::number(seconds).rightJustified(2, '0'));
+}
+
+HeadlessExport::HeadlessExport(const QString &project,
+                               const QString &sequence,
+                               const QString &preset,
+                               const QString &output) :
+  project_(project),
+  sequence_name_(sequence),
+  preset_(preset),
+  output_(output),
+  sequence_(nullptr),
+  export_thread_(nullptr),
+  progress_(-1),
+  start_time_(0)
+{
+  footage_timer_.setInterval(kFootageCheckInterval);
+  connect(&footage_timer_, SIGNAL(timeout()), this, SLOT(CheckFootage()));
+}
+
+void HeadlessExport::Start()
+{
+  if (!QFileInfo::exists(project_)) {
+    qCritical() << "Project file" << project_ << "does not exist";
+    Exit(kExitLoadFailed);
+    return;
+  }
+
+  InitializeEnvironment();
+
+  printf("Loading project '%s'...\n", project_.toUtf8().constData());
+  fflush(stdout);
+
+  LoadThread* lt = new LoadThread(project_, false, false);
+  connect(lt, SIGNAL(success()), this, SLOT(ProjectLoaded()));
+  connect(lt, SIGNAL(error()), this, SLOT(ProjectFailed()));
+  lt->start();
+}
+
+void HeadlessExport::ProjectLoaded()
+{
+  QVector<Media*> all_sequences = olive::project_model.GetAllSequences();
+  for (int i=0;i<all_sequences.size();i++) {
+    if (all_sequences.at(i)->to_sequence()->name() == sequence_name_) {
+      sequence_ = all_sequences.at(i)->to_sequence().get();
+      break;
+    }
+  }
+
+  if (sequence_ == nullptr) {
+    qCritical() << "Project contains no sequence named" << sequence_name_;
+    for (int i=0;i<all_sequences.size();i++) {
+      qInfo() << "  Available sequence:" << all_sequences.at(i)->to_sequence()->name();
+    }
+    Exit(kExitSequenceNotFound);
+    return;
+  }
+
+  // clips using footage that's still being analyzed would render blank, so wait for it
+  QVector<Sequence*> visited;
+  collect_footage(sequence_, pending_footage_, visited);
+
+  CheckFootage();
+}
+
+void HeadlessExport::ProjectFailed()
+{
+  // the LoadThread has already logged the reason
+  Exit(kExitLoadFailed);
+}
+
+void HeadlessExport::CheckFootage()
+{
+  for (int i=0;i<pending_footage_.size();i++) {
+    Footage* f = pending_footage_.at(i);
+
+    // the ready lock is held from the footage's creation until its PreviewGenerator has finished analyzing it
+    bool analyzed = f->ready_lock.tryLock();
+    if (analyzed) {
+      analyzed = (f->ready || f->invalid);
+      f->ready_lock.unlock();
+    }
+
+    if (analyzed) {
+      if (f->invalid) {
+        qWarning() << "Footage" << f->url << "could not be opened and will be missing from the export";
+      }
+
+      pending_footage_.removeAt(i);
+      i--;
+    }
+  }
+
+  if (pending_footage_.isEmpty()) {
+    footage_timer_.stop();
+    StartExport();
+  } else if (!footage_timer_.isActive()) {
+    printf("Waiting for %d footage file(s) to be analyzed...\n", pending_footage_.size());
+    fflush(stdout);
+    footage_timer_.start();
+  }
+}
+
+void HeadlessExport::UpdateProgress(int value, qint64 remaining_ms)
+{
+  if (value == progress_) {
+    return;
+  }
+
+  progress_ = value;
+
+  if (value < 100) {
+    printf("Progress: %d%% (ETA: %s)\n", value, format_time(remaining_ms).toUtf8().constData());
+    fflush(stdout);
+  }
+}
+
+void HeadlessExport::ExportFinished()
+{
+  qint64 total_time = QDateTime::currentMSecsSinceEpoch() - start_time_;
+
+  olive::Global->set_export_state(false);
+
+  // ExportThread only reports 100% once the file has been completely written
+  if (progress_ == 100) {
+    printf("Progress: 100%% (Total: %s)\n", format_time(total_time).toUtf8().constData());
+    printf("Exported '%s'\n", output_.toUtf8().constData());
+    fflush(stdout);
+    Exit(kExitSuccess);
+  } else {
+    qCritical() << "Export failed -" << export_thread_->GetError();
+    Exit(kExitExportFailed);
+  }
+}
+
+void HeadlessExport::InitializeEnvironment()
+{
+  EffectInit::StartLoading();
+
+  QString config_path = get_config_path();
+  if (!config_path.isEmpty()) {
+    QString config_fn = QDir(config_path).filePath("config.xml");
+    if (QFileInfo::exists(config_fn)) {
+      olive::config.load(config_fn);
+    }
+  }
+
+  olive::icon::Initialize();
+
+  // Load OpenColorIO configuration if set
+  if (olive::config.enable_color_management && !olive::config.ocio_config_path.isEmpty()) {
+    try {
+      OCIO::SetCurrentConfig(OCIO::Config::CreateFromFile(olive::config.ocio_config_path.toUtf8()));
+    } catch (OCIO::Exception& e) {
+      qCritical() << "Failed to set OpenColorIO configuration:" << e.what();
+    }
+  }
+}
+
+bool HeadlessExport::LoadPreset(ExportParams &params, VideoCodecParams &vparams)
+{
+  QHash<QString, QVariant> preset;
+
+  if (!preset_.isEmpty()) {
+    if (!QFileInfo::exists(preset_)) {
+      qCritical() << "Preset file" << preset_ << "does not exist";
+      return false;
+    }
+
+    QSettings settings(preset_, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError) {
+      qCritical() << "Failed to parse preset file" << preset_;
+      return false;
+    }
+
+    QStringList keys = settings.allKeys();
+    for (int i=0;i<keys.size();i++) {
+      preset.insert(keys.at(i), settings.value(keys.at(i)));
+    }
+  }
+
+  QByteArray filename = output_.toUtf8();
+  AVOutputFormat* format = av_guess_format(nullptr, filename.constData(), nullptr);
+  if (format == nullptr) {
+    qCritical() << "Couldn't determine an output format from the filename" << output_;
+    return false;
+  }
+
+  params.sequence = sequence_;
+  params.filename = output_;
+
+  // video settings
+  AVCodecID vcodec = av_guess_codec(format, nullptr, filename.constData(), nullptr, AVMEDIA_TYPE_VIDEO);
+  if (preset.contains("video/codec")) {
+    vcodec = find_encoder(preset.value("video/codec").toString());
+    if (vcodec == AV_CODEC_ID_NONE) {
+      qCritical() << "Couldn't find a video encoder named" << preset.value("video/codec").toString();
+      return false;
+    }
+  }
+
+  params.video_enabled = (vcodec != AV_CODEC_ID_NONE && preset.value("video/enabled", true).toBool());
+  if (params.video_enabled) {
+    params.video_codec = vcodec;
+    params.video_width = preset.value("video/width", sequence_->width()).toInt();
+    params.video_height = preset.value("video/height", sequence_->height()).toInt();
+    params.video_frame_rate = preset.value("video/framerate", sequence_->frame_rate()).toDouble();
+
+    bool supports_crf = (vcodec == AV_CODEC_ID_H264 || vcodec == AV_CODEC_ID_H265);
+    QString compression = preset.value("video/compression", supports_crf ? "crf" : "cbr").toString();
+
+    if (compression == "crf" && supports_crf) {
+      params.video_compression_type = COMPRESSION_TYPE_CFR;
+      params.video_bitrate = preset.value("video/bitrate", 23).toDouble();
+    } else if (compression == "cbr") {
+      params.video_compression_type = COMPRESSION_TYPE_CBR;
+      params.video_bitrate = preset.value("video/bitrate",
+                                          qMax(0.5, double(qRound((0.01528 * params.video_height) - 4.5)))).toDouble();
+    } else {
+      qCritical() << "Invalid video compression type" << compression << "for this codec";
+      return false;
+    }
+
+    if (preset.contains("video/pixfmt")) {
+      vparams.pix_fmt = av_get_pix_fmt(preset.value("video/pixfmt").toString().toUtf8().constData());
+    } else {
+      AVCodec* encoder = avcodec_find_encoder(vcodec);
+      vparams.pix_fmt = (encoder->pix_fmts == nullptr) ? AV_PIX_FMT_NONE : encoder->pix_fmts[0];
+    }
+    if (vparams.pix_fmt == AV_PIX_FMT_NONE) {
+      qCritical() << "Couldn't determine a pixel format for the video encoder, set one with video/pixfmt";
+      return false;
+    }
+
+    vparams.threads = preset.value("video/threads", 0).toInt();
+    vparams.segments = qMax(1, preset.value("video/segments", 1).toInt());
+    vparams.smart_render = preset.value("video/smartrender", false).toBool();
+
+    if (params.video_width <= 0 || params.video_height <= 0 || params.video_frame_rate <= 0) {
+      qCritical() << "Invalid video dimensions or frame rate";
+      return false;
+    }
+  }
+
+  // audio settings
+  AVCodecID acodec = av_guess_codec(format, nullptr, filename.constData(), nullptr, AVMEDIA_TYPE_AUDIO);
+  if (preset.contains("audio/codec")) {
+    acodec = find_encoder(preset.value("audio/codec").toString());
+    if (acodec == AV_CODEC_ID_NONE) {
+      qCritical() << "Couldn't find an audio encoder named" << preset.value("audio/codec").toString();
+      return false;
+    }
+  }
+
+  params.audio_enabled = (acodec != AV_CODEC_ID_NONE && preset.value("audio/enabled", true).toBool());
+  if (params.audio_enabled) {
+    params.audio_codec = acodec;
+    params.audio_sampling_rate = preset.value("audio/samplerate", sequence_->audio_frequency()).toInt();
+    params.audio_bitrate = preset.value("audio/bitrate", 256).toInt();
+  }
+
+  if (!params.video_enabled && !params.audio_enabled) {
+    qCritical() << "Neither video nor audio is enabled for this export";
+    return false;
+  }
+
+  // range
+  params.start_frame = 0;
+  params.end_frame = sequence_->GetEndFrame();
+
+  QString range = preset.value("range", "all").toString();
+  if (range == "workarea") {
+    params.start_frame = qMax(sequence_->workarea_in, params.start_frame);
+    params.end_frame = qMin(sequence_->workarea_out, params.end_frame);
+  } else if (range != "all") {
+    qCritical() << "Invalid range" << range;
+    return false;
+  }
+
+  return true;
+}
+
+void HeadlessExport::StartExport()
+{
+  ExportParams params;
+  VideoCodecParams vparams;
+  vparams.threads = 0;
+  vparams.gop_size = 0;
+  vparams.segments = 1;
+  vparams.smart_render = false;
+
+  if (!LoadPreset(params, vparams)) {
+    Exit(kExitInvalidPreset);
+    return;
+  }
+
+  printf("Exporting sequence '%s' to '%s'...\n",
+         sequence_name_.toUtf8().constData(),
+         output_.toUtf8().constData());
+  fflush(stdout);
+
+  export_thread_ = new ExportThread(params, vparams, this);
+  connect(export_thread_, SIGNAL(finished()), this, SLOT(ExportFinished()));
+  connect(export_thread_, SIGNAL(ProgressChanged(int, qint64)), this, SLOT(UpdateProgress(int, qint64)));
+
+  olive::Global->set_export_state(true);
+
+  start_time_ = QDateTime::currentMSecsSinceEpoch();
+
+  export_thread_->start();
+}
+
+void HeadlessExport::Exit(int code)
+{
+  QCoreApplication::exit(code);
+}
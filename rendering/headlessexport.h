@@ -0,0 +1,157 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef HEADLESSEXPORT_H
+#define HEADLESSEXPORT_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include "rendering/exportthread.h"
+
+class Footage;
+
+/**
+ * @brief The HeadlessExport class
+ *
+ * Exports a sequence from a project file without the main window, used by the `--export` command line option to run
+ * exports from batch scripts and render farms.
+ *
+ * The project is loaded by a non-interactive LoadThread. Once every footage file the sequence uses has been analyzed,
+ * the sequence is exported by an ExportThread, which renders in its own offscreen OpenGL context. No window is shown,
+ * but that context still comes from the Qt platform plugin, so the platform in use must be able to provide OpenGL.
+ * Progress is printed to stdout and the application exits with one of the ExitCode values once the export has
+ * finished.
+ *
+ * Export settings are read from an optional preset file in INI format:
+ *
+ *     range=all                 ; "all" or "workarea"
+ *
+ *     [video]
+ *     enabled=true
+ *     codec=libx264             ; FFmpeg encoder or codec name, defaults to the container's default video codec
+ *     width=1920                ; width, height and framerate default to the sequence's
+ *     height=1080
+ *     framerate=29.97
+ *     compression=crf           ; "crf" (H.264/H.265 only) or "cbr"
+ *     bitrate=23                ; quality factor for "crf", Mbps for "cbr"
+ *     pixfmt=yuv420p            ; defaults to the encoder's first supported pixel format
+ *     threads=0                 ; 0 = automatic
+ *     segments=1                ; amount of parts of the video to export in parallel, 1 = off
+ *     smartrender=false         ; copy unaltered footage that's already encoded like the export instead of re-encoding
+ *
+ *     [audio]
+ *     enabled=true
+ *     codec=aac                 ; defaults to the container's default audio codec
+ *     samplerate=48000          ; defaults to the sequence's
+ *     bitrate=256               ; kbps
+ *
+ * The container format is determined by the output filename's extension.
+ */
+class HeadlessExport : public QObject {
+  Q_OBJECT
+public:
+  /**
+   * @brief Process exit codes
+   */
+  enum ExitCode {
+    kExitSuccess = 0,
+    kExitInvalidArguments = 1,
+    kExitLoadFailed = 2,
+    kExitSequenceNotFound = 3,
+    kExitInvalidPreset = 4,
+    kExitExportFailed = 5
+  };
+
+  /**
+   * @brief HeadlessExport Constructor
+   *
+   * @param project
+   *
+   * Project file to load
+   *
+   * @param sequence
+   *
+   * Name of the sequence in the project to export
+   *
+   * @param preset
+   *
+   * Preset file to read export settings from, or an empty string to use the defaults
+   *
+   * @param output
+   *
+   * File to export to
+   */
+  HeadlessExport(const QString& project, const QString& sequence, const QString& preset, const QString& output);
+
+public slots:
+  /**
+   * @brief Load the project and start the export
+   *
+   * Must be called once the application's event loop is running (e.g. through a single-shot QTimer), as the
+   * application exits by returning from the event loop.
+   */
+  void Start();
+
+private slots:
+  void ProjectLoaded();
+  void ProjectFailed();
+  void CheckFootage();
+  void UpdateProgress(int value, qint64 remaining_ms);
+  void ExportFinished();
+
+private:
+  /**
+   * @brief Set up the parts of the application the main window would usually set up that exporting relies on
+   */
+  void InitializeEnvironment();
+
+  /**
+   * @brief Fill in export parameters from the preset file (or defaults) for the sequence being exported
+   *
+   * @return
+   *
+   * **TRUE** if the parameters are valid, **FALSE** if not (with the reason having been logged).
+   */
+  bool LoadPreset(ExportParams& params, VideoCodecParams& vparams);
+
+  void StartExport();
+
+  void Exit(int code);
+
+  QString project_;
+  QString sequence_name_;
+  QString preset_;
+  QString output_;
+
+  Sequence* sequence_;
+
+  // footage used by the sequence that's still being analyzed
+  QVector<Footage*> pending_footage_;
+  QTimer footage_timer_;
+
+  ExportThread* export_thread_;
+
+  int progress_;
+  qint64 start_time_;
+};
+
+#endif // HEADLESSEXPORT_H
@@ -0,0 +1,438 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "passthrough.h"
+
+#include <QHash>
+#include <QPair>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+#include "rendering/exportthread.h"
+#include "timeline/sequence.h"
+#include "timeline/clip.h"
+#include "timeline/track.h"
+#include "project/footage.h"
+#include "project/media.h"
+#include "effects/internal/transformeffect.h"
+#include "global/config.h"
+#include "global/timing.h"
+
+// shortest run of frames worth copying rather than rendering (in seconds)
+const double kMinimumPassthroughLength = 1.0;
+
+// what find_ranges() found out about a footage file's video stream
+struct PassthroughSource {
+  bool compatible;
+  AVRational time_base;
+};
+
+// H.264 with its parameter sets stored in an "avcC" global header (e.g. from MP4/MOV/MKV files)
+static bool is_avcc(const AVCodecParameters* codecpar) {
+  return codecpar->codec_id == AV_CODEC_ID_H264
+      && codecpar->extradata_size >= 7
+      && codecpar->extradata[0] == 1;
+}
+
+// opens a footage file to see if its packets can be copied into the export
+static PassthroughSource open_source(const QString& url,
+                                     int stream_index,
+                                     AVOutputFormat* format,
+                                     const ExportParams& params,
+                                     const VideoCodecParams& vparams) {
+  PassthroughSource source;
+  source.compatible = false;
+  source.time_base = {0, 1};
+
+  QByteArray ba = url.toUtf8();
+  AVFormatContext* fmt_ctx = nullptr;
+  if (avformat_open_input(&fmt_ctx, ba.constData(), nullptr, nullptr) < 0) {
+    return source;
+  }
+
+  if (avformat_find_stream_info(fmt_ctx, nullptr) >= 0 && stream_index < int(fmt_ctx->nb_streams)) {
+    AVStream* stream = fmt_ctx->streams[stream_index];
+
+    QString reason;
+    source.compatible = olive::passthrough::can_copy_stream(stream->codecpar, format, params, vparams, &reason);
+    source.time_base = stream->time_base;
+
+    if (!source.compatible) {
+      qInfo() << "Can't copy video from" << url << "into the export," << reason;
+    }
+  }
+
+  avformat_close_input(&fmt_ctx);
+
+  return source;
+}
+
+// returns TRUE if a clip shows its footage exactly as it's stored in the file
+static bool clip_is_unaltered(Clip* c, Sequence* sequence) {
+  if (c->media() == nullptr || c->media()->get_type() != MEDIA_TYPE_FOOTAGE) {
+    return false;
+  }
+
+  // with color management on, every footage clip is converted from its colorspace to the scene linear working space
+  // (see compose_sequence()), which the copied packets wouldn't be
+  if (olive::config.enable_color_management) {
+    return false;
+  }
+
+  Footage* footage = c->media()->to_footage();
+  const FootageStream* ms = c->media_stream();
+
+  // still images and footage that hasn't been indexed yet have no keyframes to copy from
+  if (ms == nullptr || ms->infinite_length || ms->keyframe_index.isEmpty()) {
+    return false;
+  }
+
+  // each Sequence frame must be exactly one frame of the footage
+  if (c->reversed()
+      || !qFuzzyCompare(c->speed().value, 1.0)
+      || !qFuzzyCompare(footage->speed, 1.0)
+      || !qFuzzyCompare(ms->video_frame_rate, sequence->frame_rate())) {
+    return false;
+  }
+
+  // the footage must fill the frame without scaling or deinterlacing
+  if (ms->video_width != sequence->width()
+      || ms->video_height != sequence->height()
+      || ms->video_interlacing != VIDEO_PROGRESSIVE) {
+    return false;
+  }
+
+  for (int i=0;i<c->effects.size();i++) {
+    OldEffectNode* e = c->effects.at(i).get();
+
+    if (!e->IsEnabled()) {
+      continue;
+    }
+
+    // clips get a Transform effect by default, which doesn't change anything until it's been edited
+    TransformEffect* transform = dynamic_cast<TransformEffect*>(e);
+    if (transform == nullptr || !transform->IsIdentity()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// timestamp of the footage frame a clip shows at a Sequence frame (see Cacher)
+static int64_t clip_timestamp(Clip* c, long frame, const AVRational& time_base) {
+  return qRound64(playhead_to_clip_seconds(c, frame) / av_q2d(time_base));
+}
+
+// timestamp of the first keyframe at or after `pts`
+static int64_t get_keyframe_after(const FootageStream* ms, int64_t pts) {
+  int low = 0;
+  int high = ms->keyframe_index.size();
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (ms->keyframe_index.at(mid).pts < pts) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  if (low == ms->keyframe_index.size()) {
+    return AV_NOPTS_VALUE;
+  }
+
+  return ms->keyframe_index.at(low).pts;
+}
+
+// adds the whole GOPs a clip shows in [in, out) to `ranges`
+static void add_range(Clip* c,
+                      const PassthroughSource& source,
+                      long in,
+                      long out,
+                      long minimum_length,
+                      QVector<PassthroughRange>& ranges) {
+  if (out - in < minimum_length) {
+    return;
+  }
+
+  const FootageStream* ms = c->media_stream();
+
+  // the copy starts at the first keyframe shown in the range and stops before the last one, so it contains whole GOPs
+  int64_t start_pts = get_keyframe_after(ms, clip_timestamp(c, in, source.time_base));
+  int64_t end_pts = ms->get_keyframe_before(clip_timestamp(c, out, source.time_base));
+
+  if (start_pts == AV_NOPTS_VALUE || end_pts == AV_NOPTS_VALUE || end_pts <= start_pts) {
+    return;
+  }
+
+  // find the first frame that shows each keyframe
+  long start_frame = in;
+  while (start_frame < out && clip_timestamp(c, start_frame, source.time_base) < start_pts) {
+    start_frame++;
+  }
+
+  long end_frame = out;
+  while (end_frame > start_frame && clip_timestamp(c, end_frame - 1, source.time_base) >= end_pts) {
+    end_frame--;
+  }
+
+  if (end_frame - start_frame < minimum_length) {
+    return;
+  }
+
+  PassthroughRange range;
+  range.filename = c->media()->to_footage()->url;
+  range.stream_index = ms->file_index;
+  range.start_frame = start_frame;
+  range.end_frame = end_frame - 1;
+  range.start_pts = start_pts;
+  range.end_pts = end_pts;
+  ranges.append(range);
+}
+
+QVector<PassthroughRange> olive::passthrough::find_ranges(Sequence *sequence,
+                                                          const ExportParams &params,
+                                                          const VideoCodecParams &vparams)
+{
+  QVector<PassthroughRange> ranges;
+
+  // the rendered frames go through the OCIO display transform (display, view and look) if color management is on
+  if (olive::config.enable_color_management) {
+    return ranges;
+  }
+
+  // copied frames can't be scaled or retimed
+  if (params.video_width != sequence->width()
+      || params.video_height != sequence->height()
+      || !qFuzzyCompare(params.video_frame_rate, sequence->frame_rate())) {
+    return ranges;
+  }
+
+  QByteArray filename = params.filename.toUtf8();
+  AVOutputFormat* format = av_guess_format(nullptr, filename.constData(), nullptr);
+  if (format == nullptr) {
+    return ranges;
+  }
+
+  long range_end = params.end_frame + 1;
+  long minimum_length = qCeil(kMinimumPassthroughLength * sequence->frame_rate());
+
+  // get every video clip that's visible somewhere in the range
+  QVector<Clip*> clips = sequence->GetClipsInRange(params.start_frame, range_end, true);
+  QVector<Clip*> visible;
+  for (int i=0;i<clips.size();i++) {
+    Clip* c = clips.at(i);
+    if (c->type() == olive::kTypeVideo && c->enabled() && !c->track()->IsEffectivelyMuted()) {
+      visible.append(c);
+    }
+  }
+
+  // footage files that have been checked, keyed by filename and stream index
+  QHash<QString, PassthroughSource> sources;
+
+  for (int i=0;i<visible.size();i++) {
+    Clip* c = visible.at(i);
+
+    if (!clip_is_unaltered(c, sequence)) {
+      continue;
+    }
+
+    // range the clip shows its footage in without blending it with another clip through a transition
+    long in = c->timeline_in(true);
+    long out = c->timeline_out(true);
+    if (c->opening_transition != nullptr) {
+      in += c->opening_transition->get_length();
+    }
+    if (c->closing_transition != nullptr) {
+      out -= c->closing_transition->get_length();
+    }
+    out = qMin(out, c->timeline_in(true) - c->clip_in(true) + c->media_length());
+
+    in = qMax(in, params.start_frame);
+    out = qMin(out, range_end);
+
+    if (out - in < minimum_length) {
+      continue;
+    }
+
+    const FootageStream* ms = c->media_stream();
+    QString source_key = QString("%1:%2").arg(c->media()->to_footage()->url, QString::number(ms->file_index));
+    if (!sources.contains(source_key)) {
+      sources.insert(source_key, open_source(c->media()->to_footage()->url, ms->file_index, format, params, vparams));
+    }
+
+    const PassthroughSource& source = sources[source_key];
+    if (!source.compatible) {
+      continue;
+    }
+
+    // only the parts where no other clip is visible can be copied
+    QVector<QPair<long, long> > covered;
+    for (int j=0;j<visible.size();j++) {
+      Clip* other = visible.at(j);
+      if (other != c && other->timeline_in(true) < out && other->timeline_out(true) > in) {
+        covered.append(qMakePair(other->timeline_in(true), other->timeline_out(true)));
+      }
+    }
+    std::sort(covered.begin(), covered.end());
+
+    long position = in;
+    for (int j=0;j<covered.size();j++) {
+      if (covered.at(j).first > position) {
+        add_range(c, source, position, covered.at(j).first, minimum_length, ranges);
+      }
+      position = qMax(position, covered.at(j).second);
+    }
+    if (position < out) {
+      add_range(c, source, position, out, minimum_length, ranges);
+    }
+  }
+
+  std::sort(ranges.begin(), ranges.end(), [](const PassthroughRange& a, const PassthroughRange& b) {
+    return a.start_frame < b.start_frame;
+  });
+
+  return ranges;
+}
+
+bool olive::passthrough::can_copy_stream(const AVCodecParameters *source,
+                                         AVOutputFormat *format,
+                                         const ExportParams &params,
+                                         const VideoCodecParams &vparams,
+                                         QString *reason)
+{
+  if (source->codec_type != AVMEDIA_TYPE_VIDEO || source->codec_id != params.video_codec) {
+    *reason = "it uses a different codec";
+    return false;
+  }
+
+  if (source->width != params.video_width || source->height != params.video_height) {
+    *reason = "it has different dimensions";
+    return false;
+  }
+
+  if (source->format != vparams.pix_fmt) {
+    *reason = "it uses a different pixel format";
+    return false;
+  }
+
+  if (source->field_order != AV_FIELD_UNKNOWN && source->field_order != AV_FIELD_PROGRESSIVE) {
+    *reason = "it's interlaced";
+    return false;
+  }
+
+  if (source->sample_aspect_ratio.num != 0 && av_cmp_q(source->sample_aspect_ratio, {1, 1}) != 0) {
+    *reason = "it doesn't have square pixels";
+    return false;
+  }
+
+  if (source->extradata_size > 0) {
+
+    // update_parameter_sets() can only switch between H.264 parameter sets with 4 byte NAL unit lengths (which is
+    // what FFmpeg's muxers write for the export's encoder) in formats that store them in the global header
+    if (!is_avcc(source) || (source->extradata[4] & 3) != 3) {
+      *reason = "its global header can't be combined with the export's encoder";
+      return false;
+    }
+
+    if (!(format->flags & AVFMT_GLOBALHEADER)) {
+      *reason = "the export format doesn't store H.264 parameter sets in its header";
+      return false;
+    }
+
+  } else {
+
+    // without a global header to switch between, each frame must be decodable on its own
+    const AVCodecDescriptor* desc = avcodec_descriptor_get(source->codec_id);
+    if (desc == nullptr || !(desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+      *reason = "its codec isn't intra-only";
+      return false;
+    }
+
+  }
+
+  return true;
+}
+
+bool olive::passthrough::update_parameter_sets(AVPacket *packet,
+                                               const AVCodecParameters *current,
+                                               const AVCodecParameters *next)
+{
+  if (!is_avcc(next)
+      || (current->extradata_size == next->extradata_size
+          && memcmp(current->extradata, next->extradata, size_t(next->extradata_size)) == 0)) {
+    return true;
+  }
+
+  // convert the SPS and PPS NAL units in the avcC header to the length-prefixed form used in packets
+  const uint8_t* data = next->extradata;
+  int size = next->extradata_size;
+  int length_size = (data[4] & 3) + 1;
+
+  QByteArray parameter_sets;
+  int pos = 5;
+
+  for (int set=0;set<2;set++) {
+    if (pos >= size) {
+      return false;
+    }
+
+    // the SPS count is stored in the lower 5 bits, the PPS count is a whole byte
+    int count = (set == 0) ? (data[pos] & 0x1F) : data[pos];
+    pos++;
+
+    for (int i=0;i<count;i++) {
+      if (pos + 2 > size) {
+        return false;
+      }
+
+      int nal_size = (data[pos] << 8) | data[pos+1];
+      pos += 2;
+
+      if (pos + nal_size > size) {
+        return false;
+      }
+
+      for (int j=length_size-1;j>=0;j--) {
+        parameter_sets.append(char((nal_size >> (j * 8)) & 0xFF));
+      }
+      parameter_sets.append(reinterpret_cast<const char*>(data + pos), nal_size);
+
+      pos += nal_size;
+    }
+  }
+
+  AVPacket with_sets;
+  if (av_new_packet(&with_sets, parameter_sets.size() + packet->size) < 0) {
+    return false;
+  }
+
+  memcpy(with_sets.data, parameter_sets.constData(), size_t(parameter_sets.size()));
+  memcpy(with_sets.data + parameter_sets.size(), packet->data, size_t(packet->size));
+  av_packet_copy_props(&with_sets, packet);
+
+  av_packet_unref(packet);
+  av_packet_move_ref(packet, &with_sets);
+
+  return true;
+}
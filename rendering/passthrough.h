@@ -0,0 +1,141 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PASSTHROUGH_H
+#define PASSTHROUGH_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QString>
+#include <QVector>
+
+class Sequence;
+struct ExportParams;
+struct VideoCodecParams;
+
+/**
+ * @brief The PassthroughRange struct
+ *
+ * A range of an export where the Sequence shows a single source file's video unaltered, so the source's compressed
+ * packets can be copied into the export instead of being decoded, rendered and encoded again (see
+ * olive::passthrough::find_ranges()).
+ *
+ * The range starts and ends on the source's keyframes, so the copied packets can be decoded on their own.
+ */
+struct PassthroughRange {
+  /**
+   * @brief Filename of the source file to copy packets from
+   */
+  QString filename;
+
+  /**
+   * @brief Index of the video stream in the source file
+   */
+  int stream_index;
+
+  /**
+   * @brief First and last Sequence frame the copied packets cover
+   */
+  long start_frame;
+  long end_frame;
+
+  /**
+   * @brief Timestamp of the keyframe the copy starts at and the keyframe it stops before (in the stream's time base)
+   */
+  int64_t start_pts;
+  int64_t end_pts;
+};
+
+namespace olive {
+  namespace passthrough {
+    /**
+     * @brief Find the parts of an export that can be copied from their source files
+     *
+     * A frame can be copied if it comes from the only visible video clip, that clip plays its footage at its native
+     * speed and frame rate without any effects (other than an unchanged Transform) or transitions, and the footage's
+     * video stream is already encoded the way the export would encode it (see can_copy_stream()). Only runs of these
+     * frames that contain at least one whole GOP (from one keyframe to the next) are returned, the frames around them
+     * still have to be rendered. Nothing can be copied while OpenColorIO color management is enabled, since every
+     * rendered frame goes through its transforms.
+     *
+     * Opens each footage file to check its codec parameters, so it should be called from the export's thread rather
+     * than the main thread. The Sequence must not be modified while it runs (e.g. pass an export's snapshot).
+     *
+     * @param sequence
+     *
+     * Sequence being exported
+     *
+     * @param params
+     *
+     * Export parameters. Only the range inside start_frame and end_frame is searched.
+     *
+     * @param vparams
+     *
+     * Video codec parameters the rest of the export will be encoded with
+     *
+     * @return
+     *
+     * Ranges that can be copied, in order and not overlapping.
+     */
+    QVector<PassthroughRange> find_ranges(Sequence* sequence,
+                                          const ExportParams& params,
+                                          const VideoCodecParams& vparams);
+
+    /**
+     * @brief Check whether a source stream's packets can be mixed with packets encoded for an export
+     *
+     * The codec, dimensions, pixel format and field order must match the export's. Because the copied packets and
+     * the encoded ones end up in the same stream, they also have to be decodable with one decoder: either the codec
+     * is intra-only and has no global headers, or it's H.264 in a container that stores its parameter sets in the
+     * global header, in which case the parameter sets are repeated in the stream whenever they change (see
+     * update_parameter_sets()).
+     *
+     * @param reason
+     *
+     * Set to a description of why the stream can't be copied if this function returns **FALSE**.
+     */
+    bool can_copy_stream(const AVCodecParameters* source,
+                         AVOutputFormat* format,
+                         const ExportParams& params,
+                         const VideoCodecParams& vparams,
+                         QString* reason);
+
+    /**
+     * @brief Prepare the first packet from a different source for a stream that was configured by another source
+     *
+     * If both sources are H.264 streams with different parameter sets (e.g. copied packets following ones encoded by
+     * the export's encoder), `next`'s parameter sets are inserted at the start of `packet` so decoders switch to them.
+     * Otherwise the packet is left as it is.
+     *
+     * @param packet
+     *
+     * The first packet from `next`, which must be a keyframe
+     *
+     * @return
+     *
+     * **FALSE** if the parameter sets couldn't be inserted.
+     */
+    bool update_parameter_sets(AVPacket* packet, const AVCodecParameters* current, const AVCodecParameters* next);
+  }
+}
+
+#endif // PASSTHROUGH_H
@@ -225,6 +225,44 @@ void process_effect(QOpenGLContext* ctx,
   }
 }
 
+/**
+ * @brief Where an inactive clip is relative to the lookahead window around the playhead
+ */
+enum LookaheadState {
+  kLookaheadOutside,
+  kLookaheadUpcoming,
+  kLookaheadPassed
+};
+
+/**
+ * @brief Determine whether an inactive clip will be reached within `window` frames in the playback direction
+ * (kLookaheadUpcoming) or was passed within the last `window` frames (kLookaheadPassed)
+ */
+LookaheadState GetLookaheadState(Clip* c, long playhead, long window, bool reverse) {
+  if (window <= 0 || !c->enabled() || c->track()->IsEffectivelyMuted()) {
+    return kLookaheadOutside;
+  }
+
+  long in = c->timeline_in(true);
+  long out = c->timeline_out(true);
+
+  // during reverse playback, the clip's out point is where the playhead reaches it
+  long entry = reverse ? out : in;
+  long exit = reverse ? in : out;
+  long direction = reverse ? -1 : 1;
+
+  long distance_to_entry = (entry - playhead) * direction;
+  long distance_from_exit = (playhead - exit) * direction;
+
+  if (distance_to_entry > 0 && distance_to_entry <= window) {
+    return kLookaheadUpcoming;
+  } else if (distance_from_exit >= 0 && distance_from_exit < window) {
+    return kLookaheadPassed;
+  }
+
+  return kLookaheadOutside;
+}
+
 GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
   GLuint final_fbo = params.type == olive::kTypeVideo ? params.main_buffer->buffer() : 0;
 
@@ -251,8 +289,29 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
 
   QVector<Clip*> current_clips;
 
+  // clips this close to the playhead are opened ahead of time (or kept open after they've passed) so that opening
+  // them doesn't stall playback when the playhead reaches them
+  long lookahead_window = qRound(olive::config.clip_lookahead * s->frame_rate());
+  bool reverse_playback = (params.playback_speed < 0);
+
+  // only clips within the lookahead window can be active or need opening, the only others we need to look at are
+  // clips that are still open and need closing
+  QVector<Clip*> sequence_clips;
+  QVector<Track*> tracks = s->GetTrackList(params.type);
+  for (int i=0;i<tracks.size();i++) {
+    Track* t = tracks.at(i);
+
+    sequence_clips.append(t->GetClipsInRange(playhead - lookahead_window - 1, playhead + lookahead_window + 1, true));
+
+    QVector<Clip*> open_clips = t->GetOpenClips();
+    for (int j=0;j<open_clips.size();j++) {
+      if (!sequence_clips.contains(open_clips.at(j))) {
+        sequence_clips.append(open_clips.at(j));
+      }
+    }
+  }
+
   // loop through clips, find currently active, and sort by track
-  QVector<Clip*> sequence_clips = s->GetAllClips();
   for (int i=0;i<sequence_clips.size();i++) {
 
     Clip* c = sequence_clips.at(i);
@@ -264,6 +323,14 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
 
         bool clip_is_active = false;
 
+        // route audio to the context we're rendering for, reopening the clip if it was rendering for another
+        if (c->type() == olive::kTypeAudio) {
+          c->SetAudioContext(params.audio_context);
+        }
+
+        // likewise reopen the clip if it was opened for playback and is now exported, or vice versa
+        c->SetExporting(params.exporting);
+
         // is the clip a "footage" clip?
         if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
           Footage* m = c->media()->to_footage();
@@ -288,10 +355,29 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
                 // increment audio track count
                 if (c->type() == olive::kTypeAudio) audio_track_count++;
 
-              } else if (c->IsOpen()) {
+              } else {
 
-                // close the clip if it isn't active anymore
-                c->Close(false);
+                LookaheadState lookahead = (ms != nullptr)
+                    ? GetLookaheadState(c, playhead, lookahead_window, reverse_playback)
+                    : kLookaheadOutside;
+
+                if (lookahead == kLookaheadUpcoming) {
+
+                  // open the clip in the background and start caching from where the playhead will enter it
+                  if (!c->IsOpen()) {
+                    c->Open();
+                  } else if (c->type() == olive::kTypeVideo) {
+                    c->Preroll(reverse_playback ? c->timeline_out(true) - 1 : c->timeline_in(true),
+                               params.nests,
+                               params.playback_speed);
+                  }
+
+                } else if (lookahead == kLookaheadOutside && c->IsOpen()) {
+
+                  // close the clip if it isn't active anymore and is well behind the playhead
+                  c->Close(false);
+
+                }
 
               }
             } else {
@@ -387,7 +473,7 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
           c->fbo.resize(fbo_count);
 
           for (int j=0;j<fbo_count;j++) {
-            c->fbo[j].Create(params.ctx, video_width, video_height);
+            c->fbo[j].Create(params.ctx, video_width, video_height, params.exporting);
           }
         }
 
@@ -805,14 +891,23 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
   return 0;
 }
 
-void olive::rendering::compose_audio(Viewer* viewer, Sequence* seq, int playback_speed, bool wait_for_mutexes) {
+void olive::rendering::compose_audio(Viewer* viewer,
+                                     Sequence* seq,
+                                     AudioRenderContext* audio_context,
+                                     int playback_speed,
+                                     bool wait_for_mutexes) {
   ComposeSequenceParams params;
   params.viewer = viewer;
   params.ctx = nullptr;
+  params.audio_context = audio_context;
   params.seq = seq;
   params.type = olive::kTypeAudio;
   params.gizmos = nullptr;
   params.wait_for_mutexes = wait_for_mutexes;
+
+  // only exports pull audio synchronously
+  params.exporting = (audio_context != nullptr && audio_context->synchronous());
+
   params.playback_speed = playback_speed;
   compose_sequence(params);
 }
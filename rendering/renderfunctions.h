@@ -54,6 +54,14 @@ struct ComposeSequenceParams {
      */
     QOpenGLContext* ctx;
 
+    /**
+     * @brief The audio context to render audio into
+     *
+     * For audio rendering, every audio clip's Cacher is routed to this context (see Clip::SetAudioContext()). For
+     * video, this variable is never accessed.
+     */
+    AudioRenderContext* audio_context;
+
     /**
      * @brief The OpenGL pipeline used for rendering
      *
@@ -129,6 +137,14 @@ struct ComposeSequenceParams {
      */
     bool wait_for_mutexes;
 
+    /**
+     * @brief Whether this render is for an export rather than a viewer
+     *
+     * Clips opened by an export render use proxies according to Config::dont_use_proxies_on_export and their
+     * framebuffers are created at Config::export_bit_depth.
+     */
+    bool exporting;
+
     /**
      * @brief Set the current playback speed (adjusted with Shuttle Left/Right)
      *
@@ -217,6 +233,10 @@ GLuint compose_sequence(ComposeSequenceParams &params);
  *
  * The Sequence whose audio to render.
  *
+ * @param audio_context
+ *
+ * The context to render audio into (usually the calling Viewer's, see Viewer::audio_context()).
+ *
  * @param playback_speed
  *
  * The current playback speed (controlled by Shuttle Left/Right)
@@ -225,7 +245,7 @@ GLuint compose_sequence(ComposeSequenceParams &params);
  *
  * Whether to wait for media to open or simply fail if the media is not yet open. This should usually be **FALSE**.
  */
-void compose_audio(Viewer* viewer, Sequence *seq, int playback_speed, bool wait_for_mutexes);
+void compose_audio(Viewer* viewer, Sequence *seq, AudioRenderContext* audio_context, int playback_speed, bool wait_for_mutexes);
 }
 }
 
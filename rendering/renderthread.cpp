@@ -26,6 +26,7 @@
 #include <QFileInfo>
 #include <QOpenGLExtraFunctions>
 #include <QDebug>
+#include <cstring>
 
 #include <OpenColorIO/OpenColorIO.h>
 namespace OCIO = OCIO_NAMESPACE::v1;
@@ -36,8 +37,10 @@ namespace OCIO = OCIO_NAMESPACE::v1;
 #include "rendering/renderfunctions.h"
 #include "rendering/shadergenerators.h"
 
-RenderThread::RenderThread() :
+RenderThread::RenderThread(bool standalone, bool exporting) :
   gizmos(nullptr),
+  standalone_(standalone),
+  exporting_(exporting),
   share_ctx(nullptr),
   ctx(nullptr),
   seq(nullptr),
@@ -50,8 +53,16 @@ RenderThread::RenderThread() :
   running(true),
   ocio_config_date(0),
   front_buffer_switcher(false),
-  pipeline_program(nullptr)
+  pipeline_program(nullptr),
+  pixel_buffer(nullptr),
+  readback_buffer_size(0),
+  next_readback_buffer(0),
+  readback_flush_queued(false)
 {
+  for (int i=0;i<kReadbackBufferCount;i++) {
+    readback_buffers[i] = 0;
+  }
+
   surface.create();
 }
 
@@ -63,15 +74,31 @@ void RenderThread::run() {
   wait_lock_.lock();
 
   while (running) {
-    if (!queued) {
+    if (!queued && !readback_flush_queued) {
       wait_cond_.wait(&wait_lock_);
     }
     if (!running) {
       break;
     }
+
+    if (readback_flush_queued) {
+      readback_flush_queued = false;
+
+      if (ctx != nullptr) {
+        ctx->makeCurrent(&surface);
+
+        while (!pending_readbacks.isEmpty()) {
+          complete_readback();
+        }
+      }
+
+      emit ready();
+      continue;
+    }
+
     queued = false;
 
-    if (share_ctx != nullptr) {
+    if (share_ctx != nullptr || standalone_) {
       if (ctx != nullptr) {
         ctx->makeCurrent(&surface);
 
@@ -86,19 +113,19 @@ void RenderThread::run() {
 
         // create any buffers that don't yet exist
         if (!composite_buffer.IsCreated()) {
-          composite_buffer.Create(ctx, seq->width(), seq->height());
+          composite_buffer.Create(ctx, seq->width(), seq->height(), exporting_);
         }
         if (!front_buffer_1.IsCreated()) {
-          front_buffer_1.Create(ctx, seq->width(), seq->height());
+          front_buffer_1.Create(ctx, seq->width(), seq->height(), exporting_);
         }
         if (!front_buffer_2.IsCreated()) {
-          front_buffer_2.Create(ctx, seq->width(), seq->height());
+          front_buffer_2.Create(ctx, seq->width(), seq->height(), exporting_);
         }
         if (!back_buffer_1.IsCreated()) {
-          back_buffer_1.Create(ctx, seq->width(), seq->height());
+          back_buffer_1.Create(ctx, seq->width(), seq->height(), exporting_);
         }
         if (!back_buffer_2.IsCreated()) {
-          back_buffer_2.Create(ctx, seq->width(), seq->height());
+          back_buffer_2.Create(ctx, seq->width(), seq->height(), exporting_);
         }
 
         // If there's no pipeline shader, create it now
@@ -125,6 +152,12 @@ void RenderThread::run() {
     }
   }
 
+  // the clips' textures and framebuffers were created in our context, so they have to be freed in it too
+  if (standalone_ && ctx != nullptr && seq != nullptr) {
+    ctx->makeCurrent(&surface);
+    seq->Close();
+  }
+
   delete_ctx();
 
   wait_lock_.unlock();
@@ -198,10 +231,12 @@ void RenderThread::paint() {
   ComposeSequenceParams params;
   params.viewer = nullptr;
   params.ctx = ctx;
+  params.audio_context = nullptr;
   params.seq = seq;
   params.type = olive::kTypeVideo;
   params.texture_failed = false;
   params.wait_for_mutexes = true;
+  params.exporting = exporting_;
   params.playback_speed = playback_speed_;
   params.pipeline = pipeline_program.get();
   params.backend_buffer1 = &back_buffer_1;
@@ -255,8 +290,12 @@ void RenderThread::paint() {
 
   }
 
-  // flush changes
-  f->glFinish();
+  // flush changes (when exporting, the viewer isn't showing the front buffer so there's no need to wait for it)
+  if (pixel_buffer == nullptr) {
+    f->glFinish();
+  } else {
+    f->glFlush();
+  }
 
   f->glDisable(GL_BLEND);
 
@@ -280,24 +319,19 @@ void RenderThread::paint() {
 
   if (pixel_buffer != nullptr) {
 
-    // set main framebuffer to the current read buffer
-    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, composite_buffer.buffer());
-
-    // store pixels in buffer
-    f->glReadPixels(0,
-                    0,
-                    pixel_buffer_linesize == 0 ? tex_width : pixel_buffer_linesize,
-                    tex_height,
-                    GL_RGBA,
-                    GL_UNSIGNED_BYTE,
-                    pixel_buffer);
-
-    // release current read buffer
-    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    // a failed frame will be rendered again, so don't bother reading it back
+    if (!texture_failed) {
+      start_readback();
+    }
 
     pixel_buffer = nullptr;
   }
 
+  // complete every readback except the newest one, which the GPU can transfer while the next frame is composited
+  while (pending_readbacks.size() > 1) {
+    complete_readback();
+  }
+
   // release
   f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
@@ -326,15 +360,30 @@ void RenderThread::start_render(QOpenGLContext *share,
     ctx->setShareContext(share_ctx);
     ctx->create();
     ctx->moveToThread(this);
+  } else if (standalone_ && ctx == nullptr) {
+    ctx = new QOpenGLContext();
+    ctx->setFormat(QSurfaceFormat::defaultFormat());
+    ctx->create();
+    ctx->moveToThread(this);
   }
 
   save_fn = save;
   pixel_buffer = pixels;
   pixel_buffer_linesize = pixel_linesize;
 
+  // set the flag under the lock so the wake can't land between run()'s check and its wait
+  wait_lock_.lock();
   queued = true;
+  wait_cond_.wakeAll();
+  wait_lock_.unlock();
+}
 
+void RenderThread::finish_readback()
+{
+  wait_lock_.lock();
+  readback_flush_queued = true;
   wait_cond_.wakeAll();
+  wait_lock_.unlock();
 }
 
 bool RenderThread::did_texture_fail() {
@@ -342,8 +391,13 @@ bool RenderThread::did_texture_fail() {
 }
 
 void RenderThread::cancel() {
-  running = false;
-  wait_cond_.wakeAll();
+  {
+    // set under the lock so run() can't miss the wake between checking running and starting to wait
+    QMutexLocker locker(&wait_lock_);
+    running = false;
+    wait_cond_.wakeAll();
+  }
+
   wait();
 }
 
@@ -363,7 +417,102 @@ void RenderThread::wait_until_paused()
   }
 }
 
+void RenderThread::start_readback()
+{
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  int size = tex_width * tex_height * 4;
+
+  // (re-)create the pixel buffer objects if the sequence size changed
+  if (size != readback_buffer_size) {
+    while (!pending_readbacks.isEmpty()) {
+      complete_readback();
+    }
+
+    delete_readback_buffers();
+
+    xf->glGenBuffers(kReadbackBufferCount, readback_buffers);
+    for (int i=0;i<kReadbackBufferCount;i++) {
+      xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback_buffers[i]);
+      xf->glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback_buffer_size = size;
+  }
+
+  PendingReadback readback;
+  readback.buffer = readback_buffers[next_readback_buffer];
+  readback.pixels = pixel_buffer;
+  readback.linesize = (pixel_buffer_linesize == 0) ? tex_width : pixel_buffer_linesize;
+
+  next_readback_buffer = (next_readback_buffer + 1) % kReadbackBufferCount;
+
+  // with a pixel buffer object bound, glReadPixels() returns immediately and the GPU copies the frame in the background
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, composite_buffer.buffer());
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+  xf->glReadPixels(0, 0, tex_width, tex_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  readback.fence = xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  xf->glFlush();
+
+  pending_readbacks.append(readback);
+}
+
+void RenderThread::complete_readback()
+{
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  PendingReadback readback = pending_readbacks.takeFirst();
+
+  xf->glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  xf->glDeleteSync(readback.fence);
+
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+
+  const uchar* source = static_cast<const uchar*>(xf->glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                                                                       0,
+                                                                       readback_buffer_size,
+                                                                       GL_MAP_READ_BIT));
+  if (source == nullptr) {
+    qWarning() << "Failed to map readback buffer";
+  } else {
+    int row_size = tex_width * 4;
+    uchar* destination = static_cast<uchar*>(readback.pixels);
+
+    for (int i=0;i<tex_height;i++) {
+      memcpy(destination + i * readback.linesize * 4, source + i * row_size, size_t(row_size));
+    }
+
+    xf->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void RenderThread::delete_readback_buffers()
+{
+  // any readbacks still pending are abandoned
+  for (int i=0;i<pending_readbacks.size();i++) {
+    ctx->extraFunctions()->glDeleteSync(pending_readbacks.at(i).fence);
+  }
+  pending_readbacks.clear();
+
+  if (readback_buffers[0] != 0) {
+    ctx->extraFunctions()->glDeleteBuffers(kReadbackBufferCount, readback_buffers);
+  }
+
+  for (int i=0;i<kReadbackBufferCount;i++) {
+    readback_buffers[i] = 0;
+  }
+  readback_buffer_size = 0;
+  next_readback_buffer = 0;
+}
+
 void RenderThread::delete_buffers() {
+  delete_readback_buffers();
   composite_buffer.Destroy();
   front_buffer_1.Destroy();
   front_buffer_2.Destroy();
@@ -22,6 +22,7 @@
 #define RENDERTHREAD_H
 
 #include <QThread>
+#include <QVector>
 #include <QMutex>
 #include <QWaitCondition>
 #include <QOffscreenSurface>
@@ -37,7 +38,24 @@
 class RenderThread : public QThread {
   Q_OBJECT
 public:
-  RenderThread();
+  /**
+   * @brief RenderThread Constructor
+   *
+   * Must be called from the main thread.
+   *
+   * @param standalone
+   *
+   * **FALSE** to render in a context shared with a viewer (see start_render()). **TRUE** to render in a private
+   * offscreen context that isn't tied to any widget (e.g. for exporting), in which case the rendered Sequence's clips
+   * are closed when the thread stops so their OpenGL resources are freed in the context that created them.
+   *
+   * @param exporting
+   *
+   * **TRUE** if this thread renders for an export. Its framebuffers are then created at Config::export_bit_depth
+   * rather than Config::playback_bit_depth, and the clips it opens follow Config::dont_use_proxies_on_export. This
+   * only affects this thread, so viewers keep rendering as usual while an export is running.
+   */
+  RenderThread(bool standalone = false, bool exporting = false);
   ~RenderThread();
   void run();
 
@@ -46,6 +64,16 @@ public:
 
   OldEffectNode* gizmos;
   void paint();
+
+  /**
+   * @brief Queue a frame to be rendered
+   *
+   * If `pixels` is set, the rendered frame is read back into it asynchronously through a pixel buffer object. The
+   * pixels are only guaranteed to be there once the *next* successful render has finished (or after
+   * finish_readback()), which lets the GPU transfer one frame while the next one is being composited.
+   *
+   * `share` is the context to share textures with, standalone RenderThreads ignore it and pass `nullptr`.
+   */
   void start_render(QOpenGLContext* share,
                     Sequence *s,
                     int playback_speed,
@@ -53,6 +81,13 @@ public:
                     GLvoid *pixels = nullptr,
                     int pixel_linesize = 0,
                     int idivider = 0);
+
+  /**
+   * @brief Complete any readbacks still in progress without rendering another frame
+   *
+   * ready() is emitted once every buffer passed to start_render() has been filled.
+   */
+  void finish_readback();
   bool did_texture_fail();
   void cancel();
   void wait_until_paused();
@@ -70,6 +105,11 @@ private:
   // OpenColorIO functions
   void set_up_ocio();
 
+  // asynchronous readback functions
+  void start_readback();
+  void complete_readback();
+  void delete_readback_buffers();
+
   // OpenColorIO variables
   GLuint ocio_lut_texture;
   QOpenGLShaderProgramPtr ocio_shader;
@@ -92,6 +132,8 @@ private:
   QMutex main_thread_lock_;
 
   QOffscreenSurface surface;
+  bool standalone_;
+  bool exporting_;
   QOpenGLContext* share_ctx;
   QOpenGLContext* ctx;
   QOpenGLShaderProgramPtr pipeline_program;
@@ -111,6 +153,20 @@ private:
   QString save_fn;
   GLvoid *pixel_buffer;
   int pixel_buffer_linesize;
+
+  // asynchronous readback variables
+  struct PendingReadback {
+    GLuint buffer;
+    GLsync fence;
+    GLvoid* pixels;
+    int linesize;
+  };
+  static const int kReadbackBufferCount = 2;
+  GLuint readback_buffers[kReadbackBufferCount];
+  int readback_buffer_size;
+  int next_readback_buffer;
+  QVector<PendingReadback> pending_readbacks;
+  bool readback_flush_queued;
 };
 
 #endif // RENDERTHREAD_H
@@ -0,0 +1,188 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+// Times the kernels in rendering/audiodsp.cpp against the plain loops they replaced. Not run by ctest, build the
+// audiodsp_benchmark target and run it on the machine being measured (preferably in a Release build).
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "rendering/audiodsp.h"
+
+namespace {
+
+// one second of stereo audio at 48kHz, plus one frame so the vector loops finish with a remainder
+const int kFrames = 48001;
+const int kChannels = 2;
+const int kSamples = kFrames * kChannels;
+
+// how many times each kernel runs, the fastest run is reported
+const int kRuns = 200;
+
+// keeps results alive so the compiler can't skip the work
+volatile float sink;
+
+template<typename Function>
+double Time(Function function) {
+  double best = 0;
+
+  for (int i=0;i<kRuns;i++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    function();
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  return best;
+}
+
+template<typename Scalar, typename Kernel>
+void Report(const char* name, Scalar scalar, Kernel kernel) {
+  double scalar_time = Time(scalar);
+  double kernel_time = Time(kernel);
+
+  std::printf("%-14s %10.1f us %10.1f us %8.2fx\n", name, scalar_time, kernel_time, scalar_time / kernel_time);
+}
+
+}
+
+int main() {
+  std::vector<float> interleaved(kSamples);
+  std::vector<float> left(kFrames);
+  std::vector<float> right(kFrames);
+  std::vector<float> envelope(kSamples);
+  std::vector<float> add(kSamples);
+  std::vector<int16_t> pcm(kSamples);
+
+  for (int i=0;i<kSamples;i++) {
+    interleaved[size_t(i)] = std::sin(i * 0.01f) * 1.2f;
+    envelope[size_t(i)] = 0.5f + 0.5f * std::cos(i * 0.001f);
+    add[size_t(i)] = std::sin(i * 0.003f) * 0.1f;
+  }
+  for (int i=0;i<kFrames;i++) {
+    left[size_t(i)] = interleaved[size_t(i*2)];
+    right[size_t(i)] = interleaved[size_t(i*2 + 1)];
+  }
+
+  float* samples = interleaved.data();
+  const float* planes[] = {left.data(), right.data()};
+  float* out_planes[] = {left.data(), right.data()};
+
+  std::printf("%-14s %13s %13s %9s\n", "kernel", "scalar", "vectorized", "speed-up");
+
+  Report("Interleave",
+         [&]() {
+           for (int i=0;i<kFrames;i++) {
+             samples[i*2] = planes[0][i];
+             samples[i*2 + 1] = planes[1][i];
+           }
+         },
+         [&]() { olive::dsp::Interleave(planes, samples, kChannels, kFrames); });
+
+  Report("Deinterleave",
+         [&]() {
+           for (int i=0;i<kFrames;i++) {
+             out_planes[0][i] = samples[i*2];
+             out_planes[1][i] = samples[i*2 + 1];
+           }
+         },
+         [&]() { olive::dsp::Deinterleave(samples, out_planes, kChannels, kFrames); });
+
+  // the gain kernels alternate between a gain and its inverse so the samples don't decay to denormals
+  float gain = 0.5f;
+  Report("Gain",
+         [&]() {
+           gain = 1.0f / gain;
+           for (int i=0;i<kSamples;i++) {
+             samples[i] *= gain;
+           }
+         },
+         [&]() { gain = 1.0f / gain; olive::dsp::Gain(samples, kSamples, gain); });
+
+  Report("GainRamp",
+         [&]() {
+           float step = (1.0f - 0.999f) / float(kSamples);
+           for (int i=0;i<kSamples;i++) {
+             samples[i] *= 0.999f + step * float(i);
+           }
+         },
+         [&]() { olive::dsp::GainRamp(samples, kSamples, 0.999f, 1.0f); });
+
+  Report("MultiplyAdd",
+         [&]() {
+           for (int i=0;i<kSamples;i++) {
+             samples[i] = samples[i] * envelope[size_t(i)] + add[size_t(i)];
+           }
+         },
+         [&]() { olive::dsp::MultiplyAdd(samples, envelope.data(), add.data(), kSamples); });
+
+  Report("MixAdd",
+         [&]() {
+           for (int i=0;i<kSamples;i++) {
+             samples[i] += add[size_t(i)];
+           }
+         },
+         [&]() { olive::dsp::MixAdd(samples, add.data(), kSamples); });
+
+  Report("Reverse",
+         [&]() { std::reverse(samples, samples + kSamples); },
+         [&]() { olive::dsp::Reverse(samples, kSamples); });
+
+  float peaks[kChannels];
+  Report("Peak",
+         [&]() {
+           peaks[0] = peaks[1] = 0.0f;
+           for (int i=0;i<kSamples;i++) {
+             peaks[i%kChannels] = std::max(peaks[i%kChannels], std::fabs(samples[i]));
+           }
+           sink = peaks[0];
+         },
+         [&]() { olive::dsp::Peak(samples, kFrames, kChannels, peaks); sink = peaks[0]; });
+
+  float rms[kChannels];
+  Report("Rms",
+         [&]() {
+           double sums[kChannels] = {};
+           for (int i=0;i<kSamples;i++) {
+             sums[i%kChannels] += double(samples[i]) * double(samples[i]);
+           }
+           sink = float(std::sqrt(sums[0] / kFrames));
+         },
+         [&]() { olive::dsp::Rms(samples, kFrames, kChannels, rms); sink = rms[0]; });
+
+  Report("FloatToInt16",
+         [&]() {
+           for (int i=0;i<kSamples;i++) {
+             pcm[size_t(i)] = int16_t(std::lrint(std::min(1.0f, std::max(-1.0f, samples[i])) * 32767.0f));
+           }
+         },
+         [&]() { olive::dsp::FloatToInt16(samples, pcm.data(), kSamples); });
+
+  sink = samples[kSamples / 2] + pcm[size_t(kSamples / 3)];
+
+  return 0;
+}
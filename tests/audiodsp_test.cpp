@@ -0,0 +1,356 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+// Checks the vectorized kernels in rendering/audiodsp.cpp against straightforward scalar implementations over lengths
+// and pointer offsets that exercise the vector loops, their remainders and unaligned buffers. Build it with -mavx2 to
+// test the AVX2 paths as well (see tests/CMakeLists.txt).
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "rendering/audiodsp.h"
+
+namespace {
+
+// longest buffer tested, long enough to run every vector loop several times and then leave a remainder
+const int kMaxLength = 67;
+
+// furthest a buffer is moved from the start of its allocation to make it unaligned
+const int kMaxOffset = 3;
+
+int failures = 0;
+
+// deterministic pseudo-random samples between -1.5 and 1.5 (outside the usual range to test clipping)
+class Random {
+public:
+  Random() : state_(1) {}
+
+  float Next() {
+    state_ = state_ * 1664525u + 1013904223u;
+    return float(state_ >> 8) / float(1 << 24) * 3.0f - 1.5f;
+  }
+
+private:
+  uint32_t state_;
+};
+
+Random random;
+
+// a buffer of random samples that starts `offset` floats into its allocation
+class Buffer {
+public:
+  Buffer(int length, int offset) :
+    data_(size_t(length + offset + 8)),
+    offset_(offset)
+  {
+    for (size_t i=0;i<data_.size();i++) {
+      data_[i] = random.Next();
+    }
+  }
+
+  float* data() {
+    return data_.data() + offset_;
+  }
+
+private:
+  std::vector<float> data_;
+  int offset_;
+};
+
+void Fail(const char* kernel, int length, int offset, int index, double expected, double got) {
+  if (failures < 20) {
+    std::fprintf(stderr, "%s: length %d, offset %d, index %d: expected %.9g, got %.9g\n",
+                 kernel, length, offset, index, expected, got);
+  }
+  failures++;
+}
+
+bool Equal(float a, float b, float tolerance) {
+  return std::fabs(a - b) <= tolerance * std::max(1.0f, std::fabs(a));
+}
+
+void Compare(const char* kernel, int length, int offset, const float* expected, const float* got, int count,
+             float tolerance = 0.0f) {
+  for (int i=0;i<count;i++) {
+    if (!Equal(expected[i], got[i], tolerance)) {
+      Fail(kernel, length, offset, i, expected[i], got[i]);
+      return;
+    }
+  }
+}
+
+void TestInterleave(int length, int offset) {
+  const int channel_counts[] = {1, 2, 3, 6};
+
+  for (int channels : channel_counts) {
+    for (int step=1;step<=2;step++) {
+      std::vector<Buffer> planes;
+      std::vector<const float*> in;
+      for (int c=0;c<channels;c++) {
+        planes.push_back(Buffer(length * step, offset));
+      }
+      for (int c=0;c<channels;c++) {
+        in.push_back(planes[size_t(c)].data());
+      }
+
+      Buffer out(length * channels, offset);
+      std::vector<float> expected(static_cast<size_t>(length * channels));
+
+      for (int c=0;c<channels;c++) {
+        for (int i=0;i<length;i++) {
+          expected[size_t(i*channels + c)] = in[size_t(c)][i*step];
+        }
+      }
+
+      olive::dsp::Interleave(in.data(), out.data(), channels, length, step);
+      Compare("Interleave", length, offset, expected.data(), out.data(), length * channels);
+    }
+  }
+}
+
+void TestDeinterleave(int length, int offset) {
+  const int channel_counts[] = {1, 2, 3, 6};
+
+  for (int channels : channel_counts) {
+    Buffer in(length * channels, offset);
+
+    std::vector<Buffer> planes;
+    std::vector<float*> out;
+    for (int c=0;c<channels;c++) {
+      planes.push_back(Buffer(length, offset));
+    }
+    for (int c=0;c<channels;c++) {
+      out.push_back(planes[size_t(c)].data());
+    }
+
+    olive::dsp::Deinterleave(in.data(), out.data(), channels, length);
+
+    for (int c=0;c<channels;c++) {
+      std::vector<float> expected(static_cast<size_t>(length));
+      for (int i=0;i<length;i++) {
+        expected[size_t(i)] = in.data()[i*channels + c];
+      }
+      Compare("Deinterleave", length, offset, expected.data(), out[size_t(c)], length);
+    }
+  }
+}
+
+void TestGain(int length, int offset) {
+  Buffer samples(length, offset);
+  std::vector<float> expected(samples.data(), samples.data() + length);
+  for (int i=0;i<length;i++) {
+    expected[size_t(i)] *= 0.37f;
+  }
+
+  olive::dsp::Gain(samples.data(), length, 0.37f);
+  Compare("Gain", length, offset, expected.data(), samples.data(), length);
+}
+
+void TestGainRamp(int length, int offset) {
+  Buffer samples(length, offset);
+  std::vector<float> expected(samples.data(), samples.data() + length);
+
+  // the ramp's gain is computed differently by the kernel (start + step * i for each lane), allow for rounding
+  if (length > 0) {
+    float step = (1.25f - 0.5f) / float(length);
+    for (int i=0;i<length;i++) {
+      expected[size_t(i)] *= 0.5f + step * float(i);
+    }
+  }
+
+  olive::dsp::GainRamp(samples.data(), length, 0.5f, 1.25f);
+  Compare("GainRamp", length, offset, expected.data(), samples.data(), length, 1e-6f);
+}
+
+void TestEnvelope(int length, int offset) {
+  Buffer samples(length, offset);
+  Buffer envelope(length, kMaxOffset - offset);
+  std::vector<float> expected(samples.data(), samples.data() + length);
+  for (int i=0;i<length;i++) {
+    expected[size_t(i)] *= envelope.data()[i];
+  }
+
+  olive::dsp::Envelope(samples.data(), envelope.data(), length);
+  Compare("Envelope", length, offset, expected.data(), samples.data(), length);
+}
+
+void TestMultiplyAdd(int length, int offset) {
+  Buffer samples(length, offset);
+  Buffer multiply(length, kMaxOffset - offset);
+  Buffer add(length, (offset + 1) % (kMaxOffset + 1));
+  std::vector<float> expected(samples.data(), samples.data() + length);
+  for (int i=0;i<length;i++) {
+    expected[size_t(i)] = expected[size_t(i)] * multiply.data()[i] + add.data()[i];
+  }
+
+  olive::dsp::MultiplyAdd(samples.data(), multiply.data(), add.data(), length);
+  Compare("MultiplyAdd", length, offset, expected.data(), samples.data(), length);
+}
+
+void TestMixAdd(int length, int offset) {
+  Buffer dst(length, offset);
+  Buffer src(length, kMaxOffset - offset);
+  std::vector<float> expected(dst.data(), dst.data() + length);
+  for (int i=0;i<length;i++) {
+    expected[size_t(i)] += src.data()[i];
+  }
+
+  olive::dsp::MixAdd(dst.data(), src.data(), length);
+  Compare("MixAdd", length, offset, expected.data(), dst.data(), length);
+}
+
+void TestReverse(int length, int offset) {
+  Buffer samples(length, offset);
+  std::vector<float> expected(samples.data(), samples.data() + length);
+  std::reverse(expected.begin(), expected.end());
+
+  olive::dsp::Reverse(samples.data(), length);
+  Compare("Reverse", length, offset, expected.data(), samples.data(), length);
+}
+
+void TestResample(int length, int offset) {
+  // starts before, inside and past the end of the input, with direct copies, speed changes and reverse
+  const double positions[] = {-5.0, -0.5, 0.0, 0.4, 0.5, 2.75, length * 0.5, length - 1.0, length + 3.0};
+  const double steps[] = {1.0, 0.5, 1.5, 2.0, -1.0, -0.75};
+
+  Buffer in(length, offset);
+
+  for (double position : positions) {
+    for (double step : steps) {
+      Buffer out(length, kMaxOffset - offset);
+      std::vector<float> expected(static_cast<size_t>(length));
+
+      for (int i=0;i<length;i++) {
+        double pos = position + i * step;
+        int64_t index = (step == 1.0) ? int64_t(std::floor(position + 0.5)) + i : int64_t(std::floor(pos));
+        float t = (step == 1.0) ? 0.0f : float(pos - index);
+        float a = (index >= 0 && index < length) ? in.data()[index] : 0.0f;
+        float b = (index + 1 >= 0 && index + 1 < length) ? in.data()[index + 1] : 0.0f;
+        expected[size_t(i)] = a + (b - a) * t;
+      }
+
+      olive::dsp::Resample(in.data(), length, position, step, out.data(), length);
+      Compare("Resample", length, offset, expected.data(), out.data(), length);
+    }
+  }
+}
+
+void TestPeakAndRms(int length, int offset) {
+  for (int channels=1;channels<=6;channels++) {
+    Buffer in(length * channels, offset);
+
+    std::vector<float> expected_peaks(static_cast<size_t>(channels), 0.0f);
+    std::vector<double> sums(static_cast<size_t>(channels), 0.0);
+    for (int i=0;i<length*channels;i++) {
+      float v = in.data()[i];
+      expected_peaks[size_t(i%channels)] = std::max(expected_peaks[size_t(i%channels)], std::fabs(v));
+      sums[size_t(i%channels)] += double(v) * double(v);
+    }
+
+    std::vector<float> expected_rms(static_cast<size_t>(channels), 0.0f);
+    if (length > 0) {
+      for (int c=0;c<channels;c++) {
+        expected_rms[size_t(c)] = float(std::sqrt(sums[size_t(c)] / length));
+      }
+    }
+
+    std::vector<float> peaks(static_cast<size_t>(channels), -1.0f);
+    olive::dsp::Peak(in.data(), length, channels, peaks.data());
+    Compare("Peak", length, offset, expected_peaks.data(), peaks.data(), channels);
+
+    // the kernel sums the squares in a different order
+    std::vector<float> rms(static_cast<size_t>(channels), -1.0f);
+    olive::dsp::Rms(in.data(), length, channels, rms.data());
+    Compare("Rms", length, offset, expected_rms.data(), rms.data(), channels, 1e-6f);
+  }
+}
+
+void TestFloatToInt16(int length, int offset) {
+  Buffer in(length, offset);
+  std::vector<int16_t> out(static_cast<size_t>(length + offset + 8));
+  int16_t* out_data = out.data() + offset;
+
+  olive::dsp::FloatToInt16(in.data(), out_data, length);
+
+  for (int i=0;i<length;i++) {
+    int expected = int(std::lrint(std::min(1.0f, std::max(-1.0f, in.data()[i])) * 32767.0f));
+
+    // NEON rounds halves away from zero rather than to even
+    if (std::abs(expected - out_data[i]) > 1) {
+      Fail("FloatToInt16", length, offset, i, expected, out_data[i]);
+      return;
+    }
+  }
+}
+
+// exact halves and the clipping limits, which the vector paths convert with different instructions
+void TestFloatToInt16Limits() {
+  const float values[] = {-2.0f, -1.0f, -0.5f, 0.0f, 0.5f, 1.0f, 2.0f, 1.5f / 32767.0f, -2.5f / 32767.0f,
+                          1.0f / 32767.0f, -1.0f / 32767.0f, 0.99999f, -0.99999f, 3.0f, -3.0f, 0.25f};
+  const int count = int(sizeof(values) / sizeof(values[0]));
+  int16_t out[count];
+
+  olive::dsp::FloatToInt16(values, out, count);
+
+  for (int i=0;i<count;i++) {
+    int expected = int(std::lrint(std::min(1.0f, std::max(-1.0f, values[i])) * 32767.0f));
+    if (std::abs(expected - out[i]) > 1) {
+      Fail("FloatToInt16 (limits)", count, 0, i, expected, out[i]);
+    }
+  }
+}
+
+}
+
+int main() {
+  for (int offset=0;offset<=kMaxOffset;offset++) {
+    for (int length=0;length<=kMaxLength;length++) {
+      TestInterleave(length, offset);
+      TestDeinterleave(length, offset);
+      TestGain(length, offset);
+      TestGainRamp(length, offset);
+      TestEnvelope(length, offset);
+      TestMultiplyAdd(length, offset);
+      TestMixAdd(length, offset);
+      TestReverse(length, offset);
+      TestResample(length, offset);
+      TestPeakAndRms(length, offset);
+      TestFloatToInt16(length, offset);
+    }
+
+    // a long odd length to make sure the vector loops keep their state over many iterations
+    TestGainRamp(4099, offset);
+    TestPeakAndRms(4099, offset);
+    TestFloatToInt16(4099, offset);
+  }
+
+  TestFloatToInt16Limits();
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+
+  std::printf("All audio DSP kernels match their scalar reference\n");
+  return 0;
+}
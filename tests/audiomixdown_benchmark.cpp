@@ -0,0 +1,230 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+// Times a synthetic multi-clip mix two ways: the offline mixdown's synchronous block loop (rendering/audiomixdown.cpp)
+// and per-clip threads that each render a small block and hand it to the mixer, the way exports used to wait on every
+// clip's Cacher. Both read the clips with olive::dsp::Resample() like ConformedAudio::Read() does, so the difference is
+// the block size and the thread handoffs. Not run by ctest, build the audiomixdown_benchmark target and run it on the
+// machine being measured (preferably in a Release build).
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "rendering/audiodsp.h"
+
+namespace {
+
+const int kSampleRate = 48000;
+const int kChannels = 2;
+
+// length of the mix and of every clip's source audio
+const int kSeconds = 20;
+const int64_t kFrames = int64_t(kSeconds) * kSampleRate;
+
+// the same block sizes as AudioMixdown (kMixdownBlockSize) and Cacher (kConformedBlockSize)
+const int kMixdownBlockSize = 8192;
+const int kCacherBlockSize = 4096;
+
+// how many times each path runs, the fastest run is reported
+const int kRuns = 3;
+
+// keeps results alive so the compiler can't skip the work
+volatile float sink;
+
+// one clip on the timeline, reading its source from `start` and moving `step` samples per output sample
+struct Clip {
+  std::vector<float> channels[kChannels];
+  double start;
+  double step;
+};
+
+// render `frames` frames of a clip starting at `position` on the timeline and add them to interleaved `out`
+void MixClip(const Clip& clip, int64_t position, int frames, float* planes[kChannels], float* scratch, float* out) {
+  for (int i=0;i<kChannels;i++) {
+    olive::dsp::Resample(clip.channels[i].data(), int64_t(clip.channels[i].size()),
+                         clip.start + position * clip.step, clip.step, planes[i], frames);
+  }
+
+  olive::dsp::Interleave(planes, scratch, kChannels, frames);
+  olive::dsp::MixAdd(out, scratch, frames * kChannels);
+}
+
+// every clip mixed block by block on the calling thread
+void MixOffline(const std::vector<Clip>& clips) {
+  std::vector<float> left(kMixdownBlockSize);
+  std::vector<float> right(kMixdownBlockSize);
+  std::vector<float> scratch(kMixdownBlockSize * kChannels);
+  std::vector<float> block(kMixdownBlockSize * kChannels);
+  float* planes[kChannels] = {left.data(), right.data()};
+
+  for (int64_t position=0;position<kFrames;position+=kMixdownBlockSize) {
+    int frames = int(std::min<int64_t>(kMixdownBlockSize, kFrames - position));
+
+    std::fill(block.begin(), block.end(), 0.0f);
+    for (const Clip& clip : clips) {
+      MixClip(clip, position, frames, planes, scratch.data(), block.data());
+    }
+
+    sink = block[0];
+  }
+}
+
+// one thread per clip renders the requested block, the mixer waits for all of them before mixing it and requesting
+// the next one
+void MixThreaded(const std::vector<Clip>& clips) {
+  const int clip_count = int(clips.size());
+
+  std::mutex lock;
+  std::condition_variable cond;
+  int64_t requested = -1;
+  int finished = 0;
+  bool quit = false;
+
+  std::vector< std::vector<float> > blocks(clips.size(), std::vector<float>(kCacherBlockSize * kChannels));
+  std::vector<std::thread> threads;
+
+  for (int c=0;c<clip_count;c++) {
+    threads.push_back(std::thread([&, c]() {
+      std::vector<float> left(kCacherBlockSize);
+      std::vector<float> right(kCacherBlockSize);
+      std::vector<float> scratch(kCacherBlockSize * kChannels);
+      float* planes[kChannels] = {left.data(), right.data()};
+      int64_t rendered = -1;
+
+      while (true) {
+        int64_t position;
+        {
+          std::unique_lock<std::mutex> locker(lock);
+          cond.wait(locker, [&]() { return quit || requested != rendered; });
+          if (quit) {
+            return;
+          }
+          position = requested;
+        }
+
+        int frames = int(std::min<int64_t>(kCacherBlockSize, kFrames - position));
+        std::vector<float>& block = blocks[size_t(c)];
+        std::fill(block.begin(), block.end(), 0.0f);
+        MixClip(clips[size_t(c)], position, frames, planes, scratch.data(), block.data());
+        rendered = position;
+
+        {
+          std::lock_guard<std::mutex> locker(lock);
+          finished++;
+        }
+        cond.notify_all();
+      }
+    }));
+  }
+
+  std::vector<float> mix(kCacherBlockSize * kChannels);
+
+  for (int64_t position=0;position<kFrames;position+=kCacherBlockSize) {
+    {
+      std::unique_lock<std::mutex> locker(lock);
+      requested = position;
+      finished = 0;
+      cond.notify_all();
+      cond.wait(locker, [&]() { return finished == clip_count; });
+    }
+
+    int samples = int(std::min<int64_t>(kCacherBlockSize, kFrames - position)) * kChannels;
+    std::fill(mix.begin(), mix.end(), 0.0f);
+    for (int c=0;c<clip_count;c++) {
+      olive::dsp::MixAdd(mix.data(), blocks[size_t(c)].data(), samples);
+    }
+
+    sink = mix[0];
+  }
+
+  {
+    std::lock_guard<std::mutex> locker(lock);
+    quit = true;
+  }
+  cond.notify_all();
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+template<typename Function>
+double Time(Function function) {
+  double best = 0;
+
+  for (int i=0;i<kRuns;i++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    function();
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  return best;
+}
+
+void Report(const char* name, double time) {
+  std::printf("%-18s %10.1f ms %10.1fx real-time\n", name, time, kSeconds * 1000.0 / time);
+}
+
+}
+
+int main() {
+  // a mix of direct copies, speed changes and reverse like a typical edit, on different source audio
+  const double steps[] = {1.0, 1.0, 1.0, 1.0, 0.5, 1.5, -1.0, -1.0};
+
+  std::vector<Clip> clips;
+  uint32_t state = 1;
+  for (double step : steps) {
+    Clip clip;
+    int64_t source_frames = int64_t(double(kFrames) * std::max(1.0, step < 0 ? -step : step)) + 1;
+    for (int i=0;i<kChannels;i++) {
+      clip.channels[i].resize(size_t(source_frames));
+      for (float& sample : clip.channels[i]) {
+        state = state * 1664525u + 1013904223u;
+        sample = float(state >> 8) / float(1 << 24) * 2.0f - 1.0f;
+      }
+    }
+    clip.start = step < 0 ? double(source_frames - 1) : 0.0;
+    clip.step = step;
+    clips.push_back(clip);
+  }
+
+  std::printf("Mixing %d clips into %d seconds of stereo audio at %d Hz\n",
+              int(clips.size()), kSeconds, kSampleRate);
+
+  double threaded_time = Time([&]() { MixThreaded(clips); });
+  double offline_time = Time([&]() { MixOffline(clips); });
+
+  Report("per-clip threads", threaded_time);
+  Report("offline mixdown", offline_time);
+  std::printf("offline mixdown is %.2fx faster\n", threaded_time / offline_time);
+
+  return 0;
+}
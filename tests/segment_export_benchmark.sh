@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Times a headless export of the same sequence as one stream and split into parallel segments, then prints both times
+# and the speed-up. Not run by ctest, run it on the machine being measured with a project long enough for the
+# segments to matter (a few minutes of 1080p or more). The exports use Olive's --export option, so the Qt platform in
+# use must still be able to provide OpenGL (see HeadlessExport).
+#
+# Usage: segment_export_benchmark.sh <olive> <project> <sequence> [segments] [codec] [extension]
+#
+#   segments   amount of segments to compare against a single stream (default: the number of CPU cores)
+#   codec      video encoder to export with (default: libx264)
+#   extension  output container (default: mp4)
+
+if [ $# -lt 3 ]; then
+	echo "Usage: $0 <olive> <project> <sequence> [segments] [codec] [extension]"
+	exit 1
+fi
+
+OLIVE=$1
+PROJECT=$2
+SEQUENCE=$3
+SEGMENTS=${4:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 4)}
+CODEC=${5:-libx264}
+EXTENSION=${6:-mp4}
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+# export once with the given segment count, stores the wall-clock time in seconds in ELAPSED
+run_export() {
+	local segments=$1
+	local preset="$WORKDIR/segments-$segments.ini"
+	local log="$WORKDIR/segments-$segments.log"
+
+	printf "[video]\ncodec=%s\nsegments=%d\n" "$CODEC" "$segments" > "$preset"
+
+	local TIMEFORMAT=%R
+	ELAPSED=$( { time "$OLIVE" --export "$PROJECT" --sequence "$SEQUENCE" --preset "$preset" \
+		--output "$WORKDIR/segments-$segments.$EXTENSION" > "$log" 2>&1 ; } 2>&1 )
+
+	# the exit code is HeadlessExport's, anything but 0 means the export didn't finish
+	if [ $? -ne 0 ]; then
+		echo "[ERROR] Export with $segments segment(s) failed, output:"
+		tail -n 20 "$log"
+		exit 1
+	fi
+}
+
+echo "Exporting \"$SEQUENCE\" from $PROJECT with $CODEC"
+
+run_export 1
+SINGLE=$ELAPSED
+printf "%-14s %10.2f s\n" "1 segment" "$SINGLE"
+
+run_export "$SEGMENTS"
+PARALLEL=$ELAPSED
+printf "%-14s %10.2f s\n" "$SEGMENTS segments" "$PARALLEL"
+
+awk -v single="$SINGLE" -v parallel="$PARALLEL" 'BEGIN { printf "segmented export is %.2fx faster\n", single / parallel }'
@@ -340,6 +340,10 @@ long Clip::timeline_in(bool with_transition) {
 void Clip::set_timeline_in(long t)
 {
   timeline_in_ = t;
+
+  if (track_ != nullptr) {
+    track_->UpdateClipIndex(this);
+  }
 }
 
 long Clip::timeline_out(bool with_transitions) {
@@ -354,6 +358,10 @@ long Clip::timeline_out(bool with_transitions) {
 void Clip::set_timeline_out(long t)
 {
   timeline_out_ = t;
+
+  if (track_ != nullptr) {
+    track_->UpdateClipIndex(this);
+  }
 }
 
 bool Clip::reversed()
@@ -534,6 +542,10 @@ void Clip::Open() {
   if (!open_ && state_change_lock.tryLock()) {
     open_ = true;
 
+    if (track_ != nullptr) {
+      track_->SetClipOpen(this, true);
+    }
+
     for (int i=0;i<effects.size();i++) {
       effects.at(i)->open();
     }
@@ -556,6 +568,10 @@ void Clip::Close(bool wait) {
   if (open_ && state_change_lock.tryLock()) {
     open_ = false;
 
+    if (track_ != nullptr) {
+      track_->SetClipOpen(this, false);
+    }
+
     if (media() != nullptr && media()->get_type() == MEDIA_TYPE_SEQUENCE) {
       media()->to_sequence()->Close();
     }
@@ -592,34 +608,60 @@ bool Clip::IsOpen()
   return open_;
 }
 
+void Clip::SetAudioContext(AudioRenderContext *context)
+{
+  if (!UsesCacher()) {
+    return;
+  }
+
+  // the cacher is set up for one context's mixer and sample rate when it opens, so it has to reopen for another one
+  if (open_ && cacher.audio_context() != context) {
+    Close(false);
+  }
+
+  cacher.SetAudioContext(context);
+}
+
+void Clip::SetExporting(bool exporting)
+{
+  if (!UsesCacher()) {
+    return;
+  }
+
+  // the cacher chooses between the proxy and the original file when it opens
+  if (open_ && cacher.exporting() != exporting) {
+    Close(false);
+  }
+
+  cacher.SetExporting(exporting);
+}
+
 void Clip::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playback_speed) {
   cacher.Cache(playhead, scrubbing, nests, playback_speed);
   cacher_frame = playhead;
 }
 
+void Clip::Preroll(long playhead, QVector<Clip *> &nests, int playback_speed)
+{
+  if (UsesCacher()) {
+    cacher.Preroll(playhead, nests, playback_speed);
+  }
+}
+
 bool Clip::Retrieve()
 {
   bool ret = false;
 
   if (UsesCacher()) {
 
-    // Retrieve the frame from the cacher that we requested in Cache().
+    // Retrieve the frame from the cacher that we requested in Cache(). This is our own reference to the frame, so
+    // it stays valid even if the cacher removes it from its queue in the meantime.
     AVFrame* frame = cacher.Retrieve();
 
-    // Wait for exclusive control of the queue to avoid any threading collisions
-    cacher.queue()->lock();
-
-    // Check if we retrieved a frame (nullptr) and if the queue still contains this frame.
-    //
     // `nullptr` is returned if the cacher failed to get any sort of frame and is uncommon, but we do need
     // to handle it.
-    //
-    // We check the queue because in some situations (e.g. intensive scrubbing), in the time it took to gain
-    // exclusive control of the queue, the cacher may have deleted the frame.
-    // Therefore we check to ensure the queue still contains the frame now that we have exclusive control,
-    // to avoid any attempt to utilize now-freed memory.
 
-    if (frame != nullptr && cacher.queue()->contains(frame)) {
+    if (frame != nullptr) {
 
       //if (frame->pts != texture_timestamp) {
 
@@ -697,12 +739,12 @@ bool Clip::Retrieve()
 
       texture_timestamp = frame->pts;
 
+      av_frame_free(&frame);
+
       ret = true;
     } else {
       qCritical() << "Failed to retrieve frame for clip" << name();
     }
-
-    cacher.queue()->unlock();
   }
 
   return ret;
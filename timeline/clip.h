@@ -139,8 +139,11 @@ public:
   void Open();
   void Cache(long playhead, bool scrubbing, QVector<Clip*> &nests, int playback_speed);
   bool Retrieve();
+  void Preroll(long playhead, QVector<Clip*> &nests, int playback_speed);
   void Close(bool wait);
   bool IsOpen();
+  void SetAudioContext(AudioRenderContext* context);
+  void SetExporting(bool exporting);
 
   bool UsesCacher();
 
@@ -21,12 +21,14 @@
 #include "sequence.h"
 
 #include <QCoreApplication>
+#include <QHash>
 
 #include "timelinefunctions.h"
 #include "panels/panels.h"
 #include "global/clipboard.h"
 #include "global/config.h"
 #include "global/debug.h"
+#include "global/math.h"
 
 Sequence::Sequence() :
   playhead(0),
@@ -48,12 +50,64 @@ SequencePtr Sequence::copy() {
   s->audio_frequency_ = audio_frequency_;
   s->audio_layout_ = audio_layout_;
 
-  /* FIXME
-  // deep copy all of the sequence's clips
-  for (int i=0;i<track_lists_.size();i++) {
-    s->track_lists_[i] = track_lists_.at(i)->copy(s.get());
+  // replace the default tracks with copies of this sequence's tracks (children that aren't tracks are left alone)
+  QList<Track*> default_tracks = s->findChildren<Track*>(QString(), Qt::FindDirectChildrenOnly);
+  qDeleteAll(default_tracks);
+
+  QHash<Clip*, Clip*> copied_clips;
+
+  const QObjectList& all_children = children();
+  for (int i=0;i<all_children.size();i++) {
+    Track* track = qobject_cast<Track*>(all_children.at(i));
+    if (track == nullptr) {
+      continue;
+    }
+
+    Track* track_copy = track->copy(s.get());
+
+    for (int j=0;j<track->ClipCount();j++) {
+      copied_clips.insert(track->GetClip(j).get(), track_copy->GetClip(j).get());
+    }
+  }
+
+  // links and transitions may span tracks, so they're copied once every clip has been
+  QHash<Transition*, TransitionPtr> copied_transitions;
+
+  for (QHash<Clip*, Clip*>::const_iterator i=copied_clips.constBegin();i!=copied_clips.constEnd();i++) {
+    Clip* original = i.key();
+    Clip* copy = i.value();
+
+    for (int j=0;j<original->linked.size();j++) {
+      Clip* linked_copy = copied_clips.value(original->linked.at(j), nullptr);
+      if (linked_copy != nullptr) {
+        copy->linked.append(linked_copy);
+      }
+    }
+
+    // shared transitions are referenced by two clips but must only be copied once
+    for (int j=0;j<2;j++) {
+      TransitionPtr original_transition = (j == 0) ? original->opening_transition : original->closing_transition;
+
+      if (original_transition == nullptr) {
+        continue;
+      }
+
+      TransitionPtr transition_copy = copied_transitions.value(original_transition.get());
+
+      if (transition_copy == nullptr) {
+        transition_copy = std::static_pointer_cast<Transition>(
+              original_transition->copy(copied_clips.value(original_transition->parent_clip)));
+        transition_copy->secondary_clip = copied_clips.value(original_transition->secondary_clip, nullptr);
+        copied_transitions.insert(original_transition.get(), transition_copy);
+      }
+
+      if (j == 0) {
+        copy->opening_transition = transition_copy;
+      } else {
+        copy->closing_transition = transition_copy;
+      }
+    }
   }
-  */
 
   // copy all of the sequence's markers
   s->markers = markers;
@@ -61,6 +115,45 @@ SequencePtr Sequence::copy() {
   return s;
 }
 
+SequencePtr Sequence::Snapshot()
+{
+  SequencePtr s = copy();
+
+  s->name_ = name_;
+  s->playhead = playhead;
+  s->using_workarea = using_workarea;
+  s->workarea_in = workarea_in;
+  s->workarea_out = workarea_out;
+  s->wrapper_sequence = wrapper_sequence;
+
+  // nested sequences are rendered from their own clips, so give the snapshot its own copies of them too
+  QHash<Media*, Media*> nested_snapshots;
+
+  QVector<Clip*> all_clips = s->GetAllClips();
+  for (int i=0;i<all_clips.size();i++) {
+    Clip* c = all_clips.at(i);
+
+    if (c->media() == nullptr || c->media()->get_type() != MEDIA_TYPE_SEQUENCE) {
+      continue;
+    }
+
+    Media* nested = nested_snapshots.value(c->media(), nullptr);
+
+    if (nested == nullptr) {
+      MediaPtr m = std::make_shared<Media>();
+      m->set_sequence(c->media()->to_sequence()->Snapshot());
+      s->snapshot_media_.append(m);
+
+      nested = m.get();
+      nested_snapshots.insert(c->media(), nested);
+    }
+
+    c->set_media(nested, c->media_stream_index());
+  }
+
+  return s;
+}
+
 void Sequence::Save(QXmlStreamWriter &stream)
 {
   // Provide unique IDs for each Clip
@@ -87,11 +180,11 @@ void Sequence::Save(QXmlStreamWriter &stream)
   QVector<TransitionPtr> transition_save_cache;
   QVector<int> transition_clip_save_cache;
 
-  /* FIXME
-  for (int j=0;j<track_lists_.size();j++) {
-    track_lists_.at(j)->Save(stream);
+  // tracks are saved in order so that loading them back restores the same layout
+  QList<Track*> tracks = findChildren<Track*>(QString(), Qt::FindDirectChildrenOnly);
+  for (int j=0;j<tracks.size();j++) {
+    tracks.at(j)->Save(stream);
   }
-  */
 
   for (int j=0;j<markers.size();j++) {
     markers.at(j).Save(stream);
@@ -194,6 +287,21 @@ QVector<Clip *> Sequence::GetAllClips()
   return all_clips;
 }
 
+QVector<Clip *> Sequence::GetClipsInRange(long in, long out, bool with_transitions)
+{
+  QVector<Clip*> clips;
+
+  const QObjectList& tracks = children();
+
+  for (int j=0;j<tracks.size();j++) {
+
+    clips.append(static_cast<Track*>(tracks.at(j))->GetClipsInRange(in, out, with_transitions));
+
+  }
+
+  return clips;
+}
+
 QVector<Track *> Sequence::GetTrackList(olive::TrackType type)
 {
   QVector<Track*> tracks;
@@ -500,17 +608,30 @@ bool Sequence::SnapPoint(long *l, double zoom, bool use_playhead, bool use_marke
       if (olive::timeline::SnapToPoint(workarea_out, l, zoom)) return true;
     }
 
-    // snap to clip/transition
-    QVector<Clip*> all_clips = GetAllClips();
-    for (int i=0;i<all_clips.size();i++) {
+    // snap to the nearest clip in/out point
+    const QObjectList& tracks = children();
+    long nearest_edge = 0;
+    bool found_edge = false;
+    for (int i=0;i<tracks.size();i++) {
+      long edge;
+      if (static_cast<Track*>(tracks.at(i))->GetNearestEdge(*l, &edge)
+          && (!found_edge || qAbs(edge - *l) < qAbs(nearest_edge - *l))) {
+        nearest_edge = edge;
+        found_edge = true;
+      }
+    }
+    if (found_edge && olive::timeline::SnapToPoint(nearest_edge, l, zoom)) {
+      return true;
+    }
 
-      Clip* c = all_clips.at(i);
-      if (olive::timeline::SnapToPoint(c->timeline_in(), l, zoom)) {
-        return true;
-      } else if (olive::timeline::SnapToPoint(c->timeline_out(), l, zoom)) {
-        return true;
-      } else if (c->opening_transition != nullptr
-                 && olive::timeline::SnapToPoint(c->timeline_in() + c->opening_transition->get_true_length(), l, zoom)) {
+    // snap to transitions/clip markers, which can only be within clips near the point
+    long limit = getFrameFromScreenPoint(zoom, 10); // matches the threshold used by SnapToPoint()
+    QVector<Clip*> nearby_clips = GetClipsInRange(*l - limit - 1, *l + limit + 2);
+    for (int i=0;i<nearby_clips.size();i++) {
+
+      Clip* c = nearby_clips.at(i);
+      if (c->opening_transition != nullptr
+          && olive::timeline::SnapToPoint(c->timeline_in() + c->opening_transition->get_true_length(), l, zoom)) {
         return true;
       } else if (c->closing_transition != nullptr
                  && olive::timeline::SnapToPoint(c->timeline_out() - c->closing_transition->get_true_length(), l, zoom)) {
@@ -811,10 +932,10 @@ bool Sequence::SplitAllClipsAtPoint(ComboAction *ca, long point)
 {
   bool split = false;
 
-  QVector<Clip*> all_clips = GetAllClips();
+  QVector<Clip*> clips_at_point = GetClipsInRange(point, point + 1, true);
 
-  for (int j=0;j<all_clips.size();j++) {
-    Clip* c = all_clips.at(j);
+  for (int j=0;j<clips_at_point.size();j++) {
+    Clip* c = clips_at_point.at(j);
 
     if (c->IsActiveAt(point)) {
       SplitClipAtPositions(ca, c, {point}, true);
@@ -1381,10 +1502,21 @@ ClipPtr Sequence::SplitClip(ComboAction *ca, bool transitions, Clip* pre, long f
 bool Sequence::SplitSelection(ComboAction *ca, QVector<Selection> selections)
 {
   bool ret = false;
-  QVector<Clip*> all_clips = GetAllClips();
 
-  for (int i=0;i<all_clips.size();i++) {
-    Clip* c = all_clips.at(i);
+  // only clips overlapping a selection can be split by it
+  QVector<Clip*> selected_clips;
+  for (int i=0;i<selections.size();i++) {
+    const Selection& s = selections.at(i);
+    QVector<Clip*> track_clips = s.track()->GetClipsInRange(s.in(), s.out() + 1);
+    for (int j=0;j<track_clips.size();j++) {
+      if (!selected_clips.contains(track_clips.at(j))) {
+        selected_clips.append(track_clips.at(j));
+      }
+    }
+  }
+
+  for (int i=0;i<selected_clips.size();i++) {
+    Clip* c = selected_clips.at(i);
 
     QVector<long> points;
 
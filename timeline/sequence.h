@@ -36,6 +36,18 @@ public:
   Sequence();
   SequencePtr copy();
 
+  /**
+   * @brief Create an independent copy of this Sequence for rendering in the background
+   *
+   * Unlike copy(), the snapshot keeps this Sequence's name, playhead and workarea, and any nested Sequences are
+   * snapshotted too (owned by the snapshot through private Media objects that aren't part of the project). The
+   * snapshot's clips have their own Cachers, so it can be rendered on another thread while this Sequence is edited or
+   * played back.
+   *
+   * Must be called from the main thread.
+   */
+  SequencePtr Snapshot();
+
   void Save(QXmlStreamWriter& stream);
 
   const QString& name();
@@ -59,6 +71,30 @@ public:
   long GetEndFrame();
   QVector<Clip*> GetAllClips();
 
+  /**
+   * @brief Get all clips overlapping a range of frames
+   *
+   * Uses each Track's clip index rather than scanning every clip, so this is much faster than filtering GetAllClips()
+   * on large Sequences.
+   *
+   * @param in
+   *
+   * First frame of the range
+   *
+   * @param out
+   *
+   * Frame after the last frame of the range (i.e. the range is [in, out))
+   *
+   * @param with_transitions
+   *
+   * **TRUE** if clips should be treated as extended by shared transitions (see Clip::timeline_in())
+   *
+   * @return
+   *
+   * All clips overlapping the range, in track order.
+   */
+  QVector<Clip*> GetClipsInRange(long in, long out, bool with_transitions = false);
+
   /**
    * @brief Close all open clips in a Sequence
    *
@@ -146,6 +182,9 @@ signals:
 private:
   Track *AddTrack(olive::TrackType type);
 
+  // media wrapping nested Sequence snapshots (see Snapshot()), the snapshot's clips must be closed before it's freed
+  QVector<MediaPtr> snapshot_media_;
+
   //QVector<Track*> tracks_;
 
   ClipPtr SplitClip(ComboAction* ca, bool transitions, Clip *clip, long frame);
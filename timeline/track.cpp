@@ -1,5 +1,8 @@
 #include "track.h"
 
+#include <algorithm>
+#include <climits>
+
 #include "timeline/clip.h"
 #include "timeline/sequence.h"
 #include "global/math.h"
@@ -22,12 +25,18 @@ Track *Track::copy(Sequence *parent)
 {
   Track* t = new Track(parent, type_);
 
+  t->height_ = height_;
+  t->muted_ = muted_;
+  t->soloed_ = soloed_;
+  t->locked_ = locked_;
+  t->name_ = name_;
+
+  // links and transitions can span tracks, so the Sequence copying this track is responsible for copying them
   t->ResizeClipArray(ClipCount());
   for (int i=0;i<clips_.size();i++) {
-    ClipPtr c = clips_.at(i);
-    ClipPtr copy = c->copy(t);
-    copy->linked = c->linked;
+    ClipPtr copy = clips_.at(i)->copy(t);
     t->clips_[i] = copy;
+    t->IndexClip(copy.get());
   }
 
   return t;
@@ -41,6 +50,12 @@ Sequence *Track::sequence()
 void Track::Save(QXmlStreamWriter &stream)
 {
   stream.writeStartElement("track");
+  stream.writeAttribute("type", QString::number(type_));
+  stream.writeAttribute("name", name_);
+  stream.writeAttribute("muted", QString::number(muted_));
+  stream.writeAttribute("soloed", QString::number(soloed_));
+  stream.writeAttribute("locked", QString::number(locked_));
+  stream.writeAttribute("height", QString::number(height_));
 
   for (int j=0;j<clips_.size();j++) {
     Clip* c = clips_.at(j).get();
@@ -104,6 +119,11 @@ void Track::AddClip(ClipPtr clip)
     clip->track()->RemoveClip(clip.get());
   }
   clip->set_track(this);
+
+  IndexClip(clip.get());
+  if (clip->IsOpen()) {
+    open_clips_.append(clip.get());
+  }
 }
 
 int Track::ClipCount()
@@ -118,6 +138,11 @@ ClipPtr Track::GetClip(int i)
 
 void Track::RemoveClip(int i)
 {
+  Clip* c = clips_.at(i).get();
+
+  UnindexClip(c);
+  open_clips_.removeOne(c);
+
   clips_.removeAt(i);
 }
 
@@ -125,7 +150,7 @@ void Track::RemoveClip(Clip *c)
 {
   for (int i=0;i<clips_.size();i++) {
     if (clips_.at(i).get() == c) {
-      clips_.removeAt(i);
+      RemoveClip(i);
       return;
     }
   }
@@ -180,26 +205,211 @@ ClipPtr Track::GetClipObjectFromRawPtr(Clip *c)
 
 Clip *Track::GetClipFromPoint(long point)
 {
-  for (int i=0;i<clips_.size();i++) {
-    Clip* c = clips_.at(i).get();
+  QVector<Clip*> clips = GetClipsAt(point);
 
-    if (c->timeline_in() <= point && c->timeline_out() > point) {
-      return c;
-    }
+  if (clips.isEmpty()) {
+    return nullptr;
   }
 
-  return nullptr;
+  return clips.first();
 }
 
 bool Track::ContainsClip(Clip *c)
 {
-  ClipPtr clip;
-  foreach (clip, clips_) {
-    if (clip.get() == c) {
-      return true;
+  return indexed_bounds_.contains(c);
+}
+
+QVector<Clip *> Track::GetClipsAt(long frame, bool with_transitions)
+{
+  return GetClipsInRange(frame, frame + 1, with_transitions);
+}
+
+QVector<Clip *> Track::GetClipsInRange(long in, long out, bool with_transitions)
+{
+  QVector<Clip*> clips;
+
+  // only clips that start before the end of the range can overlap it
+  int end = int(std::lower_bound(index_in_.constBegin(), index_in_.constEnd(), out) - index_in_.constBegin());
+
+  // walk backwards until no earlier clip reaches the start of the range
+  for (int i=end-1;i>=0 && index_max_out_.at(i) > in;i--) {
+    if (index_out_.at(i) > in) {
+      clips.append(index_.at(i));
     }
   }
-  return false;
+
+  std::reverse(clips.begin(), clips.end());
+
+  if (with_transitions) {
+    // a shared transition extends a clip into its neighbor, so a clip can overlap the range without its own in/out
+    // points doing so, but only if its neighbor overlaps the range
+    int raw_count = clips.size();
+
+    for (int i=0;i<raw_count;i++) {
+      Clip* c = clips.at(i);
+
+      Transition* transitions[] = {c->opening_transition.get(), c->closing_transition.get()};
+
+      for (int j=0;j<2;j++) {
+        Transition* t = transitions[j];
+
+        if (t == nullptr || t->secondary_clip == nullptr) {
+          continue;
+        }
+
+        Clip* partners[] = {t->parent_clip, t->secondary_clip};
+
+        for (int k=0;k<2;k++) {
+          Clip* partner = partners[k];
+
+          if (partner != nullptr
+              && partner != c
+              && !clips.contains(partner)
+              && partner->timeline_in(true) < out
+              && partner->timeline_out(true) > in) {
+            clips.append(partner);
+          }
+        }
+      }
+    }
+
+    if (clips.size() > raw_count) {
+      std::sort(clips.begin(), clips.end(), [](Clip* a, Clip* b) {
+        return a->timeline_in(true) < b->timeline_in(true);
+      });
+    }
+  }
+
+  return clips;
+}
+
+bool Track::GetNearestEdge(long frame, long *edge)
+{
+  if (edges_.isEmpty()) {
+    return false;
+  }
+
+  QVector<long>::const_iterator next = std::lower_bound(edges_.constBegin(), edges_.constEnd(), frame);
+
+  if (next == edges_.constEnd()) {
+    *edge = edges_.last();
+  } else if (next == edges_.constBegin()) {
+    *edge = *next;
+  } else {
+    long previous = *(next - 1);
+    *edge = (frame - previous <= *next - frame) ? previous : *next;
+  }
+
+  return true;
+}
+
+QVector<Clip *> Track::GetOpenClips()
+{
+  return open_clips_;
+}
+
+void Track::UpdateClipIndex(Clip *c)
+{
+  // clips that aren't in this track yet (e.g. copies that are still being set up) get indexed when they're added
+  if (!indexed_bounds_.contains(c)) {
+    return;
+  }
+
+  UnindexClip(c);
+  IndexClip(c);
+}
+
+void Track::SetClipOpen(Clip *c, bool open)
+{
+  if (!indexed_bounds_.contains(c)) {
+    return;
+  }
+
+  if (open) {
+    if (!open_clips_.contains(c)) {
+      open_clips_.append(c);
+    }
+  } else {
+    open_clips_.removeOne(c);
+  }
+}
+
+void Track::IndexClip(Clip *c)
+{
+  IndexedBounds b;
+  b.in = c->timeline_in();
+  b.out = c->timeline_out();
+
+  indexed_bounds_.insert(c, b);
+
+  int pos = int(std::upper_bound(index_in_.constBegin(), index_in_.constEnd(), b.in) - index_in_.constBegin());
+
+  index_.insert(pos, c);
+  index_in_.insert(pos, b.in);
+  index_out_.insert(pos, b.out);
+  index_max_out_.insert(pos, b.out);
+
+  RefreshMaxOut(pos);
+
+  InsertEdge(b.in);
+  InsertEdge(b.out);
+}
+
+void Track::UnindexClip(Clip *c)
+{
+  QHash<Clip*, IndexedBounds>::iterator i = indexed_bounds_.find(c);
+  if (i == indexed_bounds_.end()) {
+    return;
+  }
+
+  IndexedBounds b = i.value();
+  indexed_bounds_.erase(i);
+
+  int pos = int(std::lower_bound(index_in_.constBegin(), index_in_.constEnd(), b.in) - index_in_.constBegin());
+  while (pos < index_.size() && index_.at(pos) != c) {
+    pos++;
+  }
+
+  Q_ASSERT(pos < index_.size());
+
+  index_.remove(pos);
+  index_in_.remove(pos);
+  index_out_.remove(pos);
+  index_max_out_.remove(pos);
+
+  RefreshMaxOut(pos);
+
+  RemoveEdge(b.in);
+  RemoveEdge(b.out);
+}
+
+void Track::RefreshMaxOut(int from)
+{
+  long max_out = (from > 0) ? index_max_out_.at(from - 1) : LONG_MIN;
+
+  for (int i=from;i<index_max_out_.size();i++) {
+    max_out = qMax(max_out, index_out_.at(i));
+
+    // every entry after this one was calculated from this value, so if it hasn't changed, neither have they
+    if (i > from && index_max_out_.at(i) == max_out) {
+      break;
+    }
+
+    index_max_out_[i] = max_out;
+  }
+}
+
+void Track::InsertEdge(long edge)
+{
+  edges_.insert(std::upper_bound(edges_.begin(), edges_.end(), edge), edge);
+}
+
+void Track::RemoveEdge(long edge)
+{
+  QVector<long>::iterator i = std::lower_bound(edges_.begin(), edges_.end(), edge);
+  if (i != edges_.end() && *i == edge) {
+    edges_.erase(i);
+  }
 }
 
 Track *Track::Previous()
@@ -306,14 +516,9 @@ void Track::SelectAtPoint(long point)
   ClearSelections();
 
   // Select every clip that this point is within
-  for (int i=0;i<clips_.size();i++) {
-
-    Clip* c = clips_.at(i).get();
-
-    if (c->timeline_in() <= point
-        && c->timeline_out() > point) {
-      SelectClip(c);
-    }
+  QVector<Clip*> clips = GetClipsAt(point);
+  for (int i=0;i<clips.size();i++) {
+    SelectClip(clips.at(i));
   }
 }
 
@@ -2,6 +2,7 @@
 #define TRACK_H
 
 #include <QVector>
+#include <QHash>
 #include <memory>
 
 #include "nodes/oldeffectnode.h"
@@ -68,6 +69,16 @@ public:
   Clip* GetClipFromPoint(long point);
   bool ContainsClip(Clip* c);
 
+  // indexed queries, much faster than scanning GetAllClips() on tracks with many clips
+  QVector<Clip*> GetClipsAt(long frame, bool with_transitions = false);
+  QVector<Clip*> GetClipsInRange(long in, long out, bool with_transitions = false);
+  bool GetNearestEdge(long frame, long* edge);
+  QVector<Clip*> GetOpenClips();
+
+  // called by Clip whenever its position or open state changes
+  void UpdateClipIndex(Clip* c);
+  void SetClipOpen(Clip* c, bool open);
+
   Track* Previous();
   Track* Next();
   Track* Sibling(int diff);
@@ -108,12 +119,34 @@ signals:
 private:
   void ResizeClipArray(int new_size);
 
+  void IndexClip(Clip* c);
+  void UnindexClip(Clip* c);
+  void RefreshMaxOut(int from);
+  void InsertEdge(long edge);
+  void RemoveEdge(long edge);
+
   olive::TrackType type_;
   int height_;
   QVector<ClipPtr> clips_;
   QVector<OldEffectNodePtr> effects_;
   QVector<Selection> selections_;
 
+  // Interval index of clips_. Clips are sorted by in point, alongside a running maximum of the out points so that
+  // overlap queries can stop searching backwards as soon as no earlier clip can reach the queried range. The index
+  // stores each clip's position at the time it was indexed so that it can be found again after the clip moves.
+  struct IndexedBounds {
+    long in;
+    long out;
+  };
+  QVector<Clip*> index_;
+  QVector<long> index_in_;
+  QVector<long> index_out_;
+  QVector<long> index_max_out_;
+  QVector<long> edges_;
+  QHash<Clip*, IndexedBounds> indexed_bounds_;
+
+  QVector<Clip*> open_clips_;
+
   bool muted_;
   bool soloed_;
   bool locked_;
@@ -28,6 +28,7 @@
 #include <QPainter>
 #include <QLinearGradient>
 #include <QtMath>
+#include <string.h>
 
 #define AUDIO_MONITOR_PEAK_HEIGHT 15
 #define AUDIO_MONITOR_GAP 3
@@ -38,26 +39,54 @@ extern "C" {
 
 AudioMonitor::AudioMonitor(QWidget *parent) :
   QWidget(parent),
+  pending_channels_(0),
   peaked_(false)
 {
   clear_timer.setInterval(500);
   connect(&clear_timer, SIGNAL(timeout()), this, SLOT(clear()));
+
+  refresh_timer.setInterval(1000 / 30);
+  connect(&refresh_timer, SIGNAL(timeout()), this, SLOT(refresh()));
+  refresh_timer.start();
 }
 
-void AudioMonitor::set_value(const QVector<float> &ivalues) {
-  if (value_lock.tryLock()) {
-    values = ivalues;
+void AudioMonitor::PushPeaks(const float *peaks, int channels) {
+  channels = qMin(channels, int(kMaxChannels));
 
-    if (peaked_.size() != values.size()) {
-      peaked_.resize(values.size());
-      peaked_.fill(false);
-    }
+  for (int i=0;i<channels;i++) {
+    float peak = qAbs(peaks[i]);
+    quint32 bits;
+    memcpy(&bits, &peak, sizeof(bits));
+
+    // keep the loudest peak since the last refresh
+    quint32 current;
+    do {
+      current = pending_peaks_[i].loadAcquire();
+    } while (bits > current && !pending_peaks_[i].testAndSetOrdered(current, bits));
+  }
 
-    value_lock.unlock();
+  pending_channels_.storeRelease(channels);
+}
 
-    QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
-    QMetaObject::invokeMethod(&clear_timer, "start", Qt::QueuedConnection);
+void AudioMonitor::refresh() {
+  int channels = pending_channels_.fetchAndStoreAcquire(0);
+  if (channels == 0) {
+    return;
   }
+
+  values.resize(channels);
+  for (int i=0;i<channels;i++) {
+    quint32 bits = pending_peaks_[i].fetchAndStoreOrdered(0);
+    memcpy(&values[i], &bits, sizeof(bits));
+  }
+
+  if (peaked_.size() != values.size()) {
+    peaked_.resize(values.size());
+    peaked_.fill(false);
+  }
+
+  clear_timer.start();
+  update();
 }
 
 void AudioMonitor::clear() {
@@ -82,7 +111,6 @@ void AudioMonitor::mousePressEvent(QMouseEvent *)
 }
 
 void AudioMonitor::paintEvent(QPaintEvent *) {
-  value_lock.lock();
   if (values.size() > 0) {
     QPainter p(this);
     int channel_x = AUDIO_MONITOR_GAP;
@@ -118,5 +146,4 @@ void AudioMonitor::paintEvent(QPaintEvent *) {
       channel_x += channel_width + AUDIO_MONITOR_GAP;
     }
   }
-  value_lock.unlock();
 }
@@ -23,7 +23,7 @@
 
 #include <QWidget>
 #include <QTimer>
-#include <QMutex>
+#include <QAtomicInteger>
 
 /**
  * @brief The AudioMonitor class
@@ -43,17 +43,27 @@ public:
   explicit AudioMonitor(QWidget *parent = nullptr);
 
   /**
-   * @brief Set the current audio value
+   * @brief Submit the peak levels of a block of audio that was just sent to the output device
    *
-   * The main interface for updating the audio monitor. Using this function will redraw the monitor with the values
-   * specified.
+   * The main interface for updating the audio monitor. Safe to call from any thread (usually the audio output thread)
+   * and never blocks. Peaks are accumulated into a lock-free snapshot that the monitor collects and redraws on the
+   * main thread at the screen's pace, so the loudest peak submitted between two redraws is the one shown.
    *
-   * @param values
+   * @param peaks
    *
-   * An array of doubles between 0.0 and 1.0 to display the amplitude. 0.0 is no audio, 1.0 is full volume. Each array
-   * entry is a channel and the audio monitor will automatically adjust to the channel count in the array.
+   * An array of values starting at 0.0 for each channel to display the amplitude. 0.0 is no audio, 1.0 is full
+   * volume. The audio monitor will automatically adjust to the channel count.
+   *
+   * @param channels
+   *
+   * Amount of entries in `peaks`. Channels beyond kMaxChannels are ignored.
+   */
+  void PushPeaks(const float* peaks, int channels);
+
+  /**
+   * @brief Maximum amount of channels the monitor can display
    */
-  void set_value(const QVector<float> &values);
+  static const int kMaxChannels = 8;
 
 protected:
   /**
@@ -89,15 +99,28 @@ private:
 
   /**
    * @brief Internal value storage
+   *
+   * Only accessed from the main thread, see PushPeaks() for how other threads submit values.
    */
   QVector<float> values;
 
   /**
-   * @brief Value mutex
+   * @brief Peaks submitted by PushPeaks() that haven't been collected yet
    *
-   * Audio is often processed and sent to this object from other threads. To keep them synchronized, we lock them here.
+   * Stored as the bit pattern of each float. Peaks are never negative and the bit patterns of positive floats sort in
+   * the same order as their values, so the maximum can be accumulated with an integer compare-and-swap.
    */
-  QMutex value_lock;
+  QAtomicInteger<quint32> pending_peaks_[kMaxChannels];
+
+  /**
+   * @brief Channel count of the last PushPeaks() call or 0 if nothing new has been submitted since the last refresh
+   */
+  QAtomicInt pending_channels_;
+
+  /**
+   * @brief Internal timer to collect submitted peaks at the screen's refresh rate
+   */
+  QTimer refresh_timer;
 
   /**
    * @brief Internal timer to clear the audio monitor after a certain amount of time
@@ -117,6 +140,11 @@ private slots:
    * @brief Slot to clear the audio monitor
    */
   void clear();
+
+  /**
+   * @brief Slot to collect peaks submitted by PushPeaks() and redraw the monitor
+   */
+  void refresh();
 };
 
 #endif // AUDIOMONITOR_H
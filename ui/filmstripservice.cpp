@@ -0,0 +1,290 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "filmstripservice.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <QMutexLocker>
+
+#include "decoders/ffmpegdecoder.h"
+#include "global/path.h"
+#include "project/footage.h"
+#include "rendering/decodescheduler.h"
+
+std::unique_ptr<FilmstripService> olive::filmstrip_service;
+
+namespace {
+
+// memory budget for thumbnails (in KB, the unit of each thumbnail's cost in the cache)
+const int kFilmstripCacheSize = 65536;
+
+// number of background threads decoding thumbnails
+const int kFilmstripThreads = 2;
+
+// requests beyond this many are dropped (oldest first), they've likely scrolled out of view by now
+const int kMaxQueuedRequests = 512;
+
+}
+
+bool operator==(const FilmstripKey &a, const FilmstripKey &b)
+{
+  return a.footage == b.footage
+      && a.stream == b.stream
+      && a.time == b.time
+      && a.height == b.height;
+}
+
+uint qHash(const FilmstripKey &key, uint seed)
+{
+  return qHash(key.footage, seed)
+      ^ qHash(key.time, seed)
+      ^ qHash((key.stream << 16) | key.height, seed);
+}
+
+FilmstripService::Worker::Worker(FilmstripService *service) :
+  service_(service)
+{
+}
+
+void FilmstripService::Worker::run()
+{
+  service_->ProcessQueue();
+}
+
+FilmstripService::FilmstripService() :
+  cache_(kFilmstripCacheSize),
+  quit_(0)
+{
+  for (int i=0;i<kFilmstripThreads;i++) {
+    workers_.append(new Worker(this));
+  }
+}
+
+FilmstripService::~FilmstripService()
+{
+  quit_.storeRelease(1);
+
+  lock_.lock();
+  request_queued_.wakeAll();
+  lock_.unlock();
+
+  for (int i=0;i<workers_.size();i++) {
+    workers_.at(i)->wait();
+    delete workers_.at(i);
+  }
+}
+
+QImage FilmstripService::GetThumbnail(Footage *footage, const FootageStream *stream, double time, int height)
+{
+  FilmstripKey key;
+  key.footage = footage;
+  key.stream = stream->file_index;
+  key.time = qRound64(time * 1000.0);
+  key.height = height;
+
+  QMutexLocker locker(&lock_);
+
+  QImage* image = cache_.object(key);
+  if (image != nullptr) {
+    return *image;
+  }
+
+  if (pending_.contains(key)) {
+    // move the request to the end of the queue so it's decoded next
+    for (int i=queue_.size()-1;i>=0;i--) {
+      if (queue_.at(i).key == key) {
+        queue_.append(queue_.takeAt(i));
+        break;
+      }
+    }
+    return QImage();
+  }
+
+  Request r;
+  r.key = key;
+  r.filename = footage->url;
+  queue_.append(r);
+  pending_.insert(key);
+
+  if (queue_.size() > kMaxQueuedRequests) {
+    pending_.remove(queue_.first().key);
+    queue_.removeFirst();
+  }
+
+  for (int i=0;i<workers_.size();i++) {
+    if (!workers_.at(i)->isRunning()) {
+      workers_.at(i)->start(QThread::LowestPriority);
+    }
+  }
+  request_queued_.wakeOne();
+
+  return QImage();
+}
+
+void FilmstripService::RemoveFootage(Footage *footage)
+{
+  QMutexLocker locker(&lock_);
+
+  QList<FilmstripKey> keys = cache_.keys();
+  for (int i=0;i<keys.size();i++) {
+    if (keys.at(i).footage == footage) {
+      cache_.remove(keys.at(i));
+    }
+  }
+
+  for (int i=queue_.size()-1;i>=0;i--) {
+    if (queue_.at(i).key.footage == footage) {
+      queue_.removeAt(i);
+    }
+  }
+
+  // thumbnails currently being decoded won't be added to the cache once they're no longer pending
+  QSet<FilmstripKey>::iterator i = pending_.begin();
+  while (i != pending_.end()) {
+    if (i->footage == footage) {
+      i = pending_.erase(i);
+    } else {
+      i++;
+    }
+  }
+
+  // the file may have changed, so hash it again next time
+  hashes_.clear();
+}
+
+void FilmstripService::ProcessQueue()
+{
+  FFmpegDecoder decoder;
+  QString open_filename;
+  int open_stream = -1;
+
+  lock_.lock();
+
+  while (!quit_.loadAcquire()) {
+    if (queue_.isEmpty()) {
+      // don't hold a file open while there's nothing to do
+      if (decoder.IsOpen()) {
+        lock_.unlock();
+        decoder.Close();
+        open_filename.clear();
+        lock_.lock();
+        continue;
+      }
+
+      request_queued_.wait(&lock_);
+      continue;
+    }
+
+    Request r = queue_.takeLast();
+
+    lock_.unlock();
+
+    QImage thumbnail = Generate(r, decoder, open_filename, open_stream);
+
+    lock_.lock();
+
+    // the footage may have been removed or changed while decoding
+    if (pending_.remove(r.key) && !thumbnail.isNull()) {
+      cache_.insert(r.key, new QImage(thumbnail), qMax(1, thumbnail.width() * thumbnail.height() * 4 / 1024));
+
+      lock_.unlock();
+      emit ThumbnailsReady();
+      lock_.lock();
+    }
+  }
+
+  lock_.unlock();
+}
+
+QImage FilmstripService::Generate(const Request &request,
+                                  FFmpegDecoder &decoder,
+                                  QString &open_filename,
+                                  int &open_stream)
+{
+  QString cache_filename = GetCacheFilename(request.filename, request.key);
+
+  // the thumbnail may have been decoded in a previous session
+  QImage thumbnail;
+  if (thumbnail.load(cache_filename)) {
+    return thumbnail;
+  }
+
+  if (!decoder.IsOpen() || open_filename != request.filename || open_stream != request.key.stream) {
+    decoder.Close();
+    open_filename.clear();
+
+    if (!decoder.Open(request.filename, request.key.stream)) {
+      qWarning() << "Failed to open" << request.filename << "for timeline thumbnails";
+      return QImage();
+    }
+
+    open_filename = request.filename;
+    open_stream = request.key.stream;
+  }
+
+  olive::decode_scheduler.Acquire(DecodeScheduler::kPriorityBackground);
+  AVFrame* frame = decoder.RetrieveKeyframe(decoder.start_time() + request.key.time * 0.001);
+  olive::decode_scheduler.Release();
+
+  if (frame == nullptr) {
+    return QImage();
+  }
+
+  // scaledToHeight() creates a new image so the frame can be freed right after
+  thumbnail = QImage(frame->data[0],
+                     frame->width,
+                     frame->height,
+                     frame->linesize[0],
+                     QImage::Format_RGBA8888).scaledToHeight(request.key.height, Qt::SmoothTransformation);
+
+  av_frame_free(&frame);
+
+  QDir().mkpath(QFileInfo(cache_filename).absolutePath());
+  if (!thumbnail.save(cache_filename, "JPG")) {
+    qWarning() << "Failed to save timeline thumbnail" << cache_filename;
+  }
+
+  return thumbnail;
+}
+
+QString FilmstripService::GetCacheFilename(const QString &media_filename, const FilmstripKey &key)
+{
+  QString hash;
+
+  lock_.lock();
+  hash = hashes_.value(media_filename);
+  lock_.unlock();
+
+  if (hash.isEmpty()) {
+    hash = get_file_hash(media_filename);
+
+    lock_.lock();
+    hashes_.insert(media_filename, hash);
+    lock_.unlock();
+  }
+
+  return QDir(get_data_dir().filePath("previews/filmstrip")).filePath(
+        QString("%1s%2t%3h%4.jpg").arg(hash,
+                                       QString::number(key.stream),
+                                       QString::number(key.time),
+                                       QString::number(key.height)));
+}
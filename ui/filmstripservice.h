@@ -0,0 +1,214 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FILMSTRIPSERVICE_H
+#define FILMSTRIPSERVICE_H
+
+#include <memory>
+#include <QAtomicInt>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+class FFmpegDecoder;
+class Footage;
+struct FootageStream;
+
+/**
+ * @brief The FilmstripKey struct
+ *
+ * Identifies one timeline thumbnail in the FilmstripService.
+ */
+struct FilmstripKey {
+  /**
+   * @brief Footage the thumbnail was decoded from
+   */
+  Footage* footage;
+
+  /**
+   * @brief File index of the stream inside the footage file (see FootageStream::file_index)
+   */
+  int stream;
+
+  /**
+   * @brief Time of the thumbnail in milliseconds from the start of the stream
+   */
+  qint64 time;
+
+  /**
+   * @brief Height in pixels the thumbnail was scaled to
+   */
+  int height;
+};
+
+bool operator==(const FilmstripKey& a, const FilmstripKey& b);
+uint qHash(const FilmstripKey& key, uint seed = 0);
+
+/**
+ * @brief The FilmstripService class
+ *
+ * Generates the thumbnails drawn along video clips in the Timeline. The Timeline asks for a thumbnail every few
+ * frames (depending on the zoom level) while painting, and GetThumbnail() only returns thumbnails that are already in
+ * memory. Any others are queued and decoded on low priority background threads, and ThumbnailsReady() is emitted so
+ * the Timeline can repaint once they're available.
+ *
+ * Thumbnails are taken from the nearest keyframe (see Decoder::RetrieveKeyframe()) so each one only costs one frame
+ * of decoding, and they're saved to the preview cache directory so they don't need decoding again in later sessions.
+ * The most recently requested thumbnails are decoded first so scrolling or zooming the Timeline doesn't leave it
+ * waiting on thumbnails that are no longer visible.
+ *
+ * All functions are thread-safe.
+ */
+class FilmstripService : public QObject {
+  Q_OBJECT
+public:
+  /**
+   * @brief FilmstripService Constructor
+   *
+   * Must be called after a QGuiApplication has been created.
+   */
+  FilmstripService();
+
+  /**
+   * @brief FilmstripService Destructor
+   *
+   * Discards any queued thumbnails and waits for the background threads to finish.
+   */
+  virtual ~FilmstripService() override;
+
+  /**
+   * @brief Retrieve a thumbnail without blocking
+   *
+   * @param footage
+   *
+   * Footage to retrieve a thumbnail from
+   *
+   * @param stream
+   *
+   * Video stream to retrieve a thumbnail from
+   *
+   * @param time
+   *
+   * Time in seconds from the start of the stream
+   *
+   * @param height
+   *
+   * Height in pixels to scale the thumbnail to (the width follows the stream's aspect ratio)
+   *
+   * @return
+   *
+   * The thumbnail, or a null QImage if it isn't ready yet (in which case it's queued for decoding and ThumbnailsReady()
+   * will be emitted when it is).
+   */
+  QImage GetThumbnail(Footage* footage, const FootageStream* stream, double time, int height);
+
+  /**
+   * @brief Remove all thumbnails of a certain Footage from memory and discard any queued for it
+   *
+   * Must be called whenever a Footage object is deleted or changed in a way that would change its decoded frames.
+   */
+  void RemoveFootage(Footage* footage);
+
+signals:
+  /**
+   * @brief Emitted from a background thread whenever queued thumbnails have been added to the cache
+   */
+  void ThumbnailsReady();
+
+private:
+  struct Request {
+    FilmstripKey key;
+    QString filename;
+  };
+
+  class Worker : public QThread {
+  public:
+    Worker(FilmstripService* service);
+  protected:
+    virtual void run() override;
+  private:
+    FilmstripService* service_;
+  };
+
+  /**
+   * @brief Background thread loop that decodes queued thumbnails until quit_ is set
+   */
+  void ProcessQueue();
+
+  /**
+   * @brief Load a thumbnail from the preview cache directory or decode it from the footage file
+   *
+   * @param decoder
+   *
+   * Decoder owned by the calling thread. It's kept open between requests for the same stream since seeking an open
+   * file is much faster than opening it again.
+   *
+   * @param open_filename, open_stream
+   *
+   * Filename and stream index the decoder currently has open, updated if it opens another.
+   *
+   * @return
+   *
+   * The thumbnail, or a null QImage if no frame could be decoded.
+   */
+  QImage Generate(const Request& request, FFmpegDecoder& decoder, QString& open_filename, int& open_stream);
+
+  /**
+   * @brief Returns the filename a thumbnail is cached to in the preview cache directory
+   */
+  QString GetCacheFilename(const QString& media_filename, const FilmstripKey& key);
+
+  QCache<FilmstripKey, QImage> cache_;
+
+  /**
+   * @brief Requests waiting to be decoded, the most recent request is at the end
+   */
+  QVector<Request> queue_;
+
+  /**
+   * @brief Every requested thumbnail that hasn't been decoded yet (including those being decoded right now)
+   */
+  QSet<FilmstripKey> pending_;
+
+  /**
+   * @brief File hashes (see get_file_hash()) by filename, so files only have to be hashed once per session
+   */
+  QHash<QString, QString> hashes_;
+
+  QMutex lock_;
+
+  QWaitCondition request_queued_;
+
+  QVector<Worker*> workers_;
+
+  QAtomicInt quit_;
+};
+
+namespace olive {
+extern std::unique_ptr<FilmstripService> filmstrip_service;
+}
+
+#endif // FILMSTRIPSERVICE_H
@@ -211,24 +211,6 @@ void GraphView::draw_lines(QPainter& p, bool vert) {
   draw_line_text(p, vert, last_line, last_line_x, width());
 }
 
-QVector<int> sort_keys_from_field(EffectField* field) {
-  QVector<int> sorted_keys;
-  for (int k=0;k<field->keyframes.size();k++) {
-    bool inserted = false;
-    for (int j=0;j<sorted_keys.size();j++) {
-      if (field->keyframes.at(sorted_keys.at(j)).time > field->keyframes.at(k).time) {
-        sorted_keys.insert(j, k);
-        inserted = true;
-        break;
-      }
-    }
-    if (!inserted) {
-      sorted_keys.append(k);
-    }
-  }
-  return sorted_keys;
-}
-
 void GraphView::paintEvent(QPaintEvent *) {
   QPainter p(this);
 
@@ -250,7 +232,7 @@ void GraphView::paintEvent(QPaintEvent *) {
 
         if (field->type() == EffectField::EFFECT_FIELD_DOUBLE && field_visibility.at(i)) {
           // sort keyframes by time
-          QVector<int> sorted_keys = sort_keys_from_field(field);
+          QVector<int> sorted_keys = field->GetSortedKeyframes();
 
           int last_key_x = 0;
           int last_key_y = 0;
@@ -385,6 +367,7 @@ void GraphView::mousePressEvent(QMouseEvent *event) {
       key.type = click_add_type;
       click_add_key = click_add_field->keyframes.size();
       click_add_field->keyframes.append(key);
+      click_add_field->KeyframesChanged();
       update_ui(false);
       click_add_proc = true;
     } else {
@@ -483,6 +466,7 @@ void GraphView::mouseMoveEvent(QMouseEvent *event) {
     } else if (click_add_proc) {
       click_add_field->keyframes[click_add_key].time = get_value_x(event->pos().x());
       click_add_field->keyframes[click_add_key].data = get_value_y(event->pos().y());
+      click_add_field->KeyframesChanged();
       update_ui(false);
     } else if (rect_select) {
       rect_select_w = event->pos().x() - rect_select_x;
@@ -523,6 +507,7 @@ void GraphView::mouseMoveEvent(QMouseEvent *event) {
           } else {
             row->Field(selected_keys_fields.at(i))->keyframes[selected_keys.at(i)].data = qRound(selected_keys_old_doubles.at(i) + (double(start_y - event->pos().y())/y_zoom));
           }
+          row->Field(selected_keys_fields.at(i))->KeyframesChanged();
         }
         moved_keys = true;
         update_ui(false);
@@ -607,7 +592,7 @@ void GraphView::mouseMoveEvent(QMouseEvent *event) {
       for (int i=0;i<row->FieldCount();i++) {
         EffectField* f = row->Field(i);
         if (field_visibility.at(i)) {
-          QVector<int> sorted_keys = sort_keys_from_field(f);
+          QVector<int> sorted_keys = f->GetSortedKeyframes();
 
           if (!sorted_keys.isEmpty()) {
             if (event->pos().x() <= get_screen_x(f->keyframes.at(sorted_keys.first()).time)) {
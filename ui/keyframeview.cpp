@@ -417,6 +417,7 @@ void KeyframeView::mouseMoveEvent(QMouseEvent* event) {
       for (int i=0;i<selected_keyframes.size();i++) {
         EffectField* field = selected_fields.at(i);
         field->keyframes[selected_keyframes.at(i)].time = old_key_vals.at(i) + frame_diff;
+        field->KeyframesChanged();
       }
 
       last_frame_diff = frame_diff;
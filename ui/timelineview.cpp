@@ -62,6 +62,7 @@
 #include "global/math.h"
 #include "project/projectfunctions.h"
 #include "ui/waveform.h"
+#include "ui/filmstripservice.h"
 
 #define MAX_TEXT_WIDTH 20
 #define TRANSITION_BETWEEN_RANGE 40
@@ -86,6 +87,8 @@ TimelineView::TimelineView(Timeline *parent) :
 
   tooltip_timer.setInterval(500);
   connect(&tooltip_timer, SIGNAL(timeout()), this, SLOT(tooltip_timer_timeout()));
+
+  connect(olive::filmstrip_service.get(), SIGNAL(ThumbnailsReady()), this, SLOT(update()));
 }
 
 void TimelineView::SetAlignment(olive::timeline::Alignment alignment)
@@ -2526,8 +2529,13 @@ void TimelineView::mouseMoveEvent(QMouseEvent *event) {
       // set currently trimming clip to -1 (aka null)
       ParentTimeline()->trim_target = nullptr;
 
-      // loop through current clips in the sequence
-      QVector<Clip*> sequence_clips = sequence()->GetAllClips();
+      // loop through the clips near the cursor (any trim point within the threshold must belong to one of them)
+      QVector<Clip*> sequence_clips;
+      if (ParentTimeline()->cursor_track != nullptr) {
+        sequence_clips = ParentTimeline()->cursor_track->GetClipsInRange(
+              ParentTimeline()->getTimelineFrameFromScreenPoint(mouse_frame_lower) - 1,
+              ParentTimeline()->getTimelineFrameFromScreenPoint(mouse_frame_upper) + 2);
+      }
       for (int i=0;i<sequence_clips.size();i++) {
         Clip* c = sequence_clips.at(i);
 
@@ -2955,18 +2963,64 @@ void TimelineView::paintEvent(QPaintEvent*) {
                         && thumb_height > thumb_y
                         && thumb_y + thumb_height >= 0
                         && space_for_thumb > MAX_TEXT_WIDTH) {
-                      int thumb_clip_width = qMin(thumb_width, space_for_thumb);
-                      p.drawImage(QRect(thumb_x,
-                                        clip_rect.y()+thumb_y,
-                                        thumb_clip_width,
-                                        thumb_height),
-                                  ms->video_preview,
-                                  QRect(0,
-                                        0,
-                                        qRound(thumb_clip_width*(double(ms->video_preview.width())/double(thumb_width))),
-                                        ms->video_preview.height()
-                                        )
-                                  );
+                      double zoom = ParentTimeline()->zoom;
+
+                      // thumbnails are spaced a power of two frames apart (anchored to the media rather than the
+                      // clip) so trimming or scrolling reuses the same thumbnails, and zooming only adds or removes
+                      // every other one
+                      long tile_frames = 1;
+                      if (!ms->infinite_length) {
+                        while (tile_frames * zoom < thumb_width) {
+                          tile_frames <<= 1;
+                        }
+                      }
+
+                      int thumb_limit = qMin(thumb_x + space_for_thumb, width());
+                      long first_tile = clip->clip_in() / tile_frames;
+
+                      for (long k=first_tile;;k++) {
+                        int tile_x = clip_rect.x() + 1 + qRound((k * tile_frames - clip->clip_in()) * zoom);
+                        if (tile_x >= thumb_limit || (ms->infinite_length && k > first_tile)) {
+                          break;
+                        }
+                        if (tile_x + thumb_width < qMax(thumb_x, 0)) {
+                          continue;
+                        }
+
+                        QImage thumbnail;
+                        if (!ms->infinite_length) {
+                          long playhead = clip->timeline_in() + qMax(k * tile_frames, long(clip->clip_in())) - clip->clip_in();
+                          thumbnail = olive::filmstrip_service->GetThumbnail(clip->media()->to_footage(),
+                                                                             ms,
+                                                                             playhead_to_clip_seconds(clip, playhead),
+                                                                             thumb_height);
+                        }
+
+                        // fall back to the footage's preview thumbnail until this one has been decoded
+                        if (thumbnail.isNull()) {
+                          thumbnail = ms->video_preview;
+                        }
+
+                        // crop the thumbnail to the space between the transitions
+                        QRect target(tile_x, clip_rect.y()+thumb_y, thumb_width, thumb_height);
+                        QRect visible = target.intersected(QRect(thumb_x,
+                                                                 target.y(),
+                                                                 thumb_limit - thumb_x,
+                                                                 thumb_height));
+                        if (visible.isEmpty()) {
+                          continue;
+                        }
+
+                        double source_scale = double(thumbnail.width()) / double(thumb_width);
+                        p.drawImage(visible,
+                                    thumbnail,
+                                    QRect(qRound((visible.x() - target.x()) * source_scale),
+                                          0,
+                                          qRound(visible.width() * source_scale),
+                                          thumbnail.height()
+                                          )
+                                    );
+                      }
                     }
                   }
                   if (clip->timeline_out() - clip->timeline_in() + clip->clip_in() > clip->media_length()) {
@@ -244,7 +244,7 @@ void ViewerWidget::frame_update() {
     }
 
     // render the audio
-    olive::rendering::compose_audio(viewer, viewer->seq.get(), viewer->get_playback_speed(), false);
+    olive::rendering::compose_audio(viewer, viewer->seq.get(), viewer->audio_context(), viewer->get_playback_speed(), false);
   }
 }
 
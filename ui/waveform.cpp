@@ -6,7 +6,7 @@
 
 int ConvertSampleToHeight(qint8 signed_sample, int channel_height) {
   int half_channel_height = channel_height >> 1;
-  return (half_channel_height) + qRound(((double(signed_sample) / 128.0)) * half_channel_height);
+  return (half_channel_height) + qRound(((double(signed_sample) / 127.0)) * half_channel_height);
 }
 
 void olive::ui::DrawWaveform(Clip* clip,
@@ -18,53 +18,67 @@ void olive::ui::DrawWaveform(Clip* clip,
                               int waveform_limit,
                               double zoom) {
 
-  int divider = ms->audio_channels;
+  const WaveformPyramid* waveform = ms->audio_preview.get();
 
-  int channel_height = clip_rect.height()/ms->audio_channels;
+  if (waveform == nullptr || waveform->level_size(0) == 0 || media_length <= 0) {
+    return;
+  }
+
+  int channels = waveform->channels();
+
+  int channel_height = clip_rect.height()/channels;
 
-  int last_waveform_index = -1;
+  // pick the level with roughly one point per pixel, so drawing costs the same at any zoom
+  double points_per_pixel = double(waveform->level_size(0)) / (double(media_length) * zoom);
+  int level = waveform->FindLevel(points_per_pixel);
+  qint64 level_size = waveform->level_size(level);
+
+  // the RMS is drawn inside the peaks in a lighter color
+  QPen peak_pen = p->pen();
+  QPen rms_pen = peak_pen;
+  rms_pen.setColor(peak_pen.color().lighter(160));
 
   for (int i=waveform_start;i<waveform_limit;i++) {
-    int waveform_index = qFloor((((clip->clip_in() + (double(i)/zoom))/media_length) * ms->audio_preview.size())/divider)*divider;
+    // range of points covered by this pixel
+    qint64 start = qFloor(((clip->clip_in() + (double(i)/zoom))/media_length) * level_size);
+    qint64 end = qFloor(((clip->clip_in() + (double(i+1)/zoom))/media_length) * level_size);
 
-    if (clip->reversed()) {
-      waveform_index = ms->audio_preview.size() - waveform_index - (ms->audio_channels * 2);
+    if (start >= level_size) {
+      break;
     }
 
-    if (last_waveform_index < 0) last_waveform_index = waveform_index;
+    if (clip->reversed()) {
+      qint64 reversed_start = level_size - end;
+      end = level_size - start;
+      start = reversed_start;
+    }
 
-    for (int j=0;j<ms->audio_channels;j++) {
+    for (int j=0;j<channels;j++) {
       int bottom = clip_rect.top()+channel_height*(j+1);
 
-      int offset_range_start = last_waveform_index+(j*2);
-      int offset_range_end = waveform_index+(j*2);
-      int offset_range_min = qMin(offset_range_start, offset_range_end);
-      int offset_range_max = qMax(offset_range_start, offset_range_end);
+      WaveformPoint point = waveform->Summarize(level, j, start, end);
 
-      // Break if we're about to draw from an index that doesn't exist
-      if (offset_range_min+1 >= ms->audio_preview.size()) {
-        break;
-      }
+      int x = clip_rect.left()+i;
 
-      int min = ConvertSampleToHeight(ms->audio_preview.at(offset_range_min), channel_height);
-      int max = ConvertSampleToHeight(ms->audio_preview.at(offset_range_min+1), channel_height);
+      if (olive::config.rectified_waveforms) {
+        int peak = qMax(-int(point.min), int(point.max));
 
-      if ((offset_range_max + 1) < ms->audio_preview.size()) {
+        p->setPen(peak_pen);
+        p->drawLine(x, bottom, x, bottom - qRound(double(peak) / 127.0 * channel_height));
 
-        // for waveform drawings, we get the maximum below 0 and maximum above 0 for this waveform range
-        for (int k=offset_range_min+2;k<=offset_range_max;k+=2) {
-          min = ConvertSampleToHeight(ms->audio_preview.at(k), channel_height);
-          max = ConvertSampleToHeight(ms->audio_preview.at(k+1), channel_height);
-        }
+        p->setPen(rms_pen);
+        p->drawLine(x, bottom, x, bottom - qRound(double(point.rms) / 127.0 * channel_height));
+      } else {
+        p->setPen(peak_pen);
+        p->drawLine(x, bottom - ConvertSampleToHeight(point.min, channel_height),
+                    x, bottom - ConvertSampleToHeight(point.max, channel_height));
 
-        // draw waveforms
-        if (olive::config.rectified_waveforms) {
-          p->drawLine(clip_rect.left()+i, bottom, clip_rect.left()+i, bottom - (max - min));
-        } else {
-          p->drawLine(clip_rect.left()+i, bottom - min, clip_rect.left()+i, bottom - max);
-        }
+        p->setPen(rms_pen);
+        p->drawLine(x, bottom - ConvertSampleToHeight(qint8(-point.rms), channel_height),
+                    x, bottom - ConvertSampleToHeight(point.rms, channel_height));
       }
     }
-    last_waveform_index = waveform_index;
   }
+
+  p->setPen(peak_pen);
 }
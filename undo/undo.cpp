@@ -610,11 +610,13 @@ KeyframeDelete::KeyframeDelete(EffectField *ifield, int iindex) :
 
 void KeyframeDelete::doUndo() {
   field->keyframes.insert(index, deleted_key);
+  field->KeyframesChanged();
 }
 
 void KeyframeDelete::doRedo() {
   deleted_key = field->keyframes.at(index);
   field->keyframes.removeAt(index);
+  field->KeyframesChanged();
 }
 
 SetClipProperty::SetClipProperty(SetClipPropertyType type) : type_(type)
@@ -1076,12 +1078,14 @@ KeyframeAdd::KeyframeAdd(EffectField *ifield, int ii) :
 
 void KeyframeAdd::doUndo() {
   field->keyframes.removeAt(index);
+  field->KeyframesChanged();
   done = false;
 }
 
 void KeyframeAdd::doRedo() {
   if (!done) {
     field->keyframes.insert(index, key);
+    field->KeyframesChanged();
     done = true;
   }
 }
@@ -1195,6 +1199,7 @@ void KeyframeDataChange::SetNewKeyframes()
 void KeyframeDataChange::doUndo()
 {
   field_->keyframes = old_keys_;
+  field_->KeyframesChanged();
   field_->persistent_data_ = old_persistent_data_;
   done_ = false;
 }
@@ -1203,6 +1208,7 @@ void KeyframeDataChange::doRedo()
 {
   if (!done_) {
     field_->keyframes = new_keys_;
+    field_->KeyframesChanged();
     field_->persistent_data_ = new_persistent_data_;
     done_ = true;
   }